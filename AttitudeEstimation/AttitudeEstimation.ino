@@ -9,7 +9,7 @@ SensorXYZ magnetometer(SENSOR_ID_MAG);
 SensorQuaternion quaternion(SENSOR_ID_RV);
 
 // setup sensor manager object with selected filter
-filters::SensorManager sensor_man(&accelerometer, &gyro, &magnetometer, &quaternion, filters::COMPLEMENTARY);
+filters::SensorManager<filters::COMPLEMENTARY> sensor_man(&accelerometer, &gyro, &magnetometer, &quaternion);
 
 void setup() {
   BHY2.begin();
@@ -0,0 +1,140 @@
+#include "../SensorDriver/FilterDriver.hpp"
+#include "benchmark/benchmark.h"
+#include <memory>
+#include <vector>
+
+using namespace filters;
+using namespace structures;
+
+/**
+ * @brief the previous SensorManager dispatch path: an abstract driver
+ * interface taking its readings by value, owned through a heap allocated
+ * std::unique_ptr chosen by a runtime switch.
+ */
+class LegacyFilterDriver {
+public:
+  virtual ~LegacyFilterDriver() {}
+  virtual Quaternion<double> update(Matrix<double, 3, 1> acc_mat,
+                                    Matrix<double, 3, 1> gyro_mat,
+                                    Matrix<double, 3, 1> mag_mat,
+                                    uint32_t ellapsed_time) = 0;
+};
+
+template <typename DriverT> class LegacyDriverAdapter : public LegacyFilterDriver {
+public:
+  Quaternion<double> update(Matrix<double, 3, 1> acc_mat,
+                            Matrix<double, 3, 1> gyro_mat,
+                            Matrix<double, 3, 1> mag_mat,
+                            uint32_t ellapsed_time) override {
+    return this->_driver.update(acc_mat, gyro_mat, mag_mat, ellapsed_time);
+  }
+
+private:
+  DriverT _driver;
+};
+
+std::unique_ptr<LegacyFilterDriver> makeLegacyDriver(available_filters_t filt) {
+  switch (filt) {
+  case COMPLEMENTARY:
+    return std::make_unique<LegacyDriverAdapter<ComplementaryDriver>>();
+  case EKF:
+    return std::make_unique<LegacyDriverAdapter<EKFDriver>>();
+  case MADGWICK:
+    return std::make_unique<LegacyDriverAdapter<MadgwickDriver>>();
+  case MAHONY:
+    return std::make_unique<LegacyDriverAdapter<MahonyDriver>>();
+  }
+  return nullptr;
+}
+
+/**
+ * @brief a small set of plausible readings that the benchmarks cycle through.
+ */
+struct ReadingSet {
+  ReadingSet() {
+    for (size_t i = 0; i < kNumReadings; i++) {
+      double phase = 0.01 * i;
+      double acc[3][1] = {{0.3 * sin(phase)}, {0.2 * cos(phase)}, {9.78}};
+      double gyro[3][1] = {{0.05 * cos(phase)}, {-0.02}, {0.1 * sin(phase)}};
+      double mag[3][1] = {{22000.0}, {1500.0 * sin(phase)}, {-41000.0}};
+      acc_mats.push_back(Matrix<double, 3, 1>(acc));
+      gyro_mats.push_back(Matrix<double, 3, 1>(gyro));
+      mag_mats.push_back(Matrix<double, 3, 1>(mag));
+
+      SensorSample<double> sample = {
+          {acc[0][0], acc[1][0], acc[2][0]},
+          {gyro[0][0], gyro[1][0], gyro[2][0]},
+          {mag[0][0], mag[1][0], mag[2][0]},
+          10000U * i};
+      samples.push_back(sample);
+    }
+  }
+
+  static const size_t kNumReadings = 256;
+  std::vector<Matrix<double, 3, 1>> acc_mats;
+  std::vector<Matrix<double, 3, 1>> gyro_mats;
+  std::vector<Matrix<double, 3, 1>> mag_mats;
+  std::vector<SensorSample<double>> samples;
+};
+
+static const ReadingSet readings;
+
+template <available_filters_t selected_filter>
+static void BM_LegacyVirtualDispatch(benchmark::State &state) {
+  std::unique_ptr<LegacyFilterDriver> driver = makeLegacyDriver(selected_filter);
+  size_t i = 0;
+  for (auto _ : state) {
+    Quaternion<double> est =
+        driver->update(readings.acc_mats[i], readings.gyro_mats[i],
+                       readings.mag_mats[i], 10000U);
+    benchmark::DoNotOptimize(est);
+    i = (i + 1) % ReadingSet::kNumReadings;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+template <available_filters_t selected_filter>
+static void BM_StaticDispatch(benchmark::State &state) {
+  typename FilterDriverSelector<selected_filter>::type driver;
+  size_t i = 0;
+  for (auto _ : state) {
+    Quaternion<double> est =
+        driver.update(readings.acc_mats[i], readings.gyro_mats[i],
+                      readings.mag_mats[i], 10000U);
+    benchmark::DoNotOptimize(est);
+    i = (i + 1) % ReadingSet::kNumReadings;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+template <available_filters_t selected_filter>
+static void BM_StaticDispatchInPlace(benchmark::State &state) {
+  typename FilterDriverSelector<selected_filter>::type driver;
+  Quaternion<double> est;
+  uint64_t timestamp_us = 0U;
+  size_t i = 0;
+  for (auto _ : state) {
+    SensorSample<double> sample = readings.samples[i];
+    sample.timestamp_us = timestamp_us;
+    driver.update(sample, est);
+    benchmark::DoNotOptimize(est);
+    timestamp_us += 10000U;
+    i = (i + 1) % ReadingSet::kNumReadings;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_LegacyVirtualDispatch, COMPLEMENTARY);
+BENCHMARK_TEMPLATE(BM_StaticDispatch, COMPLEMENTARY);
+BENCHMARK_TEMPLATE(BM_StaticDispatchInPlace, COMPLEMENTARY);
+BENCHMARK_TEMPLATE(BM_LegacyVirtualDispatch, EKF);
+BENCHMARK_TEMPLATE(BM_StaticDispatch, EKF);
+BENCHMARK_TEMPLATE(BM_StaticDispatchInPlace, EKF);
+BENCHMARK_TEMPLATE(BM_LegacyVirtualDispatch, MADGWICK);
+BENCHMARK_TEMPLATE(BM_StaticDispatch, MADGWICK);
+BENCHMARK_TEMPLATE(BM_StaticDispatchInPlace, MADGWICK);
+BENCHMARK_TEMPLATE(BM_LegacyVirtualDispatch, MAHONY);
+BENCHMARK_TEMPLATE(BM_StaticDispatch, MAHONY);
+BENCHMARK_TEMPLATE(BM_StaticDispatchInPlace, MAHONY);
+
+BENCHMARK_MAIN();
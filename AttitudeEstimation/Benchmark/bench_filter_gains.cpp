@@ -0,0 +1,58 @@
+#include "../EstimationAlgs/ComplementaryFilter/ComplementaryFilter.hpp"
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../EstimationAlgs/MahonyFilter/MahonyFilter.hpp"
+#include "../SensorDriver/AlgParams.hpp"
+#include "benchmark/benchmark.h"
+
+using namespace filters;
+using namespace structures;
+
+/**
+ * @brief runs a filter over a slowly rotating synthetic input.
+ */
+template <typename FilterT>
+static void runFilter(benchmark::State &state, FilterT filt) {
+  Quaternion<double> est;
+  SensorSample<double> sample = {
+      {0.3, 0.2, 9.78}, {0.05, -0.02, 0.1}, {22000.0, 1500.0, -41000.0}, 0U};
+  for (auto _ : state) {
+    sample.timestamp_us += 10000U;
+    sample.gyro[2] = -sample.gyro[2];
+    filt.update(sample, est);
+    benchmark::DoNotOptimize(est);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_ComplementaryRuntimeGains(benchmark::State &state) {
+  runFilter(state, ComplementaryFilter(ComplementaryParams::alpha()));
+}
+
+static void BM_ComplementaryCompileTimeGains(benchmark::State &state) {
+  runFilter(state, BasicComplementaryFilter<ComplementaryParams>());
+}
+
+static void BM_MadgwickRuntimeGains(benchmark::State &state) {
+  runFilter(state, MadgwickFilter(MadgwickParams::beta()));
+}
+
+static void BM_MadgwickCompileTimeGains(benchmark::State &state) {
+  runFilter(state, BasicMadgwickFilter<MadgwickParams>());
+}
+
+static void BM_MahonyRuntimeGains(benchmark::State &state) {
+  runFilter(state, MahonyFilter(MahonyParams::kI(), MahonyParams::kP()));
+}
+
+static void BM_MahonyCompileTimeGains(benchmark::State &state) {
+  runFilter(state, BasicMahonyFilter<MahonyParams>());
+}
+
+BENCHMARK(BM_ComplementaryRuntimeGains);
+BENCHMARK(BM_ComplementaryCompileTimeGains);
+BENCHMARK(BM_MadgwickRuntimeGains);
+BENCHMARK(BM_MadgwickCompileTimeGains);
+BENCHMARK(BM_MahonyRuntimeGains);
+BENCHMARK(BM_MahonyCompileTimeGains);
+
+BENCHMARK_MAIN();
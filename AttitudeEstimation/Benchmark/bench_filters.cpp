@@ -0,0 +1,66 @@
+#include "../SensorDriver/FilterDriver.hpp"
+#include "../Simulation/ImuSimulator.hpp"
+#include "benchmark/benchmark.h"
+#include <vector>
+
+using namespace filters;
+using namespace structures;
+
+/**
+ * @brief runs the in-place driver update, the path SensorManager uses.
+ */
+template <available_filters_t selected_filter>
+static void BM_SampleUpdate(benchmark::State &state) {
+  typename FilterDriverSelector<selected_filter>::type driver;
+  const std::vector<SensorSample<double>> &input =
+      simulation::handheldReadings();
+  Quaternion<double> est;
+  size_t i = 0;
+  uint64_t offset_us = 0;
+  for (auto _ : state) {
+    SensorSample<double> sample = input[i];
+    sample.timestamp_us += offset_us;
+    driver.update(sample, est);
+    benchmark::DoNotOptimize(est);
+    if (++i == input.size()) {
+      // keep timestamps increasing across cycles
+      i = 0;
+      offset_us += input.back().timestamp_us + 10000U;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * @brief runs the matrix driver update, the original filter interface.
+ */
+template <available_filters_t selected_filter>
+static void BM_MatrixUpdate(benchmark::State &state) {
+  typename FilterDriverSelector<selected_filter>::type driver;
+  const std::vector<SensorSample<double>> &input =
+      simulation::handheldReadings();
+  size_t i = 0;
+  for (auto _ : state) {
+    const SensorSample<double> &sample = input[i];
+    double acc[3][1] = {{sample.acc[0]}, {sample.acc[1]}, {sample.acc[2]}};
+    double gyro[3][1] = {{sample.gyro[0]}, {sample.gyro[1]}, {sample.gyro[2]}};
+    double mag[3][1] = {{sample.mag[0]}, {sample.mag[1]}, {sample.mag[2]}};
+    Quaternion<double> est =
+        driver.update(Matrix<double, 3, 1>(acc), Matrix<double, 3, 1>(gyro),
+                      Matrix<double, 3, 1>(mag), 10000U);
+    benchmark::DoNotOptimize(est);
+    i = i + 1 == input.size() ? 0 : i + 1;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_SampleUpdate, COMPLEMENTARY);
+BENCHMARK_TEMPLATE(BM_SampleUpdate, EKF);
+BENCHMARK_TEMPLATE(BM_SampleUpdate, MADGWICK);
+BENCHMARK_TEMPLATE(BM_SampleUpdate, MAHONY);
+BENCHMARK_TEMPLATE(BM_MatrixUpdate, COMPLEMENTARY);
+BENCHMARK_TEMPLATE(BM_MatrixUpdate, EKF);
+BENCHMARK_TEMPLATE(BM_MatrixUpdate, MADGWICK);
+BENCHMARK_TEMPLATE(BM_MatrixUpdate, MAHONY);
+
+BENCHMARK_MAIN();
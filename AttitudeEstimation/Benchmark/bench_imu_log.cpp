@@ -0,0 +1,164 @@
+#include "../ImuLog/ImuArchive.hpp"
+#include "../ImuLog/ImuArchiveReader.hpp"
+#include "../ImuLog/ImuLog.hpp"
+#include "../ImuLog/ImuLogReader.hpp"
+#include "../SensorDriver/SensorSources.hpp"
+#include "benchmark/benchmark.h"
+#include <unistd.h>
+#include <vector>
+
+using namespace filters;
+using namespace imulog;
+
+static const uint64_t kLogSamples = 1000000;
+static const size_t kChunkRecords = 4096;
+static const char *kLogPath = "/tmp/bench_imu_log.imulog";
+static const char *kCsvPath = "/tmp/bench_imu_log.csv";
+static const char *kArchivePath = "/tmp/bench_imu_log.imuarc";
+
+/**
+ * @brief writes the same synthetic recording as a binary log, as an archive
+ * and as CSV.
+ */
+static void writeRecordings() {
+  const double body_rate[3] = {0.2, -0.1, 0.4};
+  SyntheticSensorSource source(kLogSamples, 200.0, body_rate);
+  ImuLogWriter writer;
+  writer.open(kLogPath, makeHeader(200.0));
+  ImuArchiveWriter archive;
+  archive.open(kArchivePath, 200.0, true);
+  FILE *csv = fopen(kCsvPath, "w");
+  fputs(kRecordedSampleHeader, csv);
+
+  AcquiredSample sample;
+  ArchiveSample archived;
+  while (source.read(sample)) {
+    writer.write(sample);
+    archived.raw = sample.raw;
+    archived.ground_truth = sample.ground_truth;
+    archived.estimate = sample.ground_truth;
+    archive.write(archived);
+    writeRecordedSample(csv, sample);
+  }
+  writer.close();
+  archive.close();
+  fclose(csv);
+}
+
+static void BM_ImuLogScan(benchmark::State &state) {
+  ImuLogReader reader;
+  reader.open(kLogPath);
+  uint64_t checksum = 0;
+  for (auto _ : state) {
+    ImuLogChunker chunker(reader, kChunkRecords, false);
+    Span<const LoggedSample> chunk;
+    while (chunker.next(chunk)) {
+      for (const LoggedSample &record : chunk) {
+        checksum += record.raw.timestamp_us + record.raw.acc[2];
+      }
+    }
+  }
+  benchmark::DoNotOptimize(checksum);
+  state.SetItemsProcessed(state.iterations() * reader.size());
+  state.SetBytesProcessed(state.iterations() * reader.size() *
+                          sizeof(LoggedSample));
+}
+
+static void BM_ImuLogCalibrate(benchmark::State &state) {
+  ImuLogReader reader;
+  reader.open(kLogPath);
+  SensorCalibration<double> calibration =
+      headerCalibration(reader.getHeader());
+  std::vector<SensorSample<double>> calibrated(kChunkRecords);
+  for (auto _ : state) {
+    ImuLogChunker chunker(reader, kChunkRecords, false);
+    Span<const LoggedSample> chunk;
+    while (chunker.next(chunk)) {
+      calibrateRecords(calibration, chunk, calibrated.data());
+      benchmark::DoNotOptimize(calibrated.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * reader.size());
+  state.SetBytesProcessed(state.iterations() * reader.size() *
+                          sizeof(LoggedSample));
+}
+
+static void BM_ImuArchiveDecode(benchmark::State &state) {
+  ImuArchiveReader reader;
+  reader.open(kArchivePath);
+  ArchiveBlock block;
+  uint64_t checksum = 0;
+  for (auto _ : state) {
+    for (size_t b = 0; b < reader.blockCount(); b++) {
+      reader.decode(b, block);
+      checksum += block.timestamp_us.back() + block.raw[2].back();
+    }
+  }
+  benchmark::DoNotOptimize(checksum);
+  state.SetItemsProcessed(state.iterations() * reader.size());
+  state.SetBytesProcessed(state.iterations() * reader.byteSize());
+  state.counters["bytes_per_sample"] =
+      (double)reader.byteSize() / reader.size();
+}
+
+static void BM_ImuArchiveSource(benchmark::State &state) {
+  ImuArchiveReader reader;
+  reader.open(kArchivePath);
+  uint64_t checksum = 0;
+  for (auto _ : state) {
+    ImuArchiveSensorSource source(reader);
+    AcquiredSample sample;
+    while (source.read(sample)) {
+      checksum += sample.raw.timestamp_us + sample.raw.acc[2];
+    }
+  }
+  benchmark::DoNotOptimize(checksum);
+  state.SetItemsProcessed(state.iterations() * reader.size());
+}
+
+static void BM_ImuLogSource(benchmark::State &state) {
+  ImuLogReader reader;
+  reader.open(kLogPath);
+  uint64_t checksum = 0;
+  for (auto _ : state) {
+    ImuLogSensorSource source(reader);
+    AcquiredSample sample;
+    while (source.read(sample)) {
+      checksum += sample.raw.timestamp_us + sample.raw.acc[2];
+    }
+  }
+  benchmark::DoNotOptimize(checksum);
+  state.SetItemsProcessed(state.iterations() * reader.size());
+}
+
+static void BM_CsvRead(benchmark::State &state) {
+  uint64_t samples = 0;
+  for (auto _ : state) {
+    FILE *csv = fopen(kCsvPath, "r");
+    RecordedSensorSource source(csv);
+    AcquiredSample sample;
+    while (source.read(sample)) {
+      samples++;
+    }
+    fclose(csv);
+  }
+  state.SetItemsProcessed(samples);
+}
+
+BENCHMARK(BM_ImuLogScan)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ImuLogCalibrate)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ImuArchiveDecode)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ImuArchiveSource)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ImuLogSource)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CsvRead)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char **argv) {
+  writeRecordings();
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  unlink(kLogPath);
+  unlink(kCsvPath);
+  unlink(kArchivePath);
+  return 0;
+}
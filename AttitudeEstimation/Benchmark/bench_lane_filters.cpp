@@ -0,0 +1,72 @@
+#include "../EstimationAlgs/LaneFilters/LaneMadgwickFilter.hpp"
+#include "../EstimationAlgs/LaneFilters/LaneMahonyFilter.hpp"
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../EstimationAlgs/MahonyFilter/MahonyFilter.hpp"
+#include "../Simulation/ImuSimulator.hpp"
+#include "benchmark/benchmark.h"
+#include <vector>
+
+using namespace filters;
+using namespace structures;
+
+/**
+ * @brief updates width scalar filters one after the other, each reading
+ * the input at its own offset. Items are filter updates.
+ */
+template <typename FilterT, size_t width>
+static void BM_ScalarFilters(benchmark::State &state) {
+  std::vector<FilterT> filts(width);
+  const std::vector<SensorSample<double>> &input =
+      simulation::handheldReadings();
+  Quaternion<double> est;
+  size_t i = 0;
+  uint64_t offset_us = 0;
+  for (auto _ : state) {
+    for (size_t lane = 0; lane < width; lane++) {
+      SensorSample<double> sample = input[(i + lane) % input.size()];
+      sample.timestamp_us = offset_us;
+      filts[lane].update(sample, est);
+      benchmark::DoNotOptimize(est);
+    }
+    i = i + 1 == input.size() ? 0 : i + 1;
+    offset_us += 10000U;
+  }
+  state.SetItemsProcessed(state.iterations() * width);
+}
+
+/**
+ * @brief updates a lane filter with the same input as BM_ScalarFilters.
+ * Items are filter updates, so the two are directly comparable.
+ */
+template <template <size_t> class LaneFilterT, size_t width>
+static void BM_LaneFilters(benchmark::State &state) {
+  LaneFilterT<width> filt;
+  const std::vector<SensorSample<double>> &input =
+      simulation::handheldReadings();
+  LaneSamples<width> samples;
+  size_t i = 0;
+  uint64_t offset_us = 0;
+  for (auto _ : state) {
+    for (size_t lane = 0; lane < width; lane++) {
+      samples.set(lane, input[(i + lane) % input.size()]);
+      samples.timestamp_us[lane] = offset_us;
+    }
+    filt.update(samples);
+    benchmark::DoNotOptimize(filt);
+    i = i + 1 == input.size() ? 0 : i + 1;
+    offset_us += 10000U;
+  }
+  state.SetItemsProcessed(state.iterations() * width);
+  state.SetLabel(LaneFilterT<width>::vector_t::ops_t::name());
+}
+
+BENCHMARK_TEMPLATE(BM_ScalarFilters, MadgwickFilter, 16);
+BENCHMARK_TEMPLATE(BM_LaneFilters, LaneMadgwickFilter, 4);
+BENCHMARK_TEMPLATE(BM_LaneFilters, LaneMadgwickFilter, 8);
+BENCHMARK_TEMPLATE(BM_LaneFilters, LaneMadgwickFilter, 16);
+BENCHMARK_TEMPLATE(BM_ScalarFilters, MahonyFilter, 16);
+BENCHMARK_TEMPLATE(BM_LaneFilters, LaneMahonyFilter, 4);
+BENCHMARK_TEMPLATE(BM_LaneFilters, LaneMahonyFilter, 8);
+BENCHMARK_TEMPLATE(BM_LaneFilters, LaneMahonyFilter, 16);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,57 @@
+#include "../Simulation/ImuSimulator.hpp"
+#include "../Simulation/Trajectory.hpp"
+#include "benchmark/benchmark.h"
+#include <vector>
+
+using namespace simulation;
+
+static const size_t kBatchSamples = 4096;
+
+/**
+ * @brief a long spline of 1000 keyframes half a second apart.
+ */
+static std::vector<Keyframe> benchKeyframes() {
+  std::vector<Keyframe> keyframes;
+  for (int i = 0; i < 1000; i++) {
+    Keyframe keyframe = {i * 0.5,
+                         {0.3 * sin(i), 0.2 * cos(i), 0.1 * i},
+                         {sin(0.7 * i), cos(0.3 * i), 0.1 * sin(i)}};
+    keyframes.push_back(keyframe);
+  }
+  return keyframes;
+}
+
+/**
+ * @brief generates batches of 200 Hz samples along a trajectory.
+ */
+template <typename TrajectoryT>
+static void runSimulator(benchmark::State &state, const TrajectoryT &trajectory,
+                         const NoiseModel &noise) {
+  ImuSimulator<TrajectoryT> simulator(trajectory, 200.0, noise, 1);
+  std::vector<SimulatedSample> batch(kBatchSamples);
+  for (auto _ : state) {
+    simulator.generate(batch.data(), batch.size());
+    benchmark::DoNotOptimize(batch.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSamples);
+}
+
+static void BM_SinusoidalIdeal(benchmark::State &state) {
+  runSimulator(state, SinusoidalTrajectory::handheld(), NoiseModel::ideal());
+}
+
+static void BM_SinusoidalMems(benchmark::State &state) {
+  runSimulator(state, SinusoidalTrajectory::handheld(),
+               NoiseModel::consumerMems());
+}
+
+static void BM_SplineMems(benchmark::State &state) {
+  runSimulator(state, SplineTrajectory(benchKeyframes()),
+               NoiseModel::consumerMems());
+}
+
+BENCHMARK(BM_SinusoidalIdeal);
+BENCHMARK(BM_SinusoidalMems);
+BENCHMARK(BM_SplineMems);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,237 @@
+#include "../Angle/Angle.hpp"
+#include "../Euler/Euler.hpp"
+#include "../Matrix/Matrix.hpp"
+#include "../Quaternion/Quaternion.hpp"
+#include "benchmark/benchmark.h"
+
+using namespace structures;
+
+/**
+ * @brief fills a matrix with distinct non-trivial values.
+ */
+template <size_t rows, size_t cols>
+static Matrix<double, rows, cols> filledMatrix(double seed) {
+  Matrix<double, rows, cols> mat;
+  for (size_t row = 0; row < rows; row++) {
+    for (size_t col = 0; col < cols; col++) {
+      mat.setValue(row, col, seed + 0.37 * row - 0.11 * col);
+    }
+  }
+  return mat;
+}
+
+/**
+ * @brief a 3x1 reading vector, the shape of every filter input.
+ */
+static void BM_MatrixAdd3x1(benchmark::State &state) {
+  Matrix<double, 3, 1> a = filledMatrix<3, 1>(0.5);
+  Matrix<double, 3, 1> b = filledMatrix<3, 1>(-1.5);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    Matrix<double, 3, 1> sum = a + b;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_MatrixScale3x1(benchmark::State &state) {
+  Matrix<double, 3, 1> a = filledMatrix<3, 1>(0.5);
+  double scale = 0.01;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(scale);
+    Matrix<double, 3, 1> scaled = a * scale;
+    benchmark::DoNotOptimize(scaled);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_MatrixNorm3x1(benchmark::State &state) {
+  Matrix<double, 3, 1> a = filledMatrix<3, 1>(0.5);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    double norm = a.norm();
+    benchmark::DoNotOptimize(norm);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * @brief the Madgwick gradient: a 6x4 Jacobian transposed and applied to
+ * the 6x1 objective.
+ */
+static void BM_MatrixGradient6x4(benchmark::State &state) {
+  Matrix<double, 6, 4> jacobian = filledMatrix<6, 4>(0.2);
+  Matrix<double, 6, 1> objective = filledMatrix<6, 1>(-0.3);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(jacobian);
+    Matrix<double, 4, 1> gradient = jacobian.transpose() * objective;
+    benchmark::DoNotOptimize(gradient);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_MatrixConstruct6x4(benchmark::State &state) {
+  double values[6][4];
+  for (size_t row = 0; row < 6; row++) {
+    for (size_t col = 0; col < 4; col++) {
+      values[row][col] = 0.1 * row + 0.01 * col;
+    }
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(values);
+    Matrix<double, 6, 4> mat(values);
+    benchmark::DoNotOptimize(mat);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * @brief a 3x3 rotation applied to a reading.
+ */
+static void BM_MatrixMultiply3x3x1(benchmark::State &state) {
+  Matrix<double, 3, 3> rotation = filledMatrix<3, 3>(0.1);
+  Matrix<double, 3, 1> reading = filledMatrix<3, 1>(9.8);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(rotation);
+    Matrix<double, 3, 1> rotated = rotation * reading;
+    benchmark::DoNotOptimize(rotated);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * @brief a 4x4 product, the shape of a quaternion state covariance update.
+ */
+static void BM_MatrixMultiply4x4x4(benchmark::State &state) {
+  Matrix<double, 4, 4> a = filledMatrix<4, 4>(0.1);
+  Matrix<double, 4, 4> b = filledMatrix<4, 4>(-0.2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    Matrix<double, 4, 4> product = a * b;
+    benchmark::DoNotOptimize(product);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_QuaternionMultiply(benchmark::State &state) {
+  Quaternion<double> a(0.1, 0.2, 0.3, 0.927);
+  Quaternion<double> b(-0.3, 0.1, 0.05, 0.948);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    Quaternion<double> product = a * b;
+    benchmark::DoNotOptimize(product);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_QuaternionNorm(benchmark::State &state) {
+  Quaternion<double> a(0.1, 0.2, 0.3, 0.9);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    Quaternion<double> normalized = a.norm();
+    benchmark::DoNotOptimize(normalized);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * @brief the gyroscope integration step: q + (q * omega) * dt / 2.
+ */
+static void BM_QuaternionIntegrate(benchmark::State &state) {
+  Quaternion<double> q(0.1, 0.2, 0.3, 0.927);
+  Quaternion<double> omega(0.05, -0.02, 0.1, 0.0);
+  double half_dt = 0.005;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(q);
+    Quaternion<double> next = (q + (q * omega) * half_dt).norm();
+    benchmark::DoNotOptimize(next);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_QuaternionConj(benchmark::State &state) {
+  Quaternion<double> a(0.1, 0.2, 0.3, 0.927);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    Quaternion<double> conj = a.conj();
+    benchmark::DoNotOptimize(conj);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_EulerToQuaternionRadians(benchmark::State &state) {
+  Euler<double> euler(0.3, -0.2, 1.1, RADIANS);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(euler);
+    Quaternion<double> quat = euler.toQuaternion();
+    benchmark::DoNotOptimize(quat);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_EulerToQuaternionDegrees(benchmark::State &state) {
+  Euler<double> euler(17.0, -11.0, 63.0, DEGREES);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(euler);
+    Quaternion<double> quat = euler.toQuaternion();
+    benchmark::DoNotOptimize(quat);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_AngleAdd(benchmark::State &state) {
+  Angle<double> a(170.0, DEGREES);
+  Angle<double> b(35.0, DEGREES);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    Angle<double> sum = a + b;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * @brief addition across units, converting the right hand side first.
+ */
+static void BM_AngleAddMixedUnits(benchmark::State &state) {
+  Angle<double> a(170.0, DEGREES);
+  Angle<double> b(0.6, RADIANS);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    Angle<double> sum = a + b;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_AngleScale(benchmark::State &state) {
+  Angle<double> a(2.5, RADIANS);
+  double scale = 3.0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(scale);
+    Angle<double> scaled = a * scale;
+    benchmark::DoNotOptimize(scaled);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_MatrixAdd3x1);
+BENCHMARK(BM_MatrixScale3x1);
+BENCHMARK(BM_MatrixNorm3x1);
+BENCHMARK(BM_MatrixGradient6x4);
+BENCHMARK(BM_MatrixConstruct6x4);
+BENCHMARK(BM_MatrixMultiply3x3x1);
+BENCHMARK(BM_MatrixMultiply4x4x4);
+BENCHMARK(BM_QuaternionMultiply);
+BENCHMARK(BM_QuaternionNorm);
+BENCHMARK(BM_QuaternionIntegrate);
+BENCHMARK(BM_QuaternionConj);
+BENCHMARK(BM_EulerToQuaternionRadians);
+BENCHMARK(BM_EulerToQuaternionDegrees);
+BENCHMARK(BM_AngleAdd);
+BENCHMARK(BM_AngleAddMixedUnits);
+BENCHMARK(BM_AngleScale);
+
+BENCHMARK_MAIN();
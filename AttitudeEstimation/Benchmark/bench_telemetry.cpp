@@ -0,0 +1,139 @@
+#include "../SensorDriver/EstimateFormat.hpp"
+#include "../Telemetry/JsonEstimateDecoder.hpp"
+#include "../Telemetry/JsonLineParser.hpp"
+#include "../Telemetry/TelemetryDecoder.hpp"
+#include "../Telemetry/TelemetryProtocol.hpp"
+#include "benchmark/benchmark.h"
+#include <string>
+#include <vector>
+
+using namespace filters;
+
+/**
+ * @brief a set of slowly varying records that the benchmarks cycle through.
+ */
+static std::vector<EstimateRecord> makeRecords() {
+  std::vector<EstimateRecord> records;
+  for (uint32_t i = 0; i < 256; i++) {
+    EstimateRecord record;
+    record.sequence = i;
+    record.timestamp_us = 10000U * i;
+    record.ground_truth =
+        structures::Quaternion<double>(0.1, -0.2 + 0.001 * i, 0.3, 0.9).norm();
+    record.estimate =
+        structures::Quaternion<double>(0.12, -0.21 + 0.001 * i, 0.29, 0.88)
+            .norm();
+    records.push_back(record);
+  }
+  return records;
+}
+
+static const std::vector<EstimateRecord> records = makeRecords();
+
+template <typename FormatterT>
+static void BM_EncodeEstimate(benchmark::State &state) {
+  FormatterT formatter;
+  uint8_t message[FormatterT::kMaxMessageLength];
+  size_t total_bytes = 0;
+  size_t i = 0;
+  for (auto _ : state) {
+    size_t len = formatter.format(records[i], message, sizeof(message));
+    benchmark::DoNotOptimize(message);
+    total_bytes += len;
+    i = (i + 1) % records.size();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(total_bytes);
+  state.counters["bytes_per_sample"] =
+      (double)total_bytes / (double)state.iterations();
+
+  // the link-limited output rate at 115200 baud, 10 bits per byte
+  state.counters["max_rate_115200_hz"] =
+      11520.0 / ((double)total_bytes / (double)state.iterations());
+}
+
+static void BM_DecodeBinaryEstimate(benchmark::State &state) {
+  telemetry::BinaryEstimateFormatter formatter;
+  std::vector<uint8_t> stream;
+  for (const EstimateRecord &record : records) {
+    uint8_t message[telemetry::BinaryEstimateFormatter::kMaxMessageLength];
+    size_t len = formatter.format(record, message, sizeof(message));
+    stream.insert(stream.end(), message, message + len);
+  }
+
+  telemetry::TelemetryDecoder decoder;
+  double checksum = 0;
+  for (auto _ : state) {
+    decoder.feed(stream.data(), stream.size(),
+                 [&checksum](const EstimateRecord &record) {
+                   checksum += record.estimate.getW();
+                 });
+  }
+  benchmark::DoNotOptimize(checksum);
+  state.SetItemsProcessed(state.iterations() * records.size());
+  state.SetBytesProcessed(state.iterations() * stream.size());
+}
+
+/**
+ * @brief a capture of JSON lines, large enough to stream from memory rather
+ * than the cache, as the host reads a long serial recording.
+ */
+static std::string makeJsonCapture() {
+  JsonEstimateFormatter formatter;
+  std::string capture;
+  for (size_t i = 0; i < 65536; i++) {
+    uint8_t message[JsonEstimateFormatter::kMaxMessageLength];
+    size_t len = formatter.format(records[i % records.size()], message,
+                                  sizeof(message));
+    capture.append((const char *)message, len);
+  }
+  return capture;
+}
+
+static void BM_DecodeJsonEstimate(benchmark::State &state) {
+  std::string capture = makeJsonCapture();
+  telemetry::JsonEstimateDecoder decoder;
+  double checksum = 0;
+  for (auto _ : state) {
+    decoder.feed((const uint8_t *)capture.data(), capture.size(),
+                 [&checksum](const EstimateRecord &record) {
+                   checksum += record.estimate.getW();
+                 });
+  }
+  benchmark::DoNotOptimize(checksum);
+  state.SetItemsProcessed(decoder.getFrameCount());
+  state.SetBytesProcessed(state.iterations() * capture.size());
+}
+
+template <typename OpsT>
+static void BM_ParseJsonLines(benchmark::State &state) {
+  std::string capture = makeJsonCapture();
+  telemetry::JsonLineParser<OpsT> parser;
+  static telemetry::EstimateBatch<1024> batch;
+  double checksum = 0;
+  for (auto _ : state) {
+    for (size_t offset = 0; offset < capture.size();) {
+      offset += parser.parse(capture.data() + offset, capture.size() - offset,
+                             batch);
+      for (size_t i = 0; i < batch.count; i++) {
+        checksum += batch.estimate[0][i];
+      }
+      batch.clear();
+    }
+  }
+  benchmark::DoNotOptimize(checksum);
+  state.SetItemsProcessed(parser.getLineCount());
+  state.SetBytesProcessed(state.iterations() * capture.size());
+}
+
+BENCHMARK_TEMPLATE(BM_EncodeEstimate, JsonEstimateFormatter);
+BENCHMARK_TEMPLATE(BM_EncodeEstimate, telemetry::BinaryEstimateFormatter);
+BENCHMARK(BM_DecodeBinaryEstimate);
+BENCHMARK(BM_DecodeJsonEstimate)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_ParseJsonLines, telemetry::ScalarScanOps)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_ParseJsonLines, telemetry::JsonScanOps)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -3,51 +3,88 @@
 #include "../../Euler/Euler.hpp"
 #include "../../Matrix/Matrix.hpp"
 #include "../../Quaternion/Quaternion.hpp"
+#include "../SensorSample.hpp"
 #include <stdint.h>
 
 namespace filters {
-class ComplementaryFilter {
+
+/**
+ * @brief runtime gains for the complementary filter. Compile time gains can
+ * be used instead by passing any type with a matching static constexpr
+ * alpha() function (see AlgParams.hpp).
+ */
+class ComplementaryGains {
+public:
+  /**
+   * @brief constructor for ComplementaryGains class.
+   * @param alpha_gain the complementary gain.
+   */
+  ComplementaryGains(double alpha_gain = 0.0) {
+    this->_alpha_gain = alpha_gain;
+  }
+
+  /**
+   * @brief gets the complementary gain.
+   * @return the complementary gain.
+   */
+  double alpha() const { return this->_alpha_gain; }
+
+private:
+  double _alpha_gain;
+}; // end ComplementaryGains class
+
+/**
+ * @brief complementary filter.
+ * @tparam GainsT the gain provider, either ComplementaryGains for runtime
+ * gains or a compile time gain struct.
+ * @tparam T the scalar type of the estimate and the readings.
+ */
+template <typename GainsT, typename T = double> class BasicComplementaryFilter {
 public:
   /**
-   * @brief constructor for ComplementaryFilter class
+   * @brief constructor for ComplementaryFilter class.
+   * @param gains the complementery gain to use when combining
+   * orientation measured from accelerometer and magnetometer, and
+   * gyroscope. A higher value for alpha results in more preference
+   * given to the gyroscope estimation, and a lower value results in more
+   * preference given to the accelerometer and magnetometer estimation.
    */
-  ComplementaryFilter() {
-    this->_alpha_gain = 0.0;
+  BasicComplementaryFilter(const GainsT &gains = GainsT()) : _gains(gains) {
     this->_last_update_euler =
-        structures::Euler<double>(0, 0, 0, structures::RADIANS);
+        structures::Euler<T>(0, 0, 0, structures::RADIANS);
   }
 
   /**
    * @brief copy constructor for ComplementaryFilter class
    */
-  ComplementaryFilter(const ComplementaryFilter& other) {
-    this->_alpha_gain = other._alpha_gain;
+  BasicComplementaryFilter(const BasicComplementaryFilter &other)
+      : _gains(other._gains) {
     this->_last_update_euler = other._last_update_euler;
+    this->_sample_timer = other._sample_timer;
   }
 
   /**
    * @brief copy assignment operator overload for ComplementaryFilter class
    */
-  ComplementaryFilter operator=(const ComplementaryFilter& other) {
-    this->_alpha_gain = other._alpha_gain;
+  BasicComplementaryFilter &operator=(const BasicComplementaryFilter &other) {
+    this->_gains = other._gains;
     this->_last_update_euler = other._last_update_euler;
+    this->_sample_timer = other._sample_timer;
 
     return *this;
   }
 
   /**
-   * @brief constructor for ComplementaryFilter class.
-   * @param alpha_gain the complementery gain to use when combining
-   * orientation measured from accelerometer and magnetometer, and
-   * gyroscope. A higher value for alpha_gain results in more preference
-   * given to the gyroscope estimation, and a lower value results in more
-   * preference given to the accelerometer and magnetometer estimation.
+   * @brief gets the gains used by this filter.
+   * @return the gains used by this filter.
    */
-  ComplementaryFilter(float alpha_gain) {
-    this->_alpha_gain = alpha_gain;
-    this->_last_update_euler =
-        structures::Euler<double>(0, 0, 0, structures::RADIANS);
-  }
+  const GainsT &getGains() const { return this->_gains; }
+
+  /**
+   * @brief sets the gains used by this filter.
+   * @param gains the new gains.
+   */
+  void setGains(const GainsT &gains) { this->_gains = gains; }
 
   /**
    * @brief Complementary filter update function. NOTE: all reading matricies
@@ -58,68 +95,99 @@ public:
    * @param ellapsed_time elapsed time in microseconds since last update.
    * @return a Quaternion instance with the newly estimated attitude.
    */
-  structures::Quaternion<double>
-  update(structures::Matrix<double, 3, 1> acc_readings,
-         structures::Matrix<double, 3, 1> gyro_readings,
-         structures::Matrix<double, 3, 1> mag_readings, uint32_t ellapsed_time) {
+  structures::Quaternion<T>
+  update(const structures::Matrix<T, 3, 1> &acc_readings,
+         const structures::Matrix<T, 3, 1> &gyro_readings,
+         const structures::Matrix<T, 3, 1> &mag_readings,
+         uint32_t ellapsed_time) {
+    structures::Quaternion<T> new_quat_est;
+    this->step(acc_readings.data(), gyro_readings.data(), mag_readings.data(),
+               ellapsed_time, new_quat_est);
+    return new_quat_est;
+  }
+
+  /**
+   * @brief in-place Complementary filter update function. The elapsed time
+   * is derived from the timestamp of the previously provided sample.
+   * @param sample the new sensor sample.
+   * @param out the quaternion to write the newly estimated attitude into.
+   */
+  void update(const SensorSample<T> &sample,
+              structures::Quaternion<T> &out) {
+    this->step(sample.acc, sample.gyro, sample.mag,
+               this->_sample_timer.elapsed(sample.timestamp_us), out);
+  }
+
+private:
+  /**
+   * @brief performs the filter update on raw <X, Y, Z> reading triples.
+   * @param acc_readings accelerometer reading triple.
+   * @param gyro_readings gyroscope reading triple.
+   * @param mag_readings magnetometer reading triple.
+   * @param ellapsed_time elapsed time in microseconds since last update.
+   * @param out the quaternion to write the newly estimated attitude into.
+   */
+  void step(const T acc_readings[3], const T gyro_readings[3],
+            const T mag_readings[3], uint32_t ellapsed_time,
+            structures::Quaternion<T> &out) {
     // compute tilt angles from accelerometer readings
-    double theta_x =
-        atan2(acc_readings.getValue(1, 0), acc_readings.getValue(2, 0));
-    double ay_az_mag = sqrt(pow(acc_readings.getValue(1, 0), 2) +
-                            pow(acc_readings.getValue(2, 0), 2));
-    double theta_y = atan2(-acc_readings.getValue(0, 0), ay_az_mag);
-
-    // need to compute z angle using magnetometer readings
-    structures::Matrix<double, 3, 3> mag_field_comp;
-    mag_field_comp.setValue(0, 0, cos(theta_x));
-    mag_field_comp.setValue(0, 1, sin(theta_x) * sin(theta_y));
-    mag_field_comp.setValue(0, 2, sin(theta_x) * cos(theta_y));
-    mag_field_comp.setValue(1, 0, 0.0);
-    mag_field_comp.setValue(1, 1, cos(theta_y));
-    mag_field_comp.setValue(1, 2, -sin(theta_y));
-    mag_field_comp.setValue(2, 0, -sin(theta_x));
-    mag_field_comp.setValue(2, 1, cos(theta_x) * sin(theta_y));
-    mag_field_comp.setValue(2, 2, cos(theta_x) * cos(theta_y));
-
-    structures::Matrix<double, 3, 1> mag_field_comp_post_mul =
-        mag_field_comp * mag_readings;
+    T theta_x = atan2(acc_readings[1], acc_readings[2]);
+    T ay_az_mag = sqrt(pow(acc_readings[1], 2) + pow(acc_readings[2], 2));
+    T theta_y = atan2(-acc_readings[0], ay_az_mag);
+
+    // need to compute z angle using magnetometer readings. Only the first two
+    // rows of the tilt compensation matrix are needed for theta_z.
+    T mag_comp_x = cos(theta_x) * mag_readings[0] +
+                   sin(theta_x) * sin(theta_y) * mag_readings[1] +
+                   sin(theta_x) * cos(theta_y) * mag_readings[2];
+    T mag_comp_y =
+        cos(theta_y) * mag_readings[1] - sin(theta_y) * mag_readings[2];
 
     // compute theta_z
-    double theta_z = atan2(-mag_field_comp_post_mul.getValue(1, 0),
-                           mag_field_comp_post_mul.getValue(0, 0));
-
-    // construct Euler that was estimated from accelerometer and magnetometer
-    // data
-    structures::Euler<double> euler_accel_mag(theta_x, theta_y, theta_z,
-                                              structures::RADIANS);
+    T theta_z = atan2(-mag_comp_y, mag_comp_x);
 
     // now estimate the orientation from the gyroscope readings alone
-    double delta_t_sec = ellapsed_time / 1000000.0;
+    T delta_t_sec = ellapsed_time / ((T)1000000.0);
 
     // perform basic numerical integration to get angle from angular rates
-    theta_x = gyro_readings.getValue(0, 0) * delta_t_sec;
-    theta_y = gyro_readings.getValue(1, 0) * delta_t_sec;
-    theta_z = gyro_readings.getValue(2, 0) * delta_t_sec;
-    structures::Euler<double> euler_gyro_instantaneous(
-        theta_x, theta_y, theta_z, structures::RADIANS);
+    structures::Euler<T> euler_gyro_instantaneous(
+        gyro_readings[0] * delta_t_sec, gyro_readings[1] * delta_t_sec,
+        gyro_readings[2] * delta_t_sec, structures::RADIANS);
 
     // add angle to previous angle
-    structures::Euler<double> euler_gyro =
+    structures::Euler<T> euler_gyro =
         this->_last_update_euler + euler_gyro_instantaneous;
 
+    // a zero magnetometer reading means there is no magnetometer, so the
+    // heading comes from the gyroscope alone
+    if (mag_readings[0] == 0 && mag_readings[1] == 0 &&
+        mag_readings[2] == 0) {
+      theta_z = euler_gyro.getZ().getAngleValue();
+    }
+
+    // construct Euler that was estimated from accelerometer and magnetometer
+    // data
+    structures::Euler<T> euler_accel_mag(theta_x, theta_y, theta_z,
+                                         structures::RADIANS);
+
     // compute final euler angle based on provided weight
-    structures::Euler<double> final_euler =
-        euler_gyro * this->_alpha_gain +
-        euler_accel_mag * (1 - this->_alpha_gain);
+    structures::Euler<T> final_euler =
+        euler_gyro * this->_gains.alpha() +
+        euler_accel_mag * (1 - this->_gains.alpha());
 
     // update last euler before returning
     this->_last_update_euler = euler_gyro;
 
-    return final_euler.toQuaternion();
+    out = final_euler.toQuaternion();
   }
 
-private:
-  float _alpha_gain;
-  structures::Euler<double> _last_update_euler;
-}; // end ComplementaryFilter class
+  GainsT _gains;
+  structures::Euler<T> _last_update_euler;
+  SampleTimer _sample_timer;
+}; // end BasicComplementaryFilter class
+
+/**
+ * @brief complementary filter with gains that can be changed at runtime.
+ */
+typedef BasicComplementaryFilter<ComplementaryGains> ComplementaryFilter;
 } // namespace filters
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "../../Quaternion/Quaternion.hpp"
+#include "../MadgwickFilter/MadgwickFilter.hpp"
+#include "../SensorSample.hpp"
+#include "LaneSamples.hpp"
+#include "LaneVector.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filters {
+
+/**
+ * @brief a bank of independent Madgwick filters updated together, one per
+ * SIMD lane. Each lane has its own gain, input and time base, and follows
+ * the same arithmetic as MadgwickFilter::update, so its estimates match a
+ * scalar filter to within rounding.
+ * @tparam width the number of lanes. Multiples of 8 use AVX-512, multiples
+ * of 4 use AVX2, when the target supports them.
+ */
+template <size_t width> class LaneMadgwickFilter {
+public:
+  typedef LaneVector<width> vector_t;
+  typedef LaneQuaternion<vector_t> quaternion_t;
+
+  /**
+   * @brief constructor for LaneMadgwickFilter class.
+   * @param gains the gains of every lane.
+   */
+  LaneMadgwickFilter(const MadgwickGains &gains = MadgwickGains()) {
+    for (size_t lane = 0; lane < width; lane++) {
+      this->setGains(lane, gains);
+      this->reset(lane);
+    }
+  }
+
+  /**
+   * @brief gets the gains of a lane.
+   * @param lane the lane index.
+   * @return the gains of the lane.
+   */
+  MadgwickGains getGains(size_t lane) const {
+    return MadgwickGains(this->_beta[lane]);
+  }
+
+  /**
+   * @brief sets the gains of a lane.
+   * @param lane the lane index.
+   * @param gains the new gains.
+   */
+  void setGains(size_t lane, const MadgwickGains &gains) {
+    this->_beta[lane] = gains.beta();
+  }
+
+  /**
+   * @brief resets a lane to the identity attitude and forgets its time
+   * base.
+   * @param lane the lane index.
+   */
+  void reset(size_t lane) {
+    this->_quat[0][lane] = 1.0;
+    this->_quat[1][lane] = 0.0;
+    this->_quat[2][lane] = 0.0;
+    this->_quat[3][lane] = 0.0;
+    this->_sample_timers[lane] = SampleTimer();
+  }
+
+  /**
+   * @brief sets the attitude estimate of a lane, for example to start it
+   * from a known attitude instead of the identity.
+   * @param lane the lane index.
+   * @param estimate the new attitude estimate.
+   */
+  void setEstimate(size_t lane,
+                   const structures::Quaternion<double> &estimate) {
+    this->_quat[0][lane] = estimate.getW();
+    this->_quat[1][lane] = estimate.getX();
+    this->_quat[2][lane] = estimate.getY();
+    this->_quat[3][lane] = estimate.getZ();
+  }
+
+  /**
+   * @brief updates every lane with its new sample. The elapsed time of each
+   * lane is derived from the timestamp of its previous sample.
+   * @param samples one sample per lane.
+   */
+  void update(const LaneSamples<width> &samples) {
+    for (size_t lane = 0; lane < width; lane++) {
+      this->_elapsed_us[lane] =
+          this->_sample_timers[lane].elapsed(samples.timestamp_us[lane]);
+    }
+    this->step(samples);
+  }
+
+  /**
+   * @brief returns the attitude estimate of a lane.
+   * @param lane the lane index.
+   * @return the attitude estimate.
+   */
+  structures::Quaternion<double> getEstimate(size_t lane) const {
+    return structures::Quaternion<double>(
+        this->_quat[1][lane], this->_quat[2][lane], this->_quat[3][lane],
+        this->_quat[0][lane]);
+  }
+
+private:
+  void step(const LaneSamples<width> &samples) {
+    quaternion_t last_quat;
+    last_quat.w = vector_t::load(this->_quat[0]);
+    last_quat.x = vector_t::load(this->_quat[1]);
+    last_quat.y = vector_t::load(this->_quat[2]);
+    last_quat.z = vector_t::load(this->_quat[3]);
+    vector_t acc[3];
+    vector_t gyro[3];
+    vector_t mag[3];
+    for (size_t axis = 0; axis < 3; axis++) {
+      acc[axis] = vector_t::load(samples.acc[axis]);
+      gyro[axis] = vector_t::load(samples.gyro[axis]);
+      mag[axis] = vector_t::load(samples.mag[axis]);
+    }
+    const vector_t zero(0.0);
+
+    // compute Q_dot
+    quaternion_t gyro_quat = {zero, gyro[0], gyro[1], gyro[2]};
+    quaternion_t q_dot = last_quat * gyro_quat;
+    q_dot.w = q_dot.w * 0.5;
+    q_dot.x = q_dot.x * 0.5;
+    q_dot.y = q_dot.y * 0.5;
+    q_dot.z = q_dot.z * 0.5;
+
+    vector_t acc_norm =
+        sqrt(acc[0] * acc[0] + acc[1] * acc[1] + acc[2] * acc[2]);
+    vector_t mag_norm =
+        sqrt(mag[0] * mag[0] + mag[1] * mag[1] + mag[2] * mag[2]);
+
+    // every lane computes the gradient, and the lanes without an
+    // acceleration or gradient keep their gyro-only Q_dot. The lanes
+    // without a magnetometer reading keep it zero, for the accelerometer
+    // only gradient
+    vector_t a_normalized[3] = {acc[0] / acc_norm, acc[1] / acc_norm,
+                                acc[2] / acc_norm};
+    vector_t m_normalized[3];
+    for (size_t axis = 0; axis < 3; axis++) {
+      m_normalized[axis] =
+          selectPositive(mag_norm, mag[axis] / mag_norm, zero);
+    }
+
+    // rotate normalized magnetometer measurements
+    quaternion_t norm_mag_quat = {zero, m_normalized[0], m_normalized[1],
+                                  m_normalized[2]};
+    quaternion_t conj = {last_quat.w, zero - last_quat.x, zero - last_quat.y,
+                         zero - last_quat.z};
+    quaternion_t h_quat = last_quat * (norm_mag_quat * conj);
+    vector_t bx = sqrt(h_quat.x * h_quat.x + h_quat.y * h_quat.y);
+    vector_t bz = h_quat.z;
+
+    // normalize quaternion and compute objective function
+    quaternion_t last_quat_norm = last_quat.norm();
+    vector_t qw = last_quat_norm.w;
+    vector_t qx = last_quat_norm.x;
+    vector_t qy = last_quat_norm.y;
+    vector_t qz = last_quat_norm.z;
+    vector_t two_bx = bx * 2.0;
+    vector_t two_bz = bz * 2.0;
+    vector_t four_bx = bx * -4.0;
+    vector_t four_bz = bz * -4.0;
+
+    vector_t xz_wy = qx * qz - qw * qy;
+    vector_t wx_yz = qw * qx + qy * qz;
+    vector_t half_xx_yy = vector_t(0.5) - qx * qx - qy * qy;
+    vector_t objective[6] = {
+        (xz_wy * 2.0) - a_normalized[0],
+        (wx_yz * 2.0) - a_normalized[1],
+        (half_xx_yy * 2.0) - a_normalized[2],
+        two_bx * (vector_t(0.5) - qy * qy - qz * qz) + two_bz * xz_wy -
+            m_normalized[0],
+        two_bx * (qx * qy - qw * qz) + two_bz * wx_yz - m_normalized[1],
+        two_bx * (qw * qy + qx * qz) + two_bz * half_xx_yy -
+            m_normalized[2]};
+
+    // gradient = jacobian^T * objective, skipping the zero entries
+    vector_t gradient[4];
+    gradient[0] = (qy * -2.0) * objective[0] + (qx * 2.0) * objective[1] +
+                  (two_bz * -1.0 * qy) * objective[3] +
+                  (two_bz * qx - two_bx * qz) * objective[4] +
+                  (two_bx * qy) * objective[5];
+    gradient[1] = (qz * 2.0) * objective[0] + (qw * 2.0) * objective[1] +
+                  (qx * -4.0) * objective[2] + (two_bz * qz) * objective[3] +
+                  (two_bx * qy + two_bz * qw) * objective[4] +
+                  (two_bx * qz + four_bz * qx) * objective[5];
+    gradient[2] = (qw * -2.0) * objective[0] + (qz * 2.0) * objective[1] +
+                  (qy * -4.0) * objective[2] +
+                  (four_bx * qy - two_bz * qw) * objective[3] +
+                  (two_bx * qx + two_bz * qz) * objective[4] +
+                  (two_bx * qw + four_bz * qy) * objective[5];
+    gradient[3] = (qx * 2.0) * objective[0] + (qy * 2.0) * objective[1] +
+                  (four_bx * qz + two_bz * qx) * objective[3] +
+                  (two_bz * qy - two_bx * qw) * objective[4] +
+                  (two_bx * qx) * objective[5];
+
+    // normalize gradient, adjust it by the beta gain and correct Q_dot
+    vector_t gradient_norm =
+        sqrt(gradient[0] * gradient[0] + gradient[1] * gradient[1] +
+             gradient[2] * gradient[2] + gradient[3] * gradient[3]);
+    vector_t step = (vector_t(1.0) / gradient_norm);
+    vector_t beta = vector_t::load(this->_beta);
+    vector_t corrected[4] = {q_dot.w - (gradient[0] * step) * beta,
+                             q_dot.x - (gradient[1] * step) * beta,
+                             q_dot.y - (gradient[2] * step) * beta,
+                             q_dot.z - (gradient[3] * step) * beta};
+    q_dot.w = selectPositive(acc_norm,
+                             selectPositive(gradient_norm, corrected[0],
+                                            q_dot.w),
+                             q_dot.w);
+    q_dot.x = selectPositive(acc_norm,
+                             selectPositive(gradient_norm, corrected[1],
+                                            q_dot.x),
+                             q_dot.x);
+    q_dot.y = selectPositive(acc_norm,
+                             selectPositive(gradient_norm, corrected[2],
+                                            q_dot.y),
+                             q_dot.y);
+    q_dot.z = selectPositive(acc_norm,
+                             selectPositive(gradient_norm, corrected[3],
+                                            q_dot.z),
+                             q_dot.z);
+
+    // perform discretized integration
+    alignas(64) double elapsed_sec[width];
+    for (size_t lane = 0; lane < width; lane++) {
+      elapsed_sec[lane] = this->_elapsed_us[lane] / ((double)1e6);
+    }
+    vector_t ellapsed_time_sec = vector_t::load(elapsed_sec);
+    last_quat.w = last_quat.w + q_dot.w * ellapsed_time_sec;
+    last_quat.x = last_quat.x + q_dot.x * ellapsed_time_sec;
+    last_quat.y = last_quat.y + q_dot.y * ellapsed_time_sec;
+    last_quat.z = last_quat.z + q_dot.z * ellapsed_time_sec;
+    last_quat = last_quat.norm();
+
+    last_quat.w.store(this->_quat[0]);
+    last_quat.x.store(this->_quat[1]);
+    last_quat.y.store(this->_quat[2]);
+    last_quat.z.store(this->_quat[3]);
+  }
+
+  alignas(64) double _quat[4][width]; // w, x, y, z of every lane
+  alignas(64) double _beta[width];
+  uint32_t _elapsed_us[width];
+  SampleTimer _sample_timers[width];
+}; // end LaneMadgwickFilter class
+} // namespace filters
@@ -0,0 +1,223 @@
+#pragma once
+
+#include "../../Quaternion/Quaternion.hpp"
+#include "../MahonyFilter/MahonyFilter.hpp"
+#include "../SensorSample.hpp"
+#include "LaneSamples.hpp"
+#include "LaneVector.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filters {
+
+/**
+ * @brief a bank of independent Mahony filters updated together, one per
+ * SIMD lane. Each lane has its own gains, gyro bias, input and time base,
+ * and follows the same arithmetic as MahonyFilter::update.
+ * @tparam width the number of lanes. Multiples of 8 use AVX-512, multiples
+ * of 4 use AVX2, when the target supports them.
+ */
+template <size_t width> class LaneMahonyFilter {
+public:
+  typedef LaneVector<width> vector_t;
+  typedef LaneQuaternion<vector_t> quaternion_t;
+
+  /**
+   * @brief constructor for LaneMahonyFilter class.
+   * @param gains the gains of every lane.
+   */
+  LaneMahonyFilter(const MahonyGains &gains = MahonyGains()) {
+    for (size_t lane = 0; lane < width; lane++) {
+      this->setGains(lane, gains);
+      this->reset(lane);
+    }
+  }
+
+  /**
+   * @brief gets the gains of a lane.
+   * @param lane the lane index.
+   * @return the gains of the lane.
+   */
+  MahonyGains getGains(size_t lane) const {
+    return MahonyGains(this->_kI[lane], this->_kP[lane]);
+  }
+
+  /**
+   * @brief sets the gains of a lane.
+   * @param lane the lane index.
+   * @param gains the new gains.
+   */
+  void setGains(size_t lane, const MahonyGains &gains) {
+    this->_kI[lane] = gains.kI();
+    this->_kP[lane] = gains.kP();
+  }
+
+  /**
+   * @brief resets a lane to the identity attitude and a zero gyro bias, and
+   * forgets its time base.
+   * @param lane the lane index.
+   */
+  void reset(size_t lane) {
+    this->_quat[0][lane] = 1.0;
+    this->_quat[1][lane] = 0.0;
+    this->_quat[2][lane] = 0.0;
+    this->_quat[3][lane] = 0.0;
+    for (size_t axis = 0; axis < 3; axis++) {
+      this->_gyro_bias[axis][lane] = 0.0;
+    }
+    this->_sample_timers[lane] = SampleTimer();
+  }
+
+  /**
+   * @brief sets the attitude estimate of a lane, for example to start it
+   * from a known attitude instead of the identity.
+   * @param lane the lane index.
+   * @param estimate the new attitude estimate.
+   */
+  void setEstimate(size_t lane,
+                   const structures::Quaternion<double> &estimate) {
+    this->_quat[0][lane] = estimate.getW();
+    this->_quat[1][lane] = estimate.getX();
+    this->_quat[2][lane] = estimate.getY();
+    this->_quat[3][lane] = estimate.getZ();
+  }
+
+  /**
+   * @brief updates every lane with its new sample. The elapsed time of each
+   * lane is derived from the timestamp of its previous sample.
+   * @param samples one sample per lane.
+   */
+  void update(const LaneSamples<width> &samples) {
+    for (size_t lane = 0; lane < width; lane++) {
+      this->_elapsed_us[lane] =
+          this->_sample_timers[lane].elapsed(samples.timestamp_us[lane]);
+    }
+    this->step(samples);
+  }
+
+  /**
+   * @brief returns the attitude estimate of a lane.
+   * @param lane the lane index.
+   * @return the attitude estimate.
+   */
+  structures::Quaternion<double> getEstimate(size_t lane) const {
+    return structures::Quaternion<double>(
+        this->_quat[1][lane], this->_quat[2][lane], this->_quat[3][lane],
+        this->_quat[0][lane]);
+  }
+
+private:
+  void step(const LaneSamples<width> &samples) {
+    quaternion_t last_quat;
+    last_quat.w = vector_t::load(this->_quat[0]);
+    last_quat.x = vector_t::load(this->_quat[1]);
+    last_quat.y = vector_t::load(this->_quat[2]);
+    last_quat.z = vector_t::load(this->_quat[3]);
+    vector_t acc[3];
+    vector_t omega[3];
+    vector_t mag[3];
+    vector_t gyro_bias[3];
+    for (size_t axis = 0; axis < 3; axis++) {
+      acc[axis] = vector_t::load(samples.acc[axis]);
+      omega[axis] = vector_t::load(samples.gyro[axis]);
+      mag[axis] = vector_t::load(samples.mag[axis]);
+      gyro_bias[axis] = vector_t::load(this->_gyro_bias[axis]);
+    }
+    const vector_t zero(0.0);
+
+    // compute ellapsed time in seconds
+    alignas(64) double elapsed_sec[width];
+    for (size_t lane = 0; lane < width; lane++) {
+      elapsed_sec[lane] = this->_elapsed_us[lane] / ((double)1e6);
+    }
+    vector_t delta_sec = vector_t::load(elapsed_sec);
+
+    // every lane computes the correction, and the lanes without an
+    // acceleration keep their gyro bias and raw gyro reading
+    vector_t a_norm =
+        sqrt(acc[0] * acc[0] + acc[1] * acc[1] + acc[2] * acc[2]);
+    vector_t m_norm =
+        sqrt(mag[0] * mag[0] + mag[1] * mag[1] + mag[2] * mag[2]);
+    vector_t a[3] = {acc[0] / a_norm, acc[1] / a_norm, acc[2] / a_norm};
+
+    // the lanes without a magnetometer reading keep it and its correction
+    // zero, so only the accelerometer corrects them
+    vector_t m[3];
+    for (size_t axis = 0; axis < 3; axis++) {
+      m[axis] = selectPositive(m_norm, mag[axis] / m_norm, zero);
+    }
+
+    // direction cosine matrix of the normalized estimate
+    quaternion_t q = last_quat.norm();
+    vector_t ww = q.w * q.w;
+    vector_t xx = q.x * q.x;
+    vector_t yy = q.y * q.y;
+    vector_t zz = q.z * q.z;
+    vector_t dcm[3][3] = {
+        {ww + xx - yy - zz, (q.x * q.y - q.w * q.z) * 2.0,
+         (q.x * q.z + q.w * q.y) * 2.0},
+        {(q.x * q.y + q.w * q.z) * 2.0, ww - xx + yy - zz,
+         (q.y * q.z - q.w * q.x) * 2.0},
+        {(q.x * q.z - q.w * q.y) * 2.0, (q.w * q.x + q.y * q.z) * 2.0,
+         ww - xx - yy + zz}};
+
+    // gravity in the body frame, the last row of the DCM
+    vector_t v_a[3] = {dcm[2][0], dcm[2][1], dcm[2][2]};
+
+    // rotate magnetic field to inertial frame
+    vector_t h_mod[3];
+    for (size_t row = 0; row < 3; row++) {
+      h_mod[row] =
+          dcm[row][0] * m[0] + dcm[row][1] * m[1] + dcm[row][2] * m[2];
+    }
+    vector_t v_m[3] = {zero, sqrt(h_mod[0] * h_mod[0] + h_mod[1] * h_mod[1]),
+                       h_mod[2]};
+    vector_t v_m_norm = sqrt(v_m[1] * v_m[1] + v_m[2] * v_m[2]);
+    vector_t v_m_scale =
+        selectPositive(v_m_norm, vector_t(1.0) / v_m_norm, zero);
+    v_m[1] = v_m[1] * v_m_scale;
+    v_m[2] = v_m[2] * v_m_scale;
+
+    // track changes in gyro bias
+    vector_t omega_mes[3] = {
+        (a[1] * v_a[2] - a[2] * v_a[1]) + (m[1] * v_m[2] - m[2] * v_m[1]),
+        (a[2] * v_a[0] - a[0] * v_a[2]) + (m[2] * v_m[0] - m[0] * v_m[2]),
+        (a[0] * v_a[1] - a[1] * v_a[0]) + (m[0] * v_m[1] - m[1] * v_m[0])};
+    vector_t minus_kI = zero - vector_t::load(this->_kI);
+    vector_t kP = vector_t::load(this->_kP);
+
+    // estimate gyro bias change and perform gyro reading correction
+    for (size_t axis = 0; axis < 3; axis++) {
+      vector_t bias =
+          gyro_bias[axis] + (omega_mes[axis] * minus_kI) * delta_sec;
+      vector_t corrected = omega[axis] - (bias + omega_mes[axis] * kP);
+      gyro_bias[axis] = selectPositive(a_norm, bias, gyro_bias[axis]);
+      omega[axis] = selectPositive(a_norm, corrected, omega[axis]);
+      gyro_bias[axis].store(this->_gyro_bias[axis]);
+    }
+
+    // compute quaternion rate of change
+    quaternion_t p = {zero, omega[0], omega[1], omega[2]};
+    quaternion_t q_dot = last_quat * p;
+
+    // update orientation and normalize quaternion
+    last_quat.w = last_quat.w + (q_dot.w * 0.5) * delta_sec;
+    last_quat.x = last_quat.x + (q_dot.x * 0.5) * delta_sec;
+    last_quat.y = last_quat.y + (q_dot.y * 0.5) * delta_sec;
+    last_quat.z = last_quat.z + (q_dot.z * 0.5) * delta_sec;
+    last_quat = last_quat.norm();
+
+    last_quat.w.store(this->_quat[0]);
+    last_quat.x.store(this->_quat[1]);
+    last_quat.y.store(this->_quat[2]);
+    last_quat.z.store(this->_quat[3]);
+  }
+
+  alignas(64) double _quat[4][width]; // w, x, y, z of every lane
+  alignas(64) double _gyro_bias[3][width];
+  alignas(64) double _kI[width];
+  alignas(64) double _kP[width];
+  uint32_t _elapsed_us[width];
+  SampleTimer _sample_timers[width];
+}; // end LaneMahonyFilter class
+} // namespace filters
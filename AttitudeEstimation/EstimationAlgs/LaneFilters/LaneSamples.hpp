@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../SensorSample.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filters {
+
+/**
+ * @brief one 9DOF sensor sample per filter lane, stored as structure of
+ * arrays so each axis of every lane loads as one vector. NOTE: all readings
+ * are packed in <X, Y, Z> axis order.
+ * @tparam width the number of lanes.
+ */
+template <size_t width> struct LaneSamples {
+  alignas(64) double acc[3][width];  // accelerometer readings (m/s^2)
+  alignas(64) double gyro[3][width]; // gyroscope readings (rad/s)
+  alignas(64) double mag[3][width];  // magnetometer readings
+  uint64_t timestamp_us[width];      // sample timestamps in microseconds
+
+  /**
+   * @brief sets the sample of one lane.
+   * @param lane the lane index.
+   * @param sample the sample.
+   */
+  void set(size_t lane, const SensorSample<double> &sample) {
+    for (size_t axis = 0; axis < 3; axis++) {
+      this->acc[axis][lane] = sample.acc[axis];
+      this->gyro[axis][lane] = sample.gyro[axis];
+      this->mag[axis][lane] = sample.mag[axis];
+    }
+    this->timestamp_us[lane] = sample.timestamp_us;
+  }
+}; // end LaneSamples struct
+} // namespace filters
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+
+// define LANE_FILTERS_SCALAR to use the portable kernels even when the
+// compiler targets AVX2 or AVX-512
+#if !defined(LANE_FILTERS_SCALAR) && defined(__AVX512F__)
+#define LANE_VECTOR_AVX512 1
+#else
+#define LANE_VECTOR_AVX512 0
+#endif
+#if !defined(LANE_FILTERS_SCALAR) && defined(__AVX2__)
+#define LANE_VECTOR_AVX2 1
+#else
+#define LANE_VECTOR_AVX2 0
+#endif
+
+#if LANE_VECTOR_AVX512 || LANE_VECTOR_AVX2
+#include <immintrin.h>
+#endif
+
+namespace filters {
+
+/**
+ * @brief portable lane kernels, one double per block. Used when the target
+ * has no wider vector unit, or the lane count does not fill one.
+ */
+struct ScalarLaneOps {
+  typedef double block_t;
+  static const size_t kBlockWidth = 1;
+  static const char *name() { return "scalar"; }
+
+  static block_t load(const double *values) { return *values; }
+  static void store(double *values, block_t a) { *values = a; }
+  static block_t set1(double value) { return value; }
+  static block_t add(block_t a, block_t b) { return a + b; }
+  static block_t sub(block_t a, block_t b) { return a - b; }
+  static block_t mul(block_t a, block_t b) { return a * b; }
+  static block_t div(block_t a, block_t b) { return a / b; }
+  static block_t sqrt(block_t a) { return ::sqrt(a); }
+  static block_t selectPositive(block_t x, block_t a, block_t b) {
+    return x > 0 ? a : b;
+  }
+}; // end ScalarLaneOps struct
+
+#if LANE_VECTOR_AVX2
+/**
+ * @brief AVX2 lane kernels, four doubles per block.
+ */
+struct Avx2LaneOps {
+  typedef __m256d block_t;
+  static const size_t kBlockWidth = 4;
+  static const char *name() { return "avx2"; }
+
+  static block_t load(const double *values) { return _mm256_loadu_pd(values); }
+  static void store(double *values, block_t a) { _mm256_storeu_pd(values, a); }
+  static block_t set1(double value) { return _mm256_set1_pd(value); }
+  static block_t add(block_t a, block_t b) { return _mm256_add_pd(a, b); }
+  static block_t sub(block_t a, block_t b) { return _mm256_sub_pd(a, b); }
+  static block_t mul(block_t a, block_t b) { return _mm256_mul_pd(a, b); }
+  static block_t div(block_t a, block_t b) { return _mm256_div_pd(a, b); }
+  static block_t sqrt(block_t a) { return _mm256_sqrt_pd(a); }
+  static block_t selectPositive(block_t x, block_t a, block_t b) {
+    block_t mask = _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GT_OQ);
+    return _mm256_blendv_pd(b, a, mask);
+  }
+}; // end Avx2LaneOps struct
+#endif
+
+#if LANE_VECTOR_AVX512
+/**
+ * @brief AVX-512 lane kernels, eight doubles per block.
+ */
+struct Avx512LaneOps {
+  typedef __m512d block_t;
+  static const size_t kBlockWidth = 8;
+  static const char *name() { return "avx512"; }
+
+  static block_t load(const double *values) { return _mm512_loadu_pd(values); }
+  static void store(double *values, block_t a) { _mm512_storeu_pd(values, a); }
+  static block_t set1(double value) { return _mm512_set1_pd(value); }
+  static block_t add(block_t a, block_t b) { return _mm512_add_pd(a, b); }
+  static block_t sub(block_t a, block_t b) { return _mm512_sub_pd(a, b); }
+  static block_t mul(block_t a, block_t b) { return _mm512_mul_pd(a, b); }
+  static block_t div(block_t a, block_t b) { return _mm512_div_pd(a, b); }
+  // the masked form keeps GCC from flagging the undefined pass-through
+  static block_t sqrt(block_t a) {
+    return _mm512_mask_sqrt_pd(_mm512_setzero_pd(), 0xFF, a);
+  }
+  static block_t selectPositive(block_t x, block_t a, block_t b) {
+    __mmask8 mask = _mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_GT_OQ);
+    return _mm512_mask_blend_pd(mask, b, a);
+  }
+}; // end Avx512LaneOps struct
+#endif
+
+/**
+ * @brief picks the widest lane kernels the target supports whose block
+ * width divides the lane count.
+ */
+template <size_t width, bool fills_512 = (width % 8 == 0),
+          bool fills_256 = (width % 4 == 0)>
+struct LaneOpsSelector {
+  typedef ScalarLaneOps type;
+};
+
+#if LANE_VECTOR_AVX512
+template <size_t width> struct LaneOpsSelector<width, true, true> {
+  typedef Avx512LaneOps type;
+};
+#endif
+
+#if LANE_VECTOR_AVX2
+template <size_t width> struct LaneOpsSelector<width, false, true> {
+  typedef Avx2LaneOps type;
+};
+#if !LANE_VECTOR_AVX512
+template <size_t width> struct LaneOpsSelector<width, true, true> {
+  typedef Avx2LaneOps type;
+};
+#endif
+#endif
+
+/**
+ * @brief a fixed number of doubles, one per filter lane, updated together.
+ * Every operation applies to all lanes, so per lane branches are expressed
+ * with selectPositive().
+ * @tparam width the number of lanes.
+ * @tparam OpsT the lane kernels, the widest supported by default.
+ */
+template <size_t width,
+          typename OpsT = typename LaneOpsSelector<width>::type>
+class LaneVector {
+  static_assert(width % OpsT::kBlockWidth == 0,
+                "LaneVector width must be a multiple of the block width");
+  static const size_t kBlocks = width / OpsT::kBlockWidth;
+
+public:
+  typedef OpsT ops_t;
+
+  /**
+   * @brief default constructor for LaneVector class. The lanes are left
+   * uninitialized.
+   */
+  LaneVector() {}
+
+  /**
+   * @brief constructor for LaneVector class, setting every lane.
+   * @param value the value of every lane.
+   */
+  LaneVector(double value) {
+    for (size_t i = 0; i < kBlocks; i++) {
+      this->_blocks[i] = OpsT::set1(value);
+    }
+  }
+
+  /**
+   * @brief loads every lane from an array.
+   * @param values the lane values, width of them.
+   * @return the loaded vector.
+   */
+  static LaneVector load(const double *values) {
+    LaneVector loaded;
+    for (size_t i = 0; i < kBlocks; i++) {
+      loaded._blocks[i] = OpsT::load(values + i * OpsT::kBlockWidth);
+    }
+    return loaded;
+  }
+
+  /**
+   * @brief stores every lane into an array.
+   * @param values the array to store width lane values into.
+   */
+  void store(double *values) const {
+    for (size_t i = 0; i < kBlocks; i++) {
+      OpsT::store(values + i * OpsT::kBlockWidth, this->_blocks[i]);
+    }
+  }
+
+  friend LaneVector operator+(const LaneVector &a, const LaneVector &b) {
+    return apply(a, b, OpsT::add);
+  }
+  friend LaneVector operator-(const LaneVector &a, const LaneVector &b) {
+    return apply(a, b, OpsT::sub);
+  }
+  friend LaneVector operator*(const LaneVector &a, const LaneVector &b) {
+    return apply(a, b, OpsT::mul);
+  }
+  friend LaneVector operator/(const LaneVector &a, const LaneVector &b) {
+    return apply(a, b, OpsT::div);
+  }
+
+  friend LaneVector sqrt(const LaneVector &a) {
+    LaneVector result;
+    for (size_t i = 0; i < kBlocks; i++) {
+      result._blocks[i] = OpsT::sqrt(a._blocks[i]);
+    }
+    return result;
+  }
+
+  /**
+   * @brief picks a per lane, x > 0 ? a : b. NaN lanes of x pick b.
+   */
+  friend LaneVector selectPositive(const LaneVector &x, const LaneVector &a,
+                                   const LaneVector &b) {
+    LaneVector result;
+    for (size_t i = 0; i < kBlocks; i++) {
+      result._blocks[i] =
+          OpsT::selectPositive(x._blocks[i], a._blocks[i], b._blocks[i]);
+    }
+    return result;
+  }
+
+private:
+  template <typename BinaryT>
+  static LaneVector apply(const LaneVector &a, const LaneVector &b,
+                          BinaryT op) {
+    LaneVector result;
+    for (size_t i = 0; i < kBlocks; i++) {
+      result._blocks[i] = op(a._blocks[i], b._blocks[i]);
+    }
+    return result;
+  }
+
+  typename OpsT::block_t _blocks[kBlocks];
+}; // end LaneVector class
+
+/**
+ * @brief a quaternion per lane, in the component order of
+ * structures::Quaternion.
+ */
+template <typename VectorT> struct LaneQuaternion {
+  VectorT w;
+  VectorT x;
+  VectorT y;
+  VectorT z;
+
+  /**
+   * @brief the Hamilton product, with the same operation order as
+   * structures::Quaternion::operator*.
+   */
+  LaneQuaternion operator*(const LaneQuaternion &other) const {
+    LaneQuaternion product;
+    product.w = this->w * other.w - this->x * other.x - this->y * other.y -
+                this->z * other.z;
+    product.x = this->w * other.x + this->x * other.w + this->y * other.z -
+                this->z * other.y;
+    product.y = this->w * other.y - this->x * other.z + this->y * other.w +
+                this->z * other.x;
+    product.z = this->w * other.z + this->x * other.y - this->y * other.x +
+                this->z * other.w;
+    return product;
+  }
+
+  /**
+   * @brief the normalized quaternion, as structures::Quaternion::norm(). A
+   * lane with zero magnitude becomes the identity.
+   */
+  LaneQuaternion norm() const {
+    VectorT squared_mag =
+        this->w * this->w + this->x * this->x + this->y * this->y +
+        this->z * this->z;
+    VectorT mag = sqrt(squared_mag);
+    LaneQuaternion normalized;
+    normalized.w = selectPositive(squared_mag, this->w / mag, 1.0);
+    normalized.x = selectPositive(squared_mag, this->x / mag, 0.0);
+    normalized.y = selectPositive(squared_mag, this->y / mag, 0.0);
+    normalized.z = selectPositive(squared_mag, this->z / mag, 0.0);
+    return normalized;
+  }
+}; // end LaneQuaternion struct
+} // namespace filters
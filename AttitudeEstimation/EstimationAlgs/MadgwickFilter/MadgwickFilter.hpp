@@ -2,40 +2,83 @@
 
 #include "../../Matrix/Matrix.hpp"
 #include "../../Quaternion/Quaternion.hpp"
+#include "../SensorSample.hpp"
+#include <math.h>
+#include <stdint.h>
 
 namespace filters {
-class MadgwickFilter {
+
+/**
+ * @brief runtime gains for the Madgwick filter. Compile time gains can be
+ * used instead by passing any type with a matching static constexpr beta()
+ * function (see AlgParams.hpp).
+ */
+class MadgwickGains {
 public:
   /**
-   * @brief default constructor for MadgwickFilter class.
+   * @brief constructor for MadgwickGains class.
+   * @param beta_filter_gain the gradient descent step gain.
    */
-  MadgwickFilter() { this->_beta_filter_gain = 0; }
+  MadgwickGains(double beta_filter_gain = 0.0) {
+    this->_beta_filter_gain = beta_filter_gain;
+  }
 
+  /**
+   * @brief gets the gradient descent step gain.
+   * @return the gradient descent step gain.
+   */
+  double beta() const { return this->_beta_filter_gain; }
+
+private:
+  double _beta_filter_gain;
+}; // end MadgwickGains class
+
+/**
+ * @brief Madgwick filter.
+ * @tparam GainsT the gain provider, either MadgwickGains for runtime gains
+ * or a compile time gain struct.
+ * @tparam T the scalar type of the estimate and the readings.
+ */
+template <typename GainsT, typename T = double> class BasicMadgwickFilter {
+public:
   /**
    * @brief constructor for MadgwickFilter class.
+   * @param gains the filter gains.
    */
-  MadgwickFilter(double beta_filter_gain) {
-    this->_beta_filter_gain = beta_filter_gain;
-  }
+  BasicMadgwickFilter(const GainsT &gains = GainsT()) : _gains(gains) {}
 
   /**
    * @brief copy constructor for MadgwickFilter class.
    */
-  MadgwickFilter(const MadgwickFilter &other) {
+  BasicMadgwickFilter(const BasicMadgwickFilter &other)
+      : _gains(other._gains) {
     this->_last_quat = other._last_quat;
-    this->_beta_filter_gain = other._beta_filter_gain;
+    this->_sample_timer = other._sample_timer;
   }
 
   /**
    * @brief copy assignment operator override for
    * MadgwickFilter class.
    */
-  MadgwickFilter operator=(const MadgwickFilter &other) {
+  BasicMadgwickFilter &operator=(const BasicMadgwickFilter &other) {
     this->_last_quat = other._last_quat;
-    this->_beta_filter_gain = other._beta_filter_gain;
+    this->_gains = other._gains;
+    this->_sample_timer = other._sample_timer;
     return *this;
   }
 
+  /**
+   * @brief gets the gains used by this filter.
+   * @return the gains used by this filter.
+   */
+  const GainsT &getGains() const { return this->_gains; }
+
+  /**
+   * @brief sets the gains used by this filter.
+   * @param gains the new gains.
+   */
+  void setGains(const GainsT &gains) { this->_gains = gains; }
+
   /**
    * @brief Madgwick filter update function. NOTE: all reading matricies
    * are expected to be packed in <X, Y, Z> axis order.
@@ -45,62 +88,102 @@ public:
    * @param ellapsed_time_us elapsed time in microseconds since last update.
    * @return a Quaternion instance with the newly estimated attitude.
    */
-  structures::Quaternion<double>
-  update(structures::Matrix<double, 3, 1> acc_readings,
-         structures::Matrix<double, 3, 1> gyro_readings,
-         structures::Matrix<double, 3, 1> mag_readings,
+  structures::Quaternion<T>
+  update(const structures::Matrix<T, 3, 1> &acc_readings,
+         const structures::Matrix<T, 3, 1> &gyro_readings,
+         const structures::Matrix<T, 3, 1> &mag_readings,
          uint32_t ellapsed_time_us) {
+    this->step(acc_readings.data(), gyro_readings.data(), mag_readings.data(),
+               ellapsed_time_us);
+    return this->_last_quat;
+  }
+
+  /**
+   * @brief in-place Madgwick filter update function. The elapsed time
+   * is derived from the timestamp of the previously provided sample.
+   * @param sample the new sensor sample.
+   * @param out the quaternion to write the newly estimated attitude into.
+   */
+  void update(const SensorSample<T> &sample,
+              structures::Quaternion<T> &out) {
+    this->step(sample.acc, sample.gyro, sample.mag,
+               this->_sample_timer.elapsed(sample.timestamp_us));
+    out = this->_last_quat;
+  }
+
+private:
+  /**
+   * @brief performs the filter update on raw <X, Y, Z> reading triples,
+   * updating the internal quaternion estimate.
+   * @param acc_readings accelerometer reading triple.
+   * @param gyro_readings gyroscope reading triple.
+   * @param mag_readings magnetometer reading triple.
+   * @param ellapsed_time_us elapsed time in microseconds since last update.
+   */
+  void step(const T acc_readings[3], const T gyro_readings[3],
+            const T mag_readings[3], uint32_t ellapsed_time_us) {
 
     // compute Q_dot
-    structures::Quaternion<double> qyro_quat(gyro_readings.getValue(0, 0),
-                                             gyro_readings.getValue(1, 0),
-                                             gyro_readings.getValue(2, 0), 0);
+    structures::Quaternion<T> qyro_quat(gyro_readings[0], gyro_readings[1],
+                                        gyro_readings[2], 0);
 
-    structures::Quaternion<double> q_dot = (this->_last_quat * qyro_quat) * 0.5;
+    structures::Quaternion<T> q_dot = (this->_last_quat * qyro_quat) * 0.5;
 
     // compute the norm of the acceleration measurement
-    double acc_norm = acc_readings.norm();
-    double mag_norm = mag_readings.norm();
+    T acc_norm =
+        sqrt(acc_readings[0] * acc_readings[0] +
+             acc_readings[1] * acc_readings[1] +
+             acc_readings[2] * acc_readings[2]);
+    T mag_norm =
+        sqrt(mag_readings[0] * mag_readings[0] +
+             mag_readings[1] * mag_readings[1] +
+             mag_readings[2] * mag_readings[2]);
 
     // if it's nonzero, compute the gradient and update qDot
     if (acc_norm > 0) {
-      // normalize acceleration and magnetometer measurements
-      structures::Matrix<double, 3, 1> a_normalized =
-          acc_readings * (1 / acc_norm);
-      structures::Matrix<double, 3, 1> m_normalized =
-          mag_readings * (1 / mag_norm);
+      // normalize acceleration and magnetometer measurements. A zero
+      // magnetometer reading stays zero, which zeroes its objective and
+      // jacobian rows and leaves the accelerometer-only gradient
+      T a_normalized[3] = {acc_readings[0] / acc_norm,
+                           acc_readings[1] / acc_norm,
+                           acc_readings[2] / acc_norm};
+      T m_normalized[3] = {0, 0, 0};
+      if (mag_norm > 0) {
+        for (int axis = 0; axis < 3; axis++) {
+          m_normalized[axis] = mag_readings[axis] / mag_norm;
+        }
+      }
 
       // rotate normalized magnetometer measurements
-      structures::Quaternion<double> norm_mag_quat(
-          m_normalized.getValue(0, 0), m_normalized.getValue(1, 0),
-          m_normalized.getValue(2, 0), 0);
+      structures::Quaternion<T> norm_mag_quat(
+          m_normalized[0], m_normalized[1], m_normalized[2], 0);
 
-      structures::Quaternion<double> h_quat =
+      structures::Quaternion<T> h_quat =
           this->_last_quat * (norm_mag_quat * this->_last_quat.conj());
-      double bx = pow(pow(h_quat.getX(), 2) + pow(h_quat.getY(), 2), 0.5);
-      double bz = h_quat.getZ();
+      T bx = pow(pow(h_quat.getX(), 2) + pow(h_quat.getY(), 2), 0.5);
+      T bz = h_quat.getZ();
 
       // normalize quaternion and compute objective function.
-      structures::Quaternion<double> last_quat_norm = this->_last_quat.norm();
-      double qw = last_quat_norm.getW();
-      double qx = last_quat_norm.getX();
-      double qy = last_quat_norm.getY();
-      double qz = last_quat_norm.getZ();
-
-      double objective_vec[6][1] = {
-          {2.0 * (qx * qz - qw * qy) - a_normalized.getValue(0, 0)},
-          {2.0 * (qw * qx + qy * qz) - a_normalized.getValue(1, 0)},
-          {2.0 * (0.5 - pow(qx, 2) - pow(qy, 2)) - a_normalized.getValue(2, 0)},
+      structures::Quaternion<T> last_quat_norm = this->_last_quat.norm();
+      T qw = last_quat_norm.getW();
+      T qx = last_quat_norm.getX();
+      T qy = last_quat_norm.getY();
+      T qz = last_quat_norm.getZ();
+
+      T objective_vec[6][1] = {
+          {2.0 * (qx * qz - qw * qy) - a_normalized[0]},
+          {2.0 * (qw * qx + qy * qz) - a_normalized[1]},
+          {2.0 * (0.5 - pow(qx, 2) - pow(qy, 2)) - a_normalized[2]},
           {2.0 * bx * (0.5 - pow(qy, 2) - pow(qz, 2)) +
-           2.0 * bz * (qx * qz - qw * qy) - m_normalized.getValue(0, 0)},
+           2.0 * bz * (qx * qz - qw * qy) - m_normalized[0]},
           {2.0 * bx * (qx * qy - qw * qz) + 2.0 * bz * (qw * qx + qy * qz) -
-           m_normalized.getValue(1, 0)},
+           m_normalized[1]},
           {2.0 * bx * (qw * qy + qx * qz) +
            2.0 * bz * (0.5 - pow(qx, 2) - pow(qy, 2)) -
-           m_normalized.getValue(2, 0)}};
+           m_normalized[2]}};
 
       // compute jacobian
-      double jacobian_vec[6][4] = {
+      T jacobian_vec[6][4] = {
           {-2.0 * qy, 2.0 * qz, -2.0 * qw, 2.0 * qx},
           {2.0 * qx, 2.0 * qw, 2.0 * qz, 2.0 * qy},
           {0.0, -4.0 * qx, -4.0 * qy, 0.0},
@@ -112,26 +195,30 @@ public:
            2.0 * bx * qw - 4.0 * bz * qy, 2.0 * bx * qx}};
 
       // compute gradient
-      structures::Matrix<double, 6, 1> objective_mat(objective_vec);
-      structures::Matrix<double, 6, 4> jacobian_mat(jacobian_vec);
-      structures::Matrix<double, 4, 1> gradient_mat =
+      structures::Matrix<T, 6, 1> objective_mat(objective_vec);
+      structures::Matrix<T, 6, 4> jacobian_mat(jacobian_vec);
+      structures::Matrix<T, 4, 1> gradient_mat =
           jacobian_mat.transpose() * objective_mat;
 
-      // normalize gradient
-      gradient_mat = gradient_mat * (1 / gradient_mat.norm());
-
-      // adjust gradient by beta gain
-      gradient_mat = gradient_mat * this->_beta_filter_gain;
-
-      // adjust q_dot
-      q_dot.setW(q_dot.getW() - gradient_mat.getValue(0, 0));
-      q_dot.setX(q_dot.getX() - gradient_mat.getValue(1, 0));
-      q_dot.setY(q_dot.getY() - gradient_mat.getValue(2, 0));
-      q_dot.setZ(q_dot.getZ() - gradient_mat.getValue(3, 0));
+      // normalize gradient. A zero gradient means the estimate already
+      // matches the measurements exactly, so there is nothing to correct
+      T gradient_norm = gradient_mat.norm();
+      if (gradient_norm > 0) {
+        gradient_mat = gradient_mat * (1 / gradient_norm);
+
+        // adjust gradient by beta gain
+        gradient_mat = gradient_mat * this->_gains.beta();
+
+        // adjust q_dot
+        q_dot.setW(q_dot.getW() - gradient_mat.getValue(0, 0));
+        q_dot.setX(q_dot.getX() - gradient_mat.getValue(1, 0));
+        q_dot.setY(q_dot.getY() - gradient_mat.getValue(2, 0));
+        q_dot.setZ(q_dot.getZ() - gradient_mat.getValue(3, 0));
+      }
     }
 
     // perform discretized integration
-    double ellapsed_time_sec = (ellapsed_time_us) / ((double)1e6);
+    T ellapsed_time_sec = (ellapsed_time_us) / ((T)1e6);
     q_dot = q_dot * ellapsed_time_sec;
 
     // update internal quaternion estimate
@@ -140,13 +227,16 @@ public:
     this->_last_quat.setY(this->_last_quat.getY() + q_dot.getY());
     this->_last_quat.setZ(this->_last_quat.getZ() + q_dot.getZ());
     this->_last_quat = this->_last_quat.norm();
-
-    return this->_last_quat;
   }
 
-private:
-  structures::Quaternion<double> _last_quat;
-  double _beta_filter_gain;
+  structures::Quaternion<T> _last_quat;
+  GainsT _gains;
+  SampleTimer _sample_timer;
+
+}; // end BasicMadgwickFilter class
 
-}; // end MadgwickFilter class
+/**
+ * @brief Madgwick filter with gains that can be changed at runtime.
+ */
+typedef BasicMadgwickFilter<MadgwickGains> MadgwickFilter;
 } // end namespace filters
\ No newline at end of file
@@ -2,30 +2,68 @@
 
 #include "../../Matrix/Matrix.hpp"
 #include "../../Quaternion/Quaternion.hpp"
-#include <Arduino.h>
+#include "../SensorSample.hpp"
+#include <math.h>
+#include <stdint.h>
 
 namespace filters {
-class MahonyFilter {
+
+/**
+ * @brief runtime gains for the Mahony filter. Compile time gains can be
+ * used instead by passing any type with matching static constexpr kI() and
+ * kP() functions (see AlgParams.hpp).
+ */
+class MahonyGains {
 public:
   /**
-   * @brief default constructor
-   * @return a new MahonyFilter instance
+   * @brief constructor for MahonyGains class.
+   * @param kI integral gain
+   * @param kP proportional gain
    */
-  MahonyFilter() {
-    this->_kI = 0.0;
-    this->_kP = 0.0;
+  MahonyGains(double kI = 0.0, double kP = 0.0) {
+    this->_kI = kI;
+    this->_kP = kP;
   }
 
+  /**
+   * @brief gets the integral gain.
+   * @return the integral gain.
+   */
+  double kI() const { return this->_kI; }
+
+  /**
+   * @brief gets the proportional gain.
+   * @return the proportional gain.
+   */
+  double kP() const { return this->_kP; }
+
+private:
+  double _kI;
+  double _kP;
+}; // end MahonyGains class
+
+/**
+ * @brief Mahony filter.
+ * @tparam GainsT the gain provider, either MahonyGains for runtime gains or
+ * a compile time gain struct.
+ * @tparam T the scalar type of the estimate and the readings.
+ */
+template <typename GainsT, typename T = double> class BasicMahonyFilter {
+public:
   /**
    * @brief default constructor
+   * @param gains the filter gains.
+   * @return a new MahonyFilter instance
+   */
+  BasicMahonyFilter(const GainsT &gains = GainsT()) : _gains(gains) {}
+
+  /**
+   * @brief runtime gain constructor
    * @param kI integral gain
    * @param kP proportional gain
    * @return a new MahonyFilter instance
    */
-  MahonyFilter(double kI, double kP) {
-    this->_kI = kI;
-    this->_kP = kP;
-  }
+  BasicMahonyFilter(double kI, double kP) : _gains(kI, kP) {}
 
   /**
    * @brief copy constructor
@@ -33,9 +71,10 @@ public:
    * into this instance.
    * @return a new MahonyFilter instance
    */
-  MahonyFilter(const MahonyFilter &other) {
-    this->_kI = other._kI;
-    this->_kP = other._kP;
+  BasicMahonyFilter(const BasicMahonyFilter &other) : _gains(other._gains) {
+    this->_gyro_bias = other._gyro_bias;
+    this->_last_quat = other._last_quat;
+    this->_sample_timer = other._sample_timer;
   }
 
   /**
@@ -44,12 +83,26 @@ public:
    * into this instance.
    * @return a new MahonyFilter instance
    */
-  MahonyFilter operator=(const MahonyFilter &other) {
-    this->_kI = other._kI;
-    this->_kP = other._kP;
+  BasicMahonyFilter &operator=(const BasicMahonyFilter &other) {
+    this->_gains = other._gains;
+    this->_gyro_bias = other._gyro_bias;
+    this->_last_quat = other._last_quat;
+    this->_sample_timer = other._sample_timer;
     return *this;
   }
 
+  /**
+   * @brief gets the gains used by this filter.
+   * @return the gains used by this filter.
+   */
+  const GainsT &getGains() const { return this->_gains; }
+
+  /**
+   * @brief sets the gains used by this filter.
+   * @param gains the new gains.
+   */
+  void setGains(const GainsT &gains) { this->_gains = gains; }
+
   /**
    * @brief Mahony filter update function. NOTE: all reading matricies
    * are expected to be packed in <X, Y, Z> axis order.
@@ -59,86 +112,130 @@ public:
    * @param ellapsed_time_us elapsed time in microseconds since last update.
    * @return a Quaternion instance with the newly estimated attitude.
    */
-  structures::Quaternion<double>
-  update(structures::Matrix<double, 3, 1> acc_readings,
-         structures::Matrix<double, 3, 1> gyro_readings,
-         structures::Matrix<double, 3, 1> mag_readings,
+  structures::Quaternion<T>
+  update(const structures::Matrix<T, 3, 1> &acc_readings,
+         const structures::Matrix<T, 3, 1> &gyro_readings,
+         const structures::Matrix<T, 3, 1> &mag_readings,
          uint32_t ellapsed_time_us) {
+    this->step(acc_readings.data(), gyro_readings.data(), mag_readings.data(),
+               ellapsed_time_us);
+
+    // return a copy of the updated quaternion
+    return this->_last_quat;
+  }
+
+  /**
+   * @brief in-place Mahony filter update function. The elapsed time
+   * is derived from the timestamp of the previously provided sample.
+   * @param sample the new sensor sample.
+   * @param out the quaternion to write the newly estimated attitude into.
+   */
+  void update(const SensorSample<T> &sample,
+              structures::Quaternion<T> &out) {
+    this->step(sample.acc, sample.gyro, sample.mag,
+               this->_sample_timer.elapsed(sample.timestamp_us));
+    out = this->_last_quat;
+  }
+
+private:
+  /**
+   * @brief performs the filter update on raw <X, Y, Z> reading triples,
+   * updating the internal quaternion and gyro bias estimates.
+   * @param acc_vec accelerometer reading triple.
+   * @param gyro_vec gyroscope reading triple.
+   * @param mag_vec magnetometer reading triple.
+   * @param ellapsed_time_us elapsed time in microseconds since last update.
+   */
+  void step(const T acc_vec[3], const T gyro_vec[3],
+            const T mag_vec[3], uint32_t ellapsed_time_us) {
 
     // compute ellapsed time in seconds
-    double delta_sec = ellapsed_time_us / ((double)1e6);
+    T delta_sec = ellapsed_time_us / ((T)1e6);
+
+    // corrected angular rate, starting from the raw gyro reading
+    T omega[3] = {gyro_vec[0], gyro_vec[1], gyro_vec[2]};
 
     // compute norm of acc_readings
-    double a_norm = acc_readings.norm();
+    T a_norm = sqrt(acc_vec[0] * acc_vec[0] + acc_vec[1] * acc_vec[1] +
+                    acc_vec[2] * acc_vec[2]);
 
     if (a_norm > 0) {
-      double m_norm = mag_readings.norm();
+      T m_norm = sqrt(mag_vec[0] * mag_vec[0] + mag_vec[1] * mag_vec[1] +
+                      mag_vec[2] * mag_vec[2]);
 
-      acc_readings = acc_readings * (1 / a_norm);
-      mag_readings = mag_readings * (1 / m_norm);
+      T acc_norm_vec[3][1] = {
+          {acc_vec[0] / a_norm}, {acc_vec[1] / a_norm}, {acc_vec[2] / a_norm}};
+      structures::Matrix<T, 3, 1> acc_readings(acc_norm_vec);
 
-      structures::Matrix<double, 3, 3> dcm_mat =
+      structures::Matrix<T, 3, 3> dcm_mat =
           this->quatToDCM(this->_last_quat);
 
-      double earth_grav_field[3][1] = {{0}, {0}, {1}};
-      structures::Matrix<double, 3, 1> earth_grav_field_mat(earth_grav_field);
+      T earth_grav_field[3][1] = {{0}, {0}, {1}};
+      structures::Matrix<T, 3, 1> earth_grav_field_mat(earth_grav_field);
 
-      structures::Matrix<double, 3, 1> v_a =
+      structures::Matrix<T, 3, 1> v_a =
           dcm_mat.transpose() * earth_grav_field_mat;
 
-      // rotate magnetic field to inertial frame
-      structures::Matrix<double, 3, 1> h_mod = dcm_mat * mag_readings;
+      // track changes in gyro bias
+      structures::Matrix<T, 3, 1> omega_mes = this->cross(acc_readings, v_a);
 
-      double v_m_vec[3][1] = {
-          {0},
-          {pow(pow(h_mod.getValue(0, 0), 2) + pow(h_mod.getValue(1, 0), 2),
-               0.5)},
-          {h_mod.getValue(2, 0)}};
+      // a zero magnetometer reading means there is no magnetometer, so only
+      // the accelerometer corrects the estimate
+      if (m_norm > 0) {
+        T mag_norm_vec[3][1] = {{mag_vec[0] / m_norm},
+                                {mag_vec[1] / m_norm},
+                                {mag_vec[2] / m_norm}};
+        structures::Matrix<T, 3, 1> mag_readings(mag_norm_vec);
 
-      structures::Matrix<double, 3, 1> v_m(v_m_vec);
-      v_m = v_m * (1 / v_m.norm());
+        // rotate magnetic field to inertial frame
+        structures::Matrix<T, 3, 1> h_mod = dcm_mat * mag_readings;
 
-      // track changes in gyro bias
-      structures::Matrix<double, 3, 1> omega_mes =
-          this->cross(acc_readings, v_a) + this->cross(mag_readings, v_m);
-      structures::Matrix<double, 3, 1> gyro_bias_dot =
-          omega_mes * (-1 * this->_kI);
+        T v_m_vec[3][1] = {
+            {0},
+            {pow(pow(h_mod.getValue(0, 0), 2) + pow(h_mod.getValue(1, 0), 2),
+                 0.5)},
+            {h_mod.getValue(2, 0)}};
+
+        structures::Matrix<T, 3, 1> v_m(v_m_vec);
+        v_m = v_m * (1 / v_m.norm());
+        omega_mes = omega_mes + this->cross(mag_readings, v_m);
+      }
+      structures::Matrix<T, 3, 1> gyro_bias_dot =
+          omega_mes * (-1 * this->_gains.kI());
 
       // estimate gyro bias change
       this->_gyro_bias = this->_gyro_bias + (gyro_bias_dot * delta_sec);
 
       // perform gyro reading correction
-      gyro_readings =
-          gyro_readings - (this->_gyro_bias + (omega_mes * this->_kP));
+      structures::Matrix<T, 3, 1> correction =
+          this->_gyro_bias + (omega_mes * this->_gains.kP());
+      omega[0] -= correction.getValue(0, 0);
+      omega[1] -= correction.getValue(1, 0);
+      omega[2] -= correction.getValue(2, 0);
     }
 
     // compute quaternion rate of change
-    structures::Quaternion<double> p(gyro_readings.getValue(0, 0),
-                                     gyro_readings.getValue(1, 0),
-                                     gyro_readings.getValue(2, 0), 0.0);
-    structures::Quaternion<double> q_dot = (this->_last_quat * p) * 0.5;
+    structures::Quaternion<T> p(omega[0], omega[1], omega[2], 0.0);
+    structures::Quaternion<T> q_dot = (this->_last_quat * p) * 0.5;
 
     // update orientation
     this->_last_quat = this->_last_quat + (q_dot * delta_sec);
 
     // normalize quaternion
     this->_last_quat = this->_last_quat.norm();
-
-    // return a copy of the updated quaternion
-    return this->_last_quat;
   }
 
-private:
   /**
    * @brief function to compute direction cosine matrix
    * from quaternion.
    * @param q the quaternion to use.
    * @return the direction cosine matrix
    */
-  structures::Matrix<double, 3, 3> quatToDCM(structures::Quaternion<double> q) {
-    q = q.norm();
+  structures::Matrix<T, 3, 3>
+  quatToDCM(const structures::Quaternion<T> &q_in) const {
+    structures::Quaternion<T> q = q_in.norm();
 
-    double dcm_vec[3][3] = {
+    T dcm_vec[3][3] = {
         {pow(q[0], 2) + pow(q[1], 2) - pow(q[2], 2) - pow(q[3], 2),
          2.0 * (q[1] * q[2] - q[0] * q[3]), 2.0 * (q[1] * q[3] + q[0] * q[2])},
         {2.0 * (q[1] * q[2] + q[0] * q[3]),
@@ -147,7 +244,7 @@ private:
         {2.0 * (q[1] * q[3] - q[0] * q[2]), 2.0 * (q[0] * q[1] + q[2] * q[3]),
          pow(q[0], 2) - pow(q[1], 2) - pow(q[2], 2) + pow(q[3], 2)}};
 
-    structures::Matrix<double, 3, 3> dcm_mat(dcm_vec);
+    structures::Matrix<T, 3, 3> dcm_mat(dcm_vec);
     return dcm_mat;
   }
 
@@ -156,22 +253,28 @@ private:
    * @param a the first vector in the cross operation
    * @param b the second vector in the cross operation
    */
-  structures::Matrix<double, 3, 1> cross(structures::Matrix<double, 3, 1> a,
-                                         structures::Matrix<double, 3, 1> b) {
-    double cross_res_vec[3][1] = {{a.getValue(1, 0) * b.getValue(2, 0) -
-                                   a.getValue(2, 0) * b.getValue(1, 0)},
-                                  {a.getValue(2, 0) * b.getValue(0, 0) -
-                                   a.getValue(0, 0) * b.getValue(2, 0)},
-                                  {a.getValue(0, 0) * b.getValue(1, 0) -
-                                   a.getValue(1, 0) * b.getValue(0, 0)}};
-
-    structures::Matrix<double, 3, 1> cross_res_mat(cross_res_vec);
+  structures::Matrix<T, 3, 1>
+  cross(const structures::Matrix<T, 3, 1> &a,
+        const structures::Matrix<T, 3, 1> &b) const {
+    T cross_res_vec[3][1] = {{a.getValue(1, 0) * b.getValue(2, 0) -
+                              a.getValue(2, 0) * b.getValue(1, 0)},
+                             {a.getValue(2, 0) * b.getValue(0, 0) -
+                              a.getValue(0, 0) * b.getValue(2, 0)},
+                             {a.getValue(0, 0) * b.getValue(1, 0) -
+                              a.getValue(1, 0) * b.getValue(0, 0)}};
+
+    structures::Matrix<T, 3, 1> cross_res_mat(cross_res_vec);
     return cross_res_mat;
   }
 
-  double _kI;
-  double _kP;
-  structures::Matrix<double, 3, 1> _gyro_bias;
-  structures::Quaternion<double> _last_quat;
-};
+  GainsT _gains;
+  structures::Matrix<T, 3, 1> _gyro_bias;
+  structures::Quaternion<T> _last_quat;
+  SampleTimer _sample_timer;
+}; // end BasicMahonyFilter class
+
+/**
+ * @brief Mahony filter with gains that can be changed at runtime.
+ */
+typedef BasicMahonyFilter<MahonyGains> MahonyFilter;
 } // namespace filters
\ No newline at end of file
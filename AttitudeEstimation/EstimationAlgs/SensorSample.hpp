@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace filters {
+
+/**
+ * @brief a single 9DOF sensor sample. NOTE: all readings are packed in
+ * <X, Y, Z> axis order, and the three triples are laid out contiguously so a
+ * sample can be filled or consumed as one flat block of nine values.
+ */
+template <typename T> struct SensorSample {
+  T acc[3];              // accelerometer reading (m/s^2)
+  T gyro[3];             // gyroscope reading (rad/s)
+  T mag[3];              // magnetometer reading (any consistent unit)
+  uint64_t timestamp_us; // sample timestamp in microseconds
+};
+
+/**
+ * @brief a single raw 9DOF sensor sample, as read from the sensor ADCs
+ * before any unit conversion or calibration. NOTE: all readings are packed
+ * in <X, Y, Z> axis order.
+ */
+struct RawSensorSample {
+  int16_t acc[3];        // accelerometer reading (LSB)
+  int16_t gyro[3];       // gyroscope reading (LSB)
+  int16_t mag[3];        // magnetometer reading (LSB)
+  uint64_t timestamp_us; // sample timestamp in microseconds
+};
+
+/**
+ * @brief a helper to turn a stream of sample timestamps into elapsed
+ * times. The first sample observed has an elapsed time of zero.
+ */
+class SampleTimer {
+public:
+  /**
+   * @brief default constructor for SampleTimer class.
+   */
+  SampleTimer() {
+    this->_last_timestamp_us = 0U;
+    this->_has_timestamp = false;
+  }
+
+  /**
+   * @brief computes the time since the last observed timestamp, and records
+   * the provided timestamp as the new last observed timestamp.
+   * @param timestamp_us the new sample timestamp in microseconds.
+   * @return the elapsed time in microseconds.
+   */
+  uint32_t elapsed(uint64_t timestamp_us) {
+    uint32_t ellapsed_time_us = 0U;
+    if (this->_has_timestamp && timestamp_us > this->_last_timestamp_us) {
+      ellapsed_time_us = (uint32_t)(timestamp_us - this->_last_timestamp_us);
+    }
+
+    this->_last_timestamp_us = timestamp_us;
+    this->_has_timestamp = true;
+    return ellapsed_time_us;
+  }
+
+private:
+  uint64_t _last_timestamp_us;
+  bool _has_timestamp;
+}; // end SampleTimer class
+} // namespace filters
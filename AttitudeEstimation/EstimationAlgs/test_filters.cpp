@@ -0,0 +1,210 @@
+#include "ComplementaryFilter/ComplementaryFilter.hpp"
+#include "MadgwickFilter/MadgwickFilter.hpp"
+#include "MahonyFilter/MahonyFilter.hpp"
+#include "SensorSample.hpp"
+#include "gtest/gtest.h"
+
+using namespace filters;
+using namespace structures;
+
+/**
+ * @brief builds a plausible sample for step i of a slow rotation.
+ */
+SensorSample<double> makeSample(int i, uint64_t timestamp_us) {
+  double phase = 0.01 * i;
+  SensorSample<double> sample = {
+      {0.3 * sin(phase), 0.2 * cos(phase), 9.78},
+      {0.05 * cos(phase), -0.02, 0.1 * sin(phase)},
+      {22000.0, 1500.0 * sin(phase), -41000.0},
+      timestamp_us};
+  return sample;
+}
+
+/**
+ * @brief runs the matrix and in-place update APIs of two copies of the same
+ * filter side by side and checks that they agree.
+ */
+template <typename FilterT> void expectUpdatesAgree(FilterT matrix_filt) {
+  FilterT sample_filt = matrix_filt;
+  Quaternion<double> out;
+
+  // the first sample only establishes the time base
+  SensorSample<double> first = makeSample(0, 1000000U);
+  sample_filt.update(first, out);
+  Matrix<double, 3, 1> acc_mat, gyro_mat, mag_mat;
+  for (size_t axis = 0; axis < 3; axis++) {
+    acc_mat.setValue(axis, 0, first.acc[axis]);
+    gyro_mat.setValue(axis, 0, first.gyro[axis]);
+    mag_mat.setValue(axis, 0, first.mag[axis]);
+  }
+  matrix_filt.update(acc_mat, gyro_mat, mag_mat, 0U);
+
+  for (int i = 1; i < 200; i++) {
+    SensorSample<double> sample = makeSample(i, 1000000U + 10000U * i);
+    for (size_t axis = 0; axis < 3; axis++) {
+      acc_mat.setValue(axis, 0, sample.acc[axis]);
+      gyro_mat.setValue(axis, 0, sample.gyro[axis]);
+      mag_mat.setValue(axis, 0, sample.mag[axis]);
+    }
+
+    Quaternion<double> expected =
+        matrix_filt.update(acc_mat, gyro_mat, mag_mat, 10000U);
+    sample_filt.update(sample, out);
+
+    ASSERT_DOUBLE_EQ(expected.getW(), out.getW());
+    ASSERT_DOUBLE_EQ(expected.getX(), out.getX());
+    ASSERT_DOUBLE_EQ(expected.getY(), out.getY());
+    ASSERT_DOUBLE_EQ(expected.getZ(), out.getZ());
+  }
+
+  // make sure the readings were not modified by the update
+  ASSERT_DOUBLE_EQ(9.78, acc_mat.getValue(2, 0));
+  ASSERT_DOUBLE_EQ(22000.0, mag_mat.getValue(0, 0));
+}
+
+TEST(FilterTesting, TestSampleTimer) {
+  SampleTimer timer;
+
+  // first timestamp has no reference
+  ASSERT_EQ(0U, timer.elapsed(5000000000ULL));
+
+  // later timestamps are relative to the previous one, even past 32 bits
+  ASSERT_EQ(2500U, timer.elapsed(5000002500ULL));
+  ASSERT_EQ(10U, timer.elapsed(5000002510ULL));
+
+  // timestamps that go backwards are treated as no elapsed time
+  ASSERT_EQ(0U, timer.elapsed(5000000000ULL));
+}
+
+TEST(FilterTesting, TestComplementaryUpdateAPIs) {
+  expectUpdatesAgree(ComplementaryFilter(0.9));
+}
+
+TEST(FilterTesting, TestMadgwickUpdateAPIs) {
+  expectUpdatesAgree(MadgwickFilter(0.866 * 0.05));
+}
+
+TEST(FilterTesting, TestMahonyUpdateAPIs) {
+  expectUpdatesAgree(MahonyFilter(0.1, 1.0));
+}
+
+TEST(FilterTesting, TestMahonyCopyKeepsState) {
+  MahonyFilter filt(0.1, 1.0);
+  Quaternion<double> out;
+  for (int i = 0; i < 50; i++) {
+    filt.update(makeSample(i, 10000U * i), out);
+  }
+
+  // a copy must continue from the same estimate as the original
+  MahonyFilter filt_copy(filt);
+  Quaternion<double> out_copy;
+  filt.update(makeSample(50, 500000U), out);
+  filt_copy.update(makeSample(50, 500000U), out_copy);
+  ASSERT_DOUBLE_EQ(out.getW(), out_copy.getW());
+  ASSERT_DOUBLE_EQ(out.getZ(), out_copy.getZ());
+}
+
+/**
+ * @brief compile time gains matching the runtime gains used below.
+ */
+struct TestComplementaryParams {
+  static constexpr double alpha() { return 0.9; }
+};
+
+struct TestMadgwickParams {
+  static constexpr double beta() { return 0.866 * 0.05; }
+};
+
+struct TestMahonyParams {
+  static constexpr double kI() { return 0.1; }
+  static constexpr double kP() { return 1.0; }
+};
+
+/**
+ * @brief checks that a filter using compile time gains tracks the same
+ * filter using equal runtime gains.
+ */
+template <typename StaticFilterT, typename RuntimeFilterT>
+void expectGainsAgree(RuntimeFilterT runtime_filt) {
+  StaticFilterT static_filt;
+  Quaternion<double> static_out;
+  Quaternion<double> runtime_out;
+  for (int i = 0; i < 200; i++) {
+    SensorSample<double> sample = makeSample(i, 10000U * i);
+    static_filt.update(sample, static_out);
+    runtime_filt.update(sample, runtime_out);
+    ASSERT_NEAR(runtime_out.getW(), static_out.getW(), 1e-12);
+    ASSERT_NEAR(runtime_out.getX(), static_out.getX(), 1e-12);
+    ASSERT_NEAR(runtime_out.getY(), static_out.getY(), 1e-12);
+    ASSERT_NEAR(runtime_out.getZ(), static_out.getZ(), 1e-12);
+  }
+}
+
+TEST(FilterTesting, TestCompileTimeGains) {
+  expectGainsAgree<BasicComplementaryFilter<TestComplementaryParams>>(
+      ComplementaryFilter(0.9));
+  expectGainsAgree<BasicMadgwickFilter<TestMadgwickParams>>(
+      MadgwickFilter(0.866 * 0.05));
+  expectGainsAgree<BasicMahonyFilter<TestMahonyParams>>(
+      MahonyFilter(0.1, 1.0));
+}
+
+TEST(FilterTesting, TestRuntimeGainChange) {
+  MahonyFilter filt(0.1, 1.0);
+  ASSERT_DOUBLE_EQ(0.1, filt.getGains().kI());
+  filt.setGains(MahonyGains(0.2, 2.0));
+  ASSERT_DOUBLE_EQ(0.2, filt.getGains().kI());
+  ASSERT_DOUBLE_EQ(2.0, filt.getGains().kP());
+}
+
+TEST(FilterTesting, TestMadgwickExactMeasurement) {
+  // a level device with the field in the X-Z plane matches the identity
+  // estimate exactly, which gives a zero gradient
+  MadgwickFilter filt(0.05);
+  SensorSample<double> sample = {{0.0, 0.0, 9.81},
+                                 {0.0, 0.0, 0.0},
+                                 {20000.0, 0.0, -45000.0},
+                                 0U};
+  Quaternion<double> estimate;
+  for (int i = 0; i < 3; i++) {
+    filt.update(sample, estimate);
+    sample.timestamp_us += 10000U;
+  }
+  ASSERT_DOUBLE_EQ(1.0, estimate.getW());
+  ASSERT_DOUBLE_EQ(0.0, estimate.getX());
+}
+
+/**
+ * @brief feeds a filter a still device rolled by 0.3 rad, without a
+ * magnetometer, and checks that the accelerometer alone corrects the roll
+ * while the heading stays put.
+ */
+template <typename FilterT> void expectTiltWithoutMagnetometer(FilterT filt) {
+  SensorSample<double> sample = {{0.0, 9.81 * sin(0.3), 9.81 * cos(0.3)},
+                                 {0.0, 0.0, 0.0},
+                                 {0.0, 0.0, 0.0},
+                                 0U};
+  Quaternion<double> estimate;
+  for (int i = 0; i < 3000; i++) {
+    filt.update(sample, estimate);
+    sample.timestamp_us += 10000U;
+  }
+  ASSERT_TRUE(isfinite(estimate.getW()));
+  ASSERT_TRUE(isfinite(estimate.getX()));
+  ASSERT_GT(fabs(estimate.getX()), 1e-3);
+  ASSERT_NEAR(0.0, estimate.getY(), 1e-9);
+  ASSERT_NEAR(0.0, estimate.getZ(), 1e-9);
+}
+
+TEST(FilterTesting, TestWithoutMagnetometer) {
+  // a zero magnetometer reading leaves the accelerometer alone to correct
+  // the tilt, instead of dividing by a zero field
+  expectTiltWithoutMagnetometer(ComplementaryFilter(0.98));
+  expectTiltWithoutMagnetometer(MadgwickFilter(0.1));
+  expectTiltWithoutMagnetometer(MahonyFilter(0.05, 1.0));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
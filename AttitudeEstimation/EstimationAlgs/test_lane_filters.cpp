@@ -0,0 +1,168 @@
+#include "LaneFilters/LaneMadgwickFilter.hpp"
+#include "LaneFilters/LaneMahonyFilter.hpp"
+#include "MadgwickFilter/MadgwickFilter.hpp"
+#include "MahonyFilter/MahonyFilter.hpp"
+#include "gtest/gtest.h"
+#include <stdio.h>
+
+using namespace filters;
+using namespace structures;
+
+// the lanes use x * x and sqrt where the scalar filters call pow, which
+// glibc rounds differently about once in a thousand calls, so they agree to
+// within rounding rather than bit for bit. Near convergence the normalized
+// Madgwick gradient amplifies those differences, so lanes are compared one
+// update at a time, starting from the scalar estimate.
+static const double kLaneTolerance = 1e-9;
+static const int kLaneUpdates = 500;
+
+/**
+ * @brief builds a plausible sample for step i of a slow rotation, with a
+ * different motion and sample period per lane.
+ */
+SensorSample<double> makeLaneSample(size_t lane, int i) {
+  double phase = 0.01 * i * (1.0 + 0.1 * lane);
+  SensorSample<double> sample = {
+      {0.3 * sin(phase) + 0.05 * lane, 0.2 * cos(phase), 9.78},
+      {0.05 * cos(phase), -0.02 * lane, 0.1 * sin(phase)},
+      {22000.0, 1500.0 * sin(phase + lane), -41000.0},
+      (uint64_t)i * (10000U + 100U * lane)};
+  return sample;
+}
+
+/**
+ * @brief runs a lane filter side by side with one scalar filter per lane,
+ * every lane with its own gains and input, and checks that every update of
+ * every lane agrees with its scalar filter.
+ * @param lane_filt the lane filter, with the lane gains already set.
+ * @param scalar_filts the scalar filters, one per lane, with the same gains.
+ * @param still_lane a lane fed zero acceleration, or width for none.
+ * @param no_mag_lane a lane fed zero magnetometer readings, or width for
+ * none.
+ */
+template <typename LaneFilterT, typename FilterT, size_t width>
+void expectLanesMatchScalar(LaneFilterT &lane_filt,
+                            FilterT (&scalar_filts)[width],
+                            size_t still_lane = width,
+                            size_t no_mag_lane = width) {
+  LaneSamples<width> samples;
+  Quaternion<double> estimates[width];
+  for (int i = 0; i < kLaneUpdates; i++) {
+    for (size_t lane = 0; lane < width; lane++) {
+      SensorSample<double> sample = makeLaneSample(lane, i);
+      if (lane == still_lane) {
+        sample.acc[0] = sample.acc[1] = sample.acc[2] = 0.0;
+      }
+      if (lane == no_mag_lane) {
+        sample.mag[0] = sample.mag[1] = sample.mag[2] = 0.0;
+      }
+      samples.set(lane, sample);
+      scalar_filts[lane].update(sample, estimates[lane]);
+    }
+    lane_filt.update(samples);
+
+    for (size_t lane = 0; lane < width; lane++) {
+      Quaternion<double> lane_estimate = lane_filt.getEstimate(lane);
+      ASSERT_NEAR(estimates[lane].getW(), lane_estimate.getW(),
+                  kLaneTolerance);
+      ASSERT_NEAR(estimates[lane].getX(), lane_estimate.getX(),
+                  kLaneTolerance);
+      ASSERT_NEAR(estimates[lane].getY(), lane_estimate.getY(),
+                  kLaneTolerance);
+      ASSERT_NEAR(estimates[lane].getZ(), lane_estimate.getZ(),
+                  kLaneTolerance);
+      lane_filt.setEstimate(lane, estimates[lane]);
+    }
+  }
+}
+
+template <size_t width>
+void expectMadgwickLanesMatch(size_t still_lane, size_t no_mag_lane = width) {
+  LaneMadgwickFilter<width> lane_filt;
+  MadgwickFilter scalar_filts[width];
+  for (size_t lane = 0; lane < width; lane++) {
+    MadgwickGains gains(0.01 + 0.02 * lane);
+    lane_filt.setGains(lane, gains);
+    scalar_filts[lane].setGains(gains);
+  }
+  expectLanesMatchScalar(lane_filt, scalar_filts, still_lane, no_mag_lane);
+}
+
+template <size_t width>
+void expectMahonyLanesMatch(size_t still_lane, size_t no_mag_lane = width) {
+  LaneMahonyFilter<width> lane_filt;
+  MahonyFilter scalar_filts[width];
+  for (size_t lane = 0; lane < width; lane++) {
+    MahonyGains gains(0.05 + 0.01 * lane, 0.5 + 0.1 * lane);
+    lane_filt.setGains(lane, gains);
+    scalar_filts[lane].setGains(gains);
+  }
+  expectLanesMatchScalar(lane_filt, scalar_filts, still_lane, no_mag_lane);
+}
+
+TEST(LaneFilterTesting, TestMadgwickLanesMatchScalar) {
+  expectMadgwickLanesMatch<1>(1);
+  expectMadgwickLanesMatch<4>(4);
+  expectMadgwickLanesMatch<8>(8);
+  expectMadgwickLanesMatch<16>(16);
+}
+
+TEST(LaneFilterTesting, TestMahonyLanesMatchScalar) {
+  expectMahonyLanesMatch<1>(1);
+  expectMahonyLanesMatch<4>(4);
+  expectMahonyLanesMatch<8>(8);
+  expectMahonyLanesMatch<16>(16);
+}
+
+TEST(LaneFilterTesting, TestZeroAccelerationLane) {
+  // a lane without acceleration integrates the gyro alone, as the scalar
+  // filters do, without disturbing its neighbours
+  expectMadgwickLanesMatch<8>(3);
+  expectMahonyLanesMatch<8>(5);
+}
+
+TEST(LaneFilterTesting, TestZeroMagnetometerLane) {
+  // a lane without a magnetometer corrects with the accelerometer alone,
+  // as the scalar filters do, without disturbing its neighbours
+  expectMadgwickLanesMatch<8>(8, 2);
+  expectMahonyLanesMatch<8>(8, 6);
+}
+
+TEST(LaneFilterTesting, TestLaneGainsAndReset) {
+  LaneMahonyFilter<4> lane_filt(MahonyGains(0.1, 1.0));
+  lane_filt.setGains(2, MahonyGains(0.3, 2.0));
+  ASSERT_DOUBLE_EQ(0.1, lane_filt.getGains(0).kI());
+  ASSERT_DOUBLE_EQ(0.3, lane_filt.getGains(2).kI());
+  ASSERT_DOUBLE_EQ(2.0, lane_filt.getGains(2).kP());
+
+  LaneSamples<4> samples;
+  for (int i = 0; i < 10; i++) {
+    for (size_t lane = 0; lane < 4; lane++) {
+      samples.set(lane, makeLaneSample(lane, i));
+    }
+    lane_filt.update(samples);
+  }
+  ASSERT_NE(1.0, lane_filt.getEstimate(1).getW());
+  lane_filt.reset(1);
+  ASSERT_DOUBLE_EQ(1.0, lane_filt.getEstimate(1).getW());
+  ASSERT_DOUBLE_EQ(0.0, lane_filt.getEstimate(1).getX());
+  ASSERT_NE(1.0, lane_filt.getEstimate(2).getW());
+}
+
+int main(int argc, char **argv) {
+#if LANE_VECTOR_AVX512
+  if (!__builtin_cpu_supports("avx512f")) {
+    printf("skipping lane filter tests: no AVX-512 on this CPU\n");
+    return 0;
+  }
+#elif LANE_VECTOR_AVX2
+  if (!__builtin_cpu_supports("avx2")) {
+    printf("skipping lane filter tests: no AVX2 on this CPU\n");
+    return 0;
+  }
+#endif
+  printf("lane kernels: 4 lanes %s, 8 lanes %s\n",
+         LaneVector<4>::ops_t::name(), LaneVector<8>::ops_t::name());
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "../Quaternion/Quaternion.hpp"
+#include <algorithm>
+#include <math.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace evaluation {
+
+/**
+ * @brief computes the angle of the rotation between two attitudes. A
+ * quaternion and its negation are the same attitude, so the sign of either
+ * does not matter. An attitude that is zero or not finite, such as the
+ * output of a diverged filter, is as far as possible from any other.
+ * @param a the first attitude.
+ * @param b the second attitude.
+ * @return the angle between the attitudes in radians, in [0, pi].
+ */
+inline double attitudeError(const structures::Quaternion<double> &a,
+                            const structures::Quaternion<double> &b) {
+  double a_norm = sqrt(a.getW() * a.getW() + a.getX() * a.getX() +
+                       a.getY() * a.getY() + a.getZ() * a.getZ());
+  double b_norm = sqrt(b.getW() * b.getW() + b.getX() * b.getX() +
+                       b.getY() * b.getY() + b.getZ() * b.getZ());
+  if (!(a_norm > 0) || !(b_norm > 0) || !isfinite(a_norm) ||
+      !isfinite(b_norm)) {
+    return M_PI;
+  }
+  double dot = (a.getW() * b.getW() + a.getX() * b.getX() +
+                a.getY() * b.getY() + a.getZ() * b.getZ()) /
+               (a_norm * b_norm);
+  return 2 * acos(fmin(1.0, fabs(dot)));
+}
+
+/**
+ * @brief collects attitude errors and summarizes their distribution.
+ */
+class ErrorAccumulator {
+public:
+  /**
+   * @brief default constructor for ErrorAccumulator class.
+   */
+  ErrorAccumulator() { this->clear(); }
+
+  /**
+   * @brief reserves room for a number of errors up front.
+   * @param count the expected number of errors.
+   */
+  void reserve(size_t count) { this->_errors.reserve(count); }
+
+  /**
+   * @brief removes every collected error.
+   */
+  void clear() {
+    this->_errors.clear();
+    this->_sum = 0;
+    this->_sum_squares = 0;
+    this->_max = 0;
+    this->_sorted = true;
+  }
+
+  /**
+   * @brief adds an error.
+   * @param error the error in radians.
+   */
+  void add(double error) {
+    this->_errors.push_back(error);
+    this->_sum += error;
+    this->_sum_squares += error * error;
+    this->_max = std::max(this->_max, error);
+    this->_sorted = false;
+  }
+
+  /**
+   * @brief returns the number of collected errors.
+   * @return the error count.
+   */
+  size_t count() const { return this->_errors.size(); }
+
+  /**
+   * @brief returns the mean error.
+   * @return the mean error, or zero if there are no errors.
+   */
+  double mean() const {
+    return this->_errors.empty() ? 0.0 : this->_sum / this->_errors.size();
+  }
+
+  /**
+   * @brief returns the root mean square error.
+   * @return the RMS error, or zero if there are no errors.
+   */
+  double rms() const {
+    return this->_errors.empty()
+               ? 0.0
+               : sqrt(this->_sum_squares / this->_errors.size());
+  }
+
+  /**
+   * @brief returns the largest error.
+   * @return the largest error, or zero if there are no errors.
+   */
+  double max() const { return this->_max; }
+
+  /**
+   * @brief returns an error percentile, interpolating linearly between the
+   * closest ranks. The errors are sorted on the first call after an add().
+   * @param percent the percentile, from 0 to 100.
+   * @return the percentile, or zero if there are no errors.
+   */
+  double percentile(double percent) {
+    if (this->_errors.empty()) {
+      return 0.0;
+    }
+    if (!this->_sorted) {
+      std::sort(this->_errors.begin(), this->_errors.end());
+      this->_sorted = true;
+    }
+
+    double rank = std::min(std::max(percent, 0.0), 100.0) / 100.0 *
+                  (this->_errors.size() - 1);
+    size_t lower = (size_t)rank;
+    if (lower + 1 >= this->_errors.size()) {
+      return this->_errors.back();
+    }
+    double fraction = rank - lower;
+    return this->_errors[lower] +
+           fraction * (this->_errors[lower + 1] - this->_errors[lower]);
+  }
+
+private:
+  std::vector<double> _errors;
+  double _sum;
+  double _sum_squares;
+  double _max;
+  bool _sorted;
+}; // end ErrorAccumulator class
+
+/**
+ * @brief the accuracy and cost of one filter configuration.
+ */
+struct EvaluationResult {
+  std::string filter;      // filter name
+  std::string gains;       // gain set, as printed in reports
+  size_t samples;          // number of scored samples
+  double rms_rad;          // RMS attitude error
+  double max_rad;          // largest attitude error
+  double p50_rad;          // median attitude error
+  double p90_rad;          // 90th percentile attitude error
+  double p99_rad;          // 99th percentile attitude error
+  double ns_per_update;    // mean filter update time
+  bool pareto;             // not dominated by any other configuration
+};
+
+/**
+ * @brief fills in the error statistics of a result.
+ * @param errors the collected errors.
+ * @param result the result to fill in.
+ */
+inline void summarizeErrors(ErrorAccumulator &errors,
+                            EvaluationResult &result) {
+  result.samples = errors.count();
+  result.rms_rad = errors.rms();
+  result.max_rad = errors.max();
+  result.p50_rad = errors.percentile(50);
+  result.p90_rad = errors.percentile(90);
+  result.p99_rad = errors.percentile(99);
+}
+
+/**
+ * @brief marks the configurations on the Pareto front of RMS error against
+ * update time: those for which no other configuration is at least as
+ * accurate and as cheap, and strictly better in one of the two.
+ * @param results the configurations to mark.
+ */
+inline void markParetoFront(std::vector<EvaluationResult> &results) {
+  for (size_t i = 0; i < results.size(); i++) {
+    results[i].pareto = true;
+    for (size_t j = 0; j < results.size() && results[i].pareto; j++) {
+      const EvaluationResult &a = results[i];
+      const EvaluationResult &b = results[j];
+      bool no_worse = b.rms_rad <= a.rms_rad &&
+                      b.ns_per_update <= a.ns_per_update;
+      bool better = b.rms_rad < a.rms_rad ||
+                    b.ns_per_update < a.ns_per_update;
+      if (j != i && no_worse && better) {
+        results[i].pareto = false;
+      }
+    }
+  }
+}
+} // namespace evaluation
@@ -0,0 +1,554 @@
+#pragma once
+
+#include "../ImuLog/ImuArchiveReader.hpp"
+#include "../ImuLog/ImuLogReader.hpp"
+#include "../SensorDriver/SensorSources.hpp"
+#include "AccuracyMetrics.hpp"
+#include "EvaluationSources.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <dirent.h>
+#include <functional>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace evaluation {
+
+/**
+ * @brief one recording file read sample by sample, whatever its format:
+ * CSV, .imulog binary log or .imuarc compressed archive. The readings are
+ * calibrated as they are read.
+ */
+class RecordingReader {
+public:
+  /**
+   * @brief default constructor for RecordingReader class.
+   */
+  RecordingReader() : _file(NULL), _error("not open") {}
+
+  RecordingReader(const RecordingReader &other) = delete;
+  RecordingReader &operator=(const RecordingReader &other) = delete;
+
+  /**
+   * @brief destructor for RecordingReader class. Closes the recording.
+   */
+  ~RecordingReader() { this->close(); }
+
+  /**
+   * @brief opens a recording, picking the format from the extension.
+   * @param path the recording path.
+   * @return true if the recording was opened, false otherwise. See
+   * getError().
+   */
+  bool open(const char *path) {
+    this->close();
+    this->_calibration = filters::SensorCalibration<double>::nominal();
+    if (hasExtension(path, ".imuarc")) {
+      this->_archive.reset(new imulog::ImuArchiveReader());
+      if (!this->_archive->open(path)) {
+        this->_error = this->_archive->getError();
+        return false;
+      }
+      this->_calibration = this->_archive->getCalibration();
+      this->_archive_source.reset(
+          new imulog::ImuArchiveSensorSource(*this->_archive));
+    } else if (hasExtension(path, ".imulog")) {
+      this->_log.reset(new imulog::ImuLogReader());
+      if (!this->_log->open(path)) {
+        this->_error = this->_log->getError();
+        return false;
+      }
+      this->_calibration = imulog::headerCalibration(this->_log->getHeader());
+      this->_log_source.reset(new imulog::ImuLogSensorSource(*this->_log));
+    } else {
+      this->_file = fopen(path, "r");
+      if (this->_file == NULL) {
+        this->_error = "cannot open file";
+        return false;
+      }
+      this->_csv_source.reset(new filters::RecordedSensorSource(this->_file));
+    }
+    this->_error = NULL;
+    return true;
+  }
+
+  /**
+   * @brief reads the next sample.
+   * @param sample the calibrated sample to fill.
+   * @param ground_truth the ground truth attitude to fill.
+   * @return false at the end of the recording, true otherwise.
+   */
+  bool read(filters::SensorSample<double> &sample,
+            structures::Quaternion<double> &ground_truth) {
+    filters::AcquiredSample acquired;
+    bool has_sample = false;
+    if (this->_archive_source) {
+      has_sample = this->_archive_source->read(acquired);
+    } else if (this->_log_source) {
+      has_sample = this->_log_source->read(acquired);
+    } else if (this->_csv_source) {
+      has_sample = this->_csv_source->read(acquired);
+    }
+    if (!has_sample) {
+      return false;
+    }
+    this->_calibration.apply(acquired.raw, sample);
+    ground_truth = acquired.ground_truth;
+    return true;
+  }
+
+  /**
+   * @brief closes the recording.
+   */
+  void close() {
+    this->_archive_source.reset();
+    this->_archive.reset();
+    this->_log_source.reset();
+    this->_log.reset();
+    this->_csv_source.reset();
+    if (this->_file != NULL) {
+      fclose(this->_file);
+      this->_file = NULL;
+    }
+    this->_error = "not open";
+  }
+
+  /**
+   * @brief returns why the last open() failed.
+   * @return the error message, or NULL if the recording is open.
+   */
+  const char *getError() const { return this->_error; }
+
+private:
+  FILE *_file;
+  std::unique_ptr<filters::RecordedSensorSource> _csv_source;
+  std::unique_ptr<imulog::ImuLogReader> _log;
+  std::unique_ptr<imulog::ImuLogSensorSource> _log_source;
+  std::unique_ptr<imulog::ImuArchiveReader> _archive;
+  std::unique_ptr<imulog::ImuArchiveSensorSource> _archive_source;
+  filters::SensorCalibration<double> _calibration;
+  const char *_error;
+}; // end RecordingReader class
+
+/**
+ * @brief the recordings of one device, in time order. Consecutive files are
+ * replayed back to back through the same filter.
+ */
+struct ReplayDevice {
+  std::string name;
+  std::vector<std::string> files;
+};
+
+/**
+ * @brief checks whether a path names a recording.
+ * @param path the path.
+ * @return true for CSV, .imulog and .imuarc files, false otherwise.
+ */
+inline bool isRecordingPath(const char *path) {
+  return hasExtension(path, ".csv") || hasExtension(path, ".imulog") ||
+         hasExtension(path, ".imuarc");
+}
+
+/**
+ * @brief lists the names in a directory, sorted.
+ */
+inline bool listDirectory(const std::string &path,
+                          std::vector<std::string> &names) {
+  DIR *dir = opendir(path.c_str());
+  if (dir == NULL) {
+    return false;
+  }
+  while (struct dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  return true;
+}
+
+/**
+ * @brief finds the devices of a fleet directory. Every subdirectory is a
+ * device whose recordings, sorted by name, are consecutive stretches of
+ * one log, so they should be named in time order. Every recording directly
+ * in the directory is a device of its own, named after the file.
+ * @param path the fleet directory.
+ * @param devices the vector to append the devices to, sorted by name.
+ * @return false if the directory cannot be read, true otherwise.
+ */
+inline bool findDevices(const std::string &path,
+                        std::vector<ReplayDevice> &devices) {
+  std::vector<std::string> names;
+  if (!listDirectory(path, names)) {
+    return false;
+  }
+  for (const std::string &name : names) {
+    std::string entry_path = path + "/" + name;
+    struct stat info;
+    if (stat(entry_path.c_str(), &info) != 0) {
+      continue;
+    }
+
+    ReplayDevice device;
+    if (S_ISDIR(info.st_mode)) {
+      std::vector<std::string> files;
+      listDirectory(entry_path, files);
+      for (const std::string &file : files) {
+        if (isRecordingPath(file.c_str())) {
+          device.files.push_back(entry_path + "/" + file);
+        }
+      }
+      device.name = name;
+    } else if (isRecordingPath(name.c_str())) {
+      device.files.push_back(entry_path);
+      device.name = name.substr(0, name.rfind('.'));
+    }
+    if (!device.files.empty()) {
+      devices.push_back(device);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief the settings of a batch replay.
+ */
+struct BatchReplaySettings {
+  size_t chunk_samples = 65536;  // samples replayed per task
+  size_t max_active_jobs = 0;    // jobs open at once, 0 for 2 per thread
+  double warmup_s = 10.0;        // leading time of every device left out of
+                                 // its error scores
+  const char *output_dir = NULL; // directory for per job estimate files, or
+                                 // NULL to only summarize
+};
+
+/**
+ * @brief the outcome of replaying one device through one filter.
+ */
+struct DeviceSummary {
+  std::string device;  // device name
+  std::string filter;  // filter name
+  size_t files;        // recordings replayed
+  size_t samples;      // samples replayed
+  size_t chunks;       // tasks the replay was split into
+  EvaluationResult result; // error scores; the update time is not measured
+  const char *error;   // why the replay stopped early, or NULL
+};
+
+/**
+ * @brief re-runs filters over a fleet of device recordings on a
+ * work-stealing pool. Every (device, filter) pair is a job, split into
+ * time-contiguous chunks. Only one chunk of a job exists at a time, and it
+ * submits the next chunk when it is done, so the filter sees the samples
+ * of its device in order. The continuation goes to the front of its
+ * worker's deque, keeping the job on a warm cache, while idle workers
+ * steal chunks of other jobs. Estimates are appended to the job's output
+ * file after every chunk, and every job is summarized as soon as it ends.
+ */
+class BatchReplay {
+public:
+  /**
+   * @brief constructor for BatchReplay class.
+   * @param pool the pool the jobs run on.
+   * @param settings the replay settings.
+   */
+  BatchReplay(WorkStealingPool &pool, const BatchReplaySettings &settings)
+      : _pool(pool), _settings(settings), _next_job(0), _active_jobs(0) {
+    if (this->_settings.chunk_samples == 0) {
+      this->_settings.chunk_samples = 1;
+    }
+    if (this->_settings.max_active_jobs == 0) {
+      this->_settings.max_active_jobs = 2 * pool.getThreadCount();
+    }
+  }
+
+  /**
+   * @brief adds a filter to run over every device. Must be called before
+   * run().
+   * @tparam FilterT the filter or filter driver. Must provide
+   * update(const SensorSample<double> &, structures::Quaternion<double> &).
+   * @param name the filter name, used in reports and file names.
+   * @param prototype the filter in its initial state, copied for every
+   * device.
+   */
+  template <typename FilterT>
+  void addFilter(const char *name, const FilterT &prototype = FilterT()) {
+    this->_filters.emplace_back(new ReplayFilterOf<FilterT>(name, prototype));
+  }
+
+  /**
+   * @brief adds a device to replay. Must be called before run().
+   * @param device the device and its recordings.
+   */
+  void addDevice(const ReplayDevice &device) {
+    this->_devices.push_back(device);
+  }
+
+  /**
+   * @brief replays every device through every filter, and waits for the
+   * replays to finish.
+   * @param callback called with the DeviceSummary of every job as soon as
+   * it ends. Calls are serialized, but come from the pool's workers and in
+   * no particular order.
+   * @return the number of jobs that replayed every recording.
+   */
+  template <typename CallbackT> size_t run(CallbackT &&callback) {
+    this->_jobs.clear();
+    for (size_t device = 0; device < this->_devices.size(); device++) {
+      for (size_t filter = 0; filter < this->_filters.size(); filter++) {
+        this->_jobs.emplace_back(new Job(this->_devices[device],
+                                         *this->_filters[filter]));
+      }
+    }
+    this->_next_job = 0;
+    this->_active_jobs = 0;
+    size_t completed = 0;
+    this->_on_summary = [&callback, &completed](const DeviceSummary &s) {
+      if (s.error == NULL) {
+        completed++;
+      }
+      callback(s);
+    };
+
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      this->startJobs();
+    }
+    this->_pool.wait();
+    this->_on_summary = nullptr;
+    this->_jobs.clear();
+    return completed;
+  }
+
+private:
+  /**
+   * @brief a filter the jobs copy their own instance from.
+   */
+  struct ReplayFilter {
+    ReplayFilter(const char *filter_name) : name(filter_name) {}
+    virtual ~ReplayFilter() {}
+
+    /**
+     * @brief returns a copy of this filter in its current state.
+     */
+    virtual ReplayFilter *clone() const = 0;
+
+    /**
+     * @brief updates the filter with a chunk of samples. One virtual call
+     * per chunk, the per sample loop is specialized for the filter type.
+     */
+    virtual void update(const filters::SensorSample<double> *samples,
+                        size_t count,
+                        structures::Quaternion<double> *estimates) = 0;
+
+    const char *name;
+  };
+
+  template <typename FilterT> struct ReplayFilterOf : public ReplayFilter {
+    ReplayFilterOf(const char *filter_name, const FilterT &prototype)
+        : ReplayFilter(filter_name), filter(prototype) {}
+
+    ReplayFilter *clone() const override {
+      return new ReplayFilterOf(this->name, this->filter);
+    }
+
+    void update(const filters::SensorSample<double> *samples, size_t count,
+                structures::Quaternion<double> *estimates) override {
+      for (size_t i = 0; i < count; i++) {
+        this->filter.update(samples[i], estimates[i]);
+      }
+    }
+
+    FilterT filter;
+  };
+
+  /**
+   * @brief the replay state of one device through one filter, only ever
+   * touched by the one chunk task it has in flight.
+   */
+  struct Job {
+    Job(const ReplayDevice &job_device, const ReplayFilter &prototype)
+        : device(job_device), filter(prototype.clone()), next_file(0),
+          output(NULL), warmup_end_us(0), has_first_sample(false) {
+      summary.device = job_device.name;
+      summary.filter = prototype.name;
+      summary.files = 0;
+      summary.samples = 0;
+      summary.chunks = 0;
+      summary.error = NULL;
+    }
+
+    const ReplayDevice &device;
+    std::unique_ptr<ReplayFilter> filter;
+    RecordingReader reader;
+    size_t next_file; // next recording to open
+    FILE *output;
+    uint64_t warmup_end_us;
+    bool has_first_sample;
+    std::vector<filters::SensorSample<double>> samples;
+    std::vector<structures::Quaternion<double>> ground_truth;
+    std::vector<structures::Quaternion<double>> estimates;
+    ErrorAccumulator errors;
+    DeviceSummary summary;
+  };
+
+  /**
+   * @brief submits pending jobs until the active job limit is reached. The
+   * caller must hold _mutex.
+   */
+  void startJobs() {
+    while (this->_active_jobs < this->_settings.max_active_jobs &&
+           this->_next_job < this->_jobs.size()) {
+      Job *job = this->_jobs[this->_next_job++].get();
+      this->_active_jobs++;
+      this->_pool.submit([this, job]() { this->runChunk(*job); });
+    }
+  }
+
+  /**
+   * @brief reads up to a chunk of samples, moving on to the device's next
+   * recording whenever one ends.
+   * @return false if the job failed, true otherwise.
+   */
+  bool readChunk(Job &job) {
+    job.samples.resize(this->_settings.chunk_samples);
+    job.ground_truth.resize(this->_settings.chunk_samples);
+    size_t count = 0;
+    while (count < this->_settings.chunk_samples) {
+      if (job.reader.getError() == NULL &&
+          job.reader.read(job.samples[count], job.ground_truth[count])) {
+        count++;
+        continue;
+      }
+      if (job.next_file >= job.device.files.size()) {
+        break;
+      }
+      if (!job.reader.open(job.device.files[job.next_file++].c_str())) {
+        job.summary.error = job.reader.getError();
+        break;
+      }
+      job.summary.files++;
+    }
+    job.samples.resize(count);
+    job.ground_truth.resize(count);
+    return job.summary.error == NULL;
+  }
+
+  /**
+   * @brief replays the next chunk of a job, then either submits the chunk
+   * after it or finishes the job.
+   */
+  void runChunk(Job &job) {
+    if (job.summary.chunks == 0 && !this->openOutput(job)) {
+      this->finishJob(job);
+      return;
+    }
+    job.summary.chunks++;
+    bool read_ok = this->readChunk(job);
+    size_t count = job.samples.size();
+    if (count == 0) {
+      this->finishJob(job);
+      return;
+    }
+
+    if (!job.has_first_sample) {
+      job.warmup_end_us = job.samples[0].timestamp_us +
+                          (uint64_t)(this->_settings.warmup_s * 1e6);
+      job.has_first_sample = true;
+    }
+    job.estimates.resize(count);
+    job.filter->update(job.samples.data(), count, job.estimates.data());
+    for (size_t i = 0; i < count; i++) {
+      double error = attitudeError(job.estimates[i], job.ground_truth[i]);
+      if (job.samples[i].timestamp_us >= job.warmup_end_us) {
+        job.errors.add(error);
+      }
+      if (job.output != NULL) {
+        this->writeEstimate(job, i, error);
+      }
+    }
+    job.summary.samples += count;
+    if (job.output != NULL) {
+      fflush(job.output);
+    }
+
+    if (!read_ok || count < this->_settings.chunk_samples) {
+      this->finishJob(job); // the last recording ended within the chunk
+      return;
+    }
+    this->_pool.submit([this, &job]() { this->runChunk(job); });
+  }
+
+  bool openOutput(Job &job) {
+    if (this->_settings.output_dir == NULL) {
+      return true;
+    }
+    std::string path = std::string(this->_settings.output_dir) + "/" +
+                       job.device.name + "." + job.summary.filter + ".csv";
+    job.output = fopen(path.c_str(), "w");
+    if (job.output == NULL) {
+      job.summary.error = "cannot create the output file";
+      return false;
+    }
+    fputs("timestamp_us,gt_w,gt_x,gt_y,gt_z,est_w,est_x,est_y,est_z,"
+          "error_deg\n",
+          job.output);
+    return true;
+  }
+
+  void writeEstimate(Job &job, size_t i, double error) {
+    const structures::Quaternion<double> &truth = job.ground_truth[i];
+    const structures::Quaternion<double> &estimate = job.estimates[i];
+    fprintf(job.output,
+            "%llu,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.4f\n",
+            (unsigned long long)job.samples[i].timestamp_us, truth.getW(),
+            truth.getX(), truth.getY(), truth.getZ(), estimate.getW(),
+            estimate.getX(), estimate.getY(), estimate.getZ(),
+            error * 180.0 / M_PI);
+  }
+
+  /**
+   * @brief summarizes a job, releases its buffers and files, and starts the
+   * next pending job.
+   */
+  void finishJob(Job &job) {
+    job.summary.result.filter = job.summary.filter;
+    job.summary.result.gains = "-";
+    job.summary.result.ns_per_update = 0.0;
+    job.summary.result.pareto = false;
+    summarizeErrors(job.errors, job.summary.result);
+    if (job.output != NULL) {
+      fclose(job.output);
+      job.output = NULL;
+    }
+    job.reader.close();
+    job.errors = ErrorAccumulator();
+    std::vector<filters::SensorSample<double>>().swap(job.samples);
+    std::vector<structures::Quaternion<double>>().swap(job.ground_truth);
+    std::vector<structures::Quaternion<double>>().swap(job.estimates);
+
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_on_summary(job.summary);
+    this->_active_jobs--;
+    this->startJobs();
+  }
+
+  WorkStealingPool &_pool;
+  BatchReplaySettings _settings;
+  std::vector<std::unique_ptr<ReplayFilter>> _filters;
+  std::vector<ReplayDevice> _devices;
+  std::vector<std::unique_ptr<Job>> _jobs;
+  std::mutex _mutex; // guards the job queue and the summary callback
+  size_t _next_job;
+  size_t _active_jobs;
+  std::function<void(const DeviceSummary &)> _on_summary;
+}; // end BatchReplay class
+} // namespace evaluation
@@ -0,0 +1,607 @@
+#pragma once
+
+#include "../EstimationAlgs/SensorSample.hpp"
+#include "../ImuLog/MappedFile.hpp"
+#include "../Quaternion/Quaternion.hpp"
+#include "../SensorDriver/Clock.hpp"
+#include "FilterEvaluation.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <charconv>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <system_error>
+#include <vector>
+
+namespace evaluation {
+
+/**
+ * @brief the columns of a public dataset's CSV files: an IMU file with one
+ * row per sample, and a ground truth pose file, usually at another rate.
+ * Columns are counted from 0, and fields may be separated by commas,
+ * spaces or tabs. The defaults are the EuRoC MAV and TUM-VI layout:
+ * timestamp [ns], w_x, w_y, w_z [rad/s], a_x, a_y, a_z [m/s^2] for the IMU,
+ * and timestamp [ns], p_x, p_y, p_z, q_w, q_x, q_y, q_z for the poses.
+ */
+struct DatasetLayout {
+  int imu_timestamp = 0;          // IMU timestamp column
+  int imu_gyro = 1;               // first of the gyroscope X, Y, Z columns
+  int imu_acc = 4;                // first of the accelerometer columns
+  int imu_mag = -1;               // first magnetometer column, or -1
+  int gt_timestamp = 0;           // ground truth timestamp column
+  int gt_quat = 4;                // first of the four quaternion columns
+  bool gt_w_first = true;         // W, X, Y, Z order, otherwise X, Y, Z, W
+  uint64_t timestamp_unit_ns = 1; // nanoseconds per timestamp unit
+
+  /**
+   * @brief returns the EuRoC MAV layout, which TUM-VI shares.
+   * @return the layout.
+   */
+  static DatasetLayout euroc() { return DatasetLayout(); }
+};
+
+/**
+ * @brief a dataset held as structure of arrays, one column per reading
+ * axis, with the ground truth attitude interpolated to every IMU sample.
+ * Readings are in SI units as the datasets record them, so samples go to
+ * the filters without calibration. Without a magnetometer the field reads
+ * as zero, which the filters take as no reading and correct the attitude
+ * from the accelerometer alone, leaving the heading to the gyroscope.
+ */
+struct ImuDataset {
+  std::vector<uint64_t> timestamp_us;
+  std::vector<double> gyro[3];         // rad/s, <X, Y, Z>
+  std::vector<double> acc[3];          // m/s^2, <X, Y, Z>
+  std::vector<double> mag[3];          // zero if the dataset has none
+  std::vector<double> ground_truth[4]; // body to world, <W, X, Y, Z>
+  bool has_mag = false;                // whether the mag columns were read
+
+  /**
+   * @brief returns the number of samples.
+   * @return the sample count.
+   */
+  size_t size() const { return this->timestamp_us.size(); }
+
+  /**
+   * @brief gathers one sample for the filters.
+   * @param index the sample index.
+   * @param sample the sample to fill.
+   */
+  void getSample(size_t index, filters::SensorSample<double> &sample) const {
+    for (int axis = 0; axis < 3; axis++) {
+      sample.acc[axis] = this->acc[axis][index];
+      sample.gyro[axis] = this->gyro[axis][index];
+      sample.mag[axis] = this->mag[axis][index];
+    }
+    sample.timestamp_us = this->timestamp_us[index];
+  }
+
+  /**
+   * @brief returns the ground truth attitude of one sample.
+   * @param index the sample index.
+   * @return the ground truth attitude.
+   */
+  structures::Quaternion<double> getGroundTruth(size_t index) const {
+    return structures::Quaternion<double>(
+        this->ground_truth[1][index], this->ground_truth[2][index],
+        this->ground_truth[3][index], this->ground_truth[0][index]);
+  }
+
+  /**
+   * @brief appends the dataset to an evaluation input.
+   * @param input the input to append to.
+   */
+  void toEvaluationInput(EvaluationInput &input) const {
+    input.samples.reserve(input.samples.size() + this->size());
+    input.ground_truth.reserve(input.ground_truth.size() + this->size());
+    filters::SensorSample<double> sample;
+    for (size_t i = 0; i < this->size(); i++) {
+      this->getSample(i, sample);
+      input.samples.push_back(sample);
+      input.ground_truth.push_back(this->getGroundTruth(i));
+    }
+  }
+};
+
+/**
+ * @brief what loading a dataset found, and how long it took.
+ */
+struct DatasetReport {
+  uint64_t bytes = 0;                  // size of both files
+  size_t imu_rows = 0;                 // IMU rows parsed
+  size_t ground_truth_rows = 0;        // ground truth rows parsed
+  size_t skipped_lines = 0;            // headers, comments and blank lines
+  size_t rejected_lines = 0;           // malformed rows, left out
+  size_t trimmed_samples = 0;          // IMU samples outside the poses
+  uint64_t max_ground_truth_gap_us = 0; // longest interpolation interval
+  double load_s = 0;                   // mapping and parsing time
+  double align_s = 0;                  // interpolation time
+};
+
+/**
+ * @brief interpolates between two attitudes along the shortest arc.
+ * @param a the first attitude, <W, X, Y, Z>.
+ * @param b the second attitude, <W, X, Y, Z>.
+ * @param fraction the position between a (0) and b (1).
+ * @param out the interpolated unit attitude, <W, X, Y, Z>.
+ */
+inline void slerpAttitude(const double a[4], const double b[4],
+                          double fraction, double out[4]) {
+  double dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+  double sign = dot < 0 ? -1.0 : 1.0;
+  dot = fabs(dot);
+
+  // nearly equal attitudes fall back to a normalized linear blend
+  double weight_a = 1.0 - fraction;
+  double weight_b = fraction;
+  if (dot < 0.9995) {
+    double theta = acos(dot);
+    double sin_theta = sin(theta);
+    weight_a = sin((1.0 - fraction) * theta) / sin_theta;
+    weight_b = sin(fraction * theta) / sin_theta;
+  }
+  double norm = 0;
+  for (int i = 0; i < 4; i++) {
+    out[i] = weight_a * a[i] + sign * weight_b * b[i];
+    norm += out[i] * out[i];
+  }
+  norm = sqrt(norm);
+  for (int i = 0; i < 4; i++) {
+    out[i] /= norm;
+  }
+}
+
+/**
+ * @brief loads public IMU datasets stored as CSV. Each file is memory
+ * mapped and cut into chunks at line boundaries. The pool first counts
+ * each chunk's lines, so every column is sized once. It then parses every
+ * chunk with std::from_chars straight into its slice of the columns, and
+ * the slices are packed together in order. The ground truth is then
+ * interpolated to the IMU timestamps, chunk by chunk, and IMU samples
+ * outside the ground truth span are trimmed.
+ */
+class DatasetLoader {
+public:
+  /**
+   * @brief the default chunk size.
+   */
+  static const size_t kDefaultChunkBytes = 4 << 20;
+
+  /**
+   * @brief constructor for DatasetLoader class.
+   * @param pool the pool that parses the chunks.
+   * @param layout the columns of the dataset files.
+   * @param chunk_bytes the approximate bytes parsed per task.
+   */
+  DatasetLoader(WorkStealingPool &pool,
+                const DatasetLayout &layout = DatasetLayout::euroc(),
+                size_t chunk_bytes = kDefaultChunkBytes)
+      : _pool(pool), _layout(layout), _chunk_bytes(chunk_bytes),
+        _error(NULL) {
+    if (this->_chunk_bytes == 0) {
+      this->_chunk_bytes = 1;
+    }
+  }
+
+  /**
+   * @brief loads a dataset.
+   * @param imu_path the IMU CSV file.
+   * @param ground_truth_path the ground truth pose CSV file.
+   * @param dataset the dataset to fill, replacing its contents.
+   * @return true on success, false otherwise. See getError().
+   */
+  bool load(const char *imu_path, const char *ground_truth_path,
+            ImuDataset &dataset) {
+    this->_error = NULL;
+    this->_report = DatasetReport();
+    filters::SteadyClock clock;
+
+    const int imu_columns[9] = {
+        this->_layout.imu_gyro,    this->_layout.imu_gyro + 1,
+        this->_layout.imu_gyro + 2, this->_layout.imu_acc,
+        this->_layout.imu_acc + 1,  this->_layout.imu_acc + 2,
+        this->_layout.imu_mag,      this->_layout.imu_mag + 1,
+        this->_layout.imu_mag + 2};
+    std::vector<double> *imu_values[9] = {
+        &dataset.gyro[0], &dataset.gyro[1], &dataset.gyro[2],
+        &dataset.acc[0],  &dataset.acc[1],  &dataset.acc[2],
+        &dataset.mag[0],  &dataset.mag[1],  &dataset.mag[2]};
+    dataset.has_mag = this->_layout.imu_mag >= 0;
+    size_t imu_value_count = dataset.has_mag ? 9 : 6;
+    for (int axis = 0; axis < 3; axis++) {
+      dataset.mag[axis].clear();
+    }
+    if (!this->loadTable(imu_path, this->_layout.imu_timestamp, imu_columns,
+                         imu_values, imu_value_count, dataset.timestamp_us,
+                         this->_report.imu_rows)) {
+      return false;
+    }
+
+    // the ground truth columns are read in W, X, Y, Z order
+    int first = this->_layout.gt_quat;
+    int gt_columns[4] = {first, first + 1, first + 2, first + 3};
+    if (!this->_layout.gt_w_first) {
+      gt_columns[0] = first + 3;
+      gt_columns[1] = first;
+      gt_columns[2] = first + 1;
+      gt_columns[3] = first + 2;
+    }
+    std::vector<double> poses[4];
+    std::vector<double> *gt_values[4] = {&poses[0], &poses[1], &poses[2],
+                                         &poses[3]};
+    std::vector<uint64_t> pose_timestamps;
+    if (!this->loadTable(ground_truth_path, this->_layout.gt_timestamp,
+                         gt_columns, gt_values, 4, pose_timestamps,
+                         this->_report.ground_truth_rows)) {
+      return false;
+    }
+    this->_report.load_s = clock.nowUs() * 1e-6;
+
+    if (!this->align(pose_timestamps, poses, dataset)) {
+      return false;
+    }
+    this->_report.align_s = clock.nowUs() * 1e-6 - this->_report.load_s;
+    return true;
+  }
+
+  /**
+   * @brief returns why the last load failed.
+   * @return the error message, or NULL if it succeeded.
+   */
+  const char *getError() const { return this->_error; }
+
+  /**
+   * @brief returns what the last load found.
+   * @return the report of the last load.
+   */
+  const DatasetReport &getReport() const { return this->_report; }
+
+private:
+  static const size_t kMaxValues = 9;
+  static const int kMaxFields = 64;
+
+  typedef enum { ROW_PARSED, ROW_SKIPPED, ROW_REJECTED } row_status_t;
+
+  /**
+   * @brief one chunk of a file and the slice of the columns it fills.
+   */
+  struct Chunk {
+    const char *begin;
+    const char *end;
+    size_t first_row; // first row of its slice
+    size_t capacity;  // lines in the chunk
+    size_t rows;      // rows parsed
+    size_t skipped;
+    size_t rejected;
+  };
+
+  /**
+   * @brief where the fields of a row go.
+   */
+  struct RowTarget {
+    int8_t slots[kMaxFields]; // -1 timestamp, value index, or -2 ignored
+    int last_field;           // highest field read
+    size_t value_count;
+    uint64_t unit_ns;
+    uint64_t *timestamps;
+    double *values[kMaxValues];
+  };
+
+  bool loadTable(const char *path, int timestamp_column, const int *columns,
+                 std::vector<double> *const *values, size_t value_count,
+                 std::vector<uint64_t> &timestamps, size_t &rows) {
+    RowTarget target;
+    std::fill(target.slots, target.slots + kMaxFields, (int8_t)-2);
+    if (timestamp_column < 0 || timestamp_column >= kMaxFields) {
+      this->_error = "invalid dataset layout";
+      return false;
+    }
+    target.slots[timestamp_column] = -1;
+    target.last_field = timestamp_column;
+    for (size_t i = 0; i < value_count; i++) {
+      if (columns[i] < 0 || columns[i] >= kMaxFields ||
+          target.slots[columns[i]] != -2) {
+        this->_error = "invalid dataset layout";
+        return false;
+      }
+      target.slots[columns[i]] = (int8_t)i;
+      target.last_field = std::max(target.last_field, columns[i]);
+    }
+    target.value_count = value_count;
+    target.unit_ns = this->_layout.timestamp_unit_ns;
+
+    imulog::MappedFile file;
+    if (file.open(path) != NULL) {
+      this->_error = "cannot map a dataset file";
+      return false;
+    }
+    file.advise(0, file.size(), MADV_SEQUENTIAL);
+    this->_report.bytes += file.size();
+
+    // cut the file after the first newline past every chunk boundary
+    const char *data = (const char *)file.data();
+    const char *data_end = data + file.size();
+    std::vector<Chunk> chunks;
+    for (const char *begin = data; begin < data_end;) {
+      const char *end = begin + std::min<size_t>(this->_chunk_bytes,
+                                                 data_end - begin);
+      if (end < data_end) {
+        const char *newline =
+            (const char *)memchr(end - 1, '\n', data_end - end + 1);
+        end = newline != NULL ? newline + 1 : data_end;
+      }
+      Chunk chunk = {begin, end, 0, 0, 0, 0, 0};
+      chunks.push_back(chunk);
+      begin = end;
+    }
+
+    for (Chunk &chunk : chunks) {
+      this->_pool.submit([&chunk]() { countLines(chunk); });
+    }
+    this->_pool.wait();
+    size_t capacity = 0;
+    for (Chunk &chunk : chunks) {
+      chunk.first_row = capacity;
+      capacity += chunk.capacity;
+    }
+    timestamps.resize(capacity);
+    target.timestamps = timestamps.data();
+    for (size_t i = 0; i < value_count; i++) {
+      values[i]->resize(capacity);
+      target.values[i] = values[i]->data();
+    }
+
+    for (Chunk &chunk : chunks) {
+      this->_pool.submit(
+          [&chunk, &target]() { parseChunk(chunk, target); });
+    }
+    this->_pool.wait();
+
+    // pack the slices, leaving out the lines that held no row
+    rows = 0;
+    for (const Chunk &chunk : chunks) {
+      if (chunk.first_row != rows) {
+        std::copy(timestamps.begin() + chunk.first_row,
+                  timestamps.begin() + chunk.first_row + chunk.rows,
+                  timestamps.begin() + rows);
+        for (size_t i = 0; i < value_count; i++) {
+          std::vector<double> &column = *values[i];
+          std::copy(column.begin() + chunk.first_row,
+                    column.begin() + chunk.first_row + chunk.rows,
+                    column.begin() + rows);
+        }
+      }
+      rows += chunk.rows;
+      this->_report.skipped_lines += chunk.skipped;
+      this->_report.rejected_lines += chunk.rejected;
+    }
+    timestamps.resize(rows);
+    for (size_t i = 0; i < value_count; i++) {
+      values[i]->resize(rows);
+    }
+    return true;
+  }
+
+  static void countLines(Chunk &chunk) {
+    size_t lines = 0;
+    for (const char *at = chunk.begin; at < chunk.end; at++) {
+      at = (const char *)memchr(at, '\n', chunk.end - at);
+      if (at == NULL) {
+        lines++; // a last line without a newline
+        break;
+      }
+      lines++;
+    }
+    chunk.capacity = lines;
+  }
+
+  static void parseChunk(Chunk &chunk, const RowTarget &target) {
+    const char *line = chunk.begin;
+    while (line < chunk.end) {
+      const char *newline =
+          (const char *)memchr(line, '\n', chunk.end - line);
+      const char *line_end = newline != NULL ? newline : chunk.end;
+      row_status_t status =
+          parseRow(line, line_end, target, chunk.first_row + chunk.rows);
+      if (status == ROW_PARSED) {
+        chunk.rows++;
+      } else if (status == ROW_SKIPPED) {
+        chunk.skipped++;
+      } else {
+        chunk.rejected++;
+      }
+      line = line_end + 1;
+    }
+  }
+
+  static bool isSeparator(char c) { return c == ' ' || c == '\t'; }
+
+  static row_status_t parseRow(const char *cursor, const char *end,
+                               const RowTarget &target, size_t row) {
+    while (cursor < end && (isSeparator(*cursor) || *cursor == '\r')) {
+      cursor++;
+    }
+    if (cursor == end || *cursor == '#' || *cursor == '"' ||
+        (*cursor >= 'A' && *cursor <= 'Z') ||
+        (*cursor >= 'a' && *cursor <= 'z')) {
+      return ROW_SKIPPED; // blank, comment or header line
+    }
+
+    size_t found = 0;
+    for (int field = 0; field <= target.last_field; field++) {
+      while (cursor < end && isSeparator(*cursor)) {
+        cursor++;
+      }
+      int slot = target.slots[field];
+      if (slot == -1) {
+        if (!parseTimestamp(cursor, end, target.unit_ns,
+                            target.timestamps[row])) {
+          return ROW_REJECTED;
+        }
+        found++;
+      } else if (slot >= 0) {
+        std::from_chars_result result =
+            std::from_chars(cursor, end, target.values[slot][row]);
+        if (result.ec != std::errc()) {
+          return ROW_REJECTED;
+        }
+        cursor = result.ptr;
+        found++;
+      } else {
+        while (cursor < end && *cursor != ',' && !isSeparator(*cursor) &&
+               *cursor != '\r') {
+          cursor++;
+        }
+      }
+
+      // one comma, or spaces alone, separate the fields
+      while (cursor < end && isSeparator(*cursor)) {
+        cursor++;
+      }
+      if (cursor < end && *cursor == ',') {
+        cursor++;
+      }
+    }
+    return found == target.value_count + 1 ? ROW_PARSED : ROW_REJECTED;
+  }
+
+  static bool parseTimestamp(const char *&cursor, const char *end,
+                             uint64_t unit_ns, uint64_t &timestamp_us) {
+    uint64_t integer;
+    std::from_chars_result result = std::from_chars(cursor, end, integer);
+    if (result.ec != std::errc()) {
+      return false;
+    }
+    if (result.ptr == end ||
+        (*result.ptr != '.' && *result.ptr != 'e' && *result.ptr != 'E')) {
+      cursor = result.ptr;
+      timestamp_us = integer * unit_ns / 1000;
+      return true;
+    }
+
+    // fractional timestamps, such as seconds, are converted through double
+    double value;
+    result = std::from_chars(cursor, end, value);
+    if (result.ec != std::errc() || value < 0) {
+      return false;
+    }
+    cursor = result.ptr;
+    timestamp_us = (uint64_t)llround(value * (double)unit_ns * 1e-3);
+    return true;
+  }
+
+  bool align(const std::vector<uint64_t> &pose_timestamps,
+             const std::vector<double> *poses, ImuDataset &dataset) {
+    if (pose_timestamps.size() < 2) {
+      this->_error = "the ground truth has fewer than two poses";
+      return false;
+    }
+    for (size_t i = 1; i < pose_timestamps.size(); i++) {
+      if (pose_timestamps[i] <= pose_timestamps[i - 1]) {
+        this->_error = "the ground truth timestamps are not increasing";
+        return false;
+      }
+    }
+    for (size_t i = 1; i < dataset.timestamp_us.size(); i++) {
+      if (dataset.timestamp_us[i] < dataset.timestamp_us[i - 1]) {
+        this->_error = "the IMU timestamps are not in order";
+        return false;
+      }
+    }
+
+    // keep the IMU samples the poses span
+    std::vector<uint64_t> &timestamps = dataset.timestamp_us;
+    size_t first = std::lower_bound(timestamps.begin(), timestamps.end(),
+                                    pose_timestamps.front()) -
+                   timestamps.begin();
+    size_t last = std::upper_bound(timestamps.begin(), timestamps.end(),
+                                   pose_timestamps.back()) -
+                  timestamps.begin();
+    if (first >= last) {
+      this->_error = "the ground truth does not overlap the IMU samples";
+      return false;
+    }
+    this->_report.trimmed_samples = timestamps.size() - (last - first);
+    trimColumn(timestamps, first, last);
+    for (int axis = 0; axis < 3; axis++) {
+      trimColumn(dataset.gyro[axis], first, last);
+      trimColumn(dataset.acc[axis], first, last);
+      if (!dataset.has_mag) {
+        dataset.mag[axis].assign(timestamps.size(), 0.0);
+      } else {
+        trimColumn(dataset.mag[axis], first, last);
+      }
+    }
+
+    for (size_t i = 1; i < pose_timestamps.size(); i++) {
+      this->_report.max_ground_truth_gap_us =
+          std::max(this->_report.max_ground_truth_gap_us,
+                   pose_timestamps[i] - pose_timestamps[i - 1]);
+    }
+
+    for (int i = 0; i < 4; i++) {
+      dataset.ground_truth[i].resize(timestamps.size());
+    }
+    size_t rows_per_task = std::max<size_t>(1, this->_chunk_bytes / 64);
+    for (size_t begin = 0; begin < timestamps.size(); begin += rows_per_task) {
+      size_t end = std::min(timestamps.size(), begin + rows_per_task);
+      this->_pool.submit([&pose_timestamps, poses, &dataset, begin, end]() {
+        alignRows(pose_timestamps, poses, dataset, begin, end);
+      });
+    }
+    this->_pool.wait();
+    return true;
+  }
+
+  static void trimColumn(std::vector<double> &column, size_t first,
+                         size_t last) {
+    column.resize(last);
+    column.erase(column.begin(), column.begin() + first);
+  }
+
+  static void trimColumn(std::vector<uint64_t> &column, size_t first,
+                         size_t last) {
+    column.resize(last);
+    column.erase(column.begin(), column.begin() + first);
+  }
+
+  static void alignRows(const std::vector<uint64_t> &pose_timestamps,
+                        const std::vector<double> *poses, ImuDataset &dataset,
+                        size_t begin, size_t end) {
+    // the IMU samples are in order, so the bracketing pose only moves on
+    size_t pose = std::upper_bound(pose_timestamps.begin(),
+                                   pose_timestamps.end(),
+                                   dataset.timestamp_us[begin]) -
+                  pose_timestamps.begin();
+    for (size_t i = begin; i < end; i++) {
+      uint64_t t = dataset.timestamp_us[i];
+      while (pose < pose_timestamps.size() && pose_timestamps[pose] <= t) {
+        pose++;
+      }
+      size_t next = std::min(pose, pose_timestamps.size() - 1);
+      size_t previous = next - 1;
+      double fraction =
+          (double)(t - pose_timestamps[previous]) /
+          (double)(pose_timestamps[next] - pose_timestamps[previous]);
+
+      double a[4], b[4], out[4];
+      for (int k = 0; k < 4; k++) {
+        a[k] = poses[k][previous];
+        b[k] = poses[k][next];
+      }
+      slerpAttitude(a, b, fraction, out);
+      for (int k = 0; k < 4; k++) {
+        dataset.ground_truth[k][i] = out[k];
+      }
+    }
+  }
+
+  WorkStealingPool &_pool;
+  DatasetLayout _layout;
+  size_t _chunk_bytes;
+  const char *_error;
+  DatasetReport _report;
+}; // end DatasetLoader class
+} // namespace evaluation
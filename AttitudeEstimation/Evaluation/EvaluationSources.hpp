@@ -0,0 +1,192 @@
+#pragma once
+
+#include "../ImuLog/ImuArchiveReader.hpp"
+#include "../ImuLog/ImuLogReader.hpp"
+#include "../SensorDriver/SensorSources.hpp"
+#include "../Simulation/ImuSimulator.hpp"
+#include "../Simulation/Trajectory.hpp"
+#include "DatasetLoader.hpp"
+#include "FilterEvaluation.hpp"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace evaluation {
+
+/**
+ * @brief the usage lines of the options parsed by parseInputOption().
+ */
+static const char *const kInputUsage =
+    "  recordings are CSV files, .imulog binary logs or .imuarc\n"
+    "  compressed archives\n"
+    "  --ground-truth <csv> read the recording as a public dataset IMU CSV\n"
+    "                      (EuRoC or TUM-VI layout) with this pose file\n"
+    "  --rate <hz>         synthetic sample rate (default 100)\n"
+    "  --trajectory spin|handheld\n"
+    "                      synthetic motion (default handheld)\n"
+    "  --noise ideal|mems  handheld trajectory noise (default ideal)\n"
+    "  --seed <n>          handheld trajectory noise seed\n";
+
+/**
+ * @brief selects the recording or simulation an evaluation tool loads.
+ */
+struct InputOptions {
+  const char *recording = NULL;     // recorded sample file, or NULL
+  uint64_t synthetic_samples = 0;   // synthetic sample count if no recording
+  double synthetic_rate_hz = 100.0; // synthetic sample rate
+  bool simulate = true;             // handheld trajectory instead of a spin
+  bool noisy = false;               // consumer MEMS noise on the simulation
+  uint64_t seed = 1;                // simulation noise seed
+  const char *ground_truth = NULL;  // dataset pose file, or NULL
+
+  /**
+   * @brief checks whether an input was selected.
+   * @return true if a recording or synthetic samples were selected.
+   */
+  bool selected() const {
+    return this->recording != NULL || this->synthetic_samples > 0;
+  }
+};
+
+/**
+ * @brief checks whether a path ends with an extension.
+ * @param path the path.
+ * @param extension the extension, including the dot.
+ * @return true if the path ends with the extension, false otherwise.
+ */
+inline bool hasExtension(const char *path, const char *extension) {
+  size_t len = strlen(path);
+  size_t extension_len = strlen(extension);
+  return len >= extension_len &&
+         strcmp(path + len - extension_len, extension) == 0;
+}
+
+/**
+ * @brief parses one input selection argument.
+ * @param argc the argument count.
+ * @param argv the arguments.
+ * @param i the index of the argument, advanced past its value if any.
+ * @param options the options to update.
+ * @return true if the argument was an input option, false otherwise.
+ */
+inline bool parseInputOption(int argc, char **argv, int &i,
+                             InputOptions &options) {
+  const char *arg = argv[i];
+  bool has_value = i + 1 < argc;
+  if (strcmp(arg, "--synthetic") == 0 && has_value) {
+    options.synthetic_samples = strtoull(argv[++i], NULL, 10);
+  } else if (strcmp(arg, "--rate") == 0 && has_value) {
+    options.synthetic_rate_hz = atof(argv[++i]);
+  } else if (strcmp(arg, "--trajectory") == 0 && has_value) {
+    options.simulate = strcmp(argv[++i], "spin") != 0;
+  } else if (strcmp(arg, "--noise") == 0 && has_value) {
+    options.noisy = strcmp(argv[++i], "mems") == 0;
+  } else if (strcmp(arg, "--seed") == 0 && has_value) {
+    options.seed = strtoull(argv[++i], NULL, 10);
+  } else if (strcmp(arg, "--ground-truth") == 0 && has_value) {
+    options.ground_truth = argv[++i];
+  } else if (arg[0] != '-' && options.recording == NULL) {
+    options.recording = arg;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief loads the recording or simulation selected by the options.
+ * @param options the input selection.
+ * @param input the input to append the samples to.
+ * @return true on success, false otherwise.
+ */
+inline bool loadOptionsInput(const InputOptions &options,
+                             EvaluationInput &input) {
+  if (options.recording != NULL && options.ground_truth != NULL) {
+    WorkStealingPool pool;
+    DatasetLoader loader(pool);
+    ImuDataset dataset;
+    if (!loader.load(options.recording, options.ground_truth, dataset)) {
+      fprintf(stderr, "%s: %s\n", options.recording, loader.getError());
+      return false;
+    }
+    dataset.toEvaluationInput(input);
+    return true;
+  }
+
+  if (options.recording != NULL && hasExtension(options.recording, ".imuarc")) {
+    imulog::ImuArchiveReader reader;
+    if (!reader.open(options.recording)) {
+      fprintf(stderr, "%s: %s\n", options.recording, reader.getError());
+      return false;
+    }
+    imulog::ImuArchiveSensorSource source(reader);
+    loadInput(source, reader.getCalibration(), input);
+    return true;
+  }
+
+  if (options.recording != NULL && hasExtension(options.recording, ".imulog")) {
+    imulog::ImuLogReader reader;
+    if (!reader.open(options.recording)) {
+      fprintf(stderr, "%s: %s\n", options.recording, reader.getError());
+      return false;
+    }
+    imulog::ImuLogSensorSource source(reader);
+    loadInput(source, imulog::headerCalibration(reader.getHeader()), input);
+    return true;
+  }
+
+  if (options.recording != NULL) {
+    FILE *file = fopen(options.recording, "r");
+    if (file == NULL) {
+      perror(options.recording);
+      return false;
+    }
+    filters::RecordedSensorSource source(file);
+    loadInput(source, filters::SensorCalibration<double>::nominal(), input);
+    fclose(file);
+    return true;
+  }
+
+  if (options.simulate) {
+    simulation::ImuSimulator<simulation::SinusoidalTrajectory> simulator(
+        simulation::SinusoidalTrajectory::handheld(),
+        options.synthetic_rate_hz,
+        options.noisy ? simulation::NoiseModel::consumerMems()
+                      : simulation::NoiseModel::ideal(),
+        options.seed);
+    simulation::SimulatedSensorSource<simulation::SinusoidalTrajectory> source(
+        simulator, options.synthetic_samples);
+    loadInput(source, filters::SensorCalibration<double>::nominal(), input);
+    return true;
+  }
+
+  const double body_rate[3] = {0.1, -0.2, 0.3};
+  filters::SyntheticSensorSource source(options.synthetic_samples,
+                                        options.synthetic_rate_hz, body_rate);
+  loadInput(source, filters::SensorCalibration<double>::nominal(), input);
+  return true;
+}
+
+/**
+ * @brief counts the leading samples recorded within a warmup time of the
+ * first one.
+ * @param input the recording.
+ * @param warmup_s the warmup time in seconds.
+ * @return the number of warmup samples.
+ */
+inline size_t countWarmupSamples(const EvaluationInput &input,
+                                 double warmup_s) {
+  if (input.size() == 0) {
+    return 0;
+  }
+  uint64_t warmup_end_us =
+      input.samples[0].timestamp_us + (uint64_t)(warmup_s * 1e6);
+  size_t warmup_samples = 0;
+  while (warmup_samples < input.size() &&
+         input.samples[warmup_samples].timestamp_us < warmup_end_us) {
+    warmup_samples++;
+  }
+  return warmup_samples;
+}
+} // namespace evaluation
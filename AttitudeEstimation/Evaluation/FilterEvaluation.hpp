@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../EstimationAlgs/SensorSample.hpp"
+#include "../Quaternion/Quaternion.hpp"
+#include "../SensorDriver/Calibration.hpp"
+#include "../SensorDriver/Clock.hpp"
+#include "../SensorDriver/Records.hpp"
+#include "AccuracyMetrics.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace evaluation {
+
+/**
+ * @brief a whole recording held in memory, calibrated once, so that every
+ * filter configuration replays exactly the same input and the timed loop
+ * does no I/O or unit conversion.
+ */
+struct EvaluationInput {
+  std::vector<filters::SensorSample<double>> samples; // calibrated readings
+  std::vector<structures::Quaternion<double>> ground_truth;
+
+  /**
+   * @brief returns the number of samples.
+   * @return the sample count.
+   */
+  size_t size() const { return this->samples.size(); }
+};
+
+/**
+ * @brief reads every sample of a sensor source into memory.
+ * @param source the source, providing bool read(AcquiredSample &).
+ * @param calibration the raw-to-SI calibration.
+ * @param input the input to append the samples to.
+ * @return the number of samples read.
+ */
+template <typename SourceT>
+size_t loadInput(SourceT &source,
+                 const filters::SensorCalibration<double> &calibration,
+                 EvaluationInput &input) {
+  filters::AcquiredSample acquired;
+  filters::SensorSample<double> sample;
+  size_t count = 0;
+  while (source.read(acquired)) {
+    calibration.apply(acquired.raw, sample);
+    input.samples.push_back(sample);
+    input.ground_truth.push_back(acquired.ground_truth);
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief the replay settings shared by every filter configuration.
+ */
+struct EvaluationSettings {
+  size_t warmup_samples = 0; // leading samples left out of the error scores
+  int repetitions = 3;       // timed runs; the fastest one is reported
+};
+
+/**
+ * @brief replays an input through a filter, scores its estimates against
+ * the ground truth and measures its update time. Every run starts from a
+ * copy of the prototype, so the runs see the same initial state. The timed
+ * loop only updates the filter and stores the estimate; the errors are
+ * computed afterwards from the estimates of the last run.
+ * @param prototype the filter in its initial state, providing
+ * update(const SensorSample<double> &, Quaternion<double> &).
+ * @param input the recording.
+ * @param settings the replay settings.
+ * @param result the result to fill in; the names are left untouched.
+ */
+template <typename FilterT>
+void evaluateFilter(const FilterT &prototype, const EvaluationInput &input,
+                    const EvaluationSettings &settings,
+                    EvaluationResult &result) {
+  std::vector<structures::Quaternion<double>> estimates(input.size());
+  uint64_t best_us = UINT64_MAX;
+  for (int run = 0; run < settings.repetitions || run == 0; run++) {
+    FilterT filter(prototype);
+    filters::SteadyClock clock;
+    for (size_t i = 0; i < input.size(); i++) {
+      filter.update(input.samples[i], estimates[i]);
+    }
+    uint64_t elapsed_us = clock.nowUs();
+    if (elapsed_us < best_us) {
+      best_us = elapsed_us;
+    }
+  }
+  result.ns_per_update =
+      input.size() > 0 ? best_us * 1e3 / input.size() : 0.0;
+
+  ErrorAccumulator errors;
+  errors.reserve(input.size());
+  for (size_t i = settings.warmup_samples; i < input.size(); i++) {
+    errors.add(attitudeError(estimates[i], input.ground_truth[i]));
+  }
+  summarizeErrors(errors, result);
+  result.pareto = false;
+}
+} // namespace evaluation
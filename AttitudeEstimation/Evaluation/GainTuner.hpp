@@ -0,0 +1,261 @@
+#pragma once
+
+#include "../Simulation/ImuNoise.hpp"
+#include "AccuracyMetrics.hpp"
+#include "FilterEvaluation.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace evaluation {
+
+/**
+ * @brief the largest number of gains tuned together.
+ */
+static const size_t kMaxTunedGains = 2;
+
+/**
+ * @brief the search range of one gain.
+ */
+struct GainRange {
+  const char *name; // gain name, as printed in reports
+  double min;       // smallest value searched
+  double max;       // largest value searched
+  bool log_scale;   // sample uniformly in log(value) instead of value
+};
+
+/**
+ * @brief one gain set and its score on the data it has seen so far.
+ */
+struct TuningCandidate {
+  double gains[kMaxTunedGains];
+  double rms_rad;  // RMS error over the scored samples, or INFINITY
+  size_t scored;   // number of scored samples
+  size_t rung;     // last successive halving rung it took part in
+};
+
+/**
+ * @brief the settings of a successive halving search.
+ */
+struct TuningSettings {
+  size_t warmup_samples = 0; // leading samples left out of every score
+  size_t min_samples = 1000; // scored samples of the first rung
+  size_t eta = 3;            // survivors are 1 in eta, budgets grow by eta
+};
+
+/**
+ * @brief the outcome of one successive halving rung.
+ */
+struct TuningRung {
+  size_t candidates;  // candidates evaluated in this rung
+  size_t end_sample;  // every candidate has seen the samples before this
+  double best_rms_rad;
+};
+
+/**
+ * @brief draws candidate gain sets uniformly over their ranges. The first
+ * candidate is always the provided default gain set, so the search never
+ * does worse than the current parameters on the data it is run on.
+ * @param ranges the range of every gain.
+ * @param gain_count the number of gains, at most kMaxTunedGains.
+ * @param defaults the default gain set.
+ * @param count the number of candidates to draw.
+ * @param seed the random seed; a seed fully determines the candidates.
+ * @param candidates the vector to fill with the candidates.
+ */
+inline void sampleCandidates(const GainRange ranges[], size_t gain_count,
+                             const double defaults[], size_t count,
+                             uint64_t seed,
+                             std::vector<TuningCandidate> &candidates) {
+  simulation::Random random(seed);
+  candidates.clear();
+  for (size_t i = 0; i < count; i++) {
+    TuningCandidate candidate = {};
+    for (size_t gain = 0; gain < gain_count; gain++) {
+      const GainRange &range = ranges[gain];
+      double u = random.uniform();
+      if (i == 0) {
+        candidate.gains[gain] = defaults[gain];
+      } else if (range.log_scale) {
+        candidate.gains[gain] =
+            exp(log(range.min) + u * (log(range.max) - log(range.min)));
+      } else {
+        candidate.gains[gain] = range.min + u * (range.max - range.min);
+      }
+    }
+    candidate.rms_rad = INFINITY;
+    candidates.push_back(candidate);
+  }
+}
+
+/**
+ * @brief searches candidate gain sets with successive halving. Every
+ * surviving candidate replays the next stretch of the recording on the
+ * pool, then only the best 1 in eta survive into the next rung, which sees
+ * eta times as many samples. Candidates resume from where the previous rung
+ * stopped instead of starting over, and a candidate whose estimate stops
+ * being finite is dropped at once. The last rung replays the whole
+ * recording. Scores do not depend on the number of threads.
+ * @tparam FilterT the filter type.
+ * @param make_filter builds a filter from a candidate's gains, called as
+ * FilterT make_filter(const double gains[]).
+ * @param input the recording.
+ * @param settings the search settings.
+ * @param pool the pool the candidates are replayed on.
+ * @param candidates the candidates; their scores are filled in.
+ * @param rungs if not NULL, filled with the outcome of every rung.
+ * @return the index of the best candidate, or candidates.size() if there
+ * are none.
+ */
+template <typename FilterT, typename FactoryT>
+size_t successiveHalving(FactoryT make_filter, const EvaluationInput &input,
+                         const TuningSettings &settings,
+                         WorkStealingPool &pool,
+                         std::vector<TuningCandidate> &candidates,
+                         std::vector<TuningRung> *rungs = NULL) {
+  if (candidates.empty()) {
+    return candidates.size();
+  }
+
+  struct Replay {
+    FilterT filter;
+    size_t next;        // next sample to replay
+    double sum_squares; // sum of squared errors of the scored samples
+  };
+  std::vector<Replay> replays;
+  replays.reserve(candidates.size());
+  std::vector<size_t> alive;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    replays.push_back(Replay{make_filter(candidates[i].gains), 0, 0.0});
+    candidates[i].rms_rad = INFINITY;
+    candidates[i].scored = 0;
+    candidates[i].rung = 0;
+    alive.push_back(i);
+  }
+
+  size_t eta = std::max<size_t>(settings.eta, 2);
+  size_t budget = std::max<size_t>(settings.min_samples, 1);
+  for (size_t rung = 0;; rung++) {
+    size_t end = std::min(settings.warmup_samples + budget, input.size());
+    if (alive.size() == 1) {
+      end = input.size(); // nothing left to compare, finish the replay
+    }
+
+    for (size_t i : alive) {
+      candidates[i].rung = rung;
+      pool.submit([&, i, end]() {
+        Replay &replay = replays[i];
+        TuningCandidate &candidate = candidates[i];
+        structures::Quaternion<double> estimate;
+        for (; replay.next < end; replay.next++) {
+          replay.filter.update(input.samples[replay.next], estimate);
+          if (replay.next < settings.warmup_samples) {
+            continue;
+          }
+          if (!isfinite(estimate.getW()) || !isfinite(estimate.getX()) ||
+              !isfinite(estimate.getY()) || !isfinite(estimate.getZ())) {
+            candidate.scored = 0;
+            replay.next = input.size(); // diverged, drop it
+            break;
+          }
+          double error =
+              attitudeError(estimate, input.ground_truth[replay.next]);
+          replay.sum_squares += error * error;
+          candidate.scored++;
+        }
+        candidate.rms_rad = candidate.scored > 0
+                                ? sqrt(replay.sum_squares / candidate.scored)
+                                : INFINITY;
+      });
+    }
+    pool.wait();
+
+    std::stable_sort(alive.begin(), alive.end(), [&](size_t a, size_t b) {
+      return candidates[a].rms_rad < candidates[b].rms_rad;
+    });
+    if (rungs != NULL) {
+      rungs->push_back(
+          TuningRung{alive.size(), end, candidates[alive[0]].rms_rad});
+    }
+    if (end >= input.size()) {
+      return alive[0];
+    }
+    alive.resize(std::max<size_t>(alive.size() / eta, 1));
+    budget *= eta;
+  }
+}
+
+/**
+ * @brief the values of every parameter in AlgParams.hpp.
+ */
+struct AlgParamsValues {
+  double alpha; // complementary filter
+  double beta;  // Madgwick filter
+  double kI;    // Mahony filter integral gain
+  double kP;    // Mahony filter proportional gain
+};
+
+/**
+ * @brief formats a value with the fewest significant digits that read back
+ * as the same double.
+ */
+inline void formatShortest(double value, char *text, size_t size) {
+  for (int digits = 1; digits <= 17; digits++) {
+    snprintf(text, size, "%.*g", digits, value);
+    if (strtod(text, NULL) == value) {
+      return;
+    }
+  }
+}
+
+/**
+ * @brief writes an AlgParams.hpp holding the provided parameters, in the
+ * layout of SensorDriver/AlgParams.hpp.
+ * @param file the file to write to.
+ * @param values the parameter values.
+ * @param note a comment line describing where the values come from.
+ */
+inline void writeAlgParams(FILE *file, const AlgParamsValues &values,
+                           const char *note) {
+  char alpha[32], beta[32], k_i[32], k_p[32];
+  formatShortest(values.alpha, alpha, sizeof(alpha));
+  formatShortest(values.beta, beta, sizeof(beta));
+  formatShortest(values.kI, k_i, sizeof(k_i));
+  formatShortest(values.kP, k_p, sizeof(k_p));
+  fprintf(file,
+          "#pragma once\n"
+          "\n"
+          "// %s\n"
+          "\n"
+          "namespace filters {\n"
+          "\n"
+          "/**\n"
+          " * @brief algorithm parameters for the complementary filter\n"
+          "*/\n"
+          "struct ComplementaryParams {\n"
+          "  static constexpr double alpha() { return %s; }\n"
+          "};\n"
+          "\n"
+          "/**\n"
+          " * @brief algorithm parameters for the Madgwick Filter\n"
+          "*/\n"
+          "struct MadgwickParams {\n"
+          "  static constexpr double beta() { return %s; }\n"
+          "};\n"
+          "\n"
+          "/**\n"
+          " * @brief algorithm parameters for the Mahony Filter\n"
+          "*/\n"
+          "struct MahonyParams {\n"
+          "  static constexpr double kI() { return %s; }\n"
+          "  static constexpr double kP() { return %s; }\n"
+          "};\n"
+          "} // namespace filters\n",
+          note, alpha, beta, k_i, k_p);
+}
+} // namespace evaluation
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace evaluation {
+
+/**
+ * @brief a fixed pool of worker threads, each with its own task deque. A
+ * worker runs its newest task first, and once its deque is empty it steals
+ * the oldest task of another worker, so uneven tasks such as replays of
+ * different lengths keep every thread busy. Tasks submitted from a worker
+ * go to its own deque; others are spread round robin.
+ */
+class WorkStealingPool {
+public:
+  typedef std::function<void()> task_t;
+
+  /**
+   * @brief constructor for WorkStealingPool class. Starts the workers.
+   * @param threads the number of workers, or 0 for one per CPU.
+   */
+  explicit WorkStealingPool(size_t threads = 0)
+      : _queued(0), _outstanding(0), _stopping(false), _next_worker(0),
+        _steals(0) {
+    if (threads == 0) {
+      threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+      threads = 1;
+    }
+    for (size_t i = 0; i < threads; i++) {
+      this->_workers.emplace_back(new Worker());
+    }
+    for (size_t i = 0; i < threads; i++) {
+      this->_workers[i]->thread = std::thread([this, i]() { this->run(i); });
+    }
+  }
+
+  WorkStealingPool(const WorkStealingPool &other) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &other) = delete;
+
+  /**
+   * @brief destructor for WorkStealingPool class. Runs every queued task,
+   * then stops the workers.
+   */
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      this->_stopping = true;
+    }
+    this->_work_cv.notify_all();
+    for (size_t i = 0; i < this->_workers.size(); i++) {
+      this->_workers[i]->thread.join();
+    }
+  }
+
+  /**
+   * @brief returns the number of workers.
+   * @return the number of workers.
+   */
+  size_t getThreadCount() const { return this->_workers.size(); }
+
+  /**
+   * @brief returns the number of tasks a worker took from another worker's
+   * deque.
+   * @return the number of stolen tasks.
+   */
+  uint64_t getStealCount() const {
+    return this->_steals.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief queues a task. May be called from any thread, including from a
+   * running task.
+   * @param task the task to run.
+   */
+  void submit(task_t task) {
+    size_t index;
+    if (currentPool() == this) {
+      index = currentWorker();
+    } else {
+      index = this->_next_worker.fetch_add(1, std::memory_order_relaxed) %
+              this->_workers.size();
+    }
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      this->_queued++;
+      this->_outstanding++;
+    }
+    {
+      Worker &worker = *this->_workers[index];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      worker.tasks.push_back(std::move(task));
+    }
+    this->_work_cv.notify_one();
+  }
+
+  /**
+   * @brief waits until every submitted task, including the tasks they
+   * submitted, has finished. Must not be called from a task.
+   */
+  void wait() {
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    this->_idle_cv.wait(lock, [this]() { return this->_outstanding == 0; });
+  }
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<task_t> tasks;
+    std::thread thread;
+  };
+
+  /**
+   * @brief the pool and worker index of the calling thread, so tasks can
+   * submit to their own worker's deque.
+   */
+  static WorkStealingPool *&currentPool() {
+    static thread_local WorkStealingPool *pool = NULL;
+    return pool;
+  }
+  static size_t &currentWorker() {
+    static thread_local size_t worker = 0;
+    return worker;
+  }
+
+  /**
+   * @brief takes the newest task of a worker's own deque.
+   */
+  bool popLocal(size_t index, task_t &task) {
+    Worker &worker = *this->_workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+      return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+  }
+
+  /**
+   * @brief takes the oldest task of the first other worker that has one,
+   * starting from the thief's neighbour.
+   */
+  bool steal(size_t thief, task_t &task) {
+    size_t count = this->_workers.size();
+    for (size_t offset = 1; offset < count; offset++) {
+      Worker &victim = *this->_workers[(thief + offset) % count];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        this->_steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run(size_t index) {
+    currentPool() = this;
+    currentWorker() = index;
+    task_t task;
+    while (true) {
+      if (this->popLocal(index, task) || this->steal(index, task)) {
+        this->_queued.fetch_sub(1, std::memory_order_relaxed);
+        task();
+        task = task_t();
+
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        if (--this->_outstanding == 0) {
+          this->_idle_cv.notify_all();
+        }
+        continue;
+      }
+
+      // a task counted in _queued may not be pushed yet, so only sleep
+      // while nothing is queued
+      std::unique_lock<std::mutex> lock(this->_mutex);
+      this->_work_cv.wait(lock, [this]() {
+        return this->_queued.load(std::memory_order_relaxed) > 0 ||
+               this->_stopping;
+      });
+      if (this->_stopping &&
+          this->_queued.load(std::memory_order_relaxed) == 0) {
+        break;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::mutex _mutex;
+  std::condition_variable _work_cv; // signalled when a task is queued
+  std::condition_variable _idle_cv; // signalled when the pool runs dry
+  std::atomic<size_t> _queued;      // submitted tasks not started yet
+  size_t _outstanding;              // submitted tasks not finished yet
+  bool _stopping;
+  std::atomic<size_t> _next_worker;
+  std::atomic<uint64_t> _steals;
+}; // end WorkStealingPool class
+} // namespace evaluation
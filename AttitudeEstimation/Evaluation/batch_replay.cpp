@@ -0,0 +1,168 @@
+#include "../SensorDriver/AlgParams.hpp"
+#include "../SensorDriver/FilterDriver.hpp"
+#include "BatchReplay.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace evaluation;
+using namespace filters;
+
+/**
+ * @brief the command line options of the batch replay tool.
+ */
+struct BatchReplayOptions {
+  const char *fleet = NULL;          // directory of device recordings
+  const char *output = NULL;         // directory for the outputs
+  BatchReplaySettings settings;      // chunking and scoring
+  size_t threads = 0;                // worker threads, 0 for one per CPU
+  bool summary_only = false;         // skip the per sample estimate files
+  bool filters[4] = {true, true, true, true}; // filters to replay
+};
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <fleet directory> --output <directory>\n"
+          "  every recording in the fleet directory is a device, and every\n"
+          "  subdirectory is a device whose recordings, in name order, are\n"
+          "  consecutive parts of one log\n"
+          "  --filter complementary|ekf|madgwick|mahony\n"
+          "                      replay one filter (repeatable, default "
+          "all)\n"
+          "  --warmup <s>        leading seconds of every device left out\n"
+          "                      of the error scores (default 10)\n"
+          "  --chunk <n>         samples replayed per task (default 65536)\n"
+          "  --max-active <n>    devices replayed at once (default two per\n"
+          "                      thread)\n"
+          "  --threads <n>       worker threads (default one per CPU)\n"
+          "  --summary-only      only write summary.csv\n",
+          name);
+}
+
+static bool parseFilter(const char *name, available_filters_t &filter) {
+  if (strcmp(name, "complementary") == 0) {
+    filter = COMPLEMENTARY;
+  } else if (strcmp(name, "ekf") == 0) {
+    filter = EKF;
+  } else if (strcmp(name, "madgwick") == 0) {
+    filter = MADGWICK;
+  } else if (strcmp(name, "mahony") == 0) {
+    filter = MAHONY;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool parseOptions(int argc, char **argv, BatchReplayOptions &options) {
+  bool filter_selected = false;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "--filter") == 0 && has_value) {
+      available_filters_t filter;
+      if (!parseFilter(argv[++i], filter)) {
+        return false;
+      }
+      if (!filter_selected) {
+        std::fill(options.filters, options.filters + 4, false);
+        filter_selected = true;
+      }
+      options.filters[filter] = true;
+    } else if (strcmp(arg, "--output") == 0 && has_value) {
+      options.output = argv[++i];
+    } else if (strcmp(arg, "--warmup") == 0 && has_value) {
+      options.settings.warmup_s = atof(argv[++i]);
+    } else if (strcmp(arg, "--chunk") == 0 && has_value) {
+      options.settings.chunk_samples = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--max-active") == 0 && has_value) {
+      options.settings.max_active_jobs = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--threads") == 0 && has_value) {
+      options.threads = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--summary-only") == 0) {
+      options.summary_only = true;
+    } else if (arg[0] != '-' && options.fleet == NULL) {
+      options.fleet = arg;
+    } else {
+      return false;
+    }
+  }
+  return options.fleet != NULL && options.output != NULL;
+}
+
+static double toDegrees(double radians) { return radians * 180.0 / M_PI; }
+
+int main(int argc, char **argv) {
+  BatchReplayOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<ReplayDevice> devices;
+  if (!findDevices(options.fleet, devices)) {
+    perror(options.fleet);
+    return 1;
+  }
+  std::string summary_path = std::string(options.output) + "/summary.csv";
+  FILE *summary = fopen(summary_path.c_str(), "w");
+  if (summary == NULL) {
+    perror(summary_path.c_str());
+    return 1;
+  }
+  fputs("device,filter,files,samples,scored,rms_deg,p50_deg,p99_deg,"
+        "max_deg,error\n",
+        summary);
+  fflush(summary);
+
+  WorkStealingPool pool(options.threads);
+  if (!options.summary_only) {
+    options.settings.output_dir = options.output;
+  }
+  BatchReplay replay(pool, options.settings);
+  if (options.filters[COMPLEMENTARY]) {
+    replay.addFilter<ComplementaryDriver>("complementary");
+  }
+  if (options.filters[EKF]) {
+    replay.addFilter<EKFDriver>("ekf");
+  }
+  if (options.filters[MADGWICK]) {
+    replay.addFilter<MadgwickDriver>("madgwick");
+  }
+  if (options.filters[MAHONY]) {
+    replay.addFilter<MahonyDriver>("mahony");
+  }
+  for (const ReplayDevice &device : devices) {
+    replay.addDevice(device);
+  }
+  printf("devices: %zu, %zu threads\n", devices.size(),
+         pool.getThreadCount());
+
+  // every device is reported as soon as it finishes, so a long run can be
+  // followed and an interrupted one keeps what it finished
+  size_t jobs = 0;
+  size_t completed = replay.run([&](const DeviceSummary &s) {
+    const EvaluationResult &r = s.result;
+    fprintf(summary, "%s,%s,%zu,%zu,%zu,%.4f,%.4f,%.4f,%.4f,%s\n",
+            s.device.c_str(), s.filter.c_str(), s.files, s.samples,
+            r.samples, toDegrees(r.rms_rad), toDegrees(r.p50_rad),
+            toDegrees(r.p99_rad), toDegrees(r.max_rad),
+            s.error != NULL ? s.error : "");
+    fflush(summary);
+    printf("%-24s %-14s %9zu samples  rms %8.3f deg%s%s\n", s.device.c_str(),
+           s.filter.c_str(), s.samples, toDegrees(r.rms_rad),
+           s.error != NULL ? "  error: " : "", s.error != NULL ? s.error : "");
+    fflush(stdout);
+    jobs++;
+  });
+  fclose(summary);
+
+  printf("replayed %zu of %zu jobs, %llu chunks stolen\n", completed, jobs,
+         (unsigned long long)pool.getStealCount());
+  return completed == jobs ? 0 : 1;
+}
@@ -0,0 +1,225 @@
+#include "../SensorDriver/AlgParams.hpp"
+#include "../SensorDriver/FilterDriver.hpp"
+#include "AccuracyMetrics.hpp"
+#include "EvaluationSources.hpp"
+#include "FilterEvaluation.hpp"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace evaluation;
+using namespace filters;
+
+/**
+ * @brief the command line options of the evaluation tool.
+ */
+struct EvaluateOptions {
+  InputOptions input;               // recording or simulation to evaluate on
+  double warmup_s = 10.0;           // leading time left out of the scores
+  int repetitions = 3;              // timed runs per configuration
+  bool filters[4] = {true, false, true, true}; // filters to evaluate
+  const char *csv = NULL;           // CSV report path, or NULL
+};
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] (<recording> | --synthetic <samples>)\n"
+          "%s"
+          "  --filter complementary|madgwick|mahony\n"
+          "                      evaluate one filter (repeatable, default "
+          "all)\n"
+          "  --warmup <s>        leading seconds left out of the error\n"
+          "                      scores while filters converge (default 10)\n"
+          "  --repetitions <n>   timed runs per configuration, the fastest\n"
+          "                      is reported (default 3)\n"
+          "  --csv <path>        also write the results as CSV\n",
+          name, kInputUsage);
+}
+
+/**
+ * @brief parses a filter name. The EKF is left out, as it is still an
+ * identity placeholder with nothing to score.
+ */
+static bool parseFilter(const char *name, available_filters_t &filter) {
+  if (strcmp(name, "complementary") == 0) {
+    filter = COMPLEMENTARY;
+  } else if (strcmp(name, "madgwick") == 0) {
+    filter = MADGWICK;
+  } else if (strcmp(name, "mahony") == 0) {
+    filter = MAHONY;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool parseOptions(int argc, char **argv, EvaluateOptions &options) {
+  bool filter_selected = false;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "--filter") == 0 && has_value) {
+      available_filters_t filter;
+      if (!parseFilter(argv[++i], filter)) {
+        return false;
+      }
+      if (!filter_selected) {
+        std::fill(options.filters, options.filters + 4, false);
+        filter_selected = true;
+      }
+      options.filters[filter] = true;
+    } else if (strcmp(arg, "--warmup") == 0 && has_value) {
+      options.warmup_s = atof(argv[++i]);
+    } else if (strcmp(arg, "--repetitions") == 0 && has_value) {
+      options.repetitions = atoi(argv[++i]);
+    } else if (strcmp(arg, "--csv") == 0 && has_value) {
+      options.csv = argv[++i];
+    } else if (!parseInputOption(argc, argv, i, options.input)) {
+      return false;
+    }
+  }
+  return options.input.selected();
+}
+
+/**
+ * @brief evaluates one filter configuration and appends its result.
+ */
+template <typename FilterT>
+static void evaluate(const char *filter, const char *gains,
+                     const FilterT &prototype, const EvaluationInput &input,
+                     const EvaluationSettings &settings,
+                     std::vector<EvaluationResult> &results) {
+  EvaluationResult result;
+  result.filter = filter;
+  result.gains = gains;
+  evaluateFilter(prototype, input, settings, result);
+  results.push_back(result);
+}
+
+/**
+ * @brief evaluates every selected filter over its gain sweep. Each sweep
+ * brackets the default gains from AlgParams.hpp.
+ */
+static void evaluateAll(const EvaluateOptions &options,
+                        const EvaluationInput &input,
+                        const EvaluationSettings &settings,
+                        std::vector<EvaluationResult> &results) {
+  char gains[64];
+  if (options.filters[COMPLEMENTARY]) {
+    const double alphas[] = {0.5, 0.8, ComplementaryParams::alpha(), 0.95,
+                             0.98, 0.99};
+    for (double alpha : alphas) {
+      snprintf(gains, sizeof(gains), "alpha=%g", alpha);
+      evaluate("complementary", gains,
+               ComplementaryFilter(ComplementaryGains(alpha)), input, settings,
+               results);
+    }
+  }
+
+  if (options.filters[MADGWICK]) {
+    const double betas[] = {0.01, MadgwickParams::beta(), 0.1, 0.2, 0.5};
+    for (double beta : betas) {
+      snprintf(gains, sizeof(gains), "beta=%g", beta);
+      evaluate("madgwick", gains, MadgwickFilter(MadgwickGains(beta)), input,
+               settings, results);
+    }
+  }
+
+  if (options.filters[MAHONY]) {
+    const double k_ps[] = {0.5, MahonyParams::kP(), 2.0, 5.0};
+    const double k_is[] = {0.0, MahonyParams::kI()};
+    for (double k_p : k_ps) {
+      for (double k_i : k_is) {
+        snprintf(gains, sizeof(gains), "kP=%g kI=%g", k_p, k_i);
+        evaluate("mahony", gains, MahonyFilter(MahonyGains(k_i, k_p)), input,
+                 settings, results);
+      }
+    }
+  }
+}
+
+static double toDegrees(double radians) { return radians * 180.0 / M_PI; }
+
+/**
+ * @brief prints the results, most accurate first, with the Pareto front
+ * marked.
+ */
+static void printTable(FILE *file,
+                       const std::vector<EvaluationResult> &results) {
+  fprintf(file, "%-14s %-16s %9s %9s %9s %9s %9s %11s %s\n", "filter",
+          "gains", "rms(deg)", "p50", "p90", "p99", "max", "ns/update",
+          "pareto");
+  for (const EvaluationResult &result : results) {
+    fprintf(file, "%-14s %-16s %9.3f %9.3f %9.3f %9.3f %9.3f %11.1f %s\n",
+            result.filter.c_str(), result.gains.c_str(),
+            toDegrees(result.rms_rad), toDegrees(result.p50_rad),
+            toDegrees(result.p90_rad), toDegrees(result.p99_rad),
+            toDegrees(result.max_rad), result.ns_per_update,
+            result.pareto ? "*" : "");
+  }
+}
+
+static void writeCsv(FILE *file, const std::vector<EvaluationResult> &results) {
+  fputs("filter,gains,samples,rms_deg,p50_deg,p90_deg,p99_deg,max_deg,"
+        "ns_per_update,pareto\n",
+        file);
+  for (const EvaluationResult &result : results) {
+    fprintf(file, "%s,%s,%zu,%.6f,%.6f,%.6f,%.6f,%.6f,%.2f,%d\n",
+            result.filter.c_str(), result.gains.c_str(), result.samples,
+            toDegrees(result.rms_rad), toDegrees(result.p50_rad),
+            toDegrees(result.p90_rad), toDegrees(result.p99_rad),
+            toDegrees(result.max_rad), result.ns_per_update,
+            result.pareto ? 1 : 0);
+  }
+}
+
+int main(int argc, char **argv) {
+  EvaluateOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  EvaluationInput input;
+  if (!loadOptionsInput(options.input, input)) {
+    return 1;
+  }
+  if (input.size() == 0) {
+    fprintf(stderr, "no samples to evaluate\n");
+    return 1;
+  }
+
+  // skip the samples recorded within the warmup time of the first one
+  EvaluationSettings settings;
+  settings.repetitions = options.repetitions;
+  settings.warmup_samples = countWarmupSamples(input, options.warmup_s);
+  if (settings.warmup_samples == input.size()) {
+    fprintf(stderr, "the warmup covers the whole recording\n");
+    return 1;
+  }
+
+  std::vector<EvaluationResult> results;
+  evaluateAll(options, input, settings, results);
+  markParetoFront(results);
+  std::stable_sort(results.begin(), results.end(),
+                   [](const EvaluationResult &a, const EvaluationResult &b) {
+                     return a.rms_rad < b.rms_rad;
+                   });
+
+  fprintf(stdout, "samples: %zu (%zu scored)\n", input.size(),
+          input.size() - settings.warmup_samples);
+  printTable(stdout, results);
+
+  if (options.csv != NULL) {
+    FILE *file = fopen(options.csv, "w");
+    if (file == NULL) {
+      perror(options.csv);
+      return 1;
+    }
+    writeCsv(file, results);
+    fclose(file);
+  }
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include "DatasetLoader.hpp"
+#include "WorkStealingPool.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace evaluation;
+
+/**
+ * @brief the command line options of the dataset loader.
+ */
+struct LoadDatasetOptions {
+  const char *imu = NULL;          // IMU CSV file
+  const char *ground_truth = NULL; // ground truth pose CSV file
+  DatasetLayout layout = DatasetLayout::euroc();
+  size_t threads = 0;              // loader threads, 0 for one per CPU
+  size_t chunk_bytes = DatasetLoader::kDefaultChunkBytes;
+};
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <imu.csv> <ground_truth.csv>\n"
+          "  loads a public dataset and reports what was read and how fast\n"
+          "  --threads <n>       loader threads (default one per CPU)\n"
+          "  --chunk-kb <n>      bytes parsed per task (default 4096)\n"
+          "  --timestamp-unit ns|us|s\n"
+          "                      unit of the timestamps (default ns)\n"
+          "  --mag <column>      first magnetometer column of the IMU file\n"
+          "  --gt-xyzw           quaternions are stored X, Y, Z, W\n",
+          name);
+}
+
+static bool parseOptions(int argc, char **argv, LoadDatasetOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "--threads") == 0 && has_value) {
+      options.threads = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--chunk-kb") == 0 && has_value) {
+      options.chunk_bytes = strtoul(argv[++i], NULL, 10) << 10;
+    } else if (strcmp(arg, "--timestamp-unit") == 0 && has_value) {
+      const char *unit = argv[++i];
+      if (strcmp(unit, "ns") == 0) {
+        options.layout.timestamp_unit_ns = 1;
+      } else if (strcmp(unit, "us") == 0) {
+        options.layout.timestamp_unit_ns = 1000;
+      } else if (strcmp(unit, "s") == 0) {
+        options.layout.timestamp_unit_ns = 1000000000;
+      } else {
+        return false;
+      }
+    } else if (strcmp(arg, "--mag") == 0 && has_value) {
+      options.layout.imu_mag = atoi(argv[++i]);
+    } else if (strcmp(arg, "--gt-xyzw") == 0) {
+      options.layout.gt_w_first = false;
+    } else if (arg[0] != '-' && options.imu == NULL) {
+      options.imu = arg;
+    } else if (arg[0] != '-' && options.ground_truth == NULL) {
+      options.ground_truth = arg;
+    } else {
+      return false;
+    }
+  }
+  return options.imu != NULL && options.ground_truth != NULL;
+}
+
+int main(int argc, char **argv) {
+  LoadDatasetOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  WorkStealingPool pool(options.threads);
+  DatasetLoader loader(pool, options.layout, options.chunk_bytes);
+  ImuDataset dataset;
+  if (!loader.load(options.imu, options.ground_truth, dataset)) {
+    fprintf(stderr, "%s: %s\n", options.imu, loader.getError());
+    return 1;
+  }
+
+  const DatasetReport &report = loader.getReport();
+  double duration_s =
+      dataset.size() > 0
+          ? (dataset.timestamp_us.back() - dataset.timestamp_us.front()) * 1e-6
+          : 0.0;
+  printf("threads:              %zu\n", pool.getThreadCount());
+  printf("imu rows:             %zu\n", report.imu_rows);
+  printf("ground truth rows:    %zu\n", report.ground_truth_rows);
+  printf("skipped lines:        %zu\n", report.skipped_lines);
+  printf("rejected lines:       %zu\n", report.rejected_lines);
+  printf("trimmed samples:      %zu\n", report.trimmed_samples);
+  printf("samples:              %zu (%.1f s)\n", dataset.size(), duration_s);
+  printf("magnetometer:         %s\n",
+         dataset.has_mag ? "yes" : "no, accelerometer-only correction");
+  printf("max ground truth gap: %.3f ms\n",
+         report.max_ground_truth_gap_us * 1e-3);
+  printf("load:                 %.3f s, %.1f MB/s\n", report.load_s,
+         report.bytes / report.load_s / 1e6);
+  printf("align:                %.3f s\n", report.align_s);
+  return 0;
+}
@@ -0,0 +1,217 @@
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../ImuLog/ImuLog.hpp"
+#include "../SensorDriver/SensorSources.hpp"
+#include "BatchReplay.hpp"
+#include "WorkStealingPool.hpp"
+#include "gtest/gtest.h"
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace evaluation;
+
+/**
+ * @brief a fleet directory: two devices with one CSV recording each, and a
+ * device whose log is split over two files. Removed on destruction.
+ */
+struct TempFleet {
+  TempFleet() {
+    char path[] = "/tmp/test_batch_replay_XXXXXX";
+    EXPECT_TRUE(mkdtemp(path) != NULL);
+    this->path = path;
+    this->output = this->path + "/out";
+    mkdir(this->output.c_str(), 0700);
+    mkdir((this->path + "/gamma").c_str(), 0700);
+
+    const double rate_a[3] = {0.2, -0.1, 0.4};
+    const double rate_b[3] = {-0.3, 0.5, 0.1};
+    const double rate_c[3] = {0.1, 0.1, -0.6};
+    this->writeCsv("alpha.csv", 2500, rate_a);
+    this->writeCsv("beta.csv", 700, rate_b);
+
+    // the second part of the log picks up where the first stopped
+    filters::SyntheticSensorSource source(3000, 200.0, rate_c);
+    filters::AcquiredSample sample;
+    const char *parts[2] = {"gamma/part0.imulog", "gamma/part1.imulog"};
+    for (int part = 0; part < 2; part++) {
+      imulog::ImuLogWriter writer;
+      EXPECT_TRUE(writer.open((this->path + "/" + parts[part]).c_str(),
+                              imulog::makeHeader(200.0)));
+      for (int i = 0; i < 1500 && source.read(sample); i++) {
+        writer.write(sample);
+      }
+      EXPECT_TRUE(writer.close());
+    }
+
+    // not a recording, ignored
+    FILE *notes = fopen((this->path + "/notes.txt").c_str(), "w");
+    fputs("fleet notes\n", notes);
+    fclose(notes);
+  }
+
+  ~TempFleet() {
+    const char *files[] = {"alpha.csv", "beta.csv", "gamma/part0.imulog",
+                           "gamma/part1.imulog", "notes.txt"};
+    for (const char *file : files) {
+      remove((this->path + "/" + file).c_str());
+    }
+    std::vector<std::string> outputs;
+    listDirectory(this->output, outputs);
+    for (const std::string &file : outputs) {
+      remove((this->output + "/" + file).c_str());
+    }
+    rmdir(this->output.c_str());
+    rmdir((this->path + "/gamma").c_str());
+    rmdir(this->path.c_str());
+  }
+
+  void writeCsv(const char *name, uint64_t samples, const double rate[3]) {
+    FILE *file = fopen((this->path + "/" + name).c_str(), "w");
+    fputs(filters::kRecordedSampleHeader, file);
+    filters::SyntheticSensorSource source(samples, 200.0, rate);
+    filters::AcquiredSample sample;
+    while (source.read(sample)) {
+      filters::writeRecordedSample(file, sample);
+    }
+    fclose(file);
+  }
+
+  std::string path;
+  std::string output;
+};
+
+/**
+ * @brief replays the recordings of a device in a single pass.
+ */
+static void replaySequentially(const ReplayDevice &device, double warmup_s,
+                               ErrorAccumulator &errors, size_t &samples) {
+  filters::MadgwickFilter filter;
+  structures::Quaternion<double> estimate;
+  RecordingReader reader;
+  filters::SensorSample<double> sample;
+  structures::Quaternion<double> ground_truth;
+  uint64_t warmup_end_us = 0;
+  samples = 0;
+  for (const std::string &file : device.files) {
+    EXPECT_TRUE(reader.open(file.c_str())) << reader.getError();
+    while (reader.read(sample, ground_truth)) {
+      if (samples++ == 0) {
+        warmup_end_us = sample.timestamp_us + (uint64_t)(warmup_s * 1e6);
+      }
+      filter.update(sample, estimate);
+      if (sample.timestamp_us >= warmup_end_us) {
+        errors.add(attitudeError(estimate, ground_truth));
+      }
+    }
+  }
+}
+
+static size_t countLines(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "r");
+  if (file == NULL) {
+    return 0;
+  }
+  size_t lines = 0;
+  for (int c = fgetc(file); c != EOF; c = fgetc(file)) {
+    lines += c == '\n';
+  }
+  fclose(file);
+  return lines;
+}
+
+TEST(BatchReplayTesting, TestFindDevices) {
+  TempFleet fleet;
+  std::vector<ReplayDevice> devices;
+  ASSERT_TRUE(findDevices(fleet.path, devices));
+
+  // the output directory holds no recordings, so it is not a device
+  ASSERT_EQ(3U, devices.size());
+  ASSERT_EQ("alpha", devices[0].name);
+  ASSERT_EQ(1U, devices[0].files.size());
+  ASSERT_EQ("beta", devices[1].name);
+  ASSERT_EQ("gamma", devices[2].name);
+  ASSERT_EQ(2U, devices[2].files.size());
+  ASSERT_EQ(fleet.path + "/gamma/part0.imulog", devices[2].files[0]);
+  ASSERT_EQ(fleet.path + "/gamma/part1.imulog", devices[2].files[1]);
+
+  ASSERT_FALSE(findDevices(fleet.path + "/missing", devices));
+}
+
+TEST(BatchReplayTesting, TestMatchesSequentialReplay) {
+  TempFleet fleet;
+  std::vector<ReplayDevice> devices;
+  ASSERT_TRUE(findDevices(fleet.path, devices));
+
+  // chunks much smaller than the recordings, and a job limit below the
+  // job count, so jobs are resumed and started while others run
+  WorkStealingPool pool(3);
+  BatchReplaySettings settings;
+  settings.chunk_samples = 128;
+  settings.max_active_jobs = 2;
+  settings.warmup_s = 1.0;
+  settings.output_dir = fleet.output.c_str();
+  BatchReplay replay(pool, settings);
+  replay.addFilter<filters::MadgwickFilter>("madgwick");
+  for (const ReplayDevice &device : devices) {
+    replay.addDevice(device);
+  }
+
+  std::map<std::string, DeviceSummary> summaries;
+  ASSERT_EQ(3U, replay.run([&summaries](const DeviceSummary &summary) {
+    summaries[summary.device] = summary;
+  }));
+  ASSERT_EQ(3U, summaries.size());
+
+  // chunking changes nothing: every device matches a single pass over its
+  // recordings in order
+  for (const ReplayDevice &device : devices) {
+    const DeviceSummary &summary = summaries[device.name];
+    ErrorAccumulator errors;
+    size_t samples;
+    replaySequentially(device, settings.warmup_s, errors, samples);
+    ASSERT_TRUE(summary.error == NULL);
+    ASSERT_EQ("madgwick", summary.filter);
+    ASSERT_EQ(device.files.size(), summary.files);
+    ASSERT_EQ(samples, summary.samples);
+    ASSERT_EQ(samples / settings.chunk_samples + 1, summary.chunks);
+    ASSERT_EQ(errors.count(), summary.result.samples);
+    ASSERT_EQ(errors.rms(), summary.result.rms_rad);
+    ASSERT_EQ(errors.max(), summary.result.max_rad);
+
+    // one line per sample after the header
+    std::string output = fleet.output + "/" + device.name + ".madgwick.csv";
+    ASSERT_EQ(samples + 1, countLines(output));
+  }
+  ASSERT_EQ(3000U, summaries["gamma"].samples);
+}
+
+TEST(BatchReplayTesting, TestReportsFailedDevices) {
+  TempFleet fleet;
+  WorkStealingPool pool(2);
+  BatchReplaySettings settings;
+  settings.chunk_samples = 100;
+  BatchReplay replay(pool, settings);
+  replay.addFilter<filters::MadgwickFilter>("madgwick");
+
+  // a device whose second recording is missing keeps what it replayed
+  ReplayDevice broken = {"broken", {fleet.path + "/beta.csv",
+                                    fleet.path + "/missing.csv"}};
+  replay.addDevice(broken);
+  std::vector<DeviceSummary> summaries;
+  ASSERT_EQ(0U, replay.run([&summaries](const DeviceSummary &summary) {
+    summaries.push_back(summary);
+  }));
+  ASSERT_EQ(1U, summaries.size());
+  ASSERT_TRUE(summaries[0].error != NULL);
+  ASSERT_EQ(1U, summaries[0].files);
+  ASSERT_EQ(700U, summaries[0].samples);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,228 @@
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../EstimationAlgs/MahonyFilter/MahonyFilter.hpp"
+#include "../Simulation/ImuSimulator.hpp"
+#include "../Simulation/Trajectory.hpp"
+#include "AccuracyMetrics.hpp"
+#include "DatasetLoader.hpp"
+#include "EvaluationSources.hpp"
+#include "FilterEvaluation.hpp"
+#include "WorkStealingPool.hpp"
+#include "gtest/gtest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace evaluation;
+
+static const uint64_t kStartNs = 1403636579758555392ULL;
+static const size_t kSamples = 2000;   // 10 s at 200 Hz
+static const double kPoseRateHz = 120; // poses from 1 s to 9 s
+
+/**
+ * @brief a simulated EuRoC style dataset written to temporary files: an
+ * IMU file with a magnetometer appended after the standard columns, a
+ * malformed row and a blank line, and a pose file at another rate with
+ * CRLF line endings.
+ */
+struct DatasetFiles {
+  DatasetFiles() {
+    char imu[] = "/tmp/test_dataset_imu_XXXXXX";
+    char poses[] = "/tmp/test_dataset_gt_XXXXXX";
+    close(mkstemp(imu));
+    close(mkstemp(poses));
+    this->imu_path = imu;
+    this->gt_path = poses;
+
+    simulation::ImuSimulator<simulation::SinusoidalTrajectory> simulator(
+        simulation::SinusoidalTrajectory::handheld(), 200.0,
+        simulation::NoiseModel::consumerMems(), 5);
+    FILE *file = fopen(imu, "w");
+    fprintf(file, "#timestamp [ns],w_RS_S_x [rad s^-1],w_RS_S_y [rad s^-1],"
+                  "w_RS_S_z [rad s^-1],a_RS_S_x [m s^-2],a_RS_S_y [m s^-2],"
+                  "a_RS_S_z [m s^-2]\n");
+    for (size_t i = 0; i < kSamples; i++) {
+      simulation::SimulatedSample sample;
+      simulator.next(sample);
+      const filters::SensorSample<double> &s = sample.measured;
+      fprintf(file,
+              "%llu,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g%s",
+              (unsigned long long)(kStartNs + s.timestamp_us * 1000ULL),
+              s.gyro[0], s.gyro[1], s.gyro[2], s.acc[0], s.acc[1], s.acc[2],
+              s.mag[0], s.mag[1], s.mag[2], i + 1 < kSamples ? "\n" : "");
+      if (i == 700) {
+        fprintf(file, "1403636583258555392,0.1,0.2,bad,0,0,9.8\n\n");
+      }
+      this->samples.push_back(s);
+    }
+    fclose(file);
+
+    simulation::SinusoidalTrajectory trajectory =
+        simulation::SinusoidalTrajectory::handheld();
+    file = fopen(poses, "w");
+    fprintf(file, "#timestamp, p_RS_R_x [m], p_RS_R_y [m], p_RS_R_z [m], "
+                  "q_RS_w [], q_RS_x [], q_RS_y [], q_RS_z []\r\n");
+    for (size_t i = 0; i <= 8 * kPoseRateHz; i++) {
+      double t = 1.0 + i / kPoseRateHz;
+      simulation::TrajectoryState state;
+      trajectory.evaluate(t, state);
+      const structures::Quaternion<double> &q = state.attitude;
+      fprintf(file, "%llu,0.5,-1.25,2,%.9f,%.9f,%.9f,%.9f,0,0,0\r\n",
+              (unsigned long long)(kStartNs + (uint64_t)llround(t * 1e9)),
+              q.getW(), q.getX(), q.getY(), q.getZ());
+      this->pose_count++;
+    }
+    fclose(file);
+  }
+
+  ~DatasetFiles() {
+    unlink(this->imu_path.c_str());
+    unlink(this->gt_path.c_str());
+  }
+
+  std::string imu_path;
+  std::string gt_path;
+  std::vector<filters::SensorSample<double>> samples;
+  size_t pose_count = 0;
+};
+
+TEST(DatasetLoaderTesting, TestLoadsAndAligns) {
+  DatasetFiles files;
+  WorkStealingPool pool(3);
+
+  // small chunks, so rows and the malformed row land in many tasks
+  DatasetLayout layout = DatasetLayout::euroc();
+  layout.imu_mag = 7;
+  DatasetLoader loader(pool, layout, 1000);
+  ImuDataset dataset;
+  ASSERT_TRUE(loader.load(files.imu_path.c_str(), files.gt_path.c_str(),
+                          dataset))
+      << loader.getError();
+
+  const DatasetReport &report = loader.getReport();
+  ASSERT_EQ(kSamples, report.imu_rows);
+  ASSERT_EQ(files.pose_count, report.ground_truth_rows);
+  ASSERT_EQ(3U, report.skipped_lines); // two headers and the blank line
+  ASSERT_EQ(1U, report.rejected_lines);
+  ASSERT_NEAR(8333.0, (double)report.max_ground_truth_gap_us, 1.0);
+
+  // the samples from 1 s to 9 s are kept, bit for bit
+  ASSERT_EQ(1601U, dataset.size());
+  ASSERT_EQ(kSamples - dataset.size(), report.trimmed_samples);
+  simulation::SinusoidalTrajectory trajectory =
+      simulation::SinusoidalTrajectory::handheld();
+  for (size_t i = 0; i < dataset.size(); i++) {
+    const filters::SensorSample<double> &expected = files.samples[200 + i];
+    filters::SensorSample<double> sample;
+    dataset.getSample(i, sample);
+    ASSERT_EQ(kStartNs / 1000 + expected.timestamp_us, sample.timestamp_us);
+    for (int axis = 0; axis < 3; axis++) {
+      ASSERT_EQ(expected.gyro[axis], sample.gyro[axis]);
+      ASSERT_EQ(expected.acc[axis], sample.acc[axis]);
+      ASSERT_EQ(expected.mag[axis], sample.mag[axis]);
+    }
+
+    // interpolated poses stay within a few microradians of the trajectory
+    simulation::TrajectoryState state;
+    trajectory.evaluate(expected.timestamp_us * 1e-6, state);
+    ASSERT_LT(attitudeError(state.attitude, dataset.getGroundTruth(i)), 1e-4)
+        << i;
+  }
+
+  // one thread and one chunk load the same dataset
+  WorkStealingPool single(1);
+  DatasetLoader serial(single, layout, 1 << 30);
+  ImuDataset again;
+  ASSERT_TRUE(serial.load(files.imu_path.c_str(), files.gt_path.c_str(),
+                          again));
+  ASSERT_EQ(dataset.timestamp_us, again.timestamp_us);
+  ASSERT_EQ(dataset.acc[2], again.acc[2]);
+  ASSERT_EQ(dataset.ground_truth[0], again.ground_truth[0]);
+  ASSERT_EQ(dataset.ground_truth[3], again.ground_truth[3]);
+}
+
+TEST(DatasetLoaderTesting, TestReportsBadDatasets) {
+  DatasetFiles files;
+  WorkStealingPool pool(2);
+  DatasetLoader loader(pool);
+  ImuDataset dataset;
+  ASSERT_FALSE(loader.load("/nonexistent.csv", files.gt_path.c_str(),
+                           dataset));
+  ASSERT_STREQ("cannot map a dataset file", loader.getError());
+
+  // quaternion columns past the end of the rows reject every pose
+  DatasetLayout layout = DatasetLayout::euroc();
+  layout.gt_quat = 12;
+  DatasetLoader misplaced(pool, layout);
+  ASSERT_FALSE(misplaced.load(files.imu_path.c_str(), files.gt_path.c_str(),
+                              dataset));
+  ASSERT_STREQ("the ground truth has fewer than two poses",
+               misplaced.getError());
+  ASSERT_EQ(files.pose_count, misplaced.getReport().rejected_lines - 1);
+}
+
+TEST(DatasetLoaderTesting, TestFeedsFilters) {
+  DatasetFiles files;
+  InputOptions options;
+  options.recording = files.imu_path.c_str();
+  options.ground_truth = files.gt_path.c_str();
+  EvaluationInput input;
+  ASSERT_TRUE(loadOptionsInput(options, input));
+  ASSERT_EQ(1601U, input.size());
+
+  // without a magnetometer in the EuRoC layout, the field reads as zero
+  ASSERT_EQ(0.0, input.samples[0].mag[0]);
+  ASSERT_EQ(files.samples[200].acc[1], input.samples[0].acc[1]);
+
+  // which the filters take as no reading: their estimates stay finite and
+  // the accelerometer still corrects them, beating the gyro alone
+  EvaluationSettings no_mag;
+  no_mag.repetitions = 1;
+  EvaluationResult gyro_only;
+  evaluateFilter(filters::MadgwickFilter(0.0), input, no_mag, gyro_only);
+  EvaluationResult madgwick;
+  evaluateFilter(filters::MadgwickFilter(0.1), input, no_mag, madgwick);
+  EvaluationResult mahony;
+  evaluateFilter(filters::MahonyFilter(0.01, 1.0), input, no_mag, mahony);
+  ASSERT_EQ(input.size(), madgwick.samples);
+  ASSERT_LT(madgwick.rms_rad, gyro_only.rms_rad - 0.1);
+  ASSERT_LT(mahony.rms_rad, M_PI - 0.1); // a NaN estimate scores M_PI
+
+  // with the magnetometer, a filter scores the same against the
+  // interpolated poses as against the exact trajectory
+  WorkStealingPool pool(2);
+  DatasetLayout layout = DatasetLayout::euroc();
+  layout.imu_mag = 7;
+  DatasetLoader loader(pool, layout);
+  ImuDataset dataset;
+  ASSERT_TRUE(loader.load(files.imu_path.c_str(), files.gt_path.c_str(),
+                          dataset));
+  EvaluationInput with_mag;
+  dataset.toEvaluationInput(with_mag);
+  EvaluationSettings settings;
+  settings.warmup_samples = 400;
+  settings.repetitions = 1;
+  EvaluationResult result;
+  evaluateFilter(filters::MadgwickFilter(), with_mag, settings, result);
+
+  EvaluationInput direct;
+  simulation::SinusoidalTrajectory trajectory =
+      simulation::SinusoidalTrajectory::handheld();
+  for (size_t i = 200; i <= 1800; i++) {
+    simulation::TrajectoryState state;
+    trajectory.evaluate(files.samples[i].timestamp_us * 1e-6, state);
+    direct.samples.push_back(files.samples[i]);
+    direct.ground_truth.push_back(state.attitude);
+  }
+  EvaluationResult direct_result;
+  evaluateFilter(filters::MadgwickFilter(), direct, settings, direct_result);
+  ASSERT_EQ(direct_result.samples, result.samples);
+  ASSERT_NEAR(direct_result.rms_rad, result.rms_rad, 1e-4);
+  ASSERT_NEAR(direct_result.p99_rad, result.p99_rad, 1e-4);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,147 @@
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../Euler/Euler.hpp"
+#include "../Simulation/ImuSimulator.hpp"
+#include "../Simulation/Trajectory.hpp"
+#include "AccuracyMetrics.hpp"
+#include "FilterEvaluation.hpp"
+#include "gtest/gtest.h"
+#include <vector>
+
+using namespace evaluation;
+using namespace structures;
+
+/**
+ * @brief a filter that always reports the same attitude.
+ */
+class ConstantFilter {
+public:
+  ConstantFilter(const Quaternion<double> &attitude) : _attitude(attitude) {}
+
+  void update(const filters::SensorSample<double> &,
+              Quaternion<double> &out) {
+    out = this->_attitude;
+  }
+
+private:
+  Quaternion<double> _attitude;
+}; // end ConstantFilter class
+
+TEST(EvaluationTesting, TestAttitudeError) {
+  Quaternion<double> a =
+      Euler<double>(0.1, -0.2, 0.3, RADIANS).toQuaternion();
+  ASSERT_NEAR(0.0, attitudeError(a, a), 1e-7);
+
+  // a quaternion and its negation are the same attitude
+  ASSERT_NEAR(0.0, attitudeError(a, a * -1.0), 1e-7);
+
+  // the error is the angle of the rotation between the attitudes, and does
+  // not depend on their scale
+  Quaternion<double> yawed =
+      a * Euler<double>(0.0, 0.0, 0.25, RADIANS).toQuaternion();
+  ASSERT_NEAR(0.25, attitudeError(a, yawed), 1e-7);
+  ASSERT_NEAR(0.25, attitudeError(a * 2.0, yawed), 1e-7);
+  ASSERT_NEAR(M_PI, attitudeError(a, Quaternion<double>(0, 0, 0, 0)), 1e-12);
+
+  // a diverged estimate scores the largest error, not zero
+  Quaternion<double> diverged(NAN, NAN, NAN, NAN);
+  ASSERT_EQ(M_PI, attitudeError(diverged, a));
+  ASSERT_EQ(M_PI, attitudeError(a, diverged));
+  ASSERT_EQ(M_PI, attitudeError(a, Quaternion<double>(0.1, NAN, 0.2, 0.9)));
+  ASSERT_EQ(M_PI, attitudeError(a, Quaternion<double>(0, 0, INFINITY, 1)));
+}
+
+TEST(EvaluationTesting, TestErrorStatistics) {
+  ErrorAccumulator errors;
+  ASSERT_EQ(0.0, errors.rms());
+  ASSERT_EQ(0.0, errors.percentile(50));
+
+  for (int i = 100; i >= 0; i--) {
+    errors.add(i * 0.01);
+  }
+  ASSERT_EQ(101U, errors.count());
+  ASSERT_DOUBLE_EQ(1.0, errors.max());
+  ASSERT_NEAR(0.5, errors.mean(), 1e-12);
+  ASSERT_NEAR(0.5, errors.percentile(50), 1e-12);
+  ASSERT_NEAR(0.99, errors.percentile(99), 1e-12);
+  ASSERT_NEAR(0.0, errors.percentile(0), 1e-12);
+  ASSERT_NEAR(1.0, errors.percentile(100), 1e-12);
+
+  // sum of squares of 0.00, 0.01, ..., 1.00 is 0.0001 * 100 * 101 * 201 / 6
+  ASSERT_NEAR(sqrt(0.0001 * 100 * 101 * 201 / 6 / 101), errors.rms(), 1e-12);
+
+  // percentiles interpolate between ranks, and stay valid after more adds
+  errors.clear();
+  errors.add(1.0);
+  errors.add(3.0);
+  ASSERT_NEAR(2.0, errors.percentile(50), 1e-12);
+  errors.add(0.0);
+  ASSERT_NEAR(1.0, errors.percentile(50), 1e-12);
+}
+
+TEST(EvaluationTesting, TestParetoFront) {
+  std::vector<EvaluationResult> results(5);
+  const double rms[5] = {1.0, 0.5, 0.2, 0.6, 0.2};
+  const double ns[5] = {10.0, 20.0, 50.0, 30.0, 60.0};
+  for (int i = 0; i < 5; i++) {
+    results[i].rms_rad = rms[i];
+    results[i].ns_per_update = ns[i];
+  }
+  markParetoFront(results);
+  ASSERT_TRUE(results[0].pareto);  // cheapest
+  ASSERT_TRUE(results[1].pareto);
+  ASSERT_TRUE(results[2].pareto);  // most accurate
+  ASSERT_FALSE(results[3].pareto); // slower and less accurate than [1]
+  ASSERT_FALSE(results[4].pareto); // as accurate as [2] but slower
+}
+
+TEST(EvaluationTesting, TestEvaluateFilter) {
+  // a slow tilted turn without linear acceleration, which the gradient
+  // descent filters follow closely once converged
+  const simulation::Sinusoid angles[3] = {{0.3, 0, 0.2, 0.1, 0},
+                                          {-0.2, 0, 0.1, 0.05, 0},
+                                          {0.0, 0.2, 0, 0, 0}};
+  const simulation::Sinusoid still[3] = {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0},
+                                         {0, 0, 0, 0, 0}};
+  simulation::ImuSimulator<simulation::SinusoidalTrajectory> simulator(
+      simulation::SinusoidalTrajectory(angles, still), 100.0);
+  simulation::SimulatedSensorSource<simulation::SinusoidalTrajectory> source(
+      simulator, 2000);
+  EvaluationInput input;
+  ASSERT_EQ(2000U, loadInput(source, filters::SensorCalibration<double>::
+                                         nominal(),
+                             input));
+  ASSERT_EQ(2000U, input.ground_truth.size());
+
+  EvaluationSettings settings;
+  settings.warmup_samples = 500;
+  settings.repetitions = 2;
+
+  // a constant estimate scores exactly its distance to the ground truth
+  Quaternion<double> attitude = input.ground_truth[1000];
+  EvaluationResult constant;
+  evaluateFilter(ConstantFilter(attitude), input, settings, constant);
+  ASSERT_EQ(1500U, constant.samples);
+  ErrorAccumulator expected;
+  for (size_t i = 500; i < input.size(); i++) {
+    expected.add(attitudeError(attitude, input.ground_truth[i]));
+  }
+  ASSERT_NEAR(expected.rms(), constant.rms_rad, 1e-12);
+  ASSERT_NEAR(expected.max(), constant.max_rad, 1e-12);
+  ASSERT_NEAR(expected.percentile(90), constant.p90_rad, 1e-12);
+  ASSERT_GE(constant.ns_per_update, 0.0);
+
+  // a fast converging Madgwick filter tracks the noiseless turn
+  EvaluationResult madgwick;
+  evaluateFilter(filters::MadgwickFilter(filters::MadgwickGains(0.5)), input,
+                 settings, madgwick);
+  ASSERT_LT(madgwick.rms_rad, 0.02);
+  ASSERT_LE(madgwick.p50_rad, madgwick.p90_rad);
+  ASSERT_LE(madgwick.p90_rad, madgwick.p99_rad);
+  ASSERT_LE(madgwick.p99_rad, madgwick.max_rad);
+  ASSERT_GT(madgwick.ns_per_update, 0.0);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
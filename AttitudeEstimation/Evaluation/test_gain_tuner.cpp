@@ -0,0 +1,232 @@
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../SensorDriver/AlgParams.hpp"
+#include "EvaluationSources.hpp"
+#include "GainTuner.hpp"
+#include "WorkStealingPool.hpp"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace evaluation;
+
+TEST(GainTunerTesting, TestPoolRunsEveryTask) {
+  WorkStealingPool pool(4);
+  ASSERT_EQ(4U, pool.getThreadCount());
+
+  // tasks submit more tasks to their own worker, which the idle workers
+  // then steal
+  std::atomic<int> runs(0);
+  for (int i = 0; i < 8; i++) {
+    pool.submit([&pool, &runs]() {
+      for (int j = 0; j < 100; j++) {
+        pool.submit([&runs]() { runs.fetch_add(1); });
+      }
+      runs.fetch_add(1);
+    });
+  }
+  pool.wait();
+  ASSERT_EQ(808, runs.load());
+
+  // the pool is reusable after a wait
+  pool.submit([&runs]() { runs.fetch_add(1); });
+  pool.wait();
+  ASSERT_EQ(809, runs.load());
+}
+
+TEST(GainTunerTesting, TestSampleCandidates) {
+  const GainRange ranges[] = {{"kI", 0.001, 1.0, true},
+                              {"kP", 2.0, 4.0, false}};
+  const double defaults[] = {0.1, 1.0};
+  std::vector<TuningCandidate> candidates;
+  sampleCandidates(ranges, 2, defaults, 50, 7, candidates);
+  ASSERT_EQ(50U, candidates.size());
+
+  // the defaults come first, even outside the ranges
+  ASSERT_EQ(0.1, candidates[0].gains[0]);
+  ASSERT_EQ(1.0, candidates[0].gains[1]);
+  for (size_t i = 1; i < candidates.size(); i++) {
+    ASSERT_GE(candidates[i].gains[0], 0.001);
+    ASSERT_LE(candidates[i].gains[0], 1.0);
+    ASSERT_GE(candidates[i].gains[1], 2.0);
+    ASSERT_LE(candidates[i].gains[1], 4.0);
+  }
+
+  // a seed fully determines the candidates
+  std::vector<TuningCandidate> again;
+  sampleCandidates(ranges, 2, defaults, 50, 7, again);
+  for (size_t i = 0; i < candidates.size(); i++) {
+    ASSERT_EQ(candidates[i].gains[0], again[i].gains[0]);
+    ASSERT_EQ(candidates[i].gains[1], again[i].gains[1]);
+  }
+}
+
+/**
+ * @brief a simulated noisy handheld recording.
+ */
+static const EvaluationInput &tuningInput() {
+  static EvaluationInput input;
+  if (input.size() == 0) {
+    InputOptions options;
+    options.synthetic_samples = 6000;
+    options.noisy = true;
+    options.seed = 3;
+    loadOptionsInput(options, input);
+  }
+  return input;
+}
+
+static filters::MadgwickFilter makeMadgwick(const double gains[]) {
+  return filters::MadgwickFilter(filters::MadgwickGains(gains[0]));
+}
+
+/**
+ * @brief scores one Madgwick gain on the whole recording.
+ */
+static double fullRms(double beta, const TuningSettings &settings) {
+  const EvaluationInput &input = tuningInput();
+  filters::MadgwickFilter filter((filters::MadgwickGains(beta)));
+  structures::Quaternion<double> estimate;
+  double sum_squares = 0;
+  for (size_t i = 0; i < input.size(); i++) {
+    filter.update(input.samples[i], estimate);
+    if (i >= settings.warmup_samples) {
+      double error = attitudeError(estimate, input.ground_truth[i]);
+      sum_squares += error * error;
+    }
+  }
+  return sqrt(sum_squares / (input.size() - settings.warmup_samples));
+}
+
+TEST(GainTunerTesting, TestSuccessiveHalving) {
+  const EvaluationInput &input = tuningInput();
+  TuningSettings settings;
+  settings.warmup_samples = 1000;
+  settings.min_samples = 200;
+  settings.eta = 3;
+
+  // a sweep with an obviously bad gain; the search must not keep it
+  std::vector<TuningCandidate> candidates(9);
+  const double betas[9] = {0.0, 0.001, 0.005, 0.02, 0.05,
+                           0.1, 0.3,   1.0,   5.0};
+  for (size_t i = 0; i < candidates.size(); i++) {
+    candidates[i].gains[0] = betas[i];
+  }
+  std::vector<TuningRung> rungs;
+  WorkStealingPool pool(3);
+  size_t best = successiveHalving<filters::MadgwickFilter>(
+      makeMadgwick, input, settings, pool, candidates, &rungs);
+
+  // 9 candidates on 200 samples, 3 on 600, then the survivor on the rest
+  ASSERT_EQ(3U, rungs.size());
+  ASSERT_EQ(9U, rungs[0].candidates);
+  ASSERT_EQ(1200U, rungs[0].end_sample);
+  ASSERT_EQ(3U, rungs[1].candidates);
+  ASSERT_EQ(1600U, rungs[1].end_sample);
+  ASSERT_EQ(1U, rungs[2].candidates);
+  ASSERT_EQ(input.size(), rungs[2].end_sample);
+
+  // resumed replays score exactly as a replay of the whole recording
+  ASSERT_EQ(input.size() - settings.warmup_samples, candidates[best].scored);
+  ASSERT_NEAR(fullRms(betas[best], settings), candidates[best].rms_rad,
+              1e-12);
+  ASSERT_NE(0.0, betas[best]);
+  ASSERT_NE(5.0, betas[best]);
+  for (size_t i = 0; i < candidates.size(); i++) {
+    if (candidates[i].rung == 2) {
+      ASSERT_EQ(best, i);
+    }
+  }
+
+  // the scores do not depend on the thread count
+  std::vector<TuningCandidate> serial = candidates;
+  WorkStealingPool single(1);
+  ASSERT_EQ(best, successiveHalving<filters::MadgwickFilter>(
+                      makeMadgwick, input, settings, single, serial));
+  for (size_t i = 0; i < candidates.size(); i++) {
+    ASSERT_EQ(candidates[i].rms_rad, serial[i].rms_rad);
+  }
+}
+
+/**
+ * @brief a Madgwick filter that, given a negative gain, blows up after a
+ * few hundred samples, as an unstable gain set would.
+ */
+class DivergingMadgwick {
+public:
+  DivergingMadgwick(double beta = 0.1)
+      : _filter(filters::MadgwickGains(fabs(beta))), _diverges(beta < 0),
+        _updates(0) {}
+
+  void update(const filters::SensorSample<double> &sample,
+              structures::Quaternion<double> &out) {
+    this->_filter.update(sample, out);
+    if (this->_diverges && ++this->_updates > 1100) {
+      out = structures::Quaternion<double>(NAN, NAN, NAN, NAN);
+    }
+  }
+
+private:
+  filters::MadgwickFilter _filter;
+  bool _diverges;
+  size_t _updates;
+}; // end DivergingMadgwick class
+
+static DivergingMadgwick makeDiverging(const double gains[]) {
+  return DivergingMadgwick(gains[0]);
+}
+
+TEST(GainTunerTesting, TestDropsDivergedCandidates) {
+  const EvaluationInput &input = tuningInput();
+  TuningSettings settings;
+  settings.warmup_samples = 1000;
+  settings.min_samples = 200;
+  settings.eta = 2;
+
+  std::vector<TuningCandidate> candidates(4);
+  const double betas[4] = {-0.05, 0.02, 0.05, 0.3};
+  for (size_t i = 0; i < candidates.size(); i++) {
+    candidates[i].gains[0] = betas[i];
+  }
+  WorkStealingPool pool(2);
+  size_t best = successiveHalving<DivergingMadgwick>(
+      makeDiverging, input, settings, pool, candidates);
+
+  // the diverged candidate is eliminated in the first rung
+  ASSERT_NE(0U, best);
+  ASSERT_EQ(INFINITY, candidates[0].rms_rad);
+  ASSERT_EQ(0U, candidates[0].scored);
+  ASSERT_EQ(0U, candidates[0].rung);
+  ASSERT_TRUE(isfinite(candidates[best].rms_rad));
+}
+
+TEST(GainTunerTesting, TestWriteAlgParams) {
+  char path[] = "/tmp/test_alg_params_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  FILE *file = fdopen(fd, "w");
+  AlgParamsValues values = {0.95, 0.0433, 0.0125, 2.5};
+  writeAlgParams(file, values, "test parameters");
+  fclose(file);
+
+  char text[2048];
+  file = fopen(path, "r");
+  size_t length = fread(text, 1, sizeof(text) - 1, file);
+  fclose(file);
+  remove(path);
+  text[length] = '\0';
+
+  // values are written with the fewest digits that read back exactly
+  ASSERT_TRUE(strstr(text, "// test parameters\n") != NULL);
+  ASSERT_TRUE(strstr(text, "alpha() { return 0.95; }") != NULL);
+  ASSERT_TRUE(strstr(text, "beta() { return 0.0433; }") != NULL);
+  ASSERT_TRUE(strstr(text, "kI() { return 0.0125; }") != NULL);
+  ASSERT_TRUE(strstr(text, "kP() { return 2.5; }") != NULL);
+  ASSERT_TRUE(strstr(text, "struct MahonyParams {") != NULL);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
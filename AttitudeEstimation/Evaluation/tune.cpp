@@ -0,0 +1,232 @@
+#include "../EstimationAlgs/ComplementaryFilter/ComplementaryFilter.hpp"
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../EstimationAlgs/MahonyFilter/MahonyFilter.hpp"
+#include "../SensorDriver/AlgParams.hpp"
+#include "EvaluationSources.hpp"
+#include "FilterEvaluation.hpp"
+#include "GainTuner.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace evaluation;
+using namespace filters;
+
+/**
+ * @brief the filters the tuner can search gains for.
+ */
+typedef enum { TUNE_COMPLEMENTARY, TUNE_MADGWICK, TUNE_MAHONY } tuned_filter_t;
+
+/**
+ * @brief the command line options of the gain tuning tool.
+ */
+struct TuneOptions {
+  InputOptions input;          // recording or simulation to tune on
+  double warmup_s = 10.0;      // leading time left out of the scores
+  size_t candidates = 64;      // gain sets drawn per filter
+  size_t eta = 3;              // successive halving rate
+  size_t min_samples = 1000;   // scored samples of the first rung
+  size_t threads = 0;          // worker threads, 0 for one per CPU
+  uint64_t tune_seed = 1;      // candidate sampling seed
+  bool filters[3] = {true, true, true}; // filters to tune
+  const char *output = NULL;   // generated AlgParams.hpp path, or NULL
+};
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] (<recording> | --synthetic <samples>)\n"
+          "%s"
+          "  --filter complementary|madgwick|mahony\n"
+          "                      tune one filter (repeatable, default all)\n"
+          "  --warmup <s>        leading seconds left out of the error\n"
+          "                      scores while filters converge (default 10)\n"
+          "  --candidates <n>    gain sets drawn per filter (default 64)\n"
+          "  --eta <n>           keep 1 in n candidates per rung, and give\n"
+          "                      the survivors n times the data (default 3)\n"
+          "  --min-samples <n>   scored samples of the first rung (default\n"
+          "                      1000)\n"
+          "  --threads <n>       worker threads (default one per CPU)\n"
+          "  --tune-seed <n>     candidate sampling seed\n"
+          "  --output <path>     write the best gains as an AlgParams.hpp\n",
+          name, kInputUsage);
+}
+
+static bool parseFilter(const char *name, tuned_filter_t &filter) {
+  if (strcmp(name, "complementary") == 0) {
+    filter = TUNE_COMPLEMENTARY;
+  } else if (strcmp(name, "madgwick") == 0) {
+    filter = TUNE_MADGWICK;
+  } else if (strcmp(name, "mahony") == 0) {
+    filter = TUNE_MAHONY;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool parseOptions(int argc, char **argv, TuneOptions &options) {
+  bool filter_selected = false;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "--filter") == 0 && has_value) {
+      tuned_filter_t filter;
+      if (!parseFilter(argv[++i], filter)) {
+        return false;
+      }
+      if (!filter_selected) {
+        std::fill(options.filters, options.filters + 3, false);
+        filter_selected = true;
+      }
+      options.filters[filter] = true;
+    } else if (strcmp(arg, "--warmup") == 0 && has_value) {
+      options.warmup_s = atof(argv[++i]);
+    } else if (strcmp(arg, "--candidates") == 0 && has_value) {
+      options.candidates = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--eta") == 0 && has_value) {
+      options.eta = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--min-samples") == 0 && has_value) {
+      options.min_samples = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--threads") == 0 && has_value) {
+      options.threads = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--tune-seed") == 0 && has_value) {
+      options.tune_seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--output") == 0 && has_value) {
+      options.output = argv[++i];
+    } else if (!parseInputOption(argc, argv, i, options.input)) {
+      return false;
+    }
+  }
+  return options.input.selected() && options.candidates > 0 &&
+         options.eta >= 2;
+}
+
+static double toDegrees(double radians) { return radians * 180.0 / M_PI; }
+
+/**
+ * @brief tunes the gains of one filter and prints the search.
+ * @param name the filter name.
+ * @param ranges the range of every gain.
+ * @param gain_count the number of gains.
+ * @param defaults the gains from AlgParams.hpp, updated to the best gains.
+ * @param make_filter builds a filter from a gain set.
+ */
+template <typename FilterT, typename FactoryT>
+static void tune(const char *name, const GainRange ranges[],
+                 size_t gain_count, double defaults[], FactoryT make_filter,
+                 const EvaluationInput &input, const TuneOptions &options,
+                 const TuningSettings &settings, WorkStealingPool &pool) {
+  std::vector<TuningCandidate> candidates;
+  sampleCandidates(ranges, gain_count, defaults, options.candidates,
+                   options.tune_seed, candidates);
+  std::vector<TuningRung> rungs;
+  size_t best = successiveHalving<FilterT>(make_filter, input, settings, pool,
+                                           candidates, &rungs);
+
+  printf("%s:\n", name);
+  for (size_t i = 0; i < rungs.size(); i++) {
+    printf("  rung %zu: %4zu candidates, %8zu samples, best rms %.3f deg\n",
+           i, rungs[i].candidates, rungs[i].end_sample,
+           toDegrees(rungs[i].best_rms_rad));
+  }
+
+  // the defaults are candidate 0, and their score covers the samples of
+  // the last rung they reached
+  printf("  best:");
+  for (size_t gain = 0; gain < gain_count; gain++) {
+    printf(" %s=%g", ranges[gain].name, candidates[best].gains[gain]);
+  }
+  printf(" (rms %.3f deg", toDegrees(candidates[best].rms_rad));
+  if (best != 0) {
+    printf(", defaults reached rung %zu at %.3f deg", candidates[0].rung,
+           toDegrees(candidates[0].rms_rad));
+  }
+  printf(")\n");
+  for (size_t gain = 0; gain < gain_count; gain++) {
+    defaults[gain] = candidates[best].gains[gain];
+  }
+}
+
+int main(int argc, char **argv) {
+  TuneOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  EvaluationInput input;
+  if (!loadOptionsInput(options.input, input)) {
+    return 1;
+  }
+  TuningSettings settings;
+  settings.warmup_samples = countWarmupSamples(input, options.warmup_s);
+  settings.min_samples = options.min_samples;
+  settings.eta = options.eta;
+  if (settings.warmup_samples >= input.size()) {
+    fprintf(stderr, "the warmup covers the whole recording\n");
+    return 1;
+  }
+
+  WorkStealingPool pool(options.threads);
+  printf("samples: %zu (%zu scored), %zu threads\n", input.size(),
+         input.size() - settings.warmup_samples, pool.getThreadCount());
+
+  AlgParamsValues values = {ComplementaryParams::alpha(),
+                            MadgwickParams::beta(), MahonyParams::kI(),
+                            MahonyParams::kP()};
+  if (options.filters[TUNE_COMPLEMENTARY]) {
+    const GainRange ranges[] = {{"alpha", 0.5, 0.999, false}};
+    tune<ComplementaryFilter>(
+        "complementary", ranges, 1, &values.alpha,
+        [](const double gains[]) {
+          return ComplementaryFilter(ComplementaryGains(gains[0]));
+        },
+        input, options, settings, pool);
+  }
+  if (options.filters[TUNE_MADGWICK]) {
+    const GainRange ranges[] = {{"beta", 0.001, 1.0, true}};
+    tune<MadgwickFilter>(
+        "madgwick", ranges, 1, &values.beta,
+        [](const double gains[]) {
+          return MadgwickFilter(MadgwickGains(gains[0]));
+        },
+        input, options, settings, pool);
+  }
+  if (options.filters[TUNE_MAHONY]) {
+    const GainRange ranges[] = {{"kI", 0.0001, 1.0, true},
+                                {"kP", 0.05, 10.0, true}};
+    double gains[2] = {values.kI, values.kP};
+    tune<MahonyFilter>(
+        "mahony", ranges, 2, gains,
+        [](const double gains[]) {
+          return MahonyFilter(MahonyGains(gains[0], gains[1]));
+        },
+        input, options, settings, pool);
+    values.kI = gains[0];
+    values.kP = gains[1];
+  }
+
+  if (options.output != NULL) {
+    FILE *file = fopen(options.output, "w");
+    if (file == NULL) {
+      perror(options.output);
+      return 1;
+    }
+    char note[256];
+    snprintf(note, sizeof(note), "generated by tuneGains from %s",
+             options.input.recording != NULL ? options.input.recording
+                                             : "a synthetic recording");
+    writeAlgParams(file, values, note);
+
+    // a full disk shows up as a stream error or a failed final flush
+    bool write_failed = ferror(file) != 0;
+    if (fclose(file) != 0 || write_failed) {
+      perror(options.output);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,827 @@
+#pragma once
+
+#include "../EstimationAlgs/SensorSample.hpp"
+#include "../Quaternion/Quaternion.hpp"
+#include "../SensorDriver/Calibration.hpp"
+#include "../Telemetry/TelemetryProtocol.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace imulog {
+
+/**
+ * @brief the columnar IMU archive layout. All fixed width fields are little
+ * endian.
+ *
+ *   file header  48 bytes: magic, version, flags, samples per block, rate,
+ *                and the accelerometer, gyroscope and magnetometer LSB to
+ *                SI scales (version 1 headers stop after the rate, 32 bytes)
+ *   blocks       one per kArchiveBlockSamples samples, see encodeBlock()
+ *   block index  one 40 byte ArchiveBlockInfo per block
+ *   footer       16 bytes: index offset, block count, footer magic
+ *
+ * Blocks are independently decodable, so the index gives random access to
+ * any time range, and a reader only ever holds one decoded block.
+ */
+static const char kArchiveMagic[8] = {'I', 'M', 'U', 'A', 'R', 'C', '\r',
+                                      '\n'};
+static const uint16_t kArchiveVersion = 2;
+static const uint16_t kArchiveHasEstimate = 0x0001;
+static const uint32_t kArchiveFooterMagic = 0x58444941; // "AIDX"
+static const size_t kArchiveHeaderLength = 48;
+static const size_t kArchiveV1HeaderLength = 32;
+static const size_t kArchiveIndexEntryLength = 40;
+static const size_t kArchiveFooterLength = 16;
+static const uint32_t kArchiveBlockSamples = 4096;
+
+/**
+ * @brief the archive columns, in the order they are stored in a block.
+ */
+typedef enum {
+  COLUMN_TIMESTAMP,
+  COLUMN_ACC_X,
+  COLUMN_ACC_Y,
+  COLUMN_ACC_Z,
+  COLUMN_GYRO_X,
+  COLUMN_GYRO_Y,
+  COLUMN_GYRO_Z,
+  COLUMN_MAG_X,
+  COLUMN_MAG_Y,
+  COLUMN_MAG_Z,
+  COLUMN_GT_LARGEST,
+  COLUMN_GT_A,
+  COLUMN_GT_B,
+  COLUMN_GT_C,
+  COLUMN_EST_LARGEST,
+  COLUMN_EST_A,
+  COLUMN_EST_B,
+  COLUMN_EST_C,
+  COLUMN_COUNT
+} archive_column_t;
+
+/**
+ * @brief one sample of the archived stream.
+ */
+struct ArchiveSample {
+  filters::RawSensorSample raw;                // raw sensor readings
+  structures::Quaternion<double> ground_truth; // sensor's own estimate
+  structures::Quaternion<double> estimate;     // filter estimate, if stored
+};
+
+/**
+ * @brief the index entry describing one block.
+ */
+struct ArchiveBlockInfo {
+  uint64_t offset;          // file offset of the encoded block
+  uint32_t length;          // encoded block length in bytes
+  uint32_t sample_count;    // number of samples in the block
+  uint64_t first_sample;    // index of the block's first sample
+  uint64_t first_timestamp; // timestamp of the block's first sample
+  uint64_t last_timestamp;  // timestamp of the block's last sample
+};
+
+/**
+ * @brief writes a little endian 64 bit value.
+ */
+inline void putU64(uint8_t *buffer, uint64_t value) {
+  telemetry::putU32(buffer, (uint32_t)(value & 0xFFFFFFFF));
+  telemetry::putU32(buffer + 4, (uint32_t)(value >> 32));
+}
+
+/**
+ * @brief reads a little endian 64 bit value.
+ */
+inline uint64_t getU64(const uint8_t *buffer) {
+  return (uint64_t)telemetry::getU32(buffer) |
+         ((uint64_t)telemetry::getU32(buffer + 4) << 32);
+}
+
+/**
+ * @brief writes a little endian double.
+ */
+inline void putF64(uint8_t *buffer, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  putU64(buffer, bits);
+}
+
+/**
+ * @brief reads a little endian double.
+ */
+inline double getF64(const uint8_t *buffer) {
+  uint64_t bits = getU64(buffer);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * @brief maps a signed value onto an unsigned one so small magnitudes of
+ * either sign encode to short varints.
+ */
+inline uint64_t zigzagEncode(int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+/**
+ * @brief reverses zigzagEncode().
+ */
+inline int64_t zigzagDecode(uint64_t value) {
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * @brief appends a LEB128 varint.
+ * @param out the buffer to append to.
+ * @param value the value to append.
+ */
+inline void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t)value);
+}
+
+/**
+ * @brief reads a LEB128 varint.
+ * @param in the first byte of the varint.
+ * @param end one past the last readable byte.
+ * @param value the decoded value.
+ * @return one past the varint, or NULL if it was truncated or too long.
+ */
+inline const uint8_t *getVarint(const uint8_t *in, const uint8_t *end,
+                                uint64_t &value) {
+  // nearly every delta fits in a single byte
+  if (in < end && *in < 0x80) {
+    value = *in;
+    return in + 1;
+  }
+
+  value = 0;
+  for (unsigned shift = 0; in < end && shift < 64; shift += 7) {
+    uint8_t byte = *in++;
+    value |= (uint64_t)(byte & 0x7F) << shift;
+    if (byte < 0x80) {
+      return in;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief writes values of up to 64 bits into a little endian bit stream.
+ */
+class BitPacker {
+public:
+  /**
+   * @brief constructor for BitPacker class.
+   * @param out the buffer to append to.
+   */
+  BitPacker(std::vector<uint8_t> &out) : _out(out) {
+    this->_bits = 0;
+    this->_filled = 0;
+  }
+
+  /**
+   * @brief appends the low bits of a value.
+   * @param value the value to append.
+   * @param width the number of bits to append, at most 64.
+   */
+  void put(uint64_t value, unsigned width) {
+    if (width > 32) {
+      this->putShort(value & 0xFFFFFFFF, 32);
+      this->putShort(value >> 32, width - 32);
+    } else {
+      this->putShort(value, width);
+    }
+  }
+
+  /**
+   * @brief writes out the last partial byte.
+   */
+  void flush() {
+    if (this->_filled > 0) {
+      this->_out.push_back((uint8_t)this->_bits);
+    }
+    this->_bits = 0;
+    this->_filled = 0;
+  }
+
+private:
+  void putShort(uint64_t value, unsigned width) {
+    if (width == 0) {
+      return;
+    }
+    this->_bits |= (value & ((1ULL << width) - 1)) << this->_filled;
+    this->_filled += width;
+    while (this->_filled >= 8) {
+      this->_out.push_back((uint8_t)this->_bits);
+      this->_bits >>= 8;
+      this->_filled -= 8;
+    }
+  }
+
+  std::vector<uint8_t> &_out;
+  uint64_t _bits;
+  unsigned _filled;
+}; // end BitPacker class
+
+/**
+ * @brief reads values written by BitPacker. The caller checks the stream is
+ * long enough up front.
+ */
+class BitUnpacker {
+public:
+  /**
+   * @brief constructor for BitUnpacker class.
+   * @param in the first byte of the bit stream.
+   */
+  BitUnpacker(const uint8_t *in) {
+    this->_in = in;
+    this->_bits = 0;
+    this->_filled = 0;
+  }
+
+  /**
+   * @brief reads the next value.
+   * @param width the number of bits to read, at most 64.
+   * @return the value read.
+   */
+  uint64_t get(unsigned width) {
+    if (width > 32) {
+      uint64_t low = this->getShort(32);
+      return low | (this->getShort(width - 32) << 32);
+    }
+    return this->getShort(width);
+  }
+
+private:
+  uint64_t getShort(unsigned width) {
+    if (width == 0) {
+      return 0;
+    }
+    while (this->_filled < width) {
+      this->_bits |= (uint64_t)*this->_in++ << this->_filled;
+      this->_filled += 8;
+    }
+    uint64_t value = this->_bits & ((1ULL << width) - 1);
+    this->_bits >>= width;
+    this->_filled -= width;
+    return value;
+  }
+
+  const uint8_t *_in;
+  uint64_t _bits;
+  unsigned _filled;
+}; // end BitUnpacker class
+
+/**
+ * @brief encodes a column of integers as patched, frame of reference bit
+ * packed deltas. Each delta is stored as the zigzag of its distance from
+ * the median delta, bit packed at the width that minimizes the column size;
+ * the few wider values, such as a quaternion component jumping when its
+ * largest component changes, keep their low bits in the packed stream and
+ * their high bits in an exception list. A constant rate timestamp column
+ * packs to zero bits per sample.
+ *
+ *   varint  zigzag first value
+ *   varint  zigzag median delta
+ *   byte    packed width
+ *   varint  exception count
+ *   bytes   (count - 1) packed values
+ *   varints exceptions as (index gap, high bits) pairs
+ *
+ * @param values pointer to count values.
+ * @param count the number of values.
+ * @param out the buffer to append to.
+ */
+template <typename T>
+void encodeDeltaColumn(const T *values, size_t count,
+                       std::vector<uint8_t> &out) {
+  if (count == 0) {
+    return;
+  }
+
+  // deltas wrap modulo 2^64, so any column round trips
+  std::vector<int64_t> deltas(count - 1);
+  for (size_t i = 1; i < count; i++) {
+    deltas[i - 1] = (int64_t)((uint64_t)values[i] - (uint64_t)values[i - 1]);
+  }
+  int64_t base = 0;
+  if (!deltas.empty()) {
+    std::vector<int64_t> sorted(deltas);
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2,
+                     sorted.end());
+    base = sorted[sorted.size() / 2];
+  }
+
+  // histogram the offset widths to pick the cheapest packed width
+  size_t widths[65] = {0};
+  for (size_t i = 0; i < deltas.size(); i++) {
+    deltas[i] = (int64_t)zigzagEncode(
+        (int64_t)((uint64_t)deltas[i] - (uint64_t)base));
+    unsigned width = 0;
+    while (width < 64 && ((uint64_t)deltas[i] >> width) != 0) {
+      width++;
+    }
+    widths[width]++;
+  }
+  unsigned width = 64;
+  size_t best_bits = (size_t)-1;
+  size_t wider = 0;
+  for (int w = 64; w >= 0; w--) {
+    // an exception costs about three varint bytes
+    size_t bits = deltas.size() * w + wider * 24;
+    if (bits <= best_bits) {
+      best_bits = bits;
+      width = (unsigned)w;
+    }
+    wider += widths[w];
+  }
+
+  putVarint(out, zigzagEncode((int64_t)values[0]));
+  putVarint(out, zigzagEncode(base));
+  out.push_back((uint8_t)width);
+  size_t exceptions = 0;
+  for (size_t i = 0; i < deltas.size(); i++) {
+    exceptions += width < 64 && ((uint64_t)deltas[i] >> width) != 0;
+  }
+  putVarint(out, exceptions);
+
+  BitPacker packer(out);
+  for (size_t i = 0; i < deltas.size(); i++) {
+    packer.put((uint64_t)deltas[i], width);
+  }
+  packer.flush();
+
+  size_t previous = 0;
+  for (size_t i = 0; width < 64 && i < deltas.size(); i++) {
+    if (((uint64_t)deltas[i] >> width) != 0) {
+      putVarint(out, i - previous);
+      putVarint(out, (uint64_t)deltas[i] >> width);
+      previous = i;
+    }
+  }
+}
+
+/**
+ * @brief decodes a column written by encodeDeltaColumn().
+ * @param in the first byte of the column.
+ * @param end one past the last byte of the column.
+ * @param count the number of values.
+ * @param values pointer to count decoded values.
+ * @return false if the column was malformed, true otherwise.
+ */
+template <typename T>
+bool decodeDeltaColumn(const uint8_t *in, const uint8_t *end, size_t count,
+                       T *values) {
+  if (count == 0) {
+    return in == end;
+  }
+
+  uint64_t first;
+  uint64_t base;
+  uint64_t exceptions;
+  in = getVarint(in, end, first);
+  if (in != NULL) {
+    in = getVarint(in, end, base);
+  }
+  if (in == NULL || in == end || *in > 64) {
+    return false;
+  }
+  unsigned width = *in++;
+  in = getVarint(in, end, exceptions);
+  size_t packed_len = ((uint64_t)(count - 1) * width + 7) / 8;
+  if (in == NULL || (size_t)(end - in) < packed_len ||
+      exceptions > count - 1) {
+    return false;
+  }
+
+  if (width == 64 && exceptions > 0) {
+    return false;
+  }
+
+  // the exceptions follow the packed values, sorted by index
+  const uint8_t *patches = in + packed_len;
+  size_t next_patch = (size_t)-1;
+  uint64_t patch_high = 0;
+  auto loadPatch = [&](size_t from) {
+    if (exceptions == 0) {
+      next_patch = (size_t)-1;
+      return true;
+    }
+    uint64_t gap;
+    patches = getVarint(patches, end, gap);
+    if (patches != NULL) {
+      patches = getVarint(patches, end, patch_high);
+    }
+    next_patch = from + gap;
+    exceptions--;
+    return patches != NULL;
+  };
+  if (!loadPatch(0)) {
+    return false;
+  }
+
+  uint64_t previous = (uint64_t)zigzagDecode(first);
+  uint64_t median = (uint64_t)zigzagDecode(base);
+  values[0] = (T)previous;
+  BitUnpacker unpacker(in);
+  for (size_t i = 1; i < count; i++) {
+    uint64_t offset = unpacker.get(width);
+    if (i - 1 == next_patch) {
+      offset |= patch_high << width;
+      if (!loadPatch(i - 1)) {
+        return false;
+      }
+    }
+    previous += median + (uint64_t)zigzagDecode(offset);
+    values[i] = (T)previous;
+  }
+  return next_patch == (size_t)-1 && patches == end;
+}
+
+/**
+ * @brief encodes a column of 2 bit values, four per byte.
+ * @param values pointer to count values in [0, 3].
+ * @param count the number of values.
+ * @param out the buffer to append to.
+ */
+inline void encodePackedColumn(const uint8_t *values, size_t count,
+                               std::vector<uint8_t> &out) {
+  for (size_t i = 0; i < count; i += 4) {
+    uint8_t packed = 0;
+    for (size_t j = 0; j < 4 && i + j < count; j++) {
+      packed |= (uint8_t)((values[i + j] & 0x03) << (2 * j));
+    }
+    out.push_back(packed);
+  }
+}
+
+/**
+ * @brief decodes a column written by encodePackedColumn().
+ * @param in the first byte of the column.
+ * @param end one past the last byte of the column.
+ * @param count the number of values.
+ * @param values pointer to count decoded values.
+ * @return false if the column was malformed, true otherwise.
+ */
+inline bool decodePackedColumn(const uint8_t *in, const uint8_t *end,
+                               size_t count, uint8_t *values) {
+  if ((size_t)(end - in) != (count + 3) / 4) {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    values[i] = (uint8_t)((in[i / 4] >> (2 * (i % 4))) & 0x03);
+  }
+  return true;
+}
+
+/**
+ * @brief a block of samples stored column by column, as decoded from or
+ * about to be encoded into an archive block.
+ */
+struct ArchiveBlock {
+  std::vector<uint64_t> timestamp_us;
+  std::vector<int16_t> raw[9];         // acc, gyro and mag X, Y, Z columns
+  std::vector<uint8_t> largest[2];     // ground truth and estimate
+  std::vector<int16_t> components[6];  // smallest three, ground truth first
+
+  /**
+   * @brief returns the number of samples in the block.
+   * @return the number of samples in the block.
+   */
+  size_t size() const { return this->timestamp_us.size(); }
+
+  /**
+   * @brief removes every sample, keeping the allocations.
+   */
+  void clear() { this->resize(0); }
+
+  /**
+   * @brief resizes every column.
+   * @param count the new number of samples.
+   */
+  void resize(size_t count) {
+    this->timestamp_us.resize(count);
+    for (size_t i = 0; i < 9; i++) {
+      this->raw[i].resize(count);
+    }
+    for (size_t i = 0; i < 2; i++) {
+      this->largest[i].resize(count);
+    }
+    for (size_t i = 0; i < 6; i++) {
+      this->components[i].resize(count);
+    }
+  }
+
+  /**
+   * @brief appends a sample, quantizing its quaternions.
+   * @param sample the sample to append.
+   */
+  void push(const ArchiveSample &sample) {
+    size_t i = this->size();
+    this->resize(i + 1);
+    this->timestamp_us[i] = sample.raw.timestamp_us;
+    for (size_t axis = 0; axis < 3; axis++) {
+      this->raw[axis][i] = sample.raw.acc[axis];
+      this->raw[3 + axis][i] = sample.raw.gyro[axis];
+      this->raw[6 + axis][i] = sample.raw.mag[axis];
+    }
+
+    int16_t values[3];
+    this->largest[0][i] = telemetry::smallestThreeEncode(sample.ground_truth,
+                                                         values);
+    for (size_t j = 0; j < 3; j++) {
+      this->components[j][i] = values[j];
+    }
+    this->largest[1][i] = telemetry::smallestThreeEncode(sample.estimate,
+                                                         values);
+    for (size_t j = 0; j < 3; j++) {
+      this->components[3 + j][i] = values[j];
+    }
+  }
+
+  /**
+   * @brief reads back one sample.
+   * @param i the index of the sample in the block.
+   * @param sample the sample to fill.
+   */
+  void get(size_t i, ArchiveSample &sample) const {
+    sample.raw.timestamp_us = this->timestamp_us[i];
+    for (size_t axis = 0; axis < 3; axis++) {
+      sample.raw.acc[axis] = this->raw[axis][i];
+      sample.raw.gyro[axis] = this->raw[3 + axis][i];
+      sample.raw.mag[axis] = this->raw[6 + axis][i];
+    }
+
+    const int16_t ground_truth[3] = {this->components[0][i],
+                                     this->components[1][i],
+                                     this->components[2][i]};
+    sample.ground_truth =
+        telemetry::smallestThreeDecode(this->largest[0][i], ground_truth);
+    const int16_t estimate[3] = {this->components[3][i],
+                                 this->components[4][i],
+                                 this->components[5][i]};
+    sample.estimate =
+        telemetry::smallestThreeDecode(this->largest[1][i], estimate);
+  }
+}; // end ArchiveBlock struct
+
+/**
+ * @brief encodes a block. The layout is a varint sample count followed by
+ * every column as a varint byte length and the column bytes, so a decoder
+ * can locate any column without decoding the ones before it.
+ * @param block the block to encode.
+ * @param has_estimate true to store the estimate columns.
+ * @param out the buffer to write the encoded block into.
+ */
+inline void encodeBlock(const ArchiveBlock &block, bool has_estimate,
+                        std::vector<uint8_t> &out) {
+  out.clear();
+  putVarint(out, block.size());
+
+  std::vector<uint8_t> column;
+  size_t column_count = has_estimate ? COLUMN_COUNT : COLUMN_EST_LARGEST;
+  for (size_t c = 0; c < column_count; c++) {
+    column.clear();
+    if (c == COLUMN_TIMESTAMP) {
+      encodeDeltaColumn(block.timestamp_us.data(), block.size(), column);
+    } else if (c <= COLUMN_MAG_Z) {
+      encodeDeltaColumn(block.raw[c - COLUMN_ACC_X].data(), block.size(),
+                        column);
+    } else if (c == COLUMN_GT_LARGEST || c == COLUMN_EST_LARGEST) {
+      encodePackedColumn(block.largest[c == COLUMN_EST_LARGEST].data(),
+                         block.size(), column);
+    } else {
+      size_t component = c < COLUMN_EST_LARGEST ? c - COLUMN_GT_A
+                                                : 3 + c - COLUMN_EST_A;
+      encodeDeltaColumn(block.components[component].data(), block.size(),
+                        column);
+    }
+    putVarint(out, column.size());
+    out.insert(out.end(), column.begin(), column.end());
+  }
+}
+
+/**
+ * @brief decodes a block written by encodeBlock().
+ * @param in the first byte of the block.
+ * @param len the encoded block length.
+ * @param has_estimate true if the block stores the estimate columns.
+ * @param block the block to decode into. Without estimate columns the
+ * estimates decode as identity.
+ * @return false if the block was malformed, true otherwise.
+ */
+inline bool decodeBlock(const uint8_t *in, size_t len, bool has_estimate,
+                        ArchiveBlock &block) {
+  const uint8_t *end = in + len;
+  uint64_t count;
+  in = getVarint(in, end, count);
+  if (in == NULL || count > len * 8) {
+    return false;
+  }
+  block.resize((size_t)count);
+
+  size_t column_count = has_estimate ? COLUMN_COUNT : COLUMN_EST_LARGEST;
+  for (size_t c = 0; c < column_count; c++) {
+    uint64_t column_len;
+    in = getVarint(in, end, column_len);
+    if (in == NULL || column_len > (uint64_t)(end - in)) {
+      return false;
+    }
+
+    const uint8_t *column_end = in + column_len;
+    bool ok;
+    if (c == COLUMN_TIMESTAMP) {
+      ok = decodeDeltaColumn(in, column_end, count, block.timestamp_us.data());
+    } else if (c <= COLUMN_MAG_Z) {
+      ok = decodeDeltaColumn(in, column_end, count,
+                             block.raw[c - COLUMN_ACC_X].data());
+    } else if (c == COLUMN_GT_LARGEST || c == COLUMN_EST_LARGEST) {
+      ok = decodePackedColumn(in, column_end, count,
+                              block.largest[c == COLUMN_EST_LARGEST].data());
+    } else {
+      size_t component = c < COLUMN_EST_LARGEST ? c - COLUMN_GT_A
+                                                : 3 + c - COLUMN_EST_A;
+      ok = decodeDeltaColumn(in, column_end, count,
+                             block.components[component].data());
+    }
+    if (!ok) {
+      return false;
+    }
+    in = column_end;
+  }
+
+  if (!has_estimate) {
+    // the identity quaternion, with w as the dropped component
+    for (size_t i = 0; i < count; i++) {
+      block.largest[1][i] = 0;
+      block.components[3][i] = 0;
+      block.components[4][i] = 0;
+      block.components[5][i] = 0;
+    }
+  }
+  return in == end;
+}
+
+/**
+ * @brief writes a columnar IMU archive, encoding a block every
+ * kArchiveBlockSamples samples.
+ */
+class ImuArchiveWriter {
+public:
+  /**
+   * @brief default constructor for ImuArchiveWriter class.
+   */
+  ImuArchiveWriter() {
+    this->_file = NULL;
+    this->_has_estimate = false;
+    this->_offset = 0;
+    this->_sample_count = 0;
+  }
+
+  ImuArchiveWriter(const ImuArchiveWriter &other) = delete;
+  ImuArchiveWriter &operator=(const ImuArchiveWriter &other) = delete;
+
+  /**
+   * @brief destructor for ImuArchiveWriter class. Closes the archive if
+   * open.
+   */
+  ~ImuArchiveWriter() { this->close(); }
+
+  /**
+   * @brief creates an archive and writes its header.
+   * @param path the path of the archive to create.
+   * @param sample_rate_hz the nominal sample rate in Hz.
+   * @param has_estimate true to store the estimate quaternion as well as the
+   * ground truth.
+   * @param calibration the calibration converting the raw samples to SI
+   * units. The header holds one scale per sensor, the X axis scale of each
+   * transform, which is exact for scale-only calibrations.
+   * @return true if the archive was created, false otherwise.
+   */
+  bool open(const char *path, double sample_rate_hz, bool has_estimate,
+            const filters::SensorCalibration<double> &calibration =
+                filters::SensorCalibration<double>::nominal()) {
+    this->close();
+    this->_file = fopen(path, "wb");
+    if (this->_file == NULL) {
+      return false;
+    }
+
+    this->_has_estimate = has_estimate;
+    this->_block.clear();
+    this->_index.clear();
+    this->_sample_count = 0;
+
+    uint8_t header[kArchiveHeaderLength];
+    memset(header, 0, sizeof(header));
+    memcpy(header, kArchiveMagic, sizeof(kArchiveMagic));
+    telemetry::putU16(header + 8, kArchiveVersion);
+    telemetry::putU16(header + 10, has_estimate ? kArchiveHasEstimate : 0);
+    telemetry::putU32(header + 12, kArchiveBlockSamples);
+    putF64(header + 16, sample_rate_hz);
+    putF64(header + 24, calibration.getAccCalibration().getValue(0, 0));
+    putF64(header + 32, calibration.getGyroCalibration().getValue(0, 0));
+    putF64(header + 40, calibration.getMagCalibration().getValue(0, 0));
+    this->_offset = sizeof(header);
+    return fwrite(header, sizeof(header), 1, this->_file) == 1;
+  }
+
+  /**
+   * @brief appends one sample.
+   * @param sample the sample to append.
+   * @return false if a full block could not be written, true otherwise.
+   */
+  bool write(const ArchiveSample &sample) {
+    if (this->_file == NULL) {
+      return false;
+    }
+    this->_block.push(sample);
+    this->_sample_count++;
+    if (this->_block.size() < kArchiveBlockSamples) {
+      return true;
+    }
+    return this->flushBlock();
+  }
+
+  /**
+   * @brief writes the last partial block, the block index and the footer,
+   * and closes the archive.
+   * @return true if the archive was finalized, false otherwise.
+   */
+  bool close() {
+    if (this->_file == NULL) {
+      return false;
+    }
+
+    bool ok = this->flushBlock();
+    uint64_t index_offset = this->_offset;
+    uint8_t entry[kArchiveIndexEntryLength];
+    for (const ArchiveBlockInfo &info : this->_index) {
+      putU64(entry, info.offset);
+      telemetry::putU32(entry + 8, info.length);
+      telemetry::putU32(entry + 12, info.sample_count);
+      putU64(entry + 16, info.first_sample);
+      putU64(entry + 24, info.first_timestamp);
+      putU64(entry + 32, info.last_timestamp);
+      ok = ok && fwrite(entry, sizeof(entry), 1, this->_file) == 1;
+    }
+
+    uint8_t footer[kArchiveFooterLength];
+    putU64(footer, index_offset);
+    telemetry::putU32(footer + 8, (uint32_t)this->_index.size());
+    telemetry::putU32(footer + 12, kArchiveFooterMagic);
+    ok = ok && fwrite(footer, sizeof(footer), 1, this->_file) == 1;
+    ok = (fclose(this->_file) == 0) && ok;
+    this->_file = NULL;
+    return ok;
+  }
+
+  /**
+   * @brief returns the number of samples written so far.
+   * @return the number of samples written so far.
+   */
+  uint64_t getSampleCount() const { return this->_sample_count; }
+
+private:
+  /**
+   * @brief encodes and writes the pending block.
+   * @return true if the block was written or empty, false otherwise.
+   */
+  bool flushBlock() {
+    if (this->_block.size() == 0) {
+      return true;
+    }
+
+    encodeBlock(this->_block, this->_has_estimate, this->_encoded);
+    ArchiveBlockInfo info;
+    info.offset = this->_offset;
+    info.length = (uint32_t)this->_encoded.size();
+    info.sample_count = (uint32_t)this->_block.size();
+    info.first_sample = this->_sample_count - this->_block.size();
+    info.first_timestamp = this->_block.timestamp_us.front();
+    info.last_timestamp = this->_block.timestamp_us.back();
+    this->_index.push_back(info);
+
+    this->_offset += this->_encoded.size();
+    this->_block.clear();
+    return fwrite(this->_encoded.data(), 1, this->_encoded.size(),
+                  this->_file) == this->_encoded.size();
+  }
+
+  FILE *_file;
+  bool _has_estimate;
+  uint64_t _offset;
+  uint64_t _sample_count;
+  ArchiveBlock _block;
+  std::vector<uint8_t> _encoded;
+  std::vector<ArchiveBlockInfo> _index;
+}; // end ImuArchiveWriter class
+} // namespace imulog
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "../SensorDriver/Records.hpp"
+#include "ImuArchive.hpp"
+#include "MappedFile.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <vector>
+
+namespace imulog {
+
+/**
+ * @brief a memory mapped columnar archive reader. The block index is loaded
+ * on open; blocks are decoded one at a time on demand, so random access to a
+ * time range only touches the blocks that overlap it.
+ */
+class ImuArchiveReader {
+public:
+  /**
+   * @brief default constructor for ImuArchiveReader class.
+   */
+  ImuArchiveReader() {
+    this->_error = NULL;
+    this->_has_estimate = false;
+    this->_sample_rate_hz = 0;
+    this->_calibration = filters::SensorCalibration<double>::nominal();
+    this->_header_length = kArchiveHeaderLength;
+    this->_sample_count = 0;
+  }
+
+  ImuArchiveReader(const ImuArchiveReader &other) = delete;
+  ImuArchiveReader &operator=(const ImuArchiveReader &other) = delete;
+
+  /**
+   * @brief maps an archive and loads its block index.
+   * @param path the path of the archive to open.
+   * @return true if the archive was opened, false otherwise. See getError().
+   */
+  bool open(const char *path) {
+    this->close();
+
+    this->_error = this->_file.open(path);
+    if (this->_error == NULL) {
+      this->_error = this->loadIndex();
+    }
+    if (this->_error != NULL) {
+      this->close();
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief unmaps the archive.
+   */
+  void close() {
+    this->_file.close();
+    this->_index.clear();
+    this->_sample_count = 0;
+  }
+
+  /**
+   * @brief checks if an archive is open.
+   * @return true if an archive is open, false otherwise.
+   */
+  bool isOpen() const { return this->_file.data() != NULL; }
+
+  /**
+   * @brief returns why the last open() failed.
+   * @return a description of the last error, or NULL.
+   */
+  const char *getError() const { return this->_error; }
+
+  /**
+   * @brief checks if the archive stores estimate quaternions.
+   * @return true if the archive stores estimates, false otherwise.
+   */
+  bool hasEstimate() const { return this->_has_estimate; }
+
+  /**
+   * @brief returns the nominal sample rate.
+   * @return the nominal sample rate in Hz.
+   */
+  double getSampleRate() const { return this->_sample_rate_hz; }
+
+  /**
+   * @brief returns the calibration converting the archived raw samples to
+   * SI units. Version 1 archives predate the scales and use the nominal
+   * calibration.
+   * @return the scale-only calibration described by the header.
+   */
+  const filters::SensorCalibration<double> &getCalibration() const {
+    return this->_calibration;
+  }
+
+  /**
+   * @brief returns the number of samples in the archive.
+   * @return the number of samples in the archive.
+   */
+  uint64_t size() const { return this->_sample_count; }
+
+  /**
+   * @brief returns the encoded length of the archive.
+   * @return the archive length in bytes.
+   */
+  size_t byteSize() const { return this->_file.size(); }
+
+  /**
+   * @brief returns the number of blocks in the archive.
+   * @return the number of blocks in the archive.
+   */
+  size_t blockCount() const { return this->_index.size(); }
+
+  /**
+   * @brief returns the index entry of a block.
+   * @param block the index of the block.
+   * @return the index entry of the block.
+   */
+  const ArchiveBlockInfo &getBlockInfo(size_t block) const {
+    return this->_index[block];
+  }
+
+  /**
+   * @brief finds the first block that may hold a timestamp.
+   * @param timestamp_us the timestamp to look for.
+   * @return the first block whose last timestamp is not before timestamp_us,
+   * or blockCount() if every sample is older.
+   */
+  size_t findBlock(uint64_t timestamp_us) const {
+    size_t low = 0;
+    size_t high = this->_index.size();
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (this->_index[mid].last_timestamp < timestamp_us) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return low;
+  }
+
+  /**
+   * @brief decodes a block.
+   * @param block the index of the block.
+   * @param out the block to decode into, reusing its allocations.
+   * @return false if the block is out of range or malformed, true otherwise.
+   */
+  bool decode(size_t block, ArchiveBlock &out) const {
+    if (block >= this->_index.size()) {
+      return false;
+    }
+    const ArchiveBlockInfo &info = this->_index[block];
+    return decodeBlock(this->_file.data() + info.offset, info.length,
+                       this->_has_estimate, out) &&
+           out.size() == info.sample_count;
+  }
+
+  /**
+   * @brief asks the kernel to start reading a block in.
+   * @param block the index of the block.
+   */
+  void prefetch(size_t block) const {
+    if (block < this->_index.size()) {
+      this->_file.advise(this->_index[block].offset,
+                         this->_index[block].length, MADV_WILLNEED);
+    }
+  }
+
+private:
+  /**
+   * @brief validates the header and footer and loads the block index.
+   * @return NULL if the archive is valid, a description of the problem
+   * otherwise.
+   */
+  const char *loadIndex() {
+    const uint8_t *data = this->_file.data();
+    const size_t size = this->_file.size();
+    if (size < kArchiveV1HeaderLength + kArchiveFooterLength ||
+        memcmp(data, kArchiveMagic, sizeof(kArchiveMagic)) != 0) {
+      return "not an IMU archive";
+    }
+    uint16_t version = telemetry::getU16(data + 8);
+    if (version == 1) {
+      this->_header_length = kArchiveV1HeaderLength;
+      this->_calibration = filters::SensorCalibration<double>::nominal();
+    } else if (version == kArchiveVersion) {
+      this->_header_length = kArchiveHeaderLength;
+      if (size < kArchiveHeaderLength + kArchiveFooterLength) {
+        return "not an IMU archive";
+      }
+      this->_calibration = filters::SensorCalibration<double>(
+          filters::AffineCalibration<double>::fromScale(getF64(data + 24)),
+          filters::AffineCalibration<double>::fromScale(getF64(data + 32)),
+          filters::AffineCalibration<double>::fromScale(getF64(data + 40)));
+    } else {
+      return "unsupported archive version";
+    }
+    this->_has_estimate =
+        (telemetry::getU16(data + 10) & kArchiveHasEstimate) != 0;
+    this->_sample_rate_hz = getF64(data + 16);
+
+    const uint8_t *footer = data + size - kArchiveFooterLength;
+    if (telemetry::getU32(footer + 12) != kArchiveFooterMagic) {
+      return "archive was not closed";
+    }
+    uint64_t index_offset = getU64(footer);
+    uint32_t block_count = telemetry::getU32(footer + 8);
+    if (index_offset < this->_header_length ||
+        index_offset + (uint64_t)block_count * kArchiveIndexEntryLength !=
+            size - kArchiveFooterLength) {
+      return "archive index is corrupt";
+    }
+
+    this->_index.resize(block_count);
+    for (uint32_t i = 0; i < block_count; i++) {
+      const uint8_t *entry = data + index_offset + i * kArchiveIndexEntryLength;
+      ArchiveBlockInfo &info = this->_index[i];
+      info.offset = getU64(entry);
+      info.length = telemetry::getU32(entry + 8);
+      info.sample_count = telemetry::getU32(entry + 12);
+      info.first_sample = getU64(entry + 16);
+      info.first_timestamp = getU64(entry + 24);
+      info.last_timestamp = getU64(entry + 32);
+      if (info.offset < this->_header_length ||
+          info.offset + info.length > index_offset ||
+          info.first_sample != this->_sample_count) {
+        return "archive index is corrupt";
+      }
+      this->_sample_count += info.sample_count;
+    }
+    return NULL;
+  }
+
+  MappedFile _file;
+  const char *_error;
+  bool _has_estimate;
+  double _sample_rate_hz;
+  filters::SensorCalibration<double> _calibration;
+  size_t _header_length;
+  uint64_t _sample_count;
+  std::vector<ArchiveBlockInfo> _index;
+}; // end ImuArchiveReader class
+
+/**
+ * @brief a sample source streaming a time range of an open archive, for use
+ * with BasicSensorManager. Blocks are decoded one at a time while the next
+ * one is prefetched.
+ */
+class ImuArchiveSensorSource {
+public:
+  /**
+   * @brief constructor for ImuArchiveSensorSource class.
+   * @param reader the open archive to replay.
+   * @param start_us the first timestamp to replay.
+   * @param end_us the last timestamp to replay.
+   */
+  ImuArchiveSensorSource(const ImuArchiveReader &reader, uint64_t start_us = 0,
+                         uint64_t end_us = UINT64_MAX)
+      : _reader(reader) {
+    this->_end_us = end_us;
+    this->_next_block = reader.findBlock(start_us);
+    this->_next = 0;
+    this->_block.clear();
+
+    // skip the samples of the first block that precede the range
+    if (this->loadBlock()) {
+      while (this->_next < this->_block.size() &&
+             this->_block.timestamp_us[this->_next] < start_us) {
+        this->_next++;
+      }
+    }
+  }
+
+  /**
+   * @brief reads the next sample of the range.
+   * @param sample the sample to fill. The estimate is not part of an
+   * AcquiredSample and is dropped.
+   * @return false at the end of the range, true otherwise.
+   */
+  bool read(filters::AcquiredSample &sample) {
+    if (this->_next >= this->_block.size() && !this->loadBlock()) {
+      return false;
+    }
+    if (this->_block.timestamp_us[this->_next] > this->_end_us) {
+      return false;
+    }
+
+    ArchiveSample decoded;
+    this->_block.get(this->_next, decoded);
+    sample.sequence = (uint32_t)(
+        this->_reader.getBlockInfo(this->_next_block - 1).first_sample +
+        this->_next);
+    sample.raw = decoded.raw;
+    sample.ground_truth = decoded.ground_truth;
+    this->_next++;
+    return true;
+  }
+
+private:
+  /**
+   * @brief decodes the next block and prefetches the one after it.
+   * @return false at the end of the archive or on a malformed block, true
+   * otherwise.
+   */
+  bool loadBlock() {
+    if (!this->_reader.decode(this->_next_block, this->_block)) {
+      this->_block.clear();
+      return false;
+    }
+    this->_next_block++;
+    this->_next = 0;
+    this->_reader.prefetch(this->_next_block);
+    return this->_block.size() > 0;
+  }
+
+  const ImuArchiveReader &_reader;
+  uint64_t _end_us;
+  size_t _next_block;
+  size_t _next;
+  ArchiveBlock _block;
+}; // end ImuArchiveSensorSource class
+} // namespace imulog
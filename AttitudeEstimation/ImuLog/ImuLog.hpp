@@ -0,0 +1,311 @@
+#pragma once
+
+#include "../EstimationAlgs/SensorSample.hpp"
+#include "../SensorDriver/Calibration.hpp"
+#include "../SensorDriver/Records.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace imulog {
+
+/**
+ * @brief the binary IMU log layout. A log is a 64 byte header followed by
+ * header.record_count fixed size LoggedSample records, stored in host byte
+ * order. Records start 64 bytes into the file and are 48 bytes each, so a
+ * memory mapped log hands out 16 byte aligned records that can be used in
+ * place.
+ */
+static const char kMagic[8] = {'I', 'M', 'U', 'L', 'O', 'G', '\r', '\n'};
+static const uint16_t kVersion = 1;
+static const uint32_t kByteOrderMark = 0x01020304;
+static const uint8_t kNoFilter = 0xFF;
+
+/**
+ * @brief the log header, describing the units, rate and filter of a
+ * recording.
+ */
+struct ImuLogHeader {
+  char magic[8];            // kMagic
+  uint16_t version;         // kVersion
+  uint16_t header_size;     // sizeof(ImuLogHeader)
+  uint16_t record_size;     // sizeof(LoggedSample)
+  uint8_t filter;           // available_filters_t in use, or kNoFilter
+  uint8_t reserved0;        // zero
+  double sample_rate_hz;    // nominal sample rate
+  double acc_lsb_to_si;     // accelerometer scale (m/s^2 per LSB)
+  double gyro_lsb_to_si;    // gyroscope scale (rad/s per LSB)
+  double mag_lsb_to_si;     // magnetometer scale (nT per LSB)
+  uint64_t record_count;    // number of records following the header
+  uint32_t byte_order_mark; // kByteOrderMark as written by the recorder
+  uint32_t reserved1;       // zero
+};
+
+/**
+ * @brief a single log record: the raw sample exactly as the filter stage
+ * consumes it, followed by the ground truth quaternion.
+ */
+struct LoggedSample {
+  filters::RawSensorSample raw; // raw sensor readings and timestamp
+  float ground_truth[4];        // ground truth quaternion <W, X, Y, Z>
+};
+
+static_assert(sizeof(ImuLogHeader) == 64, "ImuLogHeader must be 64 bytes");
+static_assert(sizeof(LoggedSample) == 48, "LoggedSample must be 48 bytes");
+static_assert(sizeof(ImuLogHeader) % alignof(LoggedSample) == 0,
+              "records must stay aligned after the header");
+
+/**
+ * @brief a non-owning view of a contiguous run of values.
+ * @tparam T the value type.
+ */
+template <typename T> struct Span {
+  T *data;
+  size_t size;
+
+  T *begin() const { return this->data; }
+  T *end() const { return this->data + this->size; }
+  T &operator[](size_t i) const { return this->data[i]; }
+  bool empty() const { return this->size == 0; }
+};
+
+/**
+ * @brief builds a header describing a recording made with the nominal
+ * sensor sensitivities.
+ * @param sample_rate_hz the nominal sample rate in Hz.
+ * @param filter the filter in use, or kNoFilter.
+ * @return the resulting header, with a record count of zero.
+ */
+inline ImuLogHeader makeHeader(double sample_rate_hz,
+                               uint8_t filter = kNoFilter) {
+  ImuLogHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.header_size = sizeof(ImuLogHeader);
+  header.record_size = sizeof(LoggedSample);
+  header.filter = filter;
+  header.sample_rate_hz = sample_rate_hz;
+  header.acc_lsb_to_si = EARTH_G_MSS / ACCEL_SENSITIVITY;
+  header.gyro_lsb_to_si = DEG_TO_RAD_SCALE / GYRO_SENSITIVITY;
+  header.mag_lsb_to_si = UT_TO_NT_SCALE / MAG_SENSITIVITY;
+  header.byte_order_mark = kByteOrderMark;
+  return header;
+}
+
+/**
+ * @brief builds a header describing a recording made with a calibration.
+ * The header holds one scale per sensor, so each transform is reduced to
+ * its X axis scale, which is exact for scale-only calibrations such as
+ * headerCalibration() builds.
+ * @param sample_rate_hz the nominal sample rate in Hz.
+ * @param calibration the calibration converting the raw samples to SI units.
+ * @param filter the filter in use, or kNoFilter.
+ * @return the resulting header, with a record count of zero.
+ */
+inline ImuLogHeader
+makeHeader(double sample_rate_hz,
+           const filters::SensorCalibration<double> &calibration,
+           uint8_t filter = kNoFilter) {
+  ImuLogHeader header = makeHeader(sample_rate_hz, filter);
+  header.acc_lsb_to_si = calibration.getAccCalibration().getValue(0, 0);
+  header.gyro_lsb_to_si = calibration.getGyroCalibration().getValue(0, 0);
+  header.mag_lsb_to_si = calibration.getMagCalibration().getValue(0, 0);
+  return header;
+}
+
+/**
+ * @brief checks that a header describes a log this build can read in place.
+ * @param header the header to check.
+ * @return NULL if the header is valid, a description of the problem
+ * otherwise.
+ */
+inline const char *validateHeader(const ImuLogHeader &header) {
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    return "not an IMU log";
+  }
+  if (header.byte_order_mark != kByteOrderMark) {
+    return "log was recorded with a different byte order";
+  }
+  if (header.version != kVersion) {
+    return "unsupported log version";
+  }
+  if (header.header_size != sizeof(ImuLogHeader) ||
+      header.record_size != sizeof(LoggedSample)) {
+    return "unexpected header or record size";
+  }
+  return NULL;
+}
+
+/**
+ * @brief builds the calibration converting logged raw samples to SI units.
+ * @param header the log header.
+ * @return the scale-only calibration described by the header.
+ */
+inline filters::SensorCalibration<double>
+headerCalibration(const ImuLogHeader &header) {
+  return filters::SensorCalibration<double>(
+      filters::AffineCalibration<double>::fromScale(header.acc_lsb_to_si),
+      filters::AffineCalibration<double>::fromScale(header.gyro_lsb_to_si),
+      filters::AffineCalibration<double>::fromScale(header.mag_lsb_to_si));
+}
+
+/**
+ * @brief converts an acquired sample to a log record.
+ * @param sample the acquired sample.
+ * @param record the record to fill. Padding bytes are zeroed so logs are
+ * reproducible byte for byte.
+ */
+inline void toLoggedSample(const filters::AcquiredSample &sample,
+                           LoggedSample &record) {
+  memset(&record, 0, sizeof(record));
+  for (size_t axis = 0; axis < 3; axis++) {
+    record.raw.acc[axis] = sample.raw.acc[axis];
+    record.raw.gyro[axis] = sample.raw.gyro[axis];
+    record.raw.mag[axis] = sample.raw.mag[axis];
+  }
+  record.raw.timestamp_us = sample.raw.timestamp_us;
+  record.ground_truth[0] = (float)sample.ground_truth.getW();
+  record.ground_truth[1] = (float)sample.ground_truth.getX();
+  record.ground_truth[2] = (float)sample.ground_truth.getY();
+  record.ground_truth[3] = (float)sample.ground_truth.getZ();
+}
+
+/**
+ * @brief converts a log record back to an acquired sample.
+ * @param record the log record.
+ * @param sample the sample to fill. The sequence number is left untouched.
+ */
+inline void fromLoggedSample(const LoggedSample &record,
+                             filters::AcquiredSample &sample) {
+  sample.raw = record.raw;
+  sample.ground_truth = structures::Quaternion<double>(
+      record.ground_truth[1], record.ground_truth[2], record.ground_truth[3],
+      record.ground_truth[0]);
+}
+
+/**
+ * @brief calibrates a run of log records in place in the mapping, without
+ * copying the raw samples out first.
+ * @param calibration the calibration to apply, such as
+ * headerCalibration(header).
+ * @param records the records to calibrate.
+ * @param out pointer to records.size calibrated samples.
+ */
+inline void
+calibrateRecords(const filters::SensorCalibration<double> &calibration,
+                 Span<const LoggedSample> records,
+                 filters::SensorSample<double> *out) {
+  for (size_t i = 0; i < records.size; i++) {
+    calibration.apply(records[i].raw, out[i]);
+  }
+}
+
+/**
+ * @brief writes an IMU log through stdio buffering. The record count in the
+ * header is filled in when the log is closed.
+ */
+class ImuLogWriter {
+public:
+  /**
+   * @brief default constructor for ImuLogWriter class.
+   */
+  ImuLogWriter() {
+    this->_file = NULL;
+    this->_record_count = 0;
+  }
+
+  ImuLogWriter(const ImuLogWriter &other) = delete;
+  ImuLogWriter &operator=(const ImuLogWriter &other) = delete;
+
+  /**
+   * @brief destructor for ImuLogWriter class. Closes the log if open.
+   */
+  ~ImuLogWriter() { this->close(); }
+
+  /**
+   * @brief creates a log file and writes its header.
+   * @param path the path of the log to create.
+   * @param header the header to write. The record count is ignored.
+   * @return true if the log was created, false otherwise.
+   */
+  bool open(const char *path, const ImuLogHeader &header) {
+    this->close();
+    this->_file = fopen(path, "wb");
+    if (this->_file == NULL) {
+      return false;
+    }
+
+    this->_header = header;
+    this->_header.record_count = 0;
+    this->_record_count = 0;
+    return fwrite(&this->_header, sizeof(this->_header), 1, this->_file) == 1;
+  }
+
+  /**
+   * @brief appends one record.
+   * @param record the record to append.
+   * @return true if the record was written, false otherwise.
+   */
+  bool write(const LoggedSample &record) {
+    return this->write(&record, 1) == 1;
+  }
+
+  /**
+   * @brief appends one acquired sample.
+   * @param sample the sample to append.
+   * @return true if the sample was written, false otherwise.
+   */
+  bool write(const filters::AcquiredSample &sample) {
+    LoggedSample record;
+    toLoggedSample(sample, record);
+    return this->write(record);
+  }
+
+  /**
+   * @brief appends a batch of records.
+   * @param records pointer to count records.
+   * @param count the number of records.
+   * @return the number of records written.
+   */
+  size_t write(const LoggedSample *records, size_t count) {
+    if (this->_file == NULL) {
+      return 0;
+    }
+    size_t written = fwrite(records, sizeof(LoggedSample), count, this->_file);
+    this->_record_count += written;
+    return written;
+  }
+
+  /**
+   * @brief writes the final record count into the header and closes the
+   * log.
+   * @return true if the log was finalized, false otherwise.
+   */
+  bool close() {
+    if (this->_file == NULL) {
+      return false;
+    }
+
+    this->_header.record_count = this->_record_count;
+    bool ok = fseek(this->_file, 0, SEEK_SET) == 0 &&
+              fwrite(&this->_header, sizeof(this->_header), 1,
+                     this->_file) == 1;
+    ok = (fclose(this->_file) == 0) && ok;
+    this->_file = NULL;
+    return ok;
+  }
+
+  /**
+   * @brief returns the number of records written so far.
+   * @return the number of records written so far.
+   */
+  uint64_t getRecordCount() const { return this->_record_count; }
+
+private:
+  FILE *_file;
+  ImuLogHeader _header;
+  uint64_t _record_count;
+}; // end ImuLogWriter class
+} // namespace imulog
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "ImuLog.hpp"
+#include "MappedFile.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+namespace imulog {
+
+/**
+ * @brief a memory mapped, zero-copy IMU log reader. Records are handed out
+ * as spans pointing straight into the mapping, so a multi-GB log is
+ * processed out-of-core with the kernel paging records in ahead of the
+ * reader and dropping them behind it.
+ */
+class ImuLogReader {
+public:
+  /**
+   * @brief default constructor for ImuLogReader class.
+   */
+  ImuLogReader() {
+    this->_records = NULL;
+    this->_record_count = 0;
+    this->_error = NULL;
+  }
+
+  ImuLogReader(const ImuLogReader &other) = delete;
+  ImuLogReader &operator=(const ImuLogReader &other) = delete;
+
+  /**
+   * @brief maps a log file and validates its header.
+   * @param path the path of the log to open.
+   * @return true if the log was opened, false otherwise. See getError().
+   */
+  bool open(const char *path) {
+    this->close();
+
+    this->_error = this->_file.open(path);
+    if (this->_error == NULL && this->_file.size() < sizeof(ImuLogHeader)) {
+      this->_error = "log is shorter than its header";
+    }
+    if (this->_error == NULL) {
+      this->_error = validateHeader(this->getHeader());
+    }
+    if (this->_error != NULL) {
+      this->close();
+      return false;
+    }
+
+    // a log that was not closed cleanly still exposes every whole record
+    size_t available =
+        (this->_file.size() - sizeof(ImuLogHeader)) / sizeof(LoggedSample);
+    uint64_t count = this->getHeader().record_count;
+    this->_record_count = (count == 0 || count > available) ? available : count;
+    this->_records =
+        (const LoggedSample *)(this->_file.data() + sizeof(ImuLogHeader));
+
+    this->_file.advise(0, this->_file.size(), MADV_SEQUENTIAL);
+    return true;
+  }
+
+  /**
+   * @brief unmaps the log.
+   */
+  void close() {
+    this->_file.close();
+    this->_records = NULL;
+    this->_record_count = 0;
+  }
+
+  /**
+   * @brief checks if a log is open.
+   * @return true if a log is open, false otherwise.
+   */
+  bool isOpen() const { return this->_file.data() != NULL; }
+
+  /**
+   * @brief returns why the last open() failed.
+   * @return a description of the last error, or NULL.
+   */
+  const char *getError() const { return this->_error; }
+
+  /**
+   * @brief returns the log header. Only valid while the log is open.
+   * @return the log header.
+   */
+  const ImuLogHeader &getHeader() const {
+    return *(const ImuLogHeader *)this->_file.data();
+  }
+
+  /**
+   * @brief returns the number of records in the log.
+   * @return the number of records in the log.
+   */
+  size_t size() const { return this->_record_count; }
+
+  /**
+   * @brief returns every record in the log.
+   * @return a span over every record in the log.
+   */
+  Span<const LoggedSample> records() const {
+    Span<const LoggedSample> span = {this->_records, this->_record_count};
+    return span;
+  }
+
+  /**
+   * @brief returns a run of records, clamped to the end of the log.
+   * @param first the index of the first record.
+   * @param count the maximum number of records.
+   * @return a span over the requested records.
+   */
+  Span<const LoggedSample> records(size_t first, size_t count) const {
+    if (first > this->_record_count) {
+      first = this->_record_count;
+    }
+    if (count > this->_record_count - first) {
+      count = this->_record_count - first;
+    }
+    Span<const LoggedSample> span = {this->_records + first, count};
+    return span;
+  }
+
+  /**
+   * @brief asks the kernel to start reading a run of records in.
+   * @param first the index of the first record.
+   * @param count the number of records.
+   */
+  void prefetch(size_t first, size_t count) const {
+    this->advise(first, count, MADV_WILLNEED);
+  }
+
+  /**
+   * @brief tells the kernel a run of records will not be read again, so
+   * their pages can be dropped instead of growing the resident set.
+   * @param first the index of the first record.
+   * @param count the number of records.
+   */
+  void release(size_t first, size_t count) const {
+    this->advise(first, count, MADV_DONTNEED);
+  }
+
+private:
+  /**
+   * @brief applies an madvise hint to the pages holding a run of records.
+   * @param first the index of the first record.
+   * @param count the number of records.
+   * @param advice the madvise advice.
+   */
+  void advise(size_t first, size_t count, int advice) const {
+    Span<const LoggedSample> span = this->records(first, count);
+    this->_file.advise(
+        (size_t)((const uint8_t *)span.begin() - this->_file.data()),
+        span.size * sizeof(LoggedSample), advice);
+  }
+
+  MappedFile _file;
+  const LoggedSample *_records;
+  size_t _record_count;
+  const char *_error;
+}; // end ImuLogReader class
+
+/**
+ * @brief walks a log in fixed size chunks, prefetching the chunk after the
+ * one handed out and releasing the chunk before it.
+ */
+class ImuLogChunker {
+public:
+  /**
+   * @brief constructor for ImuLogChunker class.
+   * @param reader the open log to walk.
+   * @param chunk_records the number of records per chunk.
+   * @param release_behind true to drop pages once they have been handed out
+   * and the next chunk is requested, keeping the resident set flat.
+   */
+  ImuLogChunker(const ImuLogReader &reader, size_t chunk_records,
+                bool release_behind = true)
+      : _reader(reader) {
+    this->_chunk_records = chunk_records > 0 ? chunk_records : 1;
+    this->_release_behind = release_behind;
+    this->_next = 0;
+    this->_reader.prefetch(0, this->_chunk_records);
+  }
+
+  /**
+   * @brief returns the next chunk of records.
+   * @param chunk the span to point at the next chunk.
+   * @return false once every record was handed out, true otherwise.
+   */
+  bool next(Span<const LoggedSample> &chunk) {
+    if (this->_release_behind && this->_next >= this->_chunk_records) {
+      this->_reader.release(this->_next - this->_chunk_records,
+                            this->_chunk_records);
+    }
+
+    chunk = this->_reader.records(this->_next, this->_chunk_records);
+    if (chunk.empty()) {
+      return false;
+    }
+
+    this->_next += chunk.size;
+    this->_reader.prefetch(this->_next, this->_chunk_records);
+    return true;
+  }
+
+private:
+  const ImuLogReader &_reader;
+  size_t _chunk_records;
+  bool _release_behind;
+  size_t _next;
+}; // end ImuLogChunker class
+
+/**
+ * @brief a sample source replaying an open log, for use with
+ * BasicSensorManager.
+ */
+class ImuLogSensorSource {
+public:
+  /**
+   * @brief constructor for ImuLogSensorSource class.
+   * @param reader the open log to replay.
+   */
+  ImuLogSensorSource(const ImuLogReader &reader) : _reader(reader) {
+    this->_next = 0;
+  }
+
+  /**
+   * @brief reads the next record of the log.
+   * @param sample the sample to fill.
+   * @return false at the end of the log, true otherwise.
+   */
+  bool read(filters::AcquiredSample &sample) {
+    if (this->_next >= this->_reader.size()) {
+      return false;
+    }
+    fromLoggedSample(this->_reader.records()[this->_next++], sample);
+    return true;
+  }
+
+private:
+  const ImuLogReader &_reader;
+  size_t _next;
+}; // end ImuLogSensorSource class
+} // namespace imulog
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace imulog {
+
+/**
+ * @brief a read-only memory mapping of a whole file.
+ */
+class MappedFile {
+public:
+  /**
+   * @brief default constructor for MappedFile class.
+   */
+  MappedFile() {
+    this->_data = NULL;
+    this->_size = 0;
+  }
+
+  MappedFile(const MappedFile &other) = delete;
+  MappedFile &operator=(const MappedFile &other) = delete;
+
+  /**
+   * @brief destructor for MappedFile class. Unmaps the file if mapped.
+   */
+  ~MappedFile() { this->close(); }
+
+  /**
+   * @brief maps a file.
+   * @param path the path of the file to map.
+   * @return NULL if the file was mapped, a description of the problem
+   * otherwise.
+   */
+  const char *open(const char *path) {
+    this->close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return "could not open file";
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+      ::close(fd);
+      return "file is empty";
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    void *mapping =
+        mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      return "could not map file";
+    }
+
+    this->_data = (const uint8_t *)mapping;
+    this->_size = (size_t)info.st_size;
+    return NULL;
+  }
+
+  /**
+   * @brief unmaps the file.
+   */
+  void close() {
+    if (this->_data != NULL) {
+      munmap((void *)this->_data, this->_size);
+    }
+    this->_data = NULL;
+    this->_size = 0;
+  }
+
+  /**
+   * @brief applies an madvise hint to a byte range of the mapping, widened
+   * to whole pages.
+   * @param offset the offset of the first byte.
+   * @param len the number of bytes.
+   * @param advice the madvise advice.
+   */
+  void advise(size_t offset, size_t len, int advice) const {
+    if (this->_data == NULL || len == 0 || offset >= this->_size) {
+      return;
+    }
+    if (len > this->_size - offset) {
+      len = this->_size - offset;
+    }
+
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = offset - offset % page;
+    madvise((void *)(this->_data + begin), offset + len - begin, advice);
+  }
+
+  /**
+   * @brief returns the mapped bytes.
+   * @return the mapped bytes, or NULL if nothing is mapped.
+   */
+  const uint8_t *data() const { return this->_data; }
+
+  /**
+   * @brief returns the mapped length.
+   * @return the mapped length in bytes.
+   */
+  size_t size() const { return this->_size; }
+
+private:
+  const uint8_t *_data;
+  size_t _size;
+}; // end MappedFile class
+} // namespace imulog
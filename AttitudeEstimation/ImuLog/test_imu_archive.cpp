@@ -0,0 +1,324 @@
+#include "../SensorDriver/SensorSources.hpp"
+#include "ImuArchive.hpp"
+#include "ImuArchiveReader.hpp"
+#include "ImuLog.hpp"
+#include "ImuLogReader.hpp"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+using namespace imulog;
+using namespace filters;
+
+/**
+ * @brief a temporary archive path, removed when the test ends.
+ */
+class TempArchive {
+public:
+  TempArchive() {
+    char path[] = "/tmp/test_imu_archive_XXXXXX";
+    int fd = mkstemp(path);
+    ::close(fd);
+    this->path = path;
+  }
+
+  ~TempArchive() { unlink(this->path.c_str()); }
+
+  std::string path;
+};
+
+/**
+ * @brief writes a synthetic recording to an archive, with the ground truth
+ * rotated about Z standing in for a filter estimate.
+ */
+std::vector<ArchiveSample> writeSyntheticArchive(const char *path,
+                                                 uint64_t num_samples) {
+  const double body_rate[3] = {0.2, -0.1, 0.4};
+  SyntheticSensorSource source(num_samples, 200.0, body_rate);
+  ImuArchiveWriter writer;
+  EXPECT_TRUE(writer.open(path, 200.0, true));
+
+  const structures::Quaternion<double> offset(0, 0, sin(0.05), cos(0.05));
+  std::vector<ArchiveSample> written;
+  AcquiredSample acquired;
+  while (source.read(acquired)) {
+    ArchiveSample sample;
+    sample.raw = acquired.raw;
+    sample.ground_truth = acquired.ground_truth;
+    sample.estimate = acquired.ground_truth * offset;
+    EXPECT_TRUE(writer.write(sample));
+    written.push_back(sample);
+  }
+  EXPECT_TRUE(writer.close());
+  return written;
+}
+
+/**
+ * @brief checks two quaternions describe the same rotation.
+ */
+void expectSameRotation(const structures::Quaternion<double> &expected,
+                        const structures::Quaternion<double> &actual) {
+  double dot = expected.getW() * actual.getW() +
+               expected.getX() * actual.getX() +
+               expected.getY() * actual.getY() +
+               expected.getZ() * actual.getZ();
+  EXPECT_NEAR(1.0, fabs(dot), 1e-8);
+}
+
+TEST(ImuArchiveTesting, TestVarintCodec) {
+  const int64_t values[] = {0,         1,         -1,    63,     -64,
+                            64,        -65,       32767, -32768, 65535,
+                            -65535,    INT64_MAX, INT64_MIN};
+  std::vector<uint8_t> encoded;
+  for (int64_t value : values) {
+    putVarint(encoded, zigzagEncode(value));
+  }
+  // small magnitudes of either sign take a single byte
+  ASSERT_EQ(0, encoded[0]);
+  ASSERT_EQ(0x7F, encoded[4]);
+
+  const uint8_t *in = encoded.data();
+  const uint8_t *end = in + encoded.size();
+  for (int64_t value : values) {
+    uint64_t decoded;
+    in = getVarint(in, end, decoded);
+    ASSERT_NE((const uint8_t *)NULL, in);
+    ASSERT_EQ(value, zigzagDecode(decoded));
+  }
+  ASSERT_EQ(end, in);
+
+  // a truncated varint is rejected
+  uint64_t decoded;
+  ASSERT_EQ((const uint8_t *)NULL,
+            getVarint(encoded.data() + encoded.size() - 1,
+                      encoded.data() + encoded.size() - 1, decoded));
+  const uint8_t unterminated[2] = {0x80, 0x80};
+  ASSERT_EQ((const uint8_t *)NULL,
+            getVarint(unterminated, unterminated + 2, decoded));
+}
+
+TEST(ImuArchiveTesting, TestDeltaColumnCodec) {
+  // noise, outliers and the extremes of the type all round trip
+  std::vector<int16_t> values(1000);
+  uint32_t state = 12345;
+  for (size_t i = 0; i < values.size(); i++) {
+    state = state * 1103515245 + 12345;
+    values[i] = (int16_t)(1000 + (int)(state >> 16) % 50);
+  }
+  values[10] = INT16_MIN;
+  values[11] = INT16_MAX;
+  values[999] = INT16_MIN;
+  std::vector<uint8_t> encoded;
+  encodeDeltaColumn(values.data(), values.size(), encoded);
+  std::vector<int16_t> decoded(values.size());
+  ASSERT_TRUE(decodeDeltaColumn(encoded.data(),
+                                encoded.data() + encoded.size(),
+                                decoded.size(), decoded.data()));
+  ASSERT_EQ(values, decoded);
+  // the outliers are patched rather than widening every value
+  ASSERT_LT(encoded.size(), values.size());
+
+  // a column that is one byte short or long is rejected
+  ASSERT_FALSE(decodeDeltaColumn(encoded.data(),
+                                 encoded.data() + encoded.size() - 1,
+                                 decoded.size(), decoded.data()));
+  encoded.push_back(0);
+  ASSERT_FALSE(decodeDeltaColumn(encoded.data(),
+                                 encoded.data() + encoded.size(),
+                                 decoded.size(), decoded.data()));
+
+  // a constant rate timestamp column packs to a few bytes
+  std::vector<uint64_t> timestamps(4096);
+  for (size_t i = 0; i < timestamps.size(); i++) {
+    timestamps[i] = 1700000000000000ULL + i * 5000;
+  }
+  encoded.clear();
+  encodeDeltaColumn(timestamps.data(), timestamps.size(), encoded);
+  ASSERT_GT(16U, encoded.size());
+  std::vector<uint64_t> decoded_timestamps(timestamps.size());
+  ASSERT_TRUE(decodeDeltaColumn(encoded.data(),
+                                encoded.data() + encoded.size(),
+                                decoded_timestamps.size(),
+                                decoded_timestamps.data()));
+  ASSERT_EQ(timestamps, decoded_timestamps);
+}
+
+TEST(ImuArchiveTesting, TestRoundTrip) {
+  TempArchive archive;
+  std::vector<ArchiveSample> written =
+      writeSyntheticArchive(archive.path.c_str(), 10001);
+
+  ImuArchiveReader reader;
+  ASSERT_TRUE(reader.open(archive.path.c_str())) << reader.getError();
+  ASSERT_EQ(10001U, reader.size());
+  ASSERT_EQ(3U, reader.blockCount());
+  ASSERT_TRUE(reader.hasEstimate());
+  ASSERT_DOUBLE_EQ(200.0, reader.getSampleRate());
+  ASSERT_EQ(SensorCalibration<double>::nominal()
+                .getGyroCalibration()
+                .getValue(0, 0),
+            reader.getCalibration().getGyroCalibration().getValue(0, 0));
+
+  // the raw readings are lossless, the quaternions are quantized
+  ArchiveBlock block;
+  size_t total = 0;
+  for (size_t b = 0; b < reader.blockCount(); b++) {
+    ASSERT_TRUE(reader.decode(b, block));
+    ASSERT_EQ(total, reader.getBlockInfo(b).first_sample);
+    for (size_t i = 0; i < block.size(); i++, total++) {
+      ArchiveSample sample;
+      block.get(i, sample);
+      const RawSensorSample &raw = written[total].raw;
+      ASSERT_EQ(raw.timestamp_us, sample.raw.timestamp_us);
+      for (int axis = 0; axis < 3; axis++) {
+        ASSERT_EQ(raw.acc[axis], sample.raw.acc[axis]);
+        ASSERT_EQ(raw.gyro[axis], sample.raw.gyro[axis]);
+        ASSERT_EQ(raw.mag[axis], sample.raw.mag[axis]);
+      }
+      expectSameRotation(written[total].ground_truth, sample.ground_truth);
+      expectSameRotation(written[total].estimate, sample.estimate);
+    }
+  }
+  ASSERT_EQ(written.size(), total);
+
+  // well under the 48 bytes per sample of the uncompressed log
+  ASSERT_LT(reader.byteSize(), 10U * written.size());
+}
+
+TEST(ImuArchiveTesting, TestTimeRange) {
+  TempArchive archive;
+  std::vector<ArchiveSample> written =
+      writeSyntheticArchive(archive.path.c_str(), 10001);
+  ImuArchiveReader reader;
+  ASSERT_TRUE(reader.open(archive.path.c_str()));
+
+  // a range starting in the second block only decodes from there on
+  uint64_t start_us = written[5000].raw.timestamp_us;
+  uint64_t end_us = written[9000].raw.timestamp_us;
+  ASSERT_EQ(1U, reader.findBlock(start_us));
+  ASSERT_EQ(0U, reader.findBlock(0));
+  ASSERT_EQ(reader.blockCount(), reader.findBlock(UINT64_MAX));
+
+  ImuArchiveSensorSource source(reader, start_us, end_us);
+  AcquiredSample sample;
+  uint32_t expected = 5000;
+  while (source.read(sample)) {
+    ASSERT_EQ(expected, sample.sequence);
+    ASSERT_EQ(written[expected].raw.timestamp_us, sample.raw.timestamp_us);
+    expected++;
+  }
+  ASSERT_EQ(9001U, expected);
+
+  // the whole archive streams in order
+  ImuArchiveSensorSource all(reader);
+  size_t replayed = 0;
+  while (all.read(sample)) {
+    replayed++;
+  }
+  ASSERT_EQ(written.size(), replayed);
+}
+
+TEST(ImuArchiveTesting, TestKeepsCalibration) {
+  // a log recorded with non-nominal scales, converted to an archive with
+  // the calibration read from its header
+  TempArchive log;
+  TempArchive archive;
+  SensorCalibration<double> calibration(
+      AffineCalibration<double>::fromScale(0.0025),
+      AffineCalibration<double>::fromScale(0.0003),
+      AffineCalibration<double>::fromScale(15.0));
+  const double body_rate[3] = {0.2, -0.1, 0.4};
+  SyntheticSensorSource synthetic(500, 200.0, body_rate);
+  ImuLogWriter log_writer;
+  ASSERT_TRUE(log_writer.open(log.path.c_str(),
+                              makeHeader(200.0, calibration)));
+  AcquiredSample acquired;
+  while (synthetic.read(acquired)) {
+    ASSERT_TRUE(log_writer.write(acquired));
+  }
+  ASSERT_TRUE(log_writer.close());
+
+  ImuLogReader log_reader;
+  ASSERT_TRUE(log_reader.open(log.path.c_str()));
+  SensorCalibration<double> log_calibration =
+      headerCalibration(log_reader.getHeader());
+  ImuArchiveWriter writer;
+  ASSERT_TRUE(writer.open(archive.path.c_str(), 200.0, false,
+                          log_calibration));
+  ImuLogSensorSource records(log_reader);
+  while (records.read(acquired)) {
+    ArchiveSample sample;
+    sample.raw = acquired.raw;
+    sample.ground_truth = acquired.ground_truth;
+    ASSERT_TRUE(writer.write(sample));
+  }
+  ASSERT_TRUE(writer.close());
+
+  // the archive decodes to the same physical values as the log
+  ImuArchiveReader reader;
+  ASSERT_TRUE(reader.open(archive.path.c_str())) << reader.getError();
+  const SensorCalibration<double> &restored = reader.getCalibration();
+  ASSERT_EQ(0.0025, restored.getAccCalibration().getValue(0, 0));
+  ASSERT_EQ(0.0003, restored.getGyroCalibration().getValue(0, 0));
+  ASSERT_EQ(15.0, restored.getMagCalibration().getValue(0, 0));
+  ImuLogSensorSource expected_records(log_reader);
+  ImuArchiveSensorSource archived(reader);
+  size_t count = 0;
+  AcquiredSample expected;
+  while (archived.read(acquired)) {
+    ASSERT_TRUE(expected_records.read(expected));
+    SensorSample<double> from_log;
+    SensorSample<double> from_archive;
+    log_calibration.apply(expected.raw, from_log);
+    restored.apply(acquired.raw, from_archive);
+    for (int axis = 0; axis < 3; axis++) {
+      ASSERT_EQ(from_log.acc[axis], from_archive.acc[axis]);
+      ASSERT_EQ(from_log.gyro[axis], from_archive.gyro[axis]);
+      ASSERT_EQ(from_log.mag[axis], from_archive.mag[axis]);
+    }
+    count++;
+  }
+  ASSERT_EQ(500U, count);
+}
+
+TEST(ImuArchiveTesting, TestRejectsBadArchives) {
+  TempArchive archive;
+  ImuArchiveReader reader;
+
+  // empty
+  ASSERT_FALSE(reader.open(archive.path.c_str()));
+
+  // never closed
+  ImuArchiveWriter writer;
+  ASSERT_TRUE(writer.open(archive.path.c_str(), 100.0, false));
+  ArchiveSample sample;
+  memset(&sample.raw, 0, sizeof(sample.raw));
+  ASSERT_TRUE(writer.write(sample));
+  ASSERT_TRUE(writer.close());
+  ASSERT_TRUE(reader.open(archive.path.c_str()));
+  ASSERT_FALSE(reader.hasEstimate());
+  ASSERT_EQ(1U, reader.size());
+  size_t size = reader.byteSize();
+  reader.close();
+  ASSERT_EQ(0, truncate(archive.path.c_str(), size - kArchiveFooterLength));
+  ASSERT_FALSE(reader.open(archive.path.c_str()));
+  ASSERT_STREQ("archive was not closed", reader.getError());
+
+  // a corrupt block fails to decode rather than reading out of bounds
+  writeSyntheticArchive(archive.path.c_str(), 100);
+  FILE *file = fopen(archive.path.c_str(), "rb+");
+  fseek(file, kArchiveHeaderLength + 1, SEEK_SET);
+  fputc(0xFF, file);
+  fclose(file);
+  ASSERT_TRUE(reader.open(archive.path.c_str()));
+  ArchiveBlock block;
+  ASSERT_FALSE(reader.decode(0, block));
+  ImuArchiveSensorSource source(reader);
+  AcquiredSample acquired;
+  ASSERT_FALSE(source.read(acquired));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
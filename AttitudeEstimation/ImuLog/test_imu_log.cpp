@@ -0,0 +1,193 @@
+#include "../SensorDriver/FilterDriver.hpp"
+#include "../SensorDriver/SensorSources.hpp"
+#include "ImuLog.hpp"
+#include "ImuLogReader.hpp"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+using namespace imulog;
+using namespace filters;
+
+/**
+ * @brief a temporary log path, removed when the test ends.
+ */
+class TempLog {
+public:
+  TempLog() {
+    char path[] = "/tmp/test_imu_log_XXXXXX";
+    int fd = mkstemp(path);
+    ::close(fd);
+    this->path = path;
+  }
+
+  ~TempLog() { unlink(this->path.c_str()); }
+
+  std::string path;
+};
+
+/**
+ * @brief writes a synthetic recording to a log.
+ */
+std::vector<AcquiredSample> writeSyntheticLog(const char *path,
+                                              uint64_t num_samples) {
+  const double body_rate[3] = {0.2, -0.1, 0.4};
+  SyntheticSensorSource source(num_samples, 200.0, body_rate);
+  ImuLogWriter writer;
+  EXPECT_TRUE(writer.open(path, makeHeader(200.0, MADGWICK)));
+
+  std::vector<AcquiredSample> written;
+  AcquiredSample sample = AcquiredSample();
+  while (source.read(sample)) {
+    EXPECT_TRUE(writer.write(sample));
+    written.push_back(sample);
+  }
+  EXPECT_TRUE(writer.close());
+  return written;
+}
+
+TEST(ImuLogTesting, TestRoundTrip) {
+  TempLog log;
+  std::vector<AcquiredSample> written = writeSyntheticLog(log.path.c_str(),
+                                                          1000);
+
+  ImuLogReader reader;
+  ASSERT_TRUE(reader.open(log.path.c_str())) << reader.getError();
+  ASSERT_EQ(1000U, reader.size());
+  ASSERT_EQ(1000U, reader.getHeader().record_count);
+  ASSERT_EQ(MADGWICK, reader.getHeader().filter);
+  ASSERT_DOUBLE_EQ(200.0, reader.getHeader().sample_rate_hz);
+
+  // records are used in place, straight from the mapping
+  Span<const LoggedSample> records = reader.records();
+  ASSERT_EQ(0U, (uintptr_t)records.data % 16);
+  for (size_t i = 0; i < written.size(); i++) {
+    ASSERT_EQ(written[i].raw.timestamp_us, records[i].raw.timestamp_us);
+    ASSERT_EQ(written[i].raw.gyro[2], records[i].raw.gyro[2]);
+    ASSERT_EQ(written[i].raw.mag[0], records[i].raw.mag[0]);
+    ASSERT_FLOAT_EQ((float)written[i].ground_truth.getW(),
+                    records[i].ground_truth[0]);
+  }
+
+  // the header carries the units needed to calibrate the records
+  std::vector<SensorSample<double>> calibrated(records.size);
+  calibrateRecords(headerCalibration(reader.getHeader()), records,
+                   calibrated.data());
+  ASSERT_NEAR(EARTH_G_MSS, calibrated[0].acc[2], 0.01);
+  ASSERT_NEAR(0.4, calibrated[500].gyro[2], 0.001);
+}
+
+TEST(ImuLogTesting, TestChunkedWalk) {
+  TempLog log;
+  writeSyntheticLog(log.path.c_str(), 10001);
+
+  ImuLogReader reader;
+  ASSERT_TRUE(reader.open(log.path.c_str()));
+  ImuLogChunker chunker(reader, 1024);
+  Span<const LoggedSample> chunk;
+  size_t total = 0;
+  size_t chunks = 0;
+  uint64_t last_timestamp_us = 0;
+  while (chunker.next(chunk)) {
+    ASSERT_EQ(reader.records().data + total, chunk.data);
+    for (const LoggedSample &record : chunk) {
+      ASSERT_TRUE(total == 0 || record.raw.timestamp_us > last_timestamp_us);
+      last_timestamp_us = record.raw.timestamp_us;
+      total++;
+    }
+    chunks++;
+  }
+  ASSERT_EQ(10001U, total);
+  ASSERT_EQ(10U, chunks);
+
+  // the source adapter replays the same records
+  ImuLogSensorSource source(reader);
+  AcquiredSample sample = AcquiredSample();
+  size_t replayed = 0;
+  while (source.read(sample)) {
+    replayed++;
+  }
+  ASSERT_EQ(10001U, replayed);
+  ASSERT_EQ(last_timestamp_us, sample.raw.timestamp_us);
+}
+
+TEST(ImuLogTesting, TestRejectsBadLogs) {
+  TempLog log;
+  ImuLogReader reader;
+
+  // too short
+  ASSERT_FALSE(reader.open(log.path.c_str()));
+  ASSERT_FALSE(reader.isOpen());
+
+  // wrong magic
+  FILE *file = fopen(log.path.c_str(), "wb");
+  ImuLogHeader header = makeHeader(100.0);
+  header.magic[0] = 'X';
+  fwrite(&header, sizeof(header), 1, file);
+  fclose(file);
+  ASSERT_FALSE(reader.open(log.path.c_str()));
+  ASSERT_STREQ("not an IMU log", reader.getError());
+
+  // a log that was never closed still exposes its whole records
+  file = fopen(log.path.c_str(), "wb");
+  header = makeHeader(100.0);
+  fwrite(&header, sizeof(header), 1, file);
+  LoggedSample record;
+  memset(&record, 0, sizeof(record));
+  fwrite(&record, sizeof(record), 1, file);
+  fwrite(&record, sizeof(record) / 2, 1, file);
+  fclose(file);
+  ASSERT_TRUE(reader.open(log.path.c_str()));
+  ASSERT_EQ(1U, reader.size());
+}
+
+TEST(ImuLogTesting, TestConversionKeepsFilterAndScales) {
+  // a log recorded with a non-nominal calibration, as replay writes it
+  TempLog source_log;
+  TempLog converted_log;
+  SensorCalibration<double> calibration(
+      AffineCalibration<double>::fromScale(0.0025),
+      AffineCalibration<double>::fromScale(0.0003),
+      AffineCalibration<double>::fromScale(15.0));
+  const double body_rate[3] = {0.2, -0.1, 0.4};
+  SyntheticSensorSource synthetic(100, 250.0, body_rate);
+  ImuLogWriter writer;
+  ASSERT_TRUE(writer.open(source_log.path.c_str(),
+                          makeHeader(250.0, calibration, MAHONY)));
+  AcquiredSample sample = AcquiredSample();
+  while (synthetic.read(sample)) {
+    ASSERT_TRUE(writer.write(sample));
+  }
+  ASSERT_TRUE(writer.close());
+
+  // converting it rebuilds the header from the calibration and filter
+  // read back, so nothing falls back to the nominal values
+  ImuLogReader reader;
+  ASSERT_TRUE(reader.open(source_log.path.c_str())) << reader.getError();
+  const ImuLogHeader &source = reader.getHeader();
+  ImuLogWriter converter;
+  ASSERT_TRUE(converter.open(
+      converted_log.path.c_str(),
+      makeHeader(source.sample_rate_hz, headerCalibration(source),
+                 source.filter)));
+  ImuLogSensorSource records(reader);
+  while (records.read(sample)) {
+    ASSERT_TRUE(converter.write(sample));
+  }
+  ASSERT_TRUE(converter.close());
+
+  ImuLogReader converted;
+  ASSERT_TRUE(converted.open(converted_log.path.c_str()));
+  const ImuLogHeader &header = converted.getHeader();
+  ASSERT_EQ(100U, header.record_count);
+  ASSERT_EQ(MAHONY, header.filter);
+  ASSERT_EQ(250.0, header.sample_rate_hz);
+  ASSERT_EQ(0.0025, header.acc_lsb_to_si);
+  ASSERT_EQ(0.0003, header.gyro_lsb_to_si);
+  ASSERT_EQ(15.0, header.mag_lsb_to_si);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,425 @@
+#pragma once
+
+#include "../Telemetry/JsonEstimateDecoder.hpp"
+#include "../Telemetry/TelemetryDecoder.hpp"
+#include "IngestRecording.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace ingest {
+
+/**
+ * @brief the settings of an ingest daemon.
+ */
+struct IngestSettings {
+  std::string output_dir = ".";           // recording directory
+  uint64_t rotate_bytes = 64ULL << 20;    // largest recording file
+  uint64_t rotate_ns = 3600000000000ULL;  // longest a file stays open
+  uint64_t flush_ns = 1000000000ULL;      // longest a record stays buffered
+  uint64_t gap_ns = 100000000ULL;         // silence counted as a gap
+  size_t read_bytes = 1 << 16;            // bytes per read(2)
+  size_t buffered_records = 4096;         // records buffered per device
+  speed_t baud = B921600;                 // line rate of serial devices
+};
+
+/**
+ * @brief the statistics of one device. Rates and gaps are measured on the
+ * arrival times of the records, so they describe the link as seen by the
+ * host.
+ */
+struct DeviceStats {
+  uint64_t bytes = 0;            // bytes read
+  uint64_t records = 0;          // estimates decoded
+  uint64_t parse_errors = 0;     // rejected lines or frames
+  uint64_t text_lines = 0;       // non estimate lines of a JSON stream
+  uint64_t missing_frames = 0;   // frames lost according to the sequence
+  uint64_t gaps = 0;             // silences longer than the gap threshold
+  uint64_t max_gap_ns = 0;       // longest silence between two reads
+  uint64_t first_arrival_ns = 0; // CLOCK_MONOTONIC of the first record
+  uint64_t last_arrival_ns = 0;  // CLOCK_MONOTONIC of the last record
+  double recent_rate_hz = 0.0;   // records per second over the last second
+  uint32_t files = 0;            // recording files started
+  bool connected = false;        // still open and readable
+
+  /**
+   * @brief returns the mean record rate since the first record.
+   * @return the mean rate in Hz, or zero before the second record.
+   */
+  double meanRateHz() const {
+    uint64_t span = this->last_arrival_ns - this->first_arrival_ns;
+    return this->records > 1 && span > 0
+               ? (this->records - 1) * 1e9 / span
+               : 0.0;
+  }
+};
+
+/**
+ * @brief reads estimates from many devices at once with epoll, and records
+ * them. Every device has a fixed read buffer, a decoder for its wire format
+ * and a fixed record buffer, all allocated when it is added, so ingesting
+ * allocates nothing. Records are stamped with the time their bytes were
+ * read and appended to a RotatingRecorder once the buffer fills or its
+ * oldest record is flush_ns old. Serial devices are switched to raw mode;
+ * ptys, pipes and sockets work as well, which is how the daemon is tested.
+ */
+class IngestDaemon {
+public:
+  /**
+   * @brief constructor for IngestDaemon class.
+   * @param settings the daemon settings.
+   */
+  explicit IngestDaemon(const IngestSettings &settings)
+      : _settings(settings), _connected(0) {
+    this->_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (this->_settings.read_bytes == 0) {
+      this->_settings.read_bytes = 1;
+    }
+    if (this->_settings.buffered_records == 0) {
+      this->_settings.buffered_records = 1;
+    }
+  }
+
+  IngestDaemon(const IngestDaemon &other) = delete;
+  IngestDaemon &operator=(const IngestDaemon &other) = delete;
+
+  /**
+   * @brief destructor for IngestDaemon class. Flushes every buffered
+   * record and closes the devices.
+   */
+  ~IngestDaemon() {
+    this->flush(true);
+    for (std::unique_ptr<Device> &device : this->_devices) {
+      this->disconnect(*device);
+    }
+    if (this->_epoll_fd >= 0) {
+      close(this->_epoll_fd);
+    }
+  }
+
+  /**
+   * @brief opens a device and starts reading it.
+   * @param name the device name, used in the recording names. At most
+   * kMaxDeviceNameLength bytes, without '/'.
+   * @param path the device path, such as /dev/ttyACM0 or a pty slave.
+   * @param format the wire format the device sends.
+   * @return the device index, or -1 if it cannot be opened.
+   */
+  int addDevice(const std::string &name, const char *path,
+                ingest_format_t format) {
+    int fd = open(path, O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+      return -1;
+    }
+    if (isatty(fd)) {
+      struct termios attributes;
+      if (tcgetattr(fd, &attributes) == 0) {
+        cfmakeraw(&attributes);
+        cfsetispeed(&attributes, this->_settings.baud);
+        cfsetospeed(&attributes, this->_settings.baud);
+        attributes.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &attributes);
+      }
+    }
+    int index = this->addDeviceFd(name, fd, format);
+    if (index < 0) {
+      close(fd);
+    }
+    return index;
+  }
+
+  /**
+   * @brief starts reading an already open descriptor. The descriptor is
+   * switched to non-blocking mode and owned by the daemon from now on.
+   * @param name the device name.
+   * @param fd the descriptor to read.
+   * @param format the wire format the device sends.
+   * @return the device index, or -1 if it cannot be watched.
+   */
+  int addDeviceFd(const std::string &name, int fd, ingest_format_t format) {
+    if (this->_epoll_fd < 0 || name.empty() ||
+        name.size() > kMaxDeviceNameLength ||
+        name.find('/') != std::string::npos) {
+      return -1;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) {
+      fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+
+    size_t index = this->_devices.size();
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.u64 = index;
+    if (epoll_ctl(this->_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      return -1;
+    }
+
+    this->_devices.emplace_back(new Device(name, fd, format, this->_settings));
+    this->_devices.back()->stats.connected = true;
+    this->_connected++;
+    return (int)index;
+  }
+
+  /**
+   * @brief waits for data from the devices and ingests whatever arrived.
+   * @param timeout_ms the longest wait, or -1 to wait until data arrives.
+   * @return the number of records decoded, or -1 if epoll failed.
+   */
+  int poll(int timeout_ms) {
+    struct epoll_event events[kMaxEvents];
+    int ready = epoll_wait(this->_epoll_fd, events, kMaxEvents, timeout_ms);
+    if (ready < 0) {
+      return errno == EINTR ? 0 : -1;
+    }
+
+    uint64_t decoded = 0;
+    for (int i = 0; i < ready; i++) {
+      Device &device = *this->_devices[events[i].data.u64];
+      decoded += this->readDevice(device);
+      if (device.fd >= 0 &&
+          (events[i].events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) != 0) {
+        this->disconnect(device); // read what was left, then let go
+      }
+    }
+    this->flush(false);
+    return (int)decoded;
+  }
+
+  /**
+   * @brief writes buffered records to the recordings.
+   * @param all true to write every buffered record, false to only write
+   * the buffers holding a record older than flush_ns.
+   */
+  void flush(bool all) {
+    uint64_t now_ns = monotonicNs();
+    for (std::unique_ptr<Device> &device : this->_devices) {
+      if (device->count > 0 &&
+          (all || now_ns - device->oldest_ns >= this->_settings.flush_ns)) {
+        this->flushDevice(*device);
+      }
+    }
+  }
+
+  /**
+   * @brief returns the number of devices added.
+   * @return the number of devices.
+   */
+  size_t getDeviceCount() const { return this->_devices.size(); }
+
+  /**
+   * @brief returns the number of devices still connected.
+   * @return the number of connected devices.
+   */
+  size_t getConnectedCount() const { return this->_connected; }
+
+  /**
+   * @brief returns the name of a device.
+   * @param index the device index.
+   * @return the device name.
+   */
+  const std::string &getName(size_t index) const {
+    return this->_devices[index]->name;
+  }
+
+  /**
+   * @brief returns the statistics of a device.
+   * @param index the device index.
+   * @return the device statistics.
+   */
+  const DeviceStats &getStats(size_t index) const {
+    return this->_devices[index]->stats;
+  }
+
+  /**
+   * @brief returns why the last recording write of a device failed.
+   * @param index the device index.
+   * @return the error message, or NULL if every write succeeded.
+   */
+  const char *getRecordingError(size_t index) const {
+    return this->_devices[index]->recorder.getError();
+  }
+
+  /**
+   * @brief writes the statistics of every device, one JSON object per line.
+   * @param file the file to write to.
+   */
+  void writeStats(FILE *file) const {
+    for (const std::unique_ptr<Device> &device : this->_devices) {
+      const DeviceStats &s = device->stats;
+      fprintf(file,
+              "{\"device\": \"%s\", \"connected\": %s, \"bytes\": %llu, "
+              "\"records\": %llu, \"rate_hz\": %.1f, \"mean_rate_hz\": %.1f, "
+              "\"parse_errors\": %llu, \"text_lines\": %llu, "
+              "\"missing_frames\": %llu, \"gaps\": %llu, "
+              "\"max_gap_ms\": %.1f, \"files\": %u}\n",
+              device->name.c_str(), s.connected ? "true" : "false",
+              (unsigned long long)s.bytes, (unsigned long long)s.records,
+              s.recent_rate_hz, s.meanRateHz(),
+              (unsigned long long)s.parse_errors,
+              (unsigned long long)s.text_lines,
+              (unsigned long long)s.missing_frames,
+              (unsigned long long)s.gaps, s.max_gap_ns * 1e-6, s.files);
+    }
+  }
+
+private:
+  static const int kMaxEvents = 32;
+
+  struct Device {
+    Device(const std::string &device_name, int device_fd,
+           ingest_format_t device_format, const IngestSettings &settings)
+        : name(device_name), fd(device_fd), format(device_format),
+          read_buffer(settings.read_bytes),
+          records(settings.buffered_records), count(0), oldest_ns(0),
+          last_read_ns(0), window_start_ns(0), window_records(0),
+          recorder(settings.output_dir, device_name, device_format,
+                   settings.rotate_bytes, settings.rotate_ns) {}
+
+    std::string name;
+    int fd;
+    ingest_format_t format;
+    std::vector<uint8_t> read_buffer;
+    telemetry::TelemetryDecoder binary_decoder;
+    telemetry::JsonEstimateDecoder json_decoder;
+    std::vector<IngestRecord> records; // fixed size record buffer
+    size_t count;                      // records buffered
+    uint64_t oldest_ns;                // arrival of the oldest buffered one
+    uint64_t last_read_ns;             // arrival of the last bytes
+    uint64_t window_start_ns;          // start of the rate window
+    uint64_t window_records;           // records in the rate window
+    RotatingRecorder recorder;
+    DeviceStats stats;
+  };
+
+  static uint64_t clockNs(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+  }
+
+  static uint64_t monotonicNs() { return clockNs(CLOCK_MONOTONIC); }
+
+  /**
+   * @brief reads everything a device has ready and decodes it.
+   * @return the number of records decoded.
+   */
+  uint64_t readDevice(Device &device) {
+    uint64_t decoded = 0;
+    while (device.fd >= 0) {
+      ssize_t len = read(device.fd, device.read_buffer.data(),
+                         device.read_buffer.size());
+      if (len < 0 && errno == EINTR) {
+        continue;
+      }
+      if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        break;
+      }
+      if (len <= 0) {
+        this->disconnect(device); // end of file, or a pty whose other side
+        break;                    // closed (EIO)
+      }
+
+      // one arrival time for every record completed by these bytes
+      uint64_t arrival_ns = monotonicNs();
+      uint64_t wall_ns = clockNs(CLOCK_REALTIME);
+      this->trackArrival(device, arrival_ns);
+      device.stats.bytes += len;
+      auto handler = [&](const filters::EstimateRecord &record) {
+        if (device.count == device.records.size()) {
+          this->flushDevice(device);
+        }
+        if (device.count == 0) {
+          device.oldest_ns = arrival_ns;
+        }
+        toIngestRecord(record, wall_ns, device.records[device.count++]);
+        decoded++;
+      };
+      if (device.format == INGEST_BINARY) {
+        device.binary_decoder.feed(device.read_buffer.data(), len, handler);
+      } else {
+        device.json_decoder.feed(device.read_buffer.data(), len, handler);
+      }
+    }
+    this->updateStats(device, decoded);
+    return decoded;
+  }
+
+  /**
+   * @brief counts silences between reads longer than the gap threshold.
+   */
+  void trackArrival(Device &device, uint64_t arrival_ns) {
+    if (device.last_read_ns != 0) {
+      uint64_t silence = arrival_ns - device.last_read_ns;
+      if (silence > device.stats.max_gap_ns) {
+        device.stats.max_gap_ns = silence;
+      }
+      if (silence > this->_settings.gap_ns) {
+        device.stats.gaps++;
+      }
+    }
+    device.last_read_ns = arrival_ns;
+  }
+
+  void updateStats(Device &device, uint64_t decoded) {
+    DeviceStats &stats = device.stats;
+    if (device.format == INGEST_BINARY) {
+      stats.parse_errors = device.binary_decoder.getCrcErrorCount() +
+                           device.binary_decoder.getFramingErrorCount();
+      stats.missing_frames = device.binary_decoder.getMissingFrameCount();
+    } else {
+      stats.parse_errors = device.json_decoder.getParseErrorCount();
+      stats.text_lines = device.json_decoder.getTextLineCount();
+    }
+    if (decoded == 0) {
+      return;
+    }
+
+    if (stats.records == 0) {
+      stats.first_arrival_ns = device.last_read_ns;
+      device.window_start_ns = device.last_read_ns;
+    }
+    stats.records += decoded;
+    stats.last_arrival_ns = device.last_read_ns;
+    device.window_records += decoded;
+    uint64_t window_ns = device.last_read_ns - device.window_start_ns;
+    if (window_ns >= 1000000000ULL) {
+      stats.recent_rate_hz = device.window_records * 1e9 / window_ns;
+      device.window_start_ns = device.last_read_ns;
+      device.window_records = 0;
+    }
+  }
+
+  void flushDevice(Device &device) {
+    device.recorder.append(device.records.data(), device.count,
+                           clockNs(CLOCK_REALTIME));
+    device.stats.files = device.recorder.getFileCount();
+    device.count = 0;
+  }
+
+  void disconnect(Device &device) {
+    if (device.fd < 0) {
+      return;
+    }
+    epoll_ctl(this->_epoll_fd, EPOLL_CTL_DEL, device.fd, NULL);
+    close(device.fd);
+    device.fd = -1;
+    device.stats.connected = false;
+    this->_connected--;
+  }
+
+  IngestSettings _settings;
+  int _epoll_fd;
+  std::vector<std::unique_ptr<Device>> _devices;
+  size_t _connected; // devices still open
+}; // end IngestDaemon class
+} // namespace ingest
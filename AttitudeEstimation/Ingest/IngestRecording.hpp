@@ -0,0 +1,289 @@
+#pragma once
+
+#include "../SensorDriver/Records.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace ingest {
+
+/**
+ * @brief the ingest recording layout. A recording is a 64 byte header
+ * followed by fixed 56 byte IngestRecord records in host byte order, one
+ * per estimate received from a device. Unlike an IMU log, the record count
+ * is not stored: a recording is only appended to, and a reader takes every
+ * complete record, so a recording cut short by a crash stays readable.
+ */
+static const char kIngestMagic[8] = {'I', 'M', 'U', 'I', 'N', 'G', '\r',
+                                     '\n'};
+static const uint16_t kIngestVersion = 1;
+static const size_t kMaxDeviceNameLength = 31;
+
+/**
+ * @brief the wire format an estimate was received in.
+ */
+typedef enum { INGEST_JSON = 0, INGEST_BINARY = 1 } ingest_format_t;
+
+/**
+ * @brief the recording header, describing the device and where the file
+ * sits in its rotation.
+ */
+struct IngestFileHeader {
+  char magic[8];          // kIngestMagic
+  uint16_t version;       // kIngestVersion
+  uint16_t header_size;   // sizeof(IngestFileHeader)
+  uint16_t record_size;   // sizeof(IngestRecord)
+  uint8_t format;         // ingest_format_t of the device
+  uint8_t reserved0;      // zero
+  char device[32];        // device name, NUL terminated
+  uint32_t file_index;    // position in the device's rotation, from 0
+  uint32_t reserved1;     // zero
+  uint64_t created_ns;    // CLOCK_REALTIME when the file was created
+};
+
+/**
+ * @brief one estimate as received, stamped with its arrival time.
+ */
+struct IngestRecord {
+  uint64_t arrival_ns;    // CLOCK_REALTIME when its bytes were read
+  uint64_t timestamp_us;  // device timestamp, zero for JSON messages
+  uint32_t sequence;      // device sequence, or arrival order for JSON
+  uint32_t reserved;      // zero
+  float ground_truth[4];  // ground truth quaternion <W, X, Y, Z>
+  float estimate[4];      // estimated quaternion <W, X, Y, Z>
+};
+
+static_assert(sizeof(IngestFileHeader) == 64,
+              "IngestFileHeader must be 64 bytes");
+static_assert(sizeof(IngestRecord) == 56, "IngestRecord must be 56 bytes");
+
+/**
+ * @brief converts a decoded estimate to a record.
+ * @param record the decoded estimate.
+ * @param arrival_ns the arrival time of its bytes.
+ * @param out the record to fill.
+ */
+inline void toIngestRecord(const filters::EstimateRecord &record,
+                           uint64_t arrival_ns, IngestRecord &out) {
+  out.arrival_ns = arrival_ns;
+  out.timestamp_us = record.timestamp_us;
+  out.sequence = record.sequence;
+  out.reserved = 0;
+  out.ground_truth[0] = (float)record.ground_truth.getW();
+  out.ground_truth[1] = (float)record.ground_truth.getX();
+  out.ground_truth[2] = (float)record.ground_truth.getY();
+  out.ground_truth[3] = (float)record.ground_truth.getZ();
+  out.estimate[0] = (float)record.estimate.getW();
+  out.estimate[1] = (float)record.estimate.getX();
+  out.estimate[2] = (float)record.estimate.getY();
+  out.estimate[3] = (float)record.estimate.getZ();
+}
+
+/**
+ * @brief builds the path of one file of a device's rotation.
+ * @param dir the recording directory.
+ * @param device the device name.
+ * @param file_index the position in the rotation.
+ * @return the path, <dir>/<device>.<index>.imuing.
+ */
+inline std::string ingestFilePath(const std::string &dir,
+                                  const std::string &device,
+                                  uint32_t file_index) {
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%06u.imuing", file_index);
+  return dir + "/" + device + suffix;
+}
+
+/**
+ * @brief appends a device's records to a rotation of recordings. A new file
+ * is started once the current one would grow past a size limit or has been
+ * open longer than an age limit, so recordings of a long running rack can
+ * be moved away or deleted while the daemon runs. Records are written with
+ * one write(2) per batch, straight from the caller's buffer.
+ */
+class RotatingRecorder {
+public:
+  /**
+   * @brief constructor for RotatingRecorder class. No file is created
+   * until the first records are appended.
+   * @param dir the recording directory.
+   * @param device the device name, at most kMaxDeviceNameLength bytes.
+   * @param format the wire format of the device.
+   * @param max_file_bytes the size a file may reach, at least one record
+   * past the header.
+   * @param max_file_ns the time a file may stay open, or 0 for no limit.
+   */
+  RotatingRecorder(const std::string &dir, const std::string &device,
+                   ingest_format_t format, uint64_t max_file_bytes,
+                   uint64_t max_file_ns)
+      : _dir(dir), _device(device), _format(format),
+        _max_file_bytes(max_file_bytes), _max_file_ns(max_file_ns), _fd(-1),
+        _file_index(0), _file_bytes(0), _opened_ns(0), _error(NULL) {
+    size_t minimum = sizeof(IngestFileHeader) + sizeof(IngestRecord);
+    if (this->_max_file_bytes < minimum) {
+      this->_max_file_bytes = minimum;
+    }
+  }
+
+  RotatingRecorder(const RotatingRecorder &other) = delete;
+  RotatingRecorder &operator=(const RotatingRecorder &other) = delete;
+
+  /**
+   * @brief destructor for RotatingRecorder class. Closes the current file.
+   */
+  ~RotatingRecorder() { this->close(); }
+
+  /**
+   * @brief appends records, rotating files as needed.
+   * @param records pointer to count records.
+   * @param count the number of records.
+   * @param now_ns the current CLOCK_REALTIME, used for the age limit.
+   * @return true if every record was written, false otherwise. See
+   * getError().
+   */
+  bool append(const IngestRecord *records, size_t count, uint64_t now_ns) {
+    while (count > 0) {
+      if (this->_fd >= 0 && (this->_file_bytes + sizeof(IngestRecord) >
+                                 this->_max_file_bytes ||
+                             (this->_max_file_ns > 0 &&
+                              now_ns - this->_opened_ns >=
+                                  this->_max_file_ns))) {
+        this->close();
+      }
+      if (this->_fd < 0 && !this->openNext(now_ns)) {
+        return false;
+      }
+
+      size_t room = (this->_max_file_bytes - this->_file_bytes) /
+                    sizeof(IngestRecord);
+      size_t batch = count < room ? count : room;
+      if (!this->writeAll(records, batch * sizeof(IngestRecord))) {
+        return false;
+      }
+      this->_file_bytes += batch * sizeof(IngestRecord);
+      records += batch;
+      count -= batch;
+    }
+    return true;
+  }
+
+  /**
+   * @brief closes the current file. The next append starts a new one.
+   */
+  void close() {
+    if (this->_fd >= 0) {
+      ::close(this->_fd);
+      this->_fd = -1;
+    }
+  }
+
+  /**
+   * @brief returns the number of files started so far.
+   * @return the number of files.
+   */
+  uint32_t getFileCount() const { return this->_file_index; }
+
+  /**
+   * @brief returns why the last append failed.
+   * @return the error message, or NULL if no append failed.
+   */
+  const char *getError() const { return this->_error; }
+
+private:
+  bool openNext(uint64_t now_ns) {
+    std::string path =
+        ingestFilePath(this->_dir, this->_device, this->_file_index);
+    this->_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     0644);
+    if (this->_fd < 0) {
+      this->_error = "cannot create the recording";
+      return false;
+    }
+
+    IngestFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kIngestMagic, sizeof(kIngestMagic));
+    header.version = kIngestVersion;
+    header.header_size = sizeof(IngestFileHeader);
+    header.record_size = sizeof(IngestRecord);
+    header.format = (uint8_t)this->_format;
+    strncpy(header.device, this->_device.c_str(), kMaxDeviceNameLength);
+    header.file_index = this->_file_index;
+    header.created_ns = now_ns;
+    this->_file_index++;
+    this->_opened_ns = now_ns;
+    this->_file_bytes = 0;
+    if (!this->writeAll(&header, sizeof(header))) {
+      return false;
+    }
+    this->_file_bytes = sizeof(header);
+    return true;
+  }
+
+  bool writeAll(const void *data, size_t len) {
+    const char *bytes = (const char *)data;
+    while (len > 0) {
+      ssize_t written = ::write(this->_fd, bytes, len);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        this->_error = "cannot write the recording";
+        this->close();
+        return false;
+      }
+      bytes += written;
+      len -= written;
+    }
+    return true;
+  }
+
+  std::string _dir;
+  std::string _device;
+  ingest_format_t _format;
+  uint64_t _max_file_bytes;
+  uint64_t _max_file_ns;
+  int _fd;
+  uint32_t _file_index; // index of the next file
+  uint64_t _file_bytes; // bytes in the current file
+  uint64_t _opened_ns;  // creation time of the current file
+  const char *_error;
+}; // end RotatingRecorder class
+
+/**
+ * @brief reads a whole ingest recording.
+ * @param path the recording path.
+ * @param header the header to fill.
+ * @param records the vector to append the complete records to.
+ * @return NULL on success, a description of the problem otherwise.
+ */
+inline const char *readIngestFile(const char *path, IngestFileHeader &header,
+                                  std::vector<IngestRecord> &records) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return "cannot open the recording";
+  }
+  const char *error = NULL;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, kIngestMagic, sizeof(kIngestMagic)) != 0) {
+    error = "not an ingest recording";
+  } else if (header.version != kIngestVersion ||
+             header.header_size != sizeof(IngestFileHeader) ||
+             header.record_size != sizeof(IngestRecord)) {
+    error = "unsupported recording version";
+  } else {
+    IngestRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+      records.push_back(record);
+    }
+  }
+  fclose(file);
+  return error;
+}
+} // namespace ingest
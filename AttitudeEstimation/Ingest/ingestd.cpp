@@ -0,0 +1,197 @@
+#include "IngestDaemon.hpp"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <termios.h>
+#include <time.h>
+#include <vector>
+
+using namespace ingest;
+
+/**
+ * @brief one device given on the command line.
+ */
+struct DeviceOption {
+  std::string name;
+  std::string path;
+  ingest_format_t format;
+};
+
+/**
+ * @brief the command line options of the ingest daemon.
+ */
+struct IngestOptions {
+  IngestSettings settings;
+  std::vector<DeviceOption> devices;
+  const char *stats = NULL;  // statistics file, rewritten periodically
+  double stats_interval_s = 1.0;
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void requestStop(int) { stop_requested = 1; }
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <device> [<device> ...]\n"
+          "  a device is [<name>=]<path>[:json|:binary]; the name defaults\n"
+          "  to the last path component and the format to json\n"
+          "  --output <dir>      recording directory (default .)\n"
+          "  --rotate-mb <n>     start a new recording file after n MiB\n"
+          "                      (default 64)\n"
+          "  --rotate-s <s>      start a new recording file after s seconds\n"
+          "                      (default 3600)\n"
+          "  --gap-ms <ms>       silence counted as a gap (default 100)\n"
+          "  --baud <rate>       serial line rate (default 921600)\n"
+          "  --stats <path>      rewrite per device statistics as JSON\n"
+          "                      lines\n"
+          "  --stats-interval <s>\n"
+          "                      statistics period (default 1)\n",
+          name);
+}
+
+static bool parseBaud(unsigned long rate, speed_t &baud) {
+  static const struct {
+    unsigned long rate;
+    speed_t baud;
+  } rates[] = {{9600, B9600},     {19200, B19200},   {38400, B38400},
+               {57600, B57600},   {115200, B115200}, {230400, B230400},
+               {460800, B460800}, {921600, B921600}};
+  for (const auto &entry : rates) {
+    if (entry.rate == rate) {
+      baud = entry.baud;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool parseDevice(const char *arg, DeviceOption &device) {
+  std::string spec = arg;
+  device.format = INGEST_JSON;
+  size_t colon = spec.rfind(':');
+  if (colon != std::string::npos) {
+    std::string format = spec.substr(colon + 1);
+    if (format == "json") {
+      spec.resize(colon);
+    } else if (format == "binary") {
+      device.format = INGEST_BINARY;
+      spec.resize(colon);
+    }
+  }
+  size_t equals = spec.find('=');
+  if (equals != std::string::npos) {
+    device.name = spec.substr(0, equals);
+    device.path = spec.substr(equals + 1);
+  } else {
+    device.path = spec;
+    device.name = spec.substr(spec.rfind('/') + 1);
+  }
+  return !device.name.empty() && !device.path.empty();
+}
+
+static bool parseOptions(int argc, char **argv, IngestOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "--output") == 0 && has_value) {
+      options.settings.output_dir = argv[++i];
+    } else if (strcmp(arg, "--rotate-mb") == 0 && has_value) {
+      options.settings.rotate_bytes = strtoull(argv[++i], NULL, 10) << 20;
+    } else if (strcmp(arg, "--rotate-s") == 0 && has_value) {
+      options.settings.rotate_ns = (uint64_t)(atof(argv[++i]) * 1e9);
+    } else if (strcmp(arg, "--gap-ms") == 0 && has_value) {
+      options.settings.gap_ns = (uint64_t)(atof(argv[++i]) * 1e6);
+    } else if (strcmp(arg, "--baud") == 0 && has_value) {
+      if (!parseBaud(strtoul(argv[++i], NULL, 10), options.settings.baud)) {
+        return false;
+      }
+    } else if (strcmp(arg, "--stats") == 0 && has_value) {
+      options.stats = argv[++i];
+    } else if (strcmp(arg, "--stats-interval") == 0 && has_value) {
+      options.stats_interval_s = atof(argv[++i]);
+    } else if (arg[0] != '-') {
+      DeviceOption device;
+      if (!parseDevice(arg, device)) {
+        return false;
+      }
+      options.devices.push_back(device);
+    } else {
+      return false;
+    }
+  }
+  return !options.devices.empty();
+}
+
+/**
+ * @brief replaces the statistics file, so readers never see it half
+ * written.
+ */
+static void writeStatsFile(const IngestDaemon &daemon, const char *path) {
+  std::string temporary = std::string(path) + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "w");
+  if (file == NULL) {
+    return;
+  }
+  daemon.writeStats(file);
+  fclose(file);
+  rename(temporary.c_str(), path);
+}
+
+static double monotonicS() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+  IngestOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  IngestDaemon daemon(options.settings);
+  for (const DeviceOption &device : options.devices) {
+    if (daemon.addDevice(device.name, device.path.c_str(), device.format) <
+        0) {
+      fprintf(stderr, "cannot open %s as %s\n", device.path.c_str(),
+              device.name.c_str());
+      return 1;
+    }
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = requestStop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  // runs until interrupted or until every device has gone away
+  double next_stats_s = monotonicS() + options.stats_interval_s;
+  while (!stop_requested && daemon.getConnectedCount() > 0) {
+    if (daemon.poll(100) < 0) {
+      perror("epoll_wait");
+      break;
+    }
+    if (options.stats != NULL && monotonicS() >= next_stats_s) {
+      writeStatsFile(daemon, options.stats);
+      next_stats_s += options.stats_interval_s;
+    }
+  }
+
+  daemon.flush(true);
+  if (options.stats != NULL) {
+    writeStatsFile(daemon, options.stats);
+  }
+  daemon.writeStats(stderr);
+  for (size_t i = 0; i < daemon.getDeviceCount(); i++) {
+    if (daemon.getRecordingError(i) != NULL) {
+      fprintf(stderr, "%s: %s\n", daemon.getName(i).c_str(),
+              daemon.getRecordingError(i));
+    }
+  }
+  return 0;
+}
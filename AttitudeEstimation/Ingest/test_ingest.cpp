@@ -0,0 +1,273 @@
+#include "../SensorDriver/EstimateFormat.hpp"
+#include "../Telemetry/TelemetryProtocol.hpp"
+#include "IngestDaemon.hpp"
+#include "IngestRecording.hpp"
+#include "gtest/gtest.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace ingest;
+
+/**
+ * @brief a temporary recording directory, removed with its files on
+ * destruction.
+ */
+struct TempDir {
+  TempDir() {
+    char path[] = "/tmp/test_ingest_XXXXXX";
+    EXPECT_TRUE(mkdtemp(path) != NULL);
+    this->path = path;
+  }
+
+  ~TempDir() {
+    for (const std::string &file : this->list()) {
+      unlink((this->path + "/" + file).c_str());
+    }
+    rmdir(this->path.c_str());
+  }
+
+  std::vector<std::string> list() const {
+    std::vector<std::string> names;
+    DIR *dir = opendir(this->path.c_str());
+    while (struct dirent *entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') {
+        names.push_back(entry->d_name);
+      }
+    }
+    closedir(dir);
+    return names;
+  }
+
+  std::string path;
+};
+
+/**
+ * @brief a pty pair standing in for a serial device: the test writes to
+ * the master side and the daemon reads the slave path.
+ */
+struct FakeDevice {
+  FakeDevice() {
+    this->master = posix_openpt(O_RDWR | O_NOCTTY);
+    EXPECT_GE(this->master, 0);
+    EXPECT_EQ(0, grantpt(this->master));
+    EXPECT_EQ(0, unlockpt(this->master));
+    this->path = ptsname(this->master);
+  }
+
+  ~FakeDevice() { this->hangUp(); }
+
+  void send(const void *data, size_t len) {
+    ASSERT_EQ((ssize_t)len, write(this->master, data, len));
+  }
+
+  void hangUp() {
+    if (this->master >= 0) {
+      close(this->master);
+      this->master = -1;
+    }
+  }
+
+  int master;
+  std::string path;
+};
+
+static filters::EstimateRecord makeRecord(uint32_t sequence) {
+  filters::EstimateRecord record;
+  record.sequence = sequence;
+  record.timestamp_us = 5000ULL * sequence;
+  record.ground_truth =
+      structures::Quaternion<double>(0.1, -0.2, 0.3 + 0.001 * sequence, 0.9)
+          .norm();
+  record.estimate =
+      structures::Quaternion<double>(-0.7, 0.1, 0.05, -0.6).norm();
+  return record;
+}
+
+static void sendJson(FakeDevice &device, uint32_t sequence) {
+  filters::JsonEstimateFormatter formatter;
+  uint8_t message[filters::JsonEstimateFormatter::kMaxMessageLength];
+  size_t len = formatter.format(makeRecord(sequence), message,
+                                sizeof(message));
+  device.send(message, len);
+}
+
+static void sendBinary(FakeDevice &device, uint32_t sequence) {
+  telemetry::BinaryEstimateFormatter formatter;
+  uint8_t message[telemetry::BinaryEstimateFormatter::kMaxMessageLength];
+  size_t len = formatter.format(makeRecord(sequence), message,
+                                sizeof(message));
+  device.send(message, len);
+}
+
+/**
+ * @brief polls until the daemon has decoded a number of records, or for at
+ * most two seconds.
+ */
+static void pollUntil(IngestDaemon &daemon, size_t index, uint64_t records) {
+  for (int i = 0; i < 200 && daemon.getStats(index).records < records; i++) {
+    daemon.poll(10);
+  }
+}
+
+static std::vector<IngestRecord> readDevice(const TempDir &dir,
+                                            const std::string &device,
+                                            uint32_t files) {
+  std::vector<IngestRecord> records;
+  for (uint32_t i = 0; i < files; i++) {
+    IngestFileHeader header;
+    std::string path = ingestFilePath(dir.path, device, i);
+    EXPECT_EQ(NULL, readIngestFile(path.c_str(), header, records)) << path;
+    EXPECT_EQ(i, header.file_index);
+    EXPECT_STREQ(device.c_str(), header.device);
+  }
+  return records;
+}
+
+TEST(IngestTesting, TestRecorderRotates) {
+  TempDir dir;
+  std::vector<IngestRecord> written(25);
+  for (size_t i = 0; i < written.size(); i++) {
+    toIngestRecord(makeRecord(i), 1000 + i, written[i]);
+  }
+
+  // room for 10 records per file, and a file older than 1 s is replaced
+  uint64_t file_bytes = sizeof(IngestFileHeader) + 10 * sizeof(IngestRecord);
+  RotatingRecorder recorder(dir.path, "imu0", INGEST_BINARY, file_bytes,
+                            1000000000ULL);
+  ASSERT_TRUE(recorder.append(written.data(), 7, 0));
+  ASSERT_TRUE(recorder.append(written.data() + 7, 8, 1));
+  ASSERT_EQ(2U, recorder.getFileCount());
+  ASSERT_TRUE(recorder.append(written.data() + 15, 10, 2000000000ULL));
+  recorder.close();
+
+  // 10 + 5 records, then a new file for age, holding the last 10
+  ASSERT_EQ(3U, recorder.getFileCount());
+  ASSERT_EQ(3U, dir.list().size());
+  std::vector<IngestRecord> records = readDevice(dir, "imu0", 3);
+  ASSERT_EQ(written.size(), records.size());
+  for (size_t i = 0; i < records.size(); i++) {
+    ASSERT_EQ(i, records[i].sequence);
+    ASSERT_EQ(1000 + i, records[i].arrival_ns);
+  }
+}
+
+TEST(IngestTesting, TestIngestsDevicesThroughPtys) {
+  TempDir dir;
+  IngestSettings settings;
+  settings.output_dir = dir.path;
+  settings.buffered_records = 16; // several flushes per device
+  settings.rotate_bytes = sizeof(IngestFileHeader) + 40 * sizeof(IngestRecord);
+  IngestDaemon daemon(settings);
+
+  FakeDevice json_device;
+  FakeDevice binary_device;
+  ASSERT_EQ(0, daemon.addDevice("json0", json_device.path.c_str(),
+                                INGEST_JSON));
+  ASSERT_EQ(1, daemon.addDevice("bin0", binary_device.path.c_str(),
+                                INGEST_BINARY));
+  ASSERT_EQ(-1, daemon.addDevice("missing", "/nonexistent", INGEST_JSON));
+  ASSERT_EQ(-1, daemon.addDevice("a/b", json_device.path.c_str(),
+                                 INGEST_JSON));
+
+  // a JSON stream with a diagnostic line and a broken message, and a
+  // binary stream that loses frame 10 and carries a corrupted frame
+  for (uint32_t i = 0; i < 50; i++) {
+    sendJson(json_device, i);
+    if (i == 20) {
+      const char noise[] = "filter restarted\n{\"ground_truth_quat\": {}\n";
+      json_device.send(noise, sizeof(noise) - 1);
+    }
+  }
+  for (uint32_t i = 0; i < 61; i++) {
+    if (i != 10) {
+      sendBinary(binary_device, i);
+    }
+    if (i == 30) {
+      const uint8_t corrupt[] = {7, 1, 2, 3, 4, 5, 6, 0};
+      binary_device.send(corrupt, sizeof(corrupt));
+    }
+  }
+  pollUntil(daemon, 0, 50);
+  pollUntil(daemon, 1, 60);
+
+  const DeviceStats &json_stats = daemon.getStats(0);
+  ASSERT_EQ(50U, json_stats.records);
+  ASSERT_EQ(1U, json_stats.parse_errors);
+  ASSERT_EQ(1U, json_stats.text_lines);
+  ASSERT_TRUE(json_stats.connected);
+  const DeviceStats &binary_stats = daemon.getStats(1);
+  ASSERT_EQ(60U, binary_stats.records);
+  ASSERT_EQ(1U, binary_stats.parse_errors);
+  ASSERT_EQ(1U, binary_stats.missing_frames);
+  ASSERT_GT(binary_stats.bytes, 60U * 22);
+
+  // hanging up disconnects the device and keeps its records
+  json_device.hangUp();
+  for (int i = 0; i < 100 && daemon.getConnectedCount() > 1; i++) {
+    daemon.poll(10);
+  }
+  ASSERT_EQ(1U, daemon.getConnectedCount());
+  ASSERT_FALSE(daemon.getStats(0).connected);
+
+  daemon.flush(true);
+  ASSERT_EQ(2U, daemon.getStats(0).files);
+  std::vector<IngestRecord> json_records = readDevice(dir, "json0", 2);
+  ASSERT_EQ(50U, json_records.size());
+  for (uint32_t i = 0; i < 50; i++) {
+    filters::EstimateRecord expected = makeRecord(i);
+    ASSERT_EQ(i, json_records[i].sequence);
+    ASSERT_EQ(0U, json_records[i].timestamp_us);
+    ASSERT_NEAR(expected.ground_truth.getZ(), json_records[i].ground_truth[3],
+                1e-6);
+    ASSERT_NEAR(expected.estimate.getW(), json_records[i].estimate[0], 1e-6);
+    if (i > 0) {
+      ASSERT_GE(json_records[i].arrival_ns, json_records[i - 1].arrival_ns);
+    }
+  }
+
+  std::vector<IngestRecord> binary_records =
+      readDevice(dir, "bin0", daemon.getStats(1).files);
+  ASSERT_EQ(60U, binary_records.size());
+  ASSERT_EQ(11U, binary_records[10].sequence);
+  ASSERT_EQ(55000U, binary_records[10].timestamp_us);
+}
+
+TEST(IngestTesting, TestCountsGaps) {
+  TempDir dir;
+  IngestSettings settings;
+  settings.output_dir = dir.path;
+  settings.gap_ns = 50000000ULL;
+  IngestDaemon daemon(settings);
+  FakeDevice device;
+  ASSERT_EQ(0, daemon.addDevice("imu", device.path.c_str(), INGEST_BINARY));
+
+  sendBinary(device, 0);
+  pollUntil(daemon, 0, 1);
+  usleep(120000);
+  sendBinary(device, 1);
+  pollUntil(daemon, 0, 2);
+
+  const DeviceStats &stats = daemon.getStats(0);
+  ASSERT_EQ(2U, stats.records);
+  ASSERT_EQ(1U, stats.gaps);
+  ASSERT_GE(stats.max_gap_ns, 100000000ULL);
+  ASSERT_GT(stats.meanRateHz(), 0.0);
+  ASSERT_LT(stats.meanRateHz(), 20.0);
+
+  char text[1024];
+  FILE *file = fmemopen(text, sizeof(text), "w");
+  daemon.writeStats(file);
+  fclose(file);
+  ASSERT_TRUE(strstr(text, "\"device\": \"imu\"") != NULL);
+  ASSERT_TRUE(strstr(text, "\"gaps\": 1,") != NULL);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
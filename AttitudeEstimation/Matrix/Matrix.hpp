@@ -101,13 +101,20 @@ public:
    */
   T getValue(size_t row, size_t col) const { return this->_matrix[row][col]; }
 
+  /**
+   * @brief returns a pointer to the row-major storage of this matrix. For a
+   * column vector this is its elements laid out contiguously.
+   * @return a pointer to the first element of this matrix.
+   */
+  const T *data() const { return &this->_matrix[0][0]; }
+
   /**
    * @brief the operator overload for addition for a
    * given set of matricies.
    * @param other the addend matrix.
    * @return the resultant matrix after the addition operation.
    */
-  Matrix<T, rows, cols> operator+(Matrix const &other) {
+  Matrix<T, rows, cols> operator+(Matrix const &other) const {
     // create empty 2D vector the same size as 'this' matrix.
     T res_vec[rows][cols];
 
@@ -128,7 +135,7 @@ public:
    * @param other the subtrahend matrix.
    * @return the resultant matrix after the subtraction.
    */
-  Matrix<T, rows, cols> operator-(Matrix const &other) {
+  Matrix<T, rows, cols> operator-(Matrix const &other) const {
     // create empty 2D vector the same size as 'this' matrix.
     T res_vec[rows][cols];
 
@@ -150,7 +157,7 @@ public:
    * @return the resultant matrix.
    */
   template <size_t n>
-  Matrix<T, rows, n> operator*(Matrix<T, cols, n> const &other) {
+  Matrix<T, rows, n> operator*(Matrix<T, cols, n> const &other) const {
     // create empty matrix of correct size
     Matrix<T, rows, n> res_mat(0.0);
 
@@ -174,7 +181,7 @@ public:
    * @param other the scalar to multiply 'this' matrix by.
    * @return the resultant matrix.
    */
-  Matrix<T, rows, cols> operator*(T const &other) {
+  Matrix<T, rows, cols> operator*(T const &other) const {
     // create empty matrix of correct size
     Matrix<T, rows, cols> res_mat(0.0);
 
@@ -194,7 +201,7 @@ public:
    * @param other the other matrix used in the equality test.
    * @return true if equal, false otherwise.
    */
-  bool operator==(Matrix const &other) {
+  bool operator==(Matrix const &other) const {
     // see if dimensions are equal.
     if (this->getNumRows() == other.getNumRows() &&
         this->getNumCols() == other.getNumCols()) {
@@ -219,7 +226,7 @@ public:
    * @param other the other matrix used in the inequality test.
    * @return true if not equal, false otherwise.
    */
-  bool operator!=(Matrix const &other) {
+  bool operator!=(Matrix const &other) const {
     // see if dimensions are not equal.
     if (this->getNumRows() != other.getNumRows() ||
         this->getNumCols() != other.getNumCols()) {
@@ -242,7 +249,7 @@ public:
    * @brief transposes 'this' given matrix.
    * @return a new copy of 'this' matrix, transposed.
    */
-  Matrix<T, cols, rows> transpose() {
+  Matrix<T, cols, rows> transpose() const {
     // make new vector with swapped dimensions of 'this' Matrix
     Matrix<T, cols, rows> transpose_mat;
 
@@ -262,7 +269,7 @@ public:
    * error. TODO: extend to handle 2D matrixes.
    * @return the computed norm value.
    */
-  T norm() {
+  T norm() const {
     bool is_row_vec = (this->getNumCols() == 1 && this->getNumRows() >= 1);
     bool is_col_vec = (this->getNumCols() >= 1 && this->getNumRows() == 1);
 
@@ -36,6 +36,11 @@ TEST(MatrixClassTesting, TestMatrixAccessor) {
 
   // access the changed value
   ASSERT_EQ(50, matrix_one.getValue(1, 1));
+
+  // access the changed value through the row-major storage pointer
+  const int *raw_values = matrix_one.data();
+  ASSERT_EQ(1, raw_values[0]);
+  ASSERT_EQ(50, raw_values[3]);
 }
 
 TEST(MatrixClassTesting, TestMatrixAddition) {
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+namespace profiling {
+
+/**
+ * @brief the categories of scalar operations counted by CountingScalar.
+ */
+typedef enum {
+  OP_ADD,   // additions, subtractions and negations
+  OP_MUL,   // multiplications
+  OP_DIV,   // divisions
+  OP_CMP,   // comparisons
+  OP_SQRT,  // square roots
+  OP_POW,   // pow calls, including pow(x, 2) and pow(x, 0.5)
+  OP_TRIG,  // sin, cos and tan
+  OP_ATAN,  // atan, atan2, asin and acos
+  OP_FLOOR, // floor and ceil
+  OP_COUNT
+} scalar_op_t;
+
+/**
+ * @brief tallies of the scalar operations performed on the calling thread.
+ */
+struct OpCounts {
+  uint64_t ops[OP_COUNT];
+
+  /**
+   * @brief zeroes every tally.
+   */
+  void reset() {
+    for (size_t op = 0; op < OP_COUNT; op++) {
+      this->ops[op] = 0;
+    }
+  }
+
+  /**
+   * @brief returns the sum of every tally.
+   * @return the total operation count.
+   */
+  uint64_t total() const {
+    uint64_t sum = 0;
+    for (size_t op = 0; op < OP_COUNT; op++) {
+      sum += this->ops[op];
+    }
+    return sum;
+  }
+
+  /**
+   * @brief returns the name of an operation category.
+   * @param op the operation category.
+   * @return the category name.
+   */
+  static const char *name(scalar_op_t op) {
+    static const char *const names[OP_COUNT] = {
+        "add", "mul", "div", "cmp", "sqrt", "pow", "trig", "atan", "floor"};
+    return names[op];
+  }
+}; // end OpCounts struct
+
+/**
+ * @brief returns the operation tallies of the calling thread. They start at
+ * zero and are never reset implicitly.
+ * @return the tallies.
+ */
+inline OpCounts &opCounts() {
+  static thread_local OpCounts counts = {};
+  return counts;
+}
+
+/**
+ * @brief a double that counts every arithmetic operation, comparison and
+ * math library call made on it. Instantiating the structures and filters
+ * with it gives a platform independent operation count per update.
+ * Construction, copies and assignments are free. There is deliberately no
+ * implicit conversion back to double, so an operation that would bypass the
+ * counting fails to compile instead.
+ */
+class CountingScalar {
+public:
+  /**
+   * @brief constructor for CountingScalar class.
+   * @param value the wrapped value.
+   */
+  CountingScalar(double value = 0.0) : _value(value) {}
+
+  /**
+   * @brief returns the wrapped value, without counting an operation.
+   * @return the wrapped value.
+   */
+  double value() const { return this->_value; }
+
+  CountingScalar &operator+=(const CountingScalar &other) {
+    return *this = *this + other;
+  }
+  CountingScalar &operator-=(const CountingScalar &other) {
+    return *this = *this - other;
+  }
+  CountingScalar &operator*=(const CountingScalar &other) {
+    return *this = *this * other;
+  }
+  CountingScalar &operator/=(const CountingScalar &other) {
+    return *this = *this / other;
+  }
+
+  friend CountingScalar operator-(const CountingScalar &a) {
+    return counted(OP_ADD, -a._value);
+  }
+  friend CountingScalar operator+(const CountingScalar &a,
+                                  const CountingScalar &b) {
+    return counted(OP_ADD, a._value + b._value);
+  }
+  friend CountingScalar operator-(const CountingScalar &a,
+                                  const CountingScalar &b) {
+    return counted(OP_ADD, a._value - b._value);
+  }
+  friend CountingScalar operator*(const CountingScalar &a,
+                                  const CountingScalar &b) {
+    return counted(OP_MUL, a._value * b._value);
+  }
+  friend CountingScalar operator/(const CountingScalar &a,
+                                  const CountingScalar &b) {
+    return counted(OP_DIV, a._value / b._value);
+  }
+
+  friend bool operator<(const CountingScalar &a, const CountingScalar &b) {
+    return compared(a._value < b._value);
+  }
+  friend bool operator<=(const CountingScalar &a, const CountingScalar &b) {
+    return compared(a._value <= b._value);
+  }
+  friend bool operator>(const CountingScalar &a, const CountingScalar &b) {
+    return compared(a._value > b._value);
+  }
+  friend bool operator>=(const CountingScalar &a, const CountingScalar &b) {
+    return compared(a._value >= b._value);
+  }
+  friend bool operator==(const CountingScalar &a, const CountingScalar &b) {
+    return compared(a._value == b._value);
+  }
+  friend bool operator!=(const CountingScalar &a, const CountingScalar &b) {
+    return compared(a._value != b._value);
+  }
+
+  // math library overloads, found through argument dependent lookup by the
+  // unqualified calls in the structures and filters
+  friend CountingScalar sqrt(const CountingScalar &a) {
+    return counted(OP_SQRT, ::sqrt(a._value));
+  }
+  friend CountingScalar pow(const CountingScalar &a,
+                            const CountingScalar &b) {
+    return counted(OP_POW, ::pow(a._value, b._value));
+  }
+  friend CountingScalar sin(const CountingScalar &a) {
+    return counted(OP_TRIG, ::sin(a._value));
+  }
+  friend CountingScalar cos(const CountingScalar &a) {
+    return counted(OP_TRIG, ::cos(a._value));
+  }
+  friend CountingScalar tan(const CountingScalar &a) {
+    return counted(OP_TRIG, ::tan(a._value));
+  }
+  friend CountingScalar atan(const CountingScalar &a) {
+    return counted(OP_ATAN, ::atan(a._value));
+  }
+  friend CountingScalar atan2(const CountingScalar &a,
+                              const CountingScalar &b) {
+    return counted(OP_ATAN, ::atan2(a._value, b._value));
+  }
+  friend CountingScalar asin(const CountingScalar &a) {
+    return counted(OP_ATAN, ::asin(a._value));
+  }
+  friend CountingScalar acos(const CountingScalar &a) {
+    return counted(OP_ATAN, ::acos(a._value));
+  }
+  friend CountingScalar floor(const CountingScalar &a) {
+    return counted(OP_FLOOR, ::floor(a._value));
+  }
+  friend CountingScalar ceil(const CountingScalar &a) {
+    return counted(OP_FLOOR, ::ceil(a._value));
+  }
+  friend CountingScalar fabs(const CountingScalar &a) {
+    return counted(OP_CMP, ::fabs(a._value));
+  }
+
+private:
+  static CountingScalar counted(scalar_op_t op, double value) {
+    opCounts().ops[op]++;
+    return CountingScalar(value);
+  }
+
+  static bool compared(bool result) {
+    opCounts().ops[OP_CMP]++;
+    return result;
+  }
+
+  double _value;
+}; // end CountingScalar class
+} // namespace profiling
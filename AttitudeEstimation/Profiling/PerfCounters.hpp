@@ -0,0 +1,310 @@
+#pragma once
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace profiling {
+
+/**
+ * @brief a counter to open with perf_event_open.
+ */
+struct PerfEventSpec {
+  const char *name; // column name in reports
+  uint32_t type;    // PERF_TYPE_*
+  uint64_t config;  // event selector for the type
+};
+
+/**
+ * @brief the CPU time of the calling thread, in ns. A software event, so it
+ * is available even where the hardware counters are not, such as in most
+ * virtual machines.
+ */
+inline PerfEventSpec taskClockEvent() {
+  PerfEventSpec spec = {"task-clock", PERF_TYPE_SOFTWARE,
+                        PERF_COUNT_SW_TASK_CLOCK};
+  return spec;
+}
+
+/**
+ * @brief returns the model specific raw event counting retired double
+ * precision floating point instructions, if this CPU has a known one.
+ * @param spec the event to fill in.
+ * @return true if the CPU has a known event, false otherwise.
+ */
+inline bool floatingPointEvent(PerfEventSpec &spec) {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  char vendor[13];
+  memcpy(vendor, &ebx, 4);
+  memcpy(vendor + 4, &edx, 4);
+  memcpy(vendor + 8, &ecx, 4);
+  vendor[12] = 0;
+
+  spec.name = "fp-ops";
+  spec.type = PERF_TYPE_RAW;
+  if (strcmp(vendor, "GenuineIntel") == 0) {
+    // FP_ARITH_INST_RETIRED: scalar, 128 bit and 256 bit packed double
+    spec.config = 0x15C7;
+    return true;
+  }
+  if (strcmp(vendor, "AuthenticAMD") == 0) {
+    // retired SSE/AVX FLOPs, every type
+    spec.config = 0xFF03;
+    return true;
+  }
+#endif
+  return false;
+}
+
+/**
+ * @brief returns the default counters: cycles, instructions, branch misses,
+ * L1 data cache read misses, floating point operations where the CPU has a
+ * known event, and the task clock.
+ * @return the counters.
+ */
+inline std::vector<PerfEventSpec> defaultEvents() {
+  std::vector<PerfEventSpec> events;
+  PerfEventSpec cycles = {"cycles", PERF_TYPE_HARDWARE,
+                          PERF_COUNT_HW_CPU_CYCLES};
+  PerfEventSpec instructions = {"instructions", PERF_TYPE_HARDWARE,
+                                PERF_COUNT_HW_INSTRUCTIONS};
+  PerfEventSpec branch_misses = {"branch-misses", PERF_TYPE_HARDWARE,
+                                 PERF_COUNT_HW_BRANCH_MISSES};
+  PerfEventSpec l1_misses = {"L1d-misses", PERF_TYPE_HW_CACHE,
+                             PERF_COUNT_HW_CACHE_L1D |
+                                 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+  events.push_back(cycles);
+  events.push_back(instructions);
+  events.push_back(branch_misses);
+  events.push_back(l1_misses);
+
+  PerfEventSpec fp_ops;
+  if (floatingPointEvent(fp_ops)) {
+    events.push_back(fp_ops);
+  }
+  events.push_back(taskClockEvent());
+  return events;
+}
+
+/**
+ * @brief a set of perf_event_open counters on the calling thread, counting
+ * user space only. Each counter is opened on its own, so counters the CPU,
+ * kernel or hypervisor does not provide are reported as unavailable instead
+ * of failing the whole set. Counts are scaled up when the kernel had to
+ * multiplex the counters.
+ */
+class PerfCounters {
+public:
+  /**
+   * @brief default constructor for PerfCounters class.
+   */
+  PerfCounters() {}
+
+  PerfCounters(const PerfCounters &other) = delete;
+  PerfCounters &operator=(const PerfCounters &other) = delete;
+
+  /**
+   * @brief destructor for PerfCounters class. Closes the counters.
+   */
+  ~PerfCounters() { this->close(); }
+
+  /**
+   * @brief opens a set of counters, closing any open ones first.
+   * @param events the counters to open.
+   * @return the number of counters that could be opened.
+   */
+  size_t open(const std::vector<PerfEventSpec> &events) {
+    this->close();
+    size_t opened = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = events[i].type;
+      attr.config = events[i].config;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format =
+          PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      Counter counter;
+      counter.spec = events[i];
+      counter.fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+      counter.error = counter.fd < 0 ? errno : 0;
+      opened += counter.fd >= 0;
+      this->_counters.push_back(counter);
+    }
+    return opened;
+  }
+
+  /**
+   * @brief closes every counter.
+   */
+  void close() {
+    for (size_t i = 0; i < this->_counters.size(); i++) {
+      if (this->_counters[i].fd >= 0) {
+        ::close(this->_counters[i].fd);
+      }
+    }
+    this->_counters.clear();
+  }
+
+  /**
+   * @brief returns the number of requested counters, open or not.
+   * @return the counter count.
+   */
+  size_t size() const { return this->_counters.size(); }
+
+  /**
+   * @brief returns the name of a counter.
+   * @param index the counter index.
+   * @return the counter name.
+   */
+  const char *name(size_t index) const {
+    return this->_counters[index].spec.name;
+  }
+
+  /**
+   * @brief returns whether a counter could be opened.
+   * @param index the counter index.
+   * @return true if the counter is counting, false otherwise.
+   */
+  bool available(size_t index) const {
+    return this->_counters[index].fd >= 0;
+  }
+
+  /**
+   * @brief returns why a counter could not be opened.
+   * @param index the counter index.
+   * @return the error message, or an empty string if it is open.
+   */
+  const char *getError(size_t index) const {
+    return this->available(index) ? "" : strerror(this->_counters[index].error);
+  }
+
+  /**
+   * @brief zeroes and starts every open counter.
+   */
+  void start() {
+    for (size_t i = 0; i < this->_counters.size(); i++) {
+      if (this->_counters[i].fd >= 0) {
+        ioctl(this->_counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+      }
+    }
+    for (size_t i = 0; i < this->_counters.size(); i++) {
+      if (this->_counters[i].fd >= 0) {
+        ioctl(this->_counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+  }
+
+  /**
+   * @brief stops every open counter.
+   */
+  void stop() {
+    for (size_t i = 0; i < this->_counters.size(); i++) {
+      if (this->_counters[i].fd >= 0) {
+        ioctl(this->_counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+  }
+
+  /**
+   * @brief reads every counter since the last start().
+   * @param values one count per counter, scaled for multiplexing. Counters
+   * that are not open, or never got scheduled, read as a negative value.
+   */
+  void read(std::vector<double> &values) const {
+    values.assign(this->_counters.size(), -1.0);
+    for (size_t i = 0; i < this->_counters.size(); i++) {
+      uint64_t data[3]; // value, time enabled, time running
+      if (this->_counters[i].fd < 0 ||
+          ::read(this->_counters[i].fd, data, sizeof(data)) !=
+              (ssize_t)sizeof(data) ||
+          data[2] == 0) {
+        continue;
+      }
+      values[i] = (double)data[0] * ((double)data[1] / (double)data[2]);
+    }
+  }
+
+private:
+  struct Counter {
+    PerfEventSpec spec;
+    int fd;
+    int error;
+  };
+
+  std::vector<Counter> _counters;
+}; // end PerfCounters class
+
+/**
+ * @brief hides a value from the optimizer, so a kernel under test is not
+ * folded away or hoisted out of its loop.
+ * @param value the value the kernel produced or consumed.
+ */
+template <typename T> inline void keep(T &value) {
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+/**
+ * @brief the per-call cost of a kernel.
+ */
+struct KernelProfile {
+  uint64_t calls;                // number of timed calls
+  double ns_per_call;            // wall clock time per call
+  std::vector<double> per_call;  // counter values per call, negative if n/a
+};
+
+/**
+ * @brief runs a kernel under the counters and averages them per call. The
+ * kernel is run once untimed first, to fault in its code and data.
+ * @param counters the open counters.
+ * @param calls the number of timed calls.
+ * @param kernel the kernel, a callable taking no arguments.
+ * @param profile the profile to fill in.
+ */
+template <typename KernelT>
+void profileKernel(PerfCounters &counters, uint64_t calls, KernelT &&kernel,
+                   KernelProfile &profile) {
+  kernel();
+
+  struct timespec begin;
+  struct timespec end;
+  counters.start();
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for (uint64_t call = 0; call < calls; call++) {
+    kernel();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  counters.stop();
+
+  counters.read(profile.per_call);
+  for (size_t i = 0; i < profile.per_call.size(); i++) {
+    if (profile.per_call[i] >= 0) {
+      profile.per_call[i] /= calls;
+    }
+  }
+  profile.calls = calls;
+  profile.ns_per_call = ((end.tv_sec - begin.tv_sec) * 1e9 +
+                         (end.tv_nsec - begin.tv_nsec)) /
+                        calls;
+}
+} // namespace profiling
@@ -0,0 +1,205 @@
+#include "../EstimationAlgs/ComplementaryFilter/ComplementaryFilter.hpp"
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../EstimationAlgs/MahonyFilter/MahonyFilter.hpp"
+#include "../SensorDriver/AlgParams.hpp"
+#include "../Simulation/ImuSimulator.hpp"
+#include "../Simulation/Trajectory.hpp"
+#include "CountingScalar.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace filters;
+using namespace profiling;
+
+/**
+ * @brief the command line options of the operation counting tool.
+ */
+struct CountOptions {
+  uint64_t samples = 1000;       // updates per filter
+  uint64_t seed = 1;             // simulation noise seed
+  bool has_weights = false;      // whether to print the weighted cost
+  double weights[OP_COUNT] = {}; // cost of one operation of each category
+  bool csv = false;              // CSV instead of a table
+};
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --samples <n>       updates per filter (default 1000)\n"
+          "  --seed <n>          simulation noise seed\n"
+          "  --weights <w,...>   cost of one add, mul, div, cmp, sqrt, pow,\n"
+          "                      trig, atan and floor, e.g. in cycles of the\n"
+          "                      target MCU, to print a weighted cost per\n"
+          "                      update\n"
+          "  --csv               print CSV instead of a table\n",
+          name);
+}
+
+static bool parseWeights(const char *text, double weights[OP_COUNT]) {
+  for (size_t op = 0; op < OP_COUNT; op++) {
+    char *end;
+    weights[op] = strtod(text, &end);
+    if (end == text || (op + 1 < OP_COUNT && *end != ',')) {
+      return false;
+    }
+    text = end + 1;
+  }
+  return true;
+}
+
+static bool parseOptions(int argc, char **argv, CountOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "--samples") == 0 && has_value) {
+      options.samples = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--seed") == 0 && has_value) {
+      options.seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--weights") == 0 && has_value) {
+      if (!parseWeights(argv[++i], options.weights)) {
+        return false;
+      }
+      options.has_weights = true;
+    } else if (strcmp(arg, "--csv") == 0) {
+      options.csv = true;
+    } else {
+      return false;
+    }
+  }
+  return options.samples > 0;
+}
+
+/**
+ * @brief the operation counts of one filter over a run of updates.
+ */
+struct FilterOpCounts {
+  const char *filter;
+  uint64_t updates;
+  OpCounts sum;       // every operation of the run
+  uint64_t max_total; // most operations in a single update
+};
+
+/**
+ * @brief runs a filter instantiated with CountingScalar over simulated
+ * samples, counting the operations of every update.
+ * @tparam FilterT the filter, with CountingScalar as its scalar type.
+ */
+template <typename FilterT>
+static FilterOpCounts countFilter(const char *name,
+                                  const CountOptions &options) {
+  simulation::ImuSimulator<simulation::SinusoidalTrajectory> simulator(
+      simulation::SinusoidalTrajectory::handheld(), 100.0,
+      simulation::NoiseModel::consumerMems(), options.seed);
+  simulation::SimulatedSample simulated;
+
+  FilterT filter;
+  structures::Quaternion<CountingScalar> estimate;
+  FilterOpCounts counts;
+  counts.filter = name;
+  counts.updates = options.samples;
+  counts.sum.reset();
+  counts.max_total = 0;
+  for (uint64_t i = 0; i < options.samples; i++) {
+    simulator.next(simulated);
+    SensorSample<CountingScalar> sample;
+    for (size_t axis = 0; axis < 3; axis++) {
+      sample.acc[axis] = simulated.measured.acc[axis];
+      sample.gyro[axis] = simulated.measured.gyro[axis];
+      sample.mag[axis] = simulated.measured.mag[axis];
+    }
+    sample.timestamp_us = simulated.measured.timestamp_us;
+
+    opCounts().reset();
+    filter.update(sample, estimate);
+    const OpCounts &update = opCounts();
+    for (size_t op = 0; op < OP_COUNT; op++) {
+      counts.sum.ops[op] += update.ops[op];
+    }
+    if (update.total() > counts.max_total) {
+      counts.max_total = update.total();
+    }
+  }
+  return counts;
+}
+
+static double weightedCost(const CountOptions &options,
+                           const FilterOpCounts &counts) {
+  double cost = 0;
+  for (size_t op = 0; op < OP_COUNT; op++) {
+    cost += options.weights[op] * counts.sum.ops[op];
+  }
+  return cost / counts.updates;
+}
+
+static void printHeader(const CountOptions &options) {
+  if (options.csv) {
+    printf("filter");
+    for (size_t op = 0; op < OP_COUNT; op++) {
+      printf(",%s", OpCounts::name((scalar_op_t)op));
+    }
+    printf(",total,max_total%s\n", options.has_weights ? ",cost" : "");
+    return;
+  }
+
+  printf("%-14s", "filter");
+  for (size_t op = 0; op < OP_COUNT; op++) {
+    printf(" %7s", OpCounts::name((scalar_op_t)op));
+  }
+  printf(" %8s %8s", "total", "max");
+  if (options.has_weights) {
+    printf(" %10s", "cost");
+  }
+  printf("\n");
+}
+
+static void printCounts(const CountOptions &options,
+                        const FilterOpCounts &counts) {
+  double updates = (double)counts.updates;
+  if (options.csv) {
+    printf("%s", counts.filter);
+    for (size_t op = 0; op < OP_COUNT; op++) {
+      printf(",%.2f", counts.sum.ops[op] / updates);
+    }
+    printf(",%.2f,%llu", counts.sum.total() / updates,
+           (unsigned long long)counts.max_total);
+    if (options.has_weights) {
+      printf(",%.1f", weightedCost(options, counts));
+    }
+    printf("\n");
+    return;
+  }
+
+  printf("%-14s", counts.filter);
+  for (size_t op = 0; op < OP_COUNT; op++) {
+    printf(" %7.1f", counts.sum.ops[op] / updates);
+  }
+  printf(" %8.1f %8llu", counts.sum.total() / updates,
+         (unsigned long long)counts.max_total);
+  if (options.has_weights) {
+    printf(" %10.1f", weightedCost(options, counts));
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  CountOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  // the filters with the gains the board runs, counted per update
+  printHeader(options);
+  printCounts(options,
+              countFilter<BasicComplementaryFilter<ComplementaryParams,
+                                                   CountingScalar>>(
+                  "complementary", options));
+  printCounts(options,
+              countFilter<BasicMadgwickFilter<MadgwickParams, CountingScalar>>(
+                  "madgwick", options));
+  printCounts(options,
+              countFilter<BasicMahonyFilter<MahonyParams, CountingScalar>>(
+                  "mahony", options));
+  return 0;
+}
@@ -0,0 +1,332 @@
+#include "../Euler/Euler.hpp"
+#include "../Matrix/Matrix.hpp"
+#include "../Quaternion/Quaternion.hpp"
+#include "../SensorDriver/FilterDriver.hpp"
+#include "../Simulation/ImuSimulator.hpp"
+#include "PerfCounters.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace filters;
+using namespace profiling;
+using namespace structures;
+
+/**
+ * @brief the command line options of the profiling tool.
+ */
+struct ProfileOptions {
+  const char *kernel = NULL;          // only run kernels containing this
+  uint64_t filter_calls = 200000;     // timed calls per filter kernel
+  uint64_t structure_calls = 2000000; // timed calls per structures kernel
+  bool csv = false;                   // CSV instead of a table
+};
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --kernel <text>     only profile kernels whose name contains\n"
+          "                      the text\n"
+          "  --calls <n>         timed calls per filter kernel (default\n"
+          "                      200000), ten times as many for the\n"
+          "                      structures kernels\n"
+          "  --csv               print CSV instead of a table\n",
+          name);
+}
+
+static bool parseOptions(int argc, char **argv, ProfileOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "--kernel") == 0 && has_value) {
+      options.kernel = argv[++i];
+    } else if (strcmp(arg, "--calls") == 0 && has_value) {
+      options.filter_calls = strtoull(argv[++i], NULL, 10);
+      options.structure_calls = 10 * options.filter_calls;
+    } else if (strcmp(arg, "--csv") == 0) {
+      options.csv = true;
+    } else {
+      return false;
+    }
+  }
+  return options.filter_calls > 0;
+}
+
+/**
+ * @brief runs the kernels selected by the options and prints one row per
+ * kernel.
+ */
+class KernelProfiler {
+public:
+  KernelProfiler(const ProfileOptions &options, PerfCounters &counters)
+      : _options(options), _counters(counters) {}
+
+  /**
+   * @brief prints the report header.
+   */
+  void printHeader() const {
+    if (this->_options.csv) {
+      printf("kernel,ns");
+      for (size_t i = 0; i < this->_counters.size(); i++) {
+        printf(",%s", this->_counters.name(i));
+      }
+      printf(",ipc\n");
+      return;
+    }
+
+    printf("%-28s %9s", "kernel", "ns");
+    for (size_t i = 0; i < this->_counters.size(); i++) {
+      printf(" %13s", this->_counters.name(i));
+    }
+    printf(" %6s\n", "ipc");
+  }
+
+  /**
+   * @brief profiles one kernel, if it is selected.
+   * @param name the kernel name.
+   * @param calls the number of timed calls.
+   * @param kernel the kernel, a callable taking no arguments.
+   */
+  template <typename KernelT>
+  void run(const char *name, uint64_t calls, KernelT &&kernel) {
+    if (this->_options.kernel != NULL &&
+        strstr(name, this->_options.kernel) == NULL) {
+      return;
+    }
+
+    KernelProfile profile;
+    profileKernel(this->_counters, calls, kernel, profile);
+
+    // instructions per cycle, when both are counted
+    double cycles = -1;
+    double instructions = -1;
+    for (size_t i = 0; i < this->_counters.size(); i++) {
+      if (strcmp(this->_counters.name(i), "cycles") == 0) {
+        cycles = profile.per_call[i];
+      } else if (strcmp(this->_counters.name(i), "instructions") == 0) {
+        instructions = profile.per_call[i];
+      }
+    }
+    double ipc = cycles > 0 && instructions >= 0 ? instructions / cycles : -1;
+
+    if (this->_options.csv) {
+      printf("%s,%.2f", name, profile.ns_per_call);
+      for (size_t i = 0; i < profile.per_call.size(); i++) {
+        if (profile.per_call[i] >= 0) {
+          printf(",%.3f", profile.per_call[i]);
+        } else {
+          printf(",");
+        }
+      }
+      if (ipc >= 0) {
+        printf(",%.2f\n", ipc);
+      } else {
+        printf(",\n");
+      }
+      return;
+    }
+
+    printf("%-28s %9.1f", name, profile.ns_per_call);
+    for (size_t i = 0; i < profile.per_call.size(); i++) {
+      if (profile.per_call[i] >= 0) {
+        printf(" %13.2f", profile.per_call[i]);
+      } else {
+        printf(" %13s", "n/a");
+      }
+    }
+    if (ipc >= 0) {
+      printf(" %6.2f\n", ipc);
+    } else {
+      printf(" %6s\n", "n/a");
+    }
+  }
+
+private:
+  const ProfileOptions &_options;
+  PerfCounters &_counters;
+}; // end KernelProfiler class
+
+/**
+ * @brief profiles the in-place update of a filter driver.
+ */
+template <available_filters_t selected_filter>
+static void profileFilter(KernelProfiler &profiler, const char *name,
+                          uint64_t calls) {
+  typename FilterDriverSelector<selected_filter>::type driver;
+  const std::vector<SensorSample<double>> &input =
+      simulation::handheldReadings();
+  Quaternion<double> estimate;
+  size_t i = 0;
+  uint64_t offset_us = 0;
+  profiler.run(name, calls, [&]() {
+    SensorSample<double> sample = input[i];
+    sample.timestamp_us += offset_us;
+    driver.update(sample, estimate);
+    keep(estimate);
+    if (++i == input.size()) {
+      // keep timestamps increasing across cycles
+      i = 0;
+      offset_us += input.back().timestamp_us + 10000U;
+    }
+  });
+}
+
+/**
+ * @brief fills a matrix with distinct non-trivial values.
+ */
+template <size_t rows, size_t cols>
+static Matrix<double, rows, cols> filledMatrix(double seed) {
+  Matrix<double, rows, cols> mat;
+  for (size_t row = 0; row < rows; row++) {
+    for (size_t col = 0; col < cols; col++) {
+      mat.setValue(row, col, seed + 0.37 * row - 0.11 * col);
+    }
+  }
+  return mat;
+}
+
+/**
+ * @brief profiles the structures operations at the shapes the filters use,
+ * and the idioms inside the filters that are suspected to be expensive.
+ */
+static void profileStructures(KernelProfiler &profiler, uint64_t calls) {
+  Matrix<double, 3, 1> a3 = filledMatrix<3, 1>(0.5);
+  Matrix<double, 3, 1> b3 = filledMatrix<3, 1>(-1.5);
+  Matrix<double, 3, 3> m33 = filledMatrix<3, 3>(0.1);
+  Matrix<double, 4, 4> a44 = filledMatrix<4, 4>(0.1);
+  Matrix<double, 4, 4> b44 = filledMatrix<4, 4>(-0.2);
+  Matrix<double, 6, 4> m64 = filledMatrix<6, 4>(0.2);
+  Matrix<double, 6, 1> v61 = filledMatrix<6, 1>(-0.3);
+  double values64[6][4];
+  for (size_t row = 0; row < 6; row++) {
+    for (size_t col = 0; col < 4; col++) {
+      values64[row][col] = 0.1 * row + 0.01 * col;
+    }
+  }
+
+  profiler.run("matrix 3x1 + 3x1", calls, [&]() {
+    keep(a3);
+    Matrix<double, 3, 1> sum = a3 + b3;
+    keep(sum);
+  });
+  profiler.run("matrix 3x1 * scalar", calls, [&]() {
+    keep(a3);
+    Matrix<double, 3, 1> scaled = a3 * 0.01;
+    keep(scaled);
+  });
+  profiler.run("matrix 3x1 norm", calls, [&]() {
+    keep(a3);
+    double norm = a3.norm();
+    keep(norm);
+  });
+  profiler.run("matrix 3x3 * 3x1", calls, [&]() {
+    keep(m33);
+    Matrix<double, 3, 1> rotated = m33 * a3;
+    keep(rotated);
+  });
+  profiler.run("matrix 4x4 * 4x4", calls, [&]() {
+    keep(a44);
+    Matrix<double, 4, 4> product = a44 * b44;
+    keep(product);
+  });
+  profiler.run("matrix 6x4^T * 6x1", calls, [&]() {
+    keep(m64);
+    Matrix<double, 4, 1> gradient = m64.transpose() * v61;
+    keep(gradient);
+  });
+  profiler.run("matrix 6x4 transpose", calls, [&]() {
+    keep(m64);
+    Matrix<double, 4, 6> transposed = m64.transpose();
+    keep(transposed);
+  });
+  profiler.run("matrix 6x4 from array", calls, [&]() {
+    keep(values64);
+    Matrix<double, 6, 4> mat(values64);
+    keep(mat);
+  });
+  profiler.run("matrix 6x4 copy", calls, [&]() {
+    keep(m64);
+    Matrix<double, 6, 4> copy(m64);
+    keep(copy);
+  });
+
+  Quaternion<double> q(0.1, 0.2, 0.3, 0.927);
+  Quaternion<double> r(-0.3, 0.1, 0.05, 0.948);
+  uint8_t index = 0;
+  profiler.run("quaternion * quaternion", calls, [&]() {
+    keep(q);
+    Quaternion<double> product = q * r;
+    keep(product);
+  });
+  profiler.run("quaternion norm", calls, [&]() {
+    keep(q);
+    Quaternion<double> normalized = q.norm();
+    keep(normalized);
+  });
+  profiler.run("quaternion operator[]", calls, [&]() {
+    // a varying index, as in the quaternion-to-DCM loops
+    keep(q);
+    double component = q[index];
+    keep(component);
+    index = (index + 1) & 3;
+  });
+  profiler.run("quaternion getters", calls, [&]() {
+    keep(q);
+    double component = q.getW() + q.getX() + q.getY() + q.getZ();
+    keep(component);
+  });
+
+  double x = 0.731;
+  profiler.run("pow(x, 2)", calls, [&]() {
+    keep(x);
+    double squared = pow(x, 2);
+    keep(squared);
+  });
+  profiler.run("pow(x, 0.5)", calls, [&]() {
+    keep(x);
+    double root = pow(x, 0.5);
+    keep(root);
+  });
+  profiler.run("sqrt(x)", calls, [&]() {
+    keep(x);
+    double root = sqrt(x);
+    keep(root);
+  });
+
+  Euler<double> euler(0.3, -0.2, 1.1, RADIANS);
+  profiler.run("euler toQuaternion", calls, [&]() {
+    keep(euler);
+    Quaternion<double> quat = euler.toQuaternion();
+    keep(quat);
+  });
+}
+
+int main(int argc, char **argv) {
+  ProfileOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  PerfCounters counters;
+  if (counters.open(defaultEvents()) == 0) {
+    fprintf(stderr, "no performance counters could be opened\n");
+  }
+  for (size_t i = 0; i < counters.size(); i++) {
+    if (!counters.available(i)) {
+      fprintf(stderr, "%s: %s\n", counters.name(i), counters.getError(i));
+    }
+  }
+
+  KernelProfiler profiler(options, counters);
+  profiler.printHeader();
+  profileFilter<COMPLEMENTARY>(profiler, "complementary update",
+                               options.filter_calls);
+  profileFilter<EKF>(profiler, "ekf update", options.filter_calls);
+  profileFilter<MADGWICK>(profiler, "madgwick update", options.filter_calls);
+  profileFilter<MAHONY>(profiler, "mahony update", options.filter_calls);
+  profileStructures(profiler, options.structure_calls);
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include "../EstimationAlgs/ComplementaryFilter/ComplementaryFilter.hpp"
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../EstimationAlgs/MahonyFilter/MahonyFilter.hpp"
+#include "../Quaternion/Quaternion.hpp"
+#include "CountingScalar.hpp"
+#include "gtest/gtest.h"
+
+using namespace filters;
+using namespace profiling;
+using namespace structures;
+
+TEST(CountingScalarTesting, TestCountsOperations) {
+  opCounts().reset();
+  CountingScalar a = 3.0;
+  CountingScalar b = 4.0;
+  CountingScalar c = sqrt(a * a + b * b) / 2;
+  ASSERT_DOUBLE_EQ(2.5, c.value());
+  ASSERT_TRUE(c > 0);
+  c -= pow(a, 2);
+  ASSERT_DOUBLE_EQ(-6.5, c.value());
+  ASSERT_DOUBLE_EQ(atan2(1.0, 2.0), atan2(CountingScalar(1.0), b / 2).value());
+
+  const OpCounts &counts = opCounts();
+  ASSERT_EQ(2U, counts.ops[OP_ADD]);
+  ASSERT_EQ(2U, counts.ops[OP_MUL]);
+  ASSERT_EQ(2U, counts.ops[OP_DIV]);
+  ASSERT_EQ(1U, counts.ops[OP_CMP]);
+  ASSERT_EQ(1U, counts.ops[OP_SQRT]);
+  ASSERT_EQ(1U, counts.ops[OP_POW]);
+  ASSERT_EQ(1U, counts.ops[OP_ATAN]);
+  ASSERT_EQ(0U, counts.ops[OP_TRIG]);
+  ASSERT_EQ(10U, counts.total());
+
+  // copies and construction are free
+  CountingScalar copy = c;
+  CountingScalar zero;
+  zero = copy;
+  ASSERT_EQ(10U, opCounts().total());
+}
+
+TEST(CountingScalarTesting, TestQuaternionCounts) {
+  Quaternion<CountingScalar> q(0.1, 0.2, 0.3, 0.9);
+  Quaternion<CountingScalar> r(-0.3, 0.1, 0.05, 0.9);
+
+  opCounts().reset();
+  Quaternion<CountingScalar> product = q * r;
+  ASSERT_EQ(16U, opCounts().ops[OP_MUL]);
+  ASSERT_EQ(12U, opCounts().ops[OP_ADD]);
+  ASSERT_DOUBLE_EQ((Quaternion<double>(0.1, 0.2, 0.3, 0.9) *
+                    Quaternion<double>(-0.3, 0.1, 0.05, 0.9))
+                       .getW(),
+                   product.getW().value());
+}
+
+/**
+ * @brief checks that a filter gives bit-identical estimates with double and
+ * CountingScalar, and that each update performs operations.
+ */
+template <typename GainsT, template <typename, typename> class FilterT>
+static void expectSameEstimates(const GainsT &gains) {
+  FilterT<GainsT, double> reference(gains);
+  FilterT<GainsT, CountingScalar> counting(gains);
+  Quaternion<double> expected;
+  Quaternion<CountingScalar> estimate;
+  for (int i = 0; i < 100; i++) {
+    double t = 0.01 * i;
+    SensorSample<double> sample = {{0.3 * sin(t), -0.2, 9.7},
+                                   {0.1, -0.2 * cos(t), 0.3},
+                                   {0.2, 0.4, -0.1 + 0.05 * t},
+                                   (uint64_t)i * 10000U};
+    SensorSample<CountingScalar> counted_sample;
+    for (size_t axis = 0; axis < 3; axis++) {
+      counted_sample.acc[axis] = sample.acc[axis];
+      counted_sample.gyro[axis] = sample.gyro[axis];
+      counted_sample.mag[axis] = sample.mag[axis];
+    }
+    counted_sample.timestamp_us = sample.timestamp_us;
+
+    reference.update(sample, expected);
+    opCounts().reset();
+    counting.update(counted_sample, estimate);
+    ASSERT_GT(opCounts().total(), 0U);
+    ASSERT_EQ(expected.getW(), estimate.getW().value());
+    ASSERT_EQ(expected.getX(), estimate.getX().value());
+    ASSERT_EQ(expected.getY(), estimate.getY().value());
+    ASSERT_EQ(expected.getZ(), estimate.getZ().value());
+  }
+}
+
+TEST(CountingScalarTesting, TestFiltersMatchDouble) {
+  expectSameEstimates<ComplementaryGains, BasicComplementaryFilter>(
+      ComplementaryGains(0.9));
+  expectSameEstimates<MadgwickGains, BasicMadgwickFilter>(
+      MadgwickGains(0.1));
+  expectSameEstimates<MahonyGains, BasicMahonyFilter>(MahonyGains(0.1, 1.0));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+#include "PerfCounters.hpp"
+#include "gtest/gtest.h"
+#include <math.h>
+#include <vector>
+
+using namespace profiling;
+
+TEST(PerfCountersTesting, TestDefaultEvents) {
+  std::vector<PerfEventSpec> events = defaultEvents();
+  ASSERT_GE(events.size(), 5U);
+  ASSERT_STREQ("cycles", events[0].name);
+  ASSERT_STREQ("task-clock", events.back().name);
+}
+
+TEST(PerfCountersTesting, TestUnavailableCounter) {
+  // an event type no kernel provides is reported, not fatal
+  std::vector<PerfEventSpec> events;
+  PerfEventSpec bogus = {"bogus", 0x7FFFFFFF, 0};
+  events.push_back(bogus);
+  events.push_back(taskClockEvent());
+
+  PerfCounters counters;
+  counters.open(events);
+  ASSERT_EQ(2U, counters.size());
+  ASSERT_FALSE(counters.available(0));
+  ASSERT_STRNE("", counters.getError(0));
+
+  KernelProfile profile;
+  double x = 0.5;
+  profileKernel(counters, 1000, [&]() {
+    x = sqrt(x + 1.0);
+    keep(x);
+  }, profile);
+  ASSERT_EQ(2U, profile.per_call.size());
+  ASSERT_LT(profile.per_call[0], 0.0);
+}
+
+TEST(PerfCountersTesting, TestTaskClock) {
+  std::vector<PerfEventSpec> events;
+  events.push_back(taskClockEvent());
+  PerfCounters counters;
+  if (counters.open(events) == 0) {
+    GTEST_SKIP() << "perf_event_open is not permitted: "
+                 << counters.getError(0);
+  }
+
+  // the CPU time per call tracks the wall clock time per call of a busy
+  // kernel
+  KernelProfile profile;
+  double x = 0.5;
+  profileKernel(counters, 200000, [&]() {
+    x = sqrt(x + 1.0);
+    keep(x);
+  }, profile);
+  ASSERT_EQ(200000U, profile.calls);
+  ASSERT_GT(profile.ns_per_call, 0.0);
+  ASSERT_GT(profile.per_call[0], 0.0);
+  ASSERT_NEAR(profile.ns_per_call, profile.per_call[0],
+              0.5 * profile.ns_per_call);
+
+  // twice the work costs about twice the CPU time
+  KernelProfile doubled;
+  profileKernel(counters, 200000, [&]() {
+    x = sqrt(x + 1.0);
+    keep(x);
+    x = sqrt(x + 1.0);
+    keep(x);
+  }, doubled);
+  ASSERT_GT(doubled.per_call[0], 1.3 * profile.per_call[0]);
+}
+
+TEST(PerfCountersTesting, TestHardwareCounters) {
+  PerfCounters counters;
+  counters.open(defaultEvents());
+  if (!counters.available(1)) {
+    GTEST_SKIP() << "no hardware counters: " << counters.getError(1);
+  }
+
+  // a fixed length loop retires at least one instruction per iteration
+  KernelProfile profile;
+  double x = 0.5;
+  profileKernel(counters, 100000, [&]() {
+    for (int i = 0; i < 10; i++) {
+      x = x * 0.999 + 0.001;
+      keep(x);
+    }
+  }, profile);
+  ASSERT_GT(profile.per_call[1], 10.0);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
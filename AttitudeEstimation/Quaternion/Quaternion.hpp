@@ -60,7 +60,7 @@ public:
    * @param other the other Quaternion to multiply with this one
    * @returns the product of the multiplication
    */
-  Quaternion<T> operator*(const Quaternion &other) {
+  Quaternion<T> operator*(const Quaternion &other) const {
     Quaternion<T> new_quat;
     new_quat.setW(this->getW() * other.getW() - this->getX() * other.getX() -
                   this->getY() * other.getY() - this->getZ() * other.getZ());
@@ -80,7 +80,7 @@ public:
    * @returns the product of the multiplication
    */
 
-  Quaternion<T> operator*(const T &other) {
+  Quaternion<T> operator*(const T &other) const {
     Quaternion<T> new_quat;
     new_quat.setW(this->getW() * other);
     new_quat.setX(this->getX() * other);
@@ -95,7 +95,7 @@ public:
    * @param other the other Quaternion to add to this one.
    * @returns the result of the addition as a quaternion
    */
-  Quaternion<T> operator+(const Quaternion &other) {
+  Quaternion<T> operator+(const Quaternion &other) const {
     Quaternion<T> new_quat;
 
     new_quat.setW(this->getW() + other.getW());
@@ -112,7 +112,7 @@ public:
    * be returned if magnitude of quaternion is zero.
    * @return the normalized quaternion.
    */
-  Quaternion<T> norm() {
+  Quaternion<T> norm() const {
     Quaternion<T> quat_norm;
 
     // compute squared magnitude
@@ -143,7 +143,7 @@ public:
    * quaternion.
    * @return the conjugate quaternion
    */
-  Quaternion<T> conj() {
+  Quaternion<T> conj() const {
     Quaternion<T> quat_conj;
 
     quat_conj.setW(this->getW());
@@ -203,10 +203,10 @@ public:
   void setW(T w) { this->_w = w; }
 
   /**
-   * @brief overide for accessor operator
+   * @brief overide for accessor operator. Indices past 3 read as zero.
    */
-  T operator[](uint8_t i) {
-    T return_val;
+  T operator[](uint8_t i) const {
+    T return_val = T();
     if (i == 0) {
       return_val = this->getW();
     } else if (i == 1) {
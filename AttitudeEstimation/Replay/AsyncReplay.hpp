@@ -0,0 +1,483 @@
+#pragma once
+
+#include "../Evaluation/AccuracyMetrics.hpp"
+#include "../ImuLog/ImuLog.hpp"
+#include "../SensorDriver/Calibration.hpp"
+#include "../SensorDriver/SensorSources.hpp"
+#include "Coroutines.hpp"
+#include <chrono>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+namespace replay {
+
+/**
+ * @brief the stages of the asynchronous replay pipeline, in data flow order.
+ */
+typedef enum {
+  STAGE_READ,
+  STAGE_DECODE,
+  STAGE_CALIBRATE,
+  STAGE_FILTER,
+  STAGE_SCORE,
+  STAGE_WRITE,
+  ASYNC_STAGE_COUNT
+} async_stage_t;
+
+/**
+ * @brief returns the name of a pipeline stage.
+ * @param stage the stage.
+ * @return the stage name.
+ */
+inline const char *asyncStageName(async_stage_t stage) {
+  static const char *const names[ASYNC_STAGE_COUNT] = {
+      "read", "decode", "calibrate", "filter", "score", "write"};
+  return names[stage];
+}
+
+/**
+ * @brief the recording formats the pipeline decodes.
+ */
+typedef enum { RECORDING_CSV, RECORDING_IMULOG } recording_format_t;
+
+/**
+ * @brief the settings of an asynchronous replay.
+ */
+struct AsyncReplaySettings {
+  recording_format_t format = RECORDING_CSV;
+  size_t block_bytes = 1 << 18;  // bytes per read request
+  size_t batch_samples = 4096;   // samples per batch after decoding
+  size_t channel_depth = 4;      // values buffered between two stages
+  double warmup_s = 10.0;        // leading time left out of the error scores
+  int output_fd = -1;            // estimate CSV destination, or -1
+};
+
+/**
+ * @brief what one stage did during a replay. Busy time covers the stage's
+ * own work, or the system calls for the read and write stages, but never
+ * the time spent suspended on a channel.
+ */
+struct AsyncStageStats {
+  uint64_t batches = 0;       // values produced, or consumed by the sink
+  uint64_t samples = 0;       // samples handled
+  uint64_t bytes = 0;         // bytes read or written
+  uint64_t busy_ns = 0;       // time spent working
+  uint64_t input_waits = 0;   // receives that found the input empty
+  uint64_t output_waits = 0;  // sends that found the output full
+};
+
+/**
+ * @brief the outcome of an asynchronous replay.
+ */
+struct AsyncReplayReport {
+  AsyncStageStats stages[ASYNC_STAGE_COUNT];
+  evaluation::ErrorAccumulator errors; // errors after the warmup
+  uint64_t samples = 0;                // samples replayed
+  uint64_t skipped_lines = 0;          // CSV lines that did not parse
+  uint64_t wall_ns = 0;                // replay duration
+  const char *error = NULL;            // why the replay stopped, or NULL
+};
+
+/**
+ * @brief a run of samples moving down the pipeline. Every stage fills in
+ * its own columns and passes the batch on.
+ */
+struct ReplayBatch {
+  std::vector<filters::RawSensorSample> raw;
+  std::vector<structures::Quaternion<double>> ground_truth;
+  std::vector<filters::SensorSample<double>> samples;
+  std::vector<structures::Quaternion<double>> estimates;
+  std::vector<double> errors;
+};
+
+/**
+ * @brief replays a recording through a filter as a pipeline of coroutines:
+ * read, decode, calibrate, filter, score and write. The stages share one
+ * thread and hand batches over bounded channels, so a stage that falls
+ * behind suspends the stages feeding it instead of letting buffers grow.
+ * Reads and writes run on an AsyncIo thread, and while a stage waits for
+ * them the scheduler keeps the compute stages busy on the batches already
+ * in flight.
+ * @tparam FilterT the filter type. Must provide
+ * update(const SensorSample<double> &, structures::Quaternion<double> &).
+ */
+template <typename FilterT> class AsyncReplay {
+public:
+  /**
+   * @brief constructor for AsyncReplay class.
+   * @param filter the filter to update, used as is.
+   * @param settings the replay settings.
+   */
+  AsyncReplay(FilterT &filter, const AsyncReplaySettings &settings)
+      : _filter(filter), _settings(settings), _io(_scheduler),
+        _blocks(_scheduler, settings.channel_depth),
+        _decoded(_scheduler, settings.channel_depth),
+        _calibrated(_scheduler, settings.channel_depth),
+        _filtered(_scheduler, settings.channel_depth),
+        _scored(_scheduler, settings.channel_depth) {
+    if (this->_settings.block_bytes == 0) {
+      this->_settings.block_bytes = 1;
+    }
+    if (this->_settings.batch_samples == 0) {
+      this->_settings.batch_samples = 1;
+    }
+    this->_calibration = filters::SensorCalibration<double>::nominal();
+  }
+
+  AsyncReplay(const AsyncReplay &other) = delete;
+  AsyncReplay &operator=(const AsyncReplay &other) = delete;
+
+  /**
+   * @brief replays a recording. Can only be called once.
+   * @param input_fd the recording, read from its current offset.
+   * @param report the report to fill.
+   * @return true if the whole recording was replayed, false otherwise. See
+   * report.error.
+   */
+  bool run(int input_fd, AsyncReplayReport &report) {
+    this->_report = &report;
+    auto start = std::chrono::steady_clock::now();
+    this->_scheduler.spawn(this->readStage(input_fd));
+    this->_scheduler.spawn(this->decodeStage());
+    this->_scheduler.spawn(this->calibrateStage());
+    this->_scheduler.spawn(this->filterStage());
+    this->_scheduler.spawn(this->scoreStage());
+    this->_scheduler.spawn(this->writeStage());
+    if (!this->_scheduler.run() && report.error == NULL) {
+      report.error = "pipeline stalled";
+    }
+    report.wall_ns = elapsedNs(start);
+
+    AsyncStageStats *stages = report.stages;
+    stages[STAGE_READ].output_waits = this->_blocks.getSendWaits();
+    stages[STAGE_DECODE].input_waits = this->_blocks.getReceiveWaits();
+    stages[STAGE_DECODE].output_waits = this->_decoded.getSendWaits();
+    stages[STAGE_CALIBRATE].input_waits = this->_decoded.getReceiveWaits();
+    stages[STAGE_CALIBRATE].output_waits = this->_calibrated.getSendWaits();
+    stages[STAGE_FILTER].input_waits = this->_calibrated.getReceiveWaits();
+    stages[STAGE_FILTER].output_waits = this->_filtered.getSendWaits();
+    stages[STAGE_SCORE].input_waits = this->_filtered.getReceiveWaits();
+    stages[STAGE_SCORE].output_waits = this->_scored.getSendWaits();
+    stages[STAGE_WRITE].input_waits = this->_scored.getReceiveWaits();
+    return report.error == NULL;
+  }
+
+private:
+  static uint64_t
+  elapsedNs(std::chrono::steady_clock::time_point start) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
+
+  /**
+   * @brief stops the pipeline early: every channel is closed, so each
+   * stage sees the end of its input or a refused send and returns.
+   */
+  void fail(const char *error) {
+    if (this->_report->error == NULL) {
+      this->_report->error = error;
+    }
+    this->_blocks.close();
+    this->_decoded.close();
+    this->_calibrated.close();
+    this->_filtered.close();
+    this->_scored.close();
+  }
+
+  Task readStage(int fd) {
+    AsyncStageStats &stats = this->_report->stages[STAGE_READ];
+    while (true) {
+      std::vector<char> block(this->_settings.block_bytes);
+      AsyncIo::Request request = this->_io.read(fd, block.data(), block.size());
+      ssize_t length = co_await request;
+      stats.busy_ns += request.ns;
+      if (length < 0) {
+        this->fail("cannot read the recording");
+        co_return;
+      }
+      if (length == 0) {
+        break;
+      }
+      block.resize(length);
+      stats.batches++;
+      stats.bytes += length;
+      if (!co_await this->_blocks.send(std::move(block))) {
+        co_return;
+      }
+    }
+    this->_blocks.close();
+  }
+
+  /**
+   * @brief appends one decoded sample to the batch being built.
+   */
+  void addSample(ReplayBatch &batch, const filters::AcquiredSample &sample) {
+    batch.raw.push_back(sample.raw);
+    batch.ground_truth.push_back(sample.ground_truth);
+  }
+
+  /**
+   * @brief decodes the complete CSV lines of a block. A line cut by the end
+   * of the block is kept in the carry buffer until the next block.
+   */
+  void decodeCsv(const std::vector<char> &block, std::vector<char> &carry,
+                 ReplayBatch &batch) {
+    filters::AcquiredSample sample;
+    size_t start = 0;
+    for (size_t i = 0; i < block.size(); i++) {
+      if (block[i] != '\n') {
+        continue;
+      }
+      const char *line;
+      if (!carry.empty()) {
+        carry.insert(carry.end(), block.begin() + start, block.begin() + i);
+        carry.push_back('\0');
+        line = carry.data();
+      } else {
+        this->_line.assign(block.begin() + start, block.begin() + i);
+        this->_line.push_back('\0');
+        line = this->_line.data();
+      }
+      if (filters::parseRecordedSample(line, sample)) {
+        this->addSample(batch, sample);
+      } else {
+        this->_report->skipped_lines++;
+      }
+      carry.clear();
+      start = i + 1;
+    }
+    carry.insert(carry.end(), block.begin() + start, block.end());
+  }
+
+  /**
+   * @brief decodes the complete log records of a block, after the header.
+   * A record cut by the end of the block is kept in the carry buffer.
+   * @return false if the header is invalid, true otherwise.
+   */
+  bool decodeImuLog(const std::vector<char> &block, std::vector<char> &carry,
+                    bool &has_header, ReplayBatch &batch) {
+    carry.insert(carry.end(), block.begin(), block.end());
+    size_t offset = 0;
+    if (!has_header) {
+      if (carry.size() < sizeof(imulog::ImuLogHeader)) {
+        return true;
+      }
+      imulog::ImuLogHeader header;
+      memcpy(&header, carry.data(), sizeof(header));
+      if (imulog::validateHeader(header) != NULL) {
+        return false;
+      }
+      this->_calibration = imulog::headerCalibration(header);
+      has_header = true;
+      offset = sizeof(header);
+    }
+
+    filters::AcquiredSample sample;
+    imulog::LoggedSample record;
+    for (; offset + sizeof(record) <= carry.size(); offset += sizeof(record)) {
+      memcpy(&record, carry.data() + offset, sizeof(record));
+      imulog::fromLoggedSample(record, sample);
+      this->addSample(batch, sample);
+    }
+    carry.erase(carry.begin(), carry.begin() + offset);
+    return true;
+  }
+
+  Task decodeStage() {
+    AsyncStageStats &stats = this->_report->stages[STAGE_DECODE];
+    std::vector<char> carry;
+    bool has_header = false;
+    ReplayBatch batch;
+    while (std::optional<std::vector<char>> block =
+               co_await this->_blocks.receive()) {
+      auto start = std::chrono::steady_clock::now();
+      if (this->_settings.format == RECORDING_IMULOG) {
+        if (!this->decodeImuLog(*block, carry, has_header, batch)) {
+          this->fail("not a valid IMU log");
+          co_return;
+        }
+      } else {
+        this->decodeCsv(*block, carry, batch);
+      }
+      stats.busy_ns += elapsedNs(start);
+      stats.bytes += block->size();
+
+      // a block may complete several batches; the rest waits for the next
+      size_t size = this->_settings.batch_samples;
+      size_t first = 0;
+      for (; batch.raw.size() - first >= size; first += size) {
+        ReplayBatch full;
+        full.raw.assign(batch.raw.begin() + first,
+                        batch.raw.begin() + first + size);
+        full.ground_truth.assign(batch.ground_truth.begin() + first,
+                                 batch.ground_truth.begin() + first + size);
+        stats.batches++;
+        stats.samples += size;
+        if (!co_await this->_decoded.send(std::move(full))) {
+          co_return;
+        }
+      }
+      batch.raw.erase(batch.raw.begin(), batch.raw.begin() + first);
+      batch.ground_truth.erase(batch.ground_truth.begin(),
+                               batch.ground_truth.begin() + first);
+    }
+
+    // a last CSV line without a newline still counts
+    if (this->_settings.format == RECORDING_CSV && !carry.empty()) {
+      carry.push_back('\n');
+      std::vector<char> last;
+      last.swap(carry);
+      this->decodeCsv(last, carry, batch);
+    }
+    if (!batch.raw.empty()) {
+      stats.batches++;
+      stats.samples += batch.raw.size();
+      co_await this->_decoded.send(std::move(batch));
+    }
+    this->_decoded.close();
+  }
+
+  Task calibrateStage() {
+    AsyncStageStats &stats = this->_report->stages[STAGE_CALIBRATE];
+    while (std::optional<ReplayBatch> batch =
+               co_await this->_decoded.receive()) {
+      auto start = std::chrono::steady_clock::now();
+      batch->samples.resize(batch->raw.size());
+      this->_calibration.applyBatch(batch->raw.data(), batch->raw.size(),
+                                    batch->samples.data());
+      stats.busy_ns += elapsedNs(start);
+      stats.batches++;
+      stats.samples += batch->raw.size();
+      if (!co_await this->_calibrated.send(std::move(*batch))) {
+        co_return;
+      }
+    }
+    this->_calibrated.close();
+  }
+
+  Task filterStage() {
+    AsyncStageStats &stats = this->_report->stages[STAGE_FILTER];
+    while (std::optional<ReplayBatch> batch =
+               co_await this->_calibrated.receive()) {
+      auto start = std::chrono::steady_clock::now();
+      size_t count = batch->samples.size();
+      batch->estimates.resize(count);
+      for (size_t i = 0; i < count; i++) {
+        this->_filter.update(batch->samples[i], batch->estimates[i]);
+      }
+      stats.busy_ns += elapsedNs(start);
+      stats.batches++;
+      stats.samples += count;
+      if (!co_await this->_filtered.send(std::move(*batch))) {
+        co_return;
+      }
+    }
+    this->_filtered.close();
+  }
+
+  Task scoreStage() {
+    AsyncStageStats &stats = this->_report->stages[STAGE_SCORE];
+    uint64_t warmup_end_us = 0;
+    bool has_first_sample = false;
+    while (std::optional<ReplayBatch> batch =
+               co_await this->_filtered.receive()) {
+      auto start = std::chrono::steady_clock::now();
+      size_t count = batch->samples.size();
+      if (!has_first_sample && count > 0) {
+        warmup_end_us = batch->samples[0].timestamp_us +
+                        (uint64_t)(this->_settings.warmup_s * 1e6);
+        has_first_sample = true;
+      }
+      batch->errors.resize(count);
+      for (size_t i = 0; i < count; i++) {
+        batch->errors[i] = evaluation::attitudeError(batch->estimates[i],
+                                                     batch->ground_truth[i]);
+        if (batch->samples[i].timestamp_us >= warmup_end_us) {
+          this->_report->errors.add(batch->errors[i]);
+        }
+      }
+      stats.busy_ns += elapsedNs(start);
+      stats.batches++;
+      stats.samples += count;
+      if (!co_await this->_scored.send(std::move(*batch))) {
+        co_return;
+      }
+    }
+    this->_scored.close();
+  }
+
+  /**
+   * @brief formats the estimates of a batch as CSV lines.
+   */
+  static void formatBatch(const ReplayBatch &batch, std::vector<char> &text) {
+    char line[192];
+    for (size_t i = 0; i < batch.samples.size(); i++) {
+      const structures::Quaternion<double> &truth = batch.ground_truth[i];
+      const structures::Quaternion<double> &estimate = batch.estimates[i];
+      int length = snprintf(
+          line, sizeof(line),
+          "%llu,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.4f\n",
+          (unsigned long long)batch.samples[i].timestamp_us, truth.getW(),
+          truth.getX(), truth.getY(), truth.getZ(), estimate.getW(),
+          estimate.getX(), estimate.getY(), estimate.getZ(),
+          batch.errors[i] * 180.0 / M_PI);
+      text.insert(text.end(), line, line + length);
+    }
+  }
+
+  Task writeStage() {
+    AsyncStageStats &stats = this->_report->stages[STAGE_WRITE];
+    int fd = this->_settings.output_fd;
+    std::vector<char> text;
+    if (fd >= 0) {
+      static const char header[] = "timestamp_us,gt_w,gt_x,gt_y,gt_z,est_w,"
+                                   "est_x,est_y,est_z,error_deg\n";
+      text.assign(header, header + sizeof(header) - 1);
+    }
+    while (std::optional<ReplayBatch> batch =
+               co_await this->_scored.receive()) {
+      stats.batches++;
+      stats.samples += batch->samples.size();
+      this->_report->samples += batch->samples.size();
+      if (fd < 0) {
+        continue;
+      }
+
+      // the text is formatted here, and written while the other stages
+      // move on to the next batches
+      auto start = std::chrono::steady_clock::now();
+      formatBatch(*batch, text);
+      stats.busy_ns += elapsedNs(start);
+      AsyncIo::Request request =
+          this->_io.write(fd, text.data(), text.size());
+      ssize_t written = co_await request;
+      stats.busy_ns += request.ns;
+      if (written < 0) {
+        this->fail("cannot write the estimates");
+        co_return;
+      }
+      stats.bytes += written;
+      text.clear();
+    }
+  }
+
+  FilterT &_filter;
+  AsyncReplaySettings _settings;
+  AsyncReplayReport *_report;
+  filters::SensorCalibration<double> _calibration; // set by the decoder
+  std::vector<char> _line;                          // decoder line buffer
+  Scheduler _scheduler;
+  AsyncIo _io;
+  Channel<std::vector<char>> _blocks;
+  Channel<ReplayBatch> _decoded;
+  Channel<ReplayBatch> _calibrated;
+  Channel<ReplayBatch> _filtered;
+  Channel<ReplayBatch> _scored;
+}; // end AsyncReplay class
+} // namespace replay
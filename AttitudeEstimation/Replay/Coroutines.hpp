@@ -0,0 +1,450 @@
+#pragma once
+
+// C++20 coroutine building blocks for the asynchronous replay pipeline:
+// tasks, a single threaded scheduler, bounded channels and an I/O thread.
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace replay {
+
+/**
+ * @brief a coroutine run by a Scheduler. It starts suspended and stays
+ * suspended once it returns, so the scheduler can tell it has finished and
+ * destroy it.
+ */
+class Task {
+public:
+  struct promise_type {
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  Task(Task &&other) noexcept : _handle(other._handle) {
+    other._handle = NULL;
+  }
+  Task(const Task &other) = delete;
+  Task &operator=(const Task &other) = delete;
+
+  /**
+   * @brief destructor for Task class. Destroys the coroutine frame.
+   */
+  ~Task() {
+    if (this->_handle) {
+      this->_handle.destroy();
+    }
+  }
+
+  /**
+   * @brief returns the coroutine handle.
+   * @return the coroutine handle.
+   */
+  std::coroutine_handle<promise_type> getHandle() const {
+    return this->_handle;
+  }
+
+private:
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : _handle(handle) {}
+
+  std::coroutine_handle<promise_type> _handle;
+}; // end Task class
+
+/**
+ * @brief runs tasks cooperatively on the calling thread. A task runs until
+ * it awaits a channel or an I/O request, and the scheduler then resumes
+ * the next ready task. Other threads hand finished I/O back with post().
+ */
+class Scheduler {
+public:
+  /**
+   * @brief default constructor for Scheduler class.
+   */
+  Scheduler() : _external(0) {}
+
+  Scheduler(const Scheduler &other) = delete;
+  Scheduler &operator=(const Scheduler &other) = delete;
+
+  /**
+   * @brief adds a task, ready to run.
+   * @param task the task. The scheduler owns it from now on.
+   */
+  void spawn(Task task) {
+    this->schedule(task.getHandle());
+    this->_tasks.push_back(std::move(task));
+  }
+
+  /**
+   * @brief marks a suspended coroutine ready. Must be called from the
+   * scheduler thread.
+   * @param handle the coroutine to resume.
+   */
+  void schedule(std::coroutine_handle<> handle) {
+    this->_ready.push_back(handle);
+  }
+
+  /**
+   * @brief announces that a suspended coroutine will be handed back by
+   * another thread through post().
+   */
+  void beginExternal() {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    this->_external++;
+  }
+
+  /**
+   * @brief hands a coroutine suspended by beginExternal() back to the
+   * scheduler. May be called from any thread.
+   * @param handle the coroutine to resume.
+   */
+  void post(std::coroutine_handle<> handle) {
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      this->_posted.push_back(handle);
+      this->_external--;
+    }
+    this->_posted_cv.notify_one();
+  }
+
+  /**
+   * @brief runs the tasks until they have all finished, or until none can
+   * make progress.
+   * @return true if every task finished, false if the remaining tasks are
+   * all waiting on each other.
+   */
+  bool run() {
+    while (true) {
+      while (!this->_ready.empty()) {
+        std::coroutine_handle<> handle = this->_ready.front();
+        this->_ready.pop_front();
+        handle.resume();
+      }
+
+      // only I/O completions can make progress now
+      std::unique_lock<std::mutex> lock(this->_mutex);
+      this->_posted_cv.wait(lock, [this]() {
+        return !this->_posted.empty() || this->_external == 0;
+      });
+      if (this->_posted.empty()) {
+        break;
+      }
+      this->_ready.insert(this->_ready.end(), this->_posted.begin(),
+                          this->_posted.end());
+      this->_posted.clear();
+    }
+
+    bool finished = true;
+    for (const Task &task : this->_tasks) {
+      finished = finished && task.getHandle().done();
+    }
+    this->_tasks.clear();
+    return finished;
+  }
+
+private:
+  std::vector<Task> _tasks;
+  std::deque<std::coroutine_handle<>> _ready;
+  std::mutex _mutex; // guards _posted and _external
+  std::condition_variable _posted_cv;
+  std::vector<std::coroutine_handle<>> _posted;
+  size_t _external; // coroutines waiting on another thread
+}; // end Scheduler class
+
+/**
+ * @brief a bounded FIFO between coroutines of one scheduler. A sender
+ * suspends while the channel is full, which is how a slow stage holds back
+ * the stages feeding it, and a receiver suspends while it is empty. A
+ * capacity of zero hands every value directly from sender to receiver.
+ * @tparam T the value type, moved through the channel.
+ */
+template <typename T> class Channel {
+public:
+  /**
+   * @brief constructor for Channel class.
+   * @param scheduler the scheduler running the senders and receivers.
+   * @param capacity the number of values buffered before senders suspend.
+   */
+  Channel(Scheduler &scheduler, size_t capacity)
+      : _scheduler(scheduler), _capacity(capacity), _closed(false),
+        _send_waits(0), _receive_waits(0) {}
+
+  Channel(const Channel &other) = delete;
+  Channel &operator=(const Channel &other) = delete;
+
+  struct SendAwaiter {
+    bool await_ready() {
+      if (channel._closed) {
+        sent = false;
+        return true;
+      }
+      if (!channel._receivers.empty()) {
+        ReceiveAwaiter *receiver = channel._receivers.front();
+        channel._receivers.pop_front();
+        receiver->value.emplace(std::move(value));
+        channel._scheduler.schedule(receiver->handle);
+        return true;
+      }
+      if (channel._buffer.size() < channel._capacity) {
+        channel._buffer.push_back(std::move(value));
+        return true;
+      }
+      return false;
+    }
+    void await_suspend(std::coroutine_handle<> suspended) {
+      handle = suspended;
+      channel._send_waits++;
+      channel._senders.push_back(this);
+    }
+    bool await_resume() { return sent; }
+
+    Channel &channel;
+    T value;
+    std::coroutine_handle<> handle{};
+    bool sent = true;
+  };
+
+  struct ReceiveAwaiter {
+    bool await_ready() { return channel.take(value) || channel._closed; }
+    void await_suspend(std::coroutine_handle<> suspended) {
+      handle = suspended;
+      channel._receive_waits++;
+      channel._receivers.push_back(this);
+    }
+    std::optional<T> await_resume() { return std::move(value); }
+
+    Channel &channel;
+    std::optional<T> value;
+    std::coroutine_handle<> handle{};
+  };
+
+  /**
+   * @brief sends a value, suspending while the channel is full.
+   * @param value the value to send.
+   * @return an awaitable resuming with false if the channel was closed and
+   * the value dropped, true otherwise.
+   */
+  SendAwaiter send(T value) { return SendAwaiter{*this, std::move(value)}; }
+
+  /**
+   * @brief receives the oldest value, suspending while the channel is
+   * empty.
+   * @return an awaitable resuming with the value, or with no value once the
+   * channel is closed and drained.
+   */
+  ReceiveAwaiter receive() { return ReceiveAwaiter{*this, std::nullopt}; }
+
+  /**
+   * @brief closes the channel. Buffered values can still be received;
+   * waiting receivers and later receives of an empty channel get no value,
+   * and waiting senders give up.
+   */
+  void close() {
+    this->_closed = true;
+    if (this->_buffer.empty()) {
+      for (ReceiveAwaiter *receiver : this->_receivers) {
+        this->_scheduler.schedule(receiver->handle);
+      }
+      this->_receivers.clear();
+    }
+    for (SendAwaiter *sender : this->_senders) {
+      sender->sent = false;
+      this->_scheduler.schedule(sender->handle);
+    }
+    this->_senders.clear();
+  }
+
+  /**
+   * @brief returns how many sends found the channel full.
+   * @return the number of suspended sends.
+   */
+  uint64_t getSendWaits() const { return this->_send_waits; }
+
+  /**
+   * @brief returns how many receives found the channel empty.
+   * @return the number of suspended receives.
+   */
+  uint64_t getReceiveWaits() const { return this->_receive_waits; }
+
+private:
+  /**
+   * @brief takes the oldest value, refilling the buffer from the first
+   * waiting sender.
+   */
+  bool take(std::optional<T> &value) {
+    if (!this->_buffer.empty()) {
+      value.emplace(std::move(this->_buffer.front()));
+      this->_buffer.pop_front();
+      if (!this->_senders.empty()) {
+        SendAwaiter *sender = this->_senders.front();
+        this->_senders.pop_front();
+        this->_buffer.push_back(std::move(sender->value));
+        this->_scheduler.schedule(sender->handle);
+      }
+      return true;
+    }
+    if (!this->_senders.empty()) {
+      SendAwaiter *sender = this->_senders.front();
+      this->_senders.pop_front();
+      value.emplace(std::move(sender->value));
+      this->_scheduler.schedule(sender->handle);
+      return true;
+    }
+    return false;
+  }
+
+  Scheduler &_scheduler;
+  size_t _capacity;
+  bool _closed;
+  std::deque<T> _buffer;
+  std::deque<SendAwaiter *> _senders;
+  std::deque<ReceiveAwaiter *> _receivers;
+  uint64_t _send_waits;
+  uint64_t _receive_waits;
+}; // end Channel class
+
+/**
+ * @brief runs blocking reads and writes on one background thread, so the
+ * scheduler keeps running other stages while a coroutine waits for I/O.
+ * Requests are served in submission order.
+ */
+class AsyncIo {
+public:
+  struct Request {
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> suspended) {
+      handle = suspended;
+      io.submit(this);
+    }
+    ssize_t await_resume() { return result; }
+
+    AsyncIo &io;
+    int fd;
+    char *data;
+    size_t size;
+    bool write;
+    ssize_t result = 0;
+    uint64_t ns = 0; // time spent in the system calls
+    std::coroutine_handle<> handle{};
+  };
+
+  /**
+   * @brief constructor for AsyncIo class. Starts the I/O thread.
+   * @param scheduler the scheduler the requests are issued from.
+   */
+  explicit AsyncIo(Scheduler &scheduler)
+      : _scheduler(scheduler), _stopping(false) {
+    this->_thread = std::thread([this]() { this->run(); });
+  }
+
+  AsyncIo(const AsyncIo &other) = delete;
+  AsyncIo &operator=(const AsyncIo &other) = delete;
+
+  /**
+   * @brief destructor for AsyncIo class. Stops the I/O thread once the
+   * queued requests are served.
+   */
+  ~AsyncIo() {
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      this->_stopping = true;
+    }
+    this->_cv.notify_one();
+    this->_thread.join();
+  }
+
+  /**
+   * @brief reads up to size bytes, like read(2).
+   * @return an awaitable resuming with the number of bytes read, 0 at the
+   * end of the file, or -1 on error.
+   */
+  Request read(int fd, char *data, size_t size) {
+    return Request{*this, fd, data, size, false};
+  }
+
+  /**
+   * @brief writes size bytes, retrying short writes.
+   * @return an awaitable resuming with size, or -1 on error.
+   */
+  Request write(int fd, const char *data, size_t size) {
+    return Request{*this, fd, const_cast<char *>(data), size, true};
+  }
+
+private:
+  void submit(Request *request) {
+    this->_scheduler.beginExternal();
+    {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      this->_requests.push_back(request);
+    }
+    this->_cv.notify_one();
+  }
+
+  static uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  static void perform(Request &request) {
+    if (!request.write) {
+      request.result = ::read(request.fd, request.data, request.size);
+      return;
+    }
+    size_t done = 0;
+    while (done < request.size) {
+      ssize_t written =
+          ::write(request.fd, request.data + done, request.size - done);
+      if (written <= 0) {
+        request.result = -1;
+        return;
+      }
+      done += written;
+    }
+    request.result = (ssize_t)done;
+  }
+
+  void run() {
+    while (true) {
+      Request *request;
+      {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        this->_cv.wait(lock, [this]() {
+          return !this->_requests.empty() || this->_stopping;
+        });
+        if (this->_requests.empty()) {
+          return;
+        }
+        request = this->_requests.front();
+        this->_requests.pop_front();
+      }
+      uint64_t start_ns = nowNs();
+      perform(*request);
+      request->ns = nowNs() - start_ns;
+      this->_scheduler.post(request->handle);
+    }
+  }
+
+  Scheduler &_scheduler;
+  std::thread _thread;
+  std::mutex _mutex; // guards _requests and _stopping
+  std::condition_variable _cv;
+  std::deque<Request *> _requests;
+  bool _stopping;
+}; // end AsyncIo class
+} // namespace replay
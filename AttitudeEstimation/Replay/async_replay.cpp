@@ -0,0 +1,187 @@
+#include "../SensorDriver/FilterDriver.hpp"
+#include "AsyncReplay.hpp"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace filters;
+using namespace replay;
+
+/**
+ * @brief the command line options of the asynchronous replay tool.
+ */
+struct AsyncReplayOptions {
+  available_filters_t filter = COMPLEMENTARY;
+  const char *recording = NULL; // CSV recording or .imulog binary log
+  const char *output = NULL;    // estimate CSV path, or NULL to discard
+  AsyncReplaySettings settings;
+};
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <recording>\n"
+          "  recordings are CSV files or .imulog binary logs\n"
+          "  --filter complementary|ekf|madgwick|mahony\n"
+          "  --output <path>     write the estimates and errors as CSV\n"
+          "  --warmup <s>        leading seconds left out of the error\n"
+          "                      scores (default 10)\n"
+          "  --batch <n>         samples per batch (default 4096)\n"
+          "  --depth <n>         batches buffered between two stages\n"
+          "                      (default 4)\n"
+          "  --block <bytes>     bytes per read (default 262144)\n",
+          name);
+}
+
+static bool parseFilter(const char *name, available_filters_t &filter) {
+  if (strcmp(name, "complementary") == 0) {
+    filter = COMPLEMENTARY;
+  } else if (strcmp(name, "ekf") == 0) {
+    filter = EKF;
+  } else if (strcmp(name, "madgwick") == 0) {
+    filter = MADGWICK;
+  } else if (strcmp(name, "mahony") == 0) {
+    filter = MAHONY;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool hasExtension(const char *path, const char *extension) {
+  size_t len = strlen(path);
+  size_t extension_len = strlen(extension);
+  return len >= extension_len &&
+         strcmp(path + len - extension_len, extension) == 0;
+}
+
+static bool parseOptions(int argc, char **argv, AsyncReplayOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "--filter") == 0 && has_value) {
+      if (!parseFilter(argv[++i], options.filter)) {
+        return false;
+      }
+    } else if (strcmp(arg, "--output") == 0 && has_value) {
+      options.output = argv[++i];
+    } else if (strcmp(arg, "--warmup") == 0 && has_value) {
+      options.settings.warmup_s = atof(argv[++i]);
+    } else if (strcmp(arg, "--batch") == 0 && has_value) {
+      options.settings.batch_samples = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--depth") == 0 && has_value) {
+      options.settings.channel_depth = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--block") == 0 && has_value) {
+      options.settings.block_bytes = strtoull(argv[++i], NULL, 10);
+    } else if (arg[0] != '-' && options.recording == NULL) {
+      options.recording = arg;
+    } else {
+      return false;
+    }
+  }
+  return options.recording != NULL;
+}
+
+/**
+ * @brief prints what every stage did, and its throughput over the time it
+ * was busy rather than the whole replay.
+ */
+static void printReport(const AsyncReplayReport &report) {
+  double wall_s = report.wall_ns * 1e-9;
+  fprintf(stderr, "samples: %llu\nelapsed: %.3f s\nrate: %.0f samples/s\n",
+          (unsigned long long)report.samples, wall_s,
+          wall_s > 0 ? report.samples / wall_s : 0.0);
+  if (report.skipped_lines > 0) {
+    fprintf(stderr, "skipped lines: %llu\n",
+            (unsigned long long)report.skipped_lines);
+  }
+  fprintf(stderr, "%-10s %8s %10s %9s %11s %9s %8s %8s\n", "stage",
+          "batches", "samples", "busy ms", "samples/s", "MB/s", "starved",
+          "blocked");
+  for (size_t i = 0; i < ASYNC_STAGE_COUNT; i++) {
+    const AsyncStageStats &stage = report.stages[i];
+    double busy_s = stage.busy_ns * 1e-9;
+    fprintf(stderr, "%-10s %8llu %10llu %9.1f %11.0f %9.1f %8llu %8llu\n",
+            asyncStageName((async_stage_t)i),
+            (unsigned long long)stage.batches,
+            (unsigned long long)stage.samples, stage.busy_ns * 1e-6,
+            busy_s > 0 ? stage.samples / busy_s : 0.0,
+            busy_s > 0 ? stage.bytes / busy_s * 1e-6 : 0.0,
+            (unsigned long long)stage.input_waits,
+            (unsigned long long)stage.output_waits);
+  }
+
+  evaluation::ErrorAccumulator errors = report.errors;
+  fprintf(stderr, "error: rms %.3f deg, p50 %.3f deg, p99 %.3f deg\n",
+          errors.rms() * 180.0 / M_PI, errors.percentile(50) * 180.0 / M_PI,
+          errors.percentile(99) * 180.0 / M_PI);
+}
+
+template <available_filters_t selected_filter>
+static int replayFilter(const AsyncReplayOptions &options, int input_fd) {
+  typename FilterDriverSelector<selected_filter>::type filter;
+  AsyncReplay<typename FilterDriverSelector<selected_filter>::type> replay(
+      filter, options.settings);
+  AsyncReplayReport report;
+  bool replayed = replay.run(input_fd, report);
+  printReport(report);
+  if (!replayed) {
+    fprintf(stderr, "%s: %s\n", options.recording, report.error);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  AsyncReplayOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  if (hasExtension(options.recording, ".imuarc")) {
+    fprintf(stderr, "archives are decoded block by block from a mapping; "
+                    "replay them with the replay tool\n");
+    return 1;
+  }
+  options.settings.format = hasExtension(options.recording, ".imulog")
+                                ? RECORDING_IMULOG
+                                : RECORDING_CSV;
+
+  int input_fd = open(options.recording, O_RDONLY);
+  if (input_fd < 0) {
+    perror(options.recording);
+    return 1;
+  }
+  if (options.output != NULL) {
+    options.settings.output_fd =
+        open(options.output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (options.settings.output_fd < 0) {
+      perror(options.output);
+      close(input_fd);
+      return 1;
+    }
+  }
+
+  int result = 1;
+  switch (options.filter) {
+  case COMPLEMENTARY:
+    result = replayFilter<COMPLEMENTARY>(options, input_fd);
+    break;
+  case EKF:
+    result = replayFilter<EKF>(options, input_fd);
+    break;
+  case MADGWICK:
+    result = replayFilter<MADGWICK>(options, input_fd);
+    break;
+  case MAHONY:
+    result = replayFilter<MAHONY>(options, input_fd);
+    break;
+  }
+  close(input_fd);
+  if (options.settings.output_fd >= 0) {
+    close(options.settings.output_fd);
+  }
+  return result;
+}
@@ -0,0 +1,477 @@
+#include "../Evaluation/AccuracyMetrics.hpp"
+#include "../ImuLog/ImuArchive.hpp"
+#include "../ImuLog/ImuArchiveReader.hpp"
+#include "../ImuLog/ImuLog.hpp"
+#include "../ImuLog/ImuLogReader.hpp"
+#include "../SensorDriver/Clock.hpp"
+#include "../SensorDriver/FilterBank.hpp"
+#include "../SensorDriver/SensorManager.hpp"
+#include "../SensorDriver/SensorSources.hpp"
+#include "../Simulation/ImuSimulator.hpp"
+#include "../Simulation/Trajectory.hpp"
+#include "../Telemetry/TelemetryProtocol.hpp"
+#include "../Telemetry/Transport.hpp"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace filters;
+
+/**
+ * @brief the command line options of the replay tool.
+ */
+struct ReplayOptions {
+  available_filters_t filter = COMPLEMENTARY;
+  bool filter_selected = false;     // --filter given, over a log's filter
+  const char *recording = NULL;     // recorded sample file, or NULL
+  uint64_t synthetic_samples = 0;   // synthetic sample count if no recording
+  double synthetic_rate_hz = 100.0; // synthetic sample rate
+  double recording_rate_hz = 0.0;   // rate in the recording header, or 0
+  bool simulate = false;            // handheld trajectory instead of a spin
+  bool noisy = false;               // consumer MEMS noise on the simulation
+  uint64_t seed = 1;                // simulation noise seed
+  bool binary = false;              // binary frames instead of JSON lines
+  const char *output = NULL;        // output file or pty, or NULL to discard
+  const char *record = NULL;        // write the samples to a file instead
+  bool realtime = false;            // pace samples by their timestamps
+  const char *bank = NULL;          // filters to run side by side, or NULL
+  SensorCalibration<double> calibration = // raw-to-SI calibration
+      SensorCalibration<double>::nominal();
+};
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] (<recording> | --synthetic <samples>)\n"
+          "  recordings are CSV files, .imulog binary logs or .imuarc\n"
+          "  compressed archives\n"
+          "  --filter complementary|ekf|madgwick|mahony\n"
+          "  --rate <hz>         synthetic sample rate, and the rate\n"
+          "                      recorded for CSV input (default 100)\n"
+          "  --trajectory spin|handheld\n"
+          "                      synthetic motion (default spin)\n"
+          "  --noise ideal|mems  handheld trajectory noise (default ideal)\n"
+          "  --seed <n>          handheld trajectory noise seed\n"
+          "  --format json|binary\n"
+          "  --output <path>     write messages to a file or pty\n"
+          "  --record <path>     write the samples to a recording and exit,\n"
+          "                      as a binary log if the path ends in .imulog,\n"
+          "                      as an archive if the path ends in .imuarc\n"
+          "  --realtime          replay at the recorded rate instead of as\n"
+          "                      fast as possible\n"
+          "  --bank <f,f,...>    run several filters side by side, each on\n"
+          "                      its own thread, and report their errors;\n"
+          "                      --output writes the aligned estimates as\n"
+          "                      CSV\n",
+          name);
+}
+
+static bool parseFilter(const char *name, available_filters_t &filter) {
+  if (strcmp(name, "complementary") == 0) {
+    filter = COMPLEMENTARY;
+  } else if (strcmp(name, "ekf") == 0) {
+    filter = EKF;
+  } else if (strcmp(name, "madgwick") == 0) {
+    filter = MADGWICK;
+  } else if (strcmp(name, "mahony") == 0) {
+    filter = MAHONY;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool hasExtension(const char *path, const char *extension) {
+  size_t len = strlen(path);
+  size_t extension_len = strlen(extension);
+  return len >= extension_len &&
+         strcmp(path + len - extension_len, extension) == 0;
+}
+
+static bool parseOptions(int argc, char **argv, ReplayOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (strcmp(arg, "--filter") == 0 && has_value) {
+      if (!parseFilter(argv[++i], options.filter)) {
+        return false;
+      }
+      options.filter_selected = true;
+    } else if (strcmp(arg, "--synthetic") == 0 && has_value) {
+      options.synthetic_samples = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--rate") == 0 && has_value) {
+      options.synthetic_rate_hz = atof(argv[++i]);
+    } else if (strcmp(arg, "--trajectory") == 0 && has_value) {
+      options.simulate = strcmp(argv[++i], "handheld") == 0;
+    } else if (strcmp(arg, "--noise") == 0 && has_value) {
+      options.noisy = strcmp(argv[++i], "mems") == 0;
+    } else if (strcmp(arg, "--seed") == 0 && has_value) {
+      options.seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--format") == 0 && has_value) {
+      options.binary = strcmp(argv[++i], "binary") == 0;
+    } else if (strcmp(arg, "--output") == 0 && has_value) {
+      options.output = argv[++i];
+    } else if (strcmp(arg, "--record") == 0 && has_value) {
+      options.record = argv[++i];
+    } else if (strcmp(arg, "--bank") == 0 && has_value) {
+      options.bank = argv[++i];
+    } else if (strcmp(arg, "--realtime") == 0) {
+      options.realtime = true;
+    } else if (arg[0] != '-' && options.recording == NULL) {
+      options.recording = arg;
+    } else {
+      return false;
+    }
+  }
+  return options.recording != NULL || options.synthetic_samples > 0;
+}
+
+/**
+ * @brief replays every sample of a source through the selected filter.
+ * @return the process exit code.
+ */
+template <available_filters_t selected_filter, typename FormatterT,
+          typename SourceT, typename TransportT>
+static int replay(const ReplayOptions &options, SourceT &source,
+                  TransportT &transport) {
+  BasicSensorManager<selected_filter, SourceT, TransportT, FormatterT>
+      sensor_man(source, transport, options.calibration);
+
+  SteadyClock clock;
+  uint64_t samples = sensor_man.runUntilExhausted();
+  double elapsed_s = clock.nowUs() * 1e-6;
+
+  fprintf(stderr,
+          "samples: %llu\nelapsed: %.3f s\nrate: %.0f samples/s\n"
+          "bytes sent: %llu\ndropped frames: %u\n",
+          (unsigned long long)samples, elapsed_s,
+          elapsed_s > 0 ? samples / elapsed_s : 0.0,
+          (unsigned long long)sensor_man.getBytesSent(),
+          sensor_man.getDroppedFrames());
+
+#if SENSOR_MANAGER_STAGE_TIMING
+  uint8_t line[StageProfiler::kMaxReportLineLength];
+  for (size_t stage = 0; stage < STAGE_COUNT; stage++) {
+    size_t line_len = sensor_man.getStageProfiler().formatReportLine(
+        (pipeline_stage_t)stage, line, sizeof(line));
+    fwrite(line, 1, line_len, stderr);
+  }
+#endif
+  return 0;
+}
+
+template <typename FormatterT, typename SourceT, typename TransportT>
+static int replayFilter(const ReplayOptions &options, SourceT &source,
+                        TransportT &transport) {
+  switch (options.filter) {
+  case COMPLEMENTARY:
+    return replay<COMPLEMENTARY, FormatterT>(options, source, transport);
+  case EKF:
+    return replay<EKF, FormatterT>(options, source, transport);
+  case MADGWICK:
+    return replay<MADGWICK, FormatterT>(options, source, transport);
+  case MAHONY:
+    return replay<MAHONY, FormatterT>(options, source, transport);
+  }
+  return 1;
+}
+
+template <typename SourceT, typename TransportT>
+static int replayFormat(const ReplayOptions &options, SourceT &source,
+                        TransportT &transport) {
+  if (options.binary) {
+    return replayFilter<telemetry::BinaryEstimateFormatter>(options, source,
+                                                            transport);
+  }
+  return replayFilter<JsonEstimateFormatter>(options, source, transport);
+}
+
+static const char *filterName(available_filters_t filter) {
+  switch (filter) {
+  case COMPLEMENTARY:
+    return "complementary";
+  case EKF:
+    return "ekf";
+  case MADGWICK:
+    return "madgwick";
+  case MAHONY:
+    return "mahony";
+  }
+  return "unknown";
+}
+
+static bool addBankFilter(FilterBank &bank, available_filters_t filter) {
+  switch (filter) {
+  case COMPLEMENTARY:
+    return bank.addFilter<FilterDriverSelector<COMPLEMENTARY>::type>(
+        filterName(filter));
+  case EKF:
+    return bank.addFilter<FilterDriverSelector<EKF>::type>(filterName(filter));
+  case MADGWICK:
+    return bank.addFilter<FilterDriverSelector<MADGWICK>::type>(
+        filterName(filter));
+  case MAHONY:
+    return bank.addFilter<FilterDriverSelector<MAHONY>::type>(
+        filterName(filter));
+  }
+  return false;
+}
+
+/**
+ * @brief replays every sample of a source through a bank of filters running
+ * side by side, and reports the error of each against the ground truth.
+ * @return the process exit code.
+ */
+template <typename SourceT>
+static int replayBank(const ReplayOptions &options, SourceT &source) {
+  FilterBank bank(options.calibration);
+  for (const char *name = options.bank; *name != 0;) {
+    size_t name_len = strcspn(name, ",");
+    char filter_name[32];
+    available_filters_t filter;
+    if (name_len >= sizeof(filter_name)) {
+      name_len = sizeof(filter_name) - 1;
+    }
+    memcpy(filter_name, name, name_len);
+    filter_name[name_len] = 0;
+    if (!parseFilter(filter_name, filter) || !addBankFilter(bank, filter)) {
+      fprintf(stderr, "cannot add filter to the bank: %s\n", filter_name);
+      return 1;
+    }
+    name += name_len + (name[name_len] == ',');
+  }
+  if (bank.size() == 0) {
+    fprintf(stderr, "the bank has no filters\n");
+    return 1;
+  }
+
+  FILE *file = NULL;
+  if (options.output != NULL) {
+    file = fopen(options.output, "w");
+    if (file == NULL) {
+      perror(options.output);
+      return 1;
+    }
+    fprintf(file, "sequence,timestamp_us,gt_w,gt_x,gt_y,gt_z");
+    for (size_t i = 0; i < bank.size(); i++) {
+      fprintf(file, ",%s_w,%s_x,%s_y,%s_z", bank.getName(i), bank.getName(i),
+              bank.getName(i), bank.getName(i));
+    }
+    fprintf(file, "\n");
+  }
+
+  std::vector<evaluation::ErrorAccumulator> errors(bank.size());
+  SteadyClock clock;
+  uint64_t samples = bank.run(source, [&](const BankRow &row) {
+    for (size_t i = 0; i < bank.size(); i++) {
+      if (row.valid_mask & (1U << i)) {
+        errors[i].add(
+            evaluation::attitudeError(row.estimates[i], row.ground_truth));
+      }
+    }
+    if (file == NULL) {
+      return;
+    }
+    fprintf(file, "%u,%llu,%.6f,%.6f,%.6f,%.6f", row.sequence,
+            (unsigned long long)row.timestamp_us, row.ground_truth.getW(),
+            row.ground_truth.getX(), row.ground_truth.getY(),
+            row.ground_truth.getZ());
+    for (size_t i = 0; i < bank.size(); i++) {
+      const structures::Quaternion<double> &estimate = row.estimates[i];
+      if (row.valid_mask & (1U << i)) {
+        fprintf(file, ",%.6f,%.6f,%.6f,%.6f", estimate.getW(),
+                estimate.getX(), estimate.getY(), estimate.getZ());
+      } else {
+        fprintf(file, ",,,,");
+      }
+    }
+    fprintf(file, "\n");
+  });
+  double elapsed_s = clock.nowUs() * 1e-6;
+  if (file != NULL) {
+    fclose(file);
+  }
+
+  fprintf(stderr, "samples: %llu\nelapsed: %.3f s\nrate: %.0f samples/s\n",
+          (unsigned long long)samples, elapsed_s,
+          elapsed_s > 0 ? samples / elapsed_s : 0.0);
+  fprintf(stderr, "%-14s %9s %9s %9s %9s %9s %6s\n", "filter", "samples",
+          "rms_rad", "p50_rad", "p99_rad", "max_rad", "pinned");
+  for (size_t i = 0; i < bank.size(); i++) {
+    fprintf(stderr, "%-14s %9zu %9.4f %9.4f %9.4f %9.4f %6s\n",
+            bank.getName(i), errors[i].count(), errors[i].rms(),
+            errors[i].percentile(50), errors[i].percentile(99),
+            errors[i].max(), bank.isPinned(i) ? "yes" : "no");
+  }
+  return 0;
+}
+
+/**
+ * @brief returns the nominal rate of the replayed samples: the rate in the
+ * recording header when there is one, the synthetic rate otherwise.
+ */
+static double sampleRate(const ReplayOptions &options) {
+  return options.recording_rate_hz > 0 ? options.recording_rate_hz
+                                       : options.synthetic_rate_hz;
+}
+
+template <typename SourceT>
+static int replaySource(const ReplayOptions &options, SourceT &source) {
+  if (options.record != NULL && hasExtension(options.record, ".imuarc")) {
+    imulog::ImuArchiveWriter writer;
+    if (!writer.open(options.record, sampleRate(options), false,
+                     options.calibration)) {
+      perror(options.record);
+      return 1;
+    }
+    AcquiredSample sample;
+    imulog::ArchiveSample archived;
+    while (source.read(sample)) {
+      archived.raw = sample.raw;
+      archived.ground_truth = sample.ground_truth;
+      writer.write(archived);
+    }
+    return writer.close() ? 0 : 1;
+  }
+
+  if (options.record != NULL && hasExtension(options.record, ".imulog")) {
+    imulog::ImuLogWriter writer;
+    if (!writer.open(options.record,
+                     imulog::makeHeader(sampleRate(options),
+                                        options.calibration,
+                                        (uint8_t)options.filter))) {
+      perror(options.record);
+      return 1;
+    }
+    AcquiredSample sample;
+    while (source.read(sample)) {
+      writer.write(sample);
+    }
+    return writer.close() ? 0 : 1;
+  }
+
+  if (options.record != NULL) {
+    FILE *file = fopen(options.record, "w");
+    if (file == NULL) {
+      perror(options.record);
+      return 1;
+    }
+    fputs(kRecordedSampleHeader, file);
+    AcquiredSample sample;
+    while (source.read(sample)) {
+      writeRecordedSample(file, sample);
+    }
+    fclose(file);
+    return 0;
+  }
+
+  if (options.bank != NULL) {
+    return replayBank(options, source);
+  }
+
+  if (options.output == NULL) {
+    telemetry::NullTransport transport;
+    return replayFormat(options, source, transport);
+  }
+
+  int fd = open(options.output, O_WRONLY | O_CREAT | O_TRUNC | O_NOCTTY, 0644);
+  if (fd < 0) {
+    perror(options.output);
+    return 1;
+  }
+  telemetry::FdTransport transport(fd);
+  int result = replayFormat(options, source, transport);
+  close(fd);
+  return result;
+}
+
+template <typename SourceT>
+static int replayPaced(const ReplayOptions &options, SourceT &source) {
+  if (!options.realtime || options.record != NULL) {
+    return replaySource(options, source);
+  }
+
+  // poll the paced source until it has released every sample
+  SteadyClock clock;
+  PacedSensorSource<SourceT, SteadyClock> paced(source, clock);
+  struct PollingSource {
+    PacedSensorSource<SourceT, SteadyClock> &paced;
+    bool read(AcquiredSample &sample) {
+      while (!this->paced.read(sample)) {
+        if (this->paced.exhausted()) {
+          return false;
+        }
+        usleep(100);
+      }
+      return true;
+    }
+  } polling = {paced};
+  return replaySource(options, polling);
+}
+
+int main(int argc, char **argv) {
+  ReplayOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  if (options.recording != NULL && hasExtension(options.recording, ".imuarc")) {
+    imulog::ImuArchiveReader reader;
+    if (!reader.open(options.recording)) {
+      fprintf(stderr, "%s: %s\n", options.recording, reader.getError());
+      return 1;
+    }
+    options.calibration = reader.getCalibration();
+    options.recording_rate_hz = reader.getSampleRate();
+    imulog::ImuArchiveSensorSource source(reader);
+    return replayPaced(options, source);
+  }
+
+  if (options.recording != NULL && hasExtension(options.recording, ".imulog")) {
+    imulog::ImuLogReader reader;
+    if (!reader.open(options.recording)) {
+      fprintf(stderr, "%s: %s\n", options.recording, reader.getError());
+      return 1;
+    }
+    const imulog::ImuLogHeader &header = reader.getHeader();
+    options.calibration = imulog::headerCalibration(header);
+    options.recording_rate_hz = header.sample_rate_hz;
+    if (!options.filter_selected && header.filter <= MAHONY) {
+      options.filter = (available_filters_t)header.filter;
+    }
+    imulog::ImuLogSensorSource source(reader);
+    return replayPaced(options, source);
+  }
+
+  if (options.recording != NULL) {
+    FILE *file = fopen(options.recording, "r");
+    if (file == NULL) {
+      perror(options.recording);
+      return 1;
+    }
+    RecordedSensorSource source(file);
+    int result = replayPaced(options, source);
+    fclose(file);
+    return result;
+  }
+
+  if (options.simulate) {
+    simulation::ImuSimulator<simulation::SinusoidalTrajectory> simulator(
+        simulation::SinusoidalTrajectory::handheld(),
+        options.synthetic_rate_hz,
+        options.noisy ? simulation::NoiseModel::consumerMems()
+                      : simulation::NoiseModel::ideal(),
+        options.seed);
+    simulation::SimulatedSensorSource<simulation::SinusoidalTrajectory> source(
+        simulator, options.synthetic_samples);
+    return replayPaced(options, source);
+  }
+
+  const double body_rate[3] = {0.1, -0.2, 0.3};
+  SyntheticSensorSource source(options.synthetic_samples,
+                               options.synthetic_rate_hz, body_rate);
+  return replayPaced(options, source);
+}
@@ -0,0 +1,277 @@
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../ImuLog/ImuLog.hpp"
+#include "../ImuLog/ImuLogReader.hpp"
+#include "../SensorDriver/SensorSources.hpp"
+#include "AsyncReplay.hpp"
+#include "Coroutines.hpp"
+#include "gtest/gtest.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace replay;
+
+static Task produce(Channel<int> &channel, int count) {
+  for (int i = 0; i < count; i++) {
+    co_await channel.send(i);
+  }
+  channel.close();
+}
+
+static Task consume(Channel<int> &channel, std::vector<int> &received) {
+  while (std::optional<int> value = co_await channel.receive()) {
+    received.push_back(*value);
+  }
+}
+
+TEST(AsyncReplayTesting, TestChannelBackpressure) {
+  // a bounded channel keeps the order, and holds the producer back while
+  // the consumer catches up
+  for (size_t capacity : {0, 1, 3}) {
+    Scheduler scheduler;
+    Channel<int> channel(scheduler, capacity);
+    std::vector<int> received;
+    scheduler.spawn(produce(channel, 20));
+    scheduler.spawn(consume(channel, received));
+    ASSERT_TRUE(scheduler.run());
+    ASSERT_EQ(20U, received.size());
+    for (int i = 0; i < 20; i++) {
+      ASSERT_EQ(i, received[i]);
+    }
+    ASSERT_GT(channel.getSendWaits(), 0U);
+    ASSERT_GT(channel.getReceiveWaits(), 0U);
+  }
+}
+
+static Task waitForever(Channel<int> &channel, bool &woke) {
+  co_await channel.receive();
+  woke = true;
+}
+
+TEST(AsyncReplayTesting, TestSchedulerDetectsStalls) {
+  Scheduler scheduler;
+  Channel<int> channel(scheduler, 1);
+  bool woke = false;
+  scheduler.spawn(waitForever(channel, woke));
+  ASSERT_FALSE(scheduler.run());
+  ASSERT_FALSE(woke);
+}
+
+static Task readAll(AsyncIo &io, int fd, std::string &text) {
+  char buffer[7];
+  while (ssize_t length = co_await io.read(fd, buffer, sizeof(buffer))) {
+    if (length < 0) {
+      break;
+    }
+    text.append(buffer, length);
+  }
+}
+
+static Task count(Channel<int> &channel, int &counted) {
+  for (int i = 0; i < 1000; i++) {
+    co_await channel.send(i);
+  }
+  channel.close();
+  counted = 1000;
+}
+
+TEST(AsyncReplayTesting, TestAsyncIoOverlapsCompute) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  const char message[] = "read on the I/O thread while other tasks run";
+  ASSERT_EQ((ssize_t)sizeof(message),
+            write(fds[1], message, sizeof(message)));
+  close(fds[1]);
+
+  Scheduler scheduler;
+  AsyncIo io(scheduler);
+  Channel<int> channel(scheduler, 2);
+  std::string text;
+  std::vector<int> received;
+  int counted = 0;
+  scheduler.spawn(readAll(io, fds[0], text));
+  scheduler.spawn(count(channel, counted));
+  scheduler.spawn(consume(channel, received));
+  ASSERT_TRUE(scheduler.run());
+  close(fds[0]);
+  ASSERT_EQ(std::string(message, sizeof(message)), text);
+  ASSERT_EQ(1000, counted);
+  ASSERT_EQ(1000U, received.size());
+}
+
+/**
+ * @brief a temporary file, removed on destruction.
+ */
+struct TempFile {
+  TempFile() {
+    char path[] = "/tmp/test_async_replay_XXXXXX";
+    int fd = mkstemp(path);
+    EXPECT_GE(fd, 0);
+    close(fd);
+    this->path = path;
+  }
+
+  ~TempFile() { unlink(this->path.c_str()); }
+
+  std::string path;
+};
+
+static const double kBodyRate[3] = {0.2, -0.1, 0.4};
+
+static void writeCsv(const char *path, uint64_t samples) {
+  FILE *file = fopen(path, "w");
+  fputs(filters::kRecordedSampleHeader, file);
+  filters::SyntheticSensorSource source(samples, 200.0, kBodyRate);
+  filters::AcquiredSample sample;
+  while (source.read(sample)) {
+    filters::writeRecordedSample(file, sample);
+  }
+  fclose(file);
+}
+
+/**
+ * @brief replays a source sample by sample through a Madgwick filter.
+ */
+template <typename SourceT>
+static void replaySequentially(SourceT &source,
+                               const filters::SensorCalibration<double> &cal,
+                               double warmup_s,
+                               evaluation::ErrorAccumulator &errors,
+                               uint64_t &samples) {
+  filters::MadgwickFilter filter;
+  structures::Quaternion<double> estimate;
+  filters::AcquiredSample acquired;
+  filters::SensorSample<double> sample;
+  uint64_t warmup_end_us = 0;
+  samples = 0;
+  while (source.read(acquired)) {
+    cal.apply(acquired.raw, sample);
+    if (samples++ == 0) {
+      warmup_end_us = sample.timestamp_us + (uint64_t)(warmup_s * 1e6);
+    }
+    filter.update(sample, estimate);
+    if (sample.timestamp_us >= warmup_end_us) {
+      errors.add(evaluation::attitudeError(estimate, acquired.ground_truth));
+    }
+  }
+}
+
+static size_t countLines(const char *path) {
+  FILE *file = fopen(path, "r");
+  size_t lines = 0;
+  for (int c = fgetc(file); c != EOF; c = fgetc(file)) {
+    lines += c == '\n';
+  }
+  fclose(file);
+  return lines;
+}
+
+static bool runPipeline(const char *path, const AsyncReplaySettings &settings,
+                        AsyncReplayReport &report) {
+  filters::MadgwickFilter filter;
+  AsyncReplay<filters::MadgwickFilter> replay(filter, settings);
+  int fd = open(path, O_RDONLY);
+  EXPECT_GE(fd, 0);
+  bool replayed = replay.run(fd, report);
+  close(fd);
+  return replayed;
+}
+
+TEST(AsyncReplayTesting, TestCsvMatchesSequentialReplay) {
+  TempFile recording;
+  TempFile output;
+  writeCsv(recording.path.c_str(), 3000);
+
+  // reads much smaller than a batch and batches much smaller than the
+  // recording, so lines straddle reads and every channel fills up
+  AsyncReplaySettings settings;
+  settings.block_bytes = 1000;
+  settings.batch_samples = 64;
+  settings.channel_depth = 1;
+  settings.warmup_s = 1.0;
+  settings.output_fd = open(output.path.c_str(), O_WRONLY | O_TRUNC);
+  AsyncReplayReport report;
+  ASSERT_TRUE(runPipeline(recording.path.c_str(), settings, report))
+      << report.error;
+  close(settings.output_fd);
+
+  FILE *file = fopen(recording.path.c_str(), "r");
+  filters::RecordedSensorSource source(file);
+  evaluation::ErrorAccumulator errors;
+  uint64_t samples;
+  replaySequentially(source, filters::SensorCalibration<double>::nominal(),
+                     settings.warmup_s, errors, samples);
+  fclose(file);
+
+  ASSERT_EQ(3000U, report.samples);
+  ASSERT_EQ(samples, report.samples);
+  ASSERT_EQ(1U, report.skipped_lines); // the header
+  ASSERT_EQ(errors.count(), report.errors.count());
+  ASSERT_EQ(errors.rms(), report.errors.rms());
+  ASSERT_EQ(errors.max(), report.errors.max());
+  ASSERT_EQ(samples + 1, countLines(output.path.c_str()));
+
+  // every stage saw every sample, in ceil(3000 / 64) batches
+  for (size_t stage = STAGE_DECODE; stage < ASYNC_STAGE_COUNT; stage++) {
+    ASSERT_EQ(3000U, report.stages[stage].samples);
+    ASSERT_EQ(47U, report.stages[stage].batches);
+  }
+  ASSERT_GT(report.stages[STAGE_READ].batches, 47U);
+}
+
+TEST(AsyncReplayTesting, TestImuLogMatchesSequentialReplay) {
+  TempFile recording;
+  {
+    imulog::ImuLogWriter writer;
+    ASSERT_TRUE(writer.open(recording.path.c_str(),
+                            imulog::makeHeader(200.0)));
+    filters::SyntheticSensorSource source(2000, 200.0, kBodyRate);
+    filters::AcquiredSample sample;
+    while (source.read(sample)) {
+      writer.write(sample);
+    }
+    ASSERT_TRUE(writer.close());
+  }
+
+  AsyncReplaySettings settings;
+  settings.format = RECORDING_IMULOG;
+  settings.block_bytes = 100; // smaller than the header
+  settings.batch_samples = 500;
+  settings.warmup_s = 1.0;
+  AsyncReplayReport report;
+  ASSERT_TRUE(runPipeline(recording.path.c_str(), settings, report))
+      << report.error;
+
+  imulog::ImuLogReader reader;
+  ASSERT_TRUE(reader.open(recording.path.c_str()));
+  imulog::ImuLogSensorSource source(reader);
+  evaluation::ErrorAccumulator errors;
+  uint64_t samples;
+  replaySequentially(source, imulog::headerCalibration(reader.getHeader()),
+                     settings.warmup_s, errors, samples);
+
+  ASSERT_EQ(2000U, report.samples);
+  ASSERT_EQ(errors.count(), report.errors.count());
+  ASSERT_EQ(errors.rms(), report.errors.rms());
+  ASSERT_EQ(4U, report.stages[STAGE_FILTER].batches);
+}
+
+TEST(AsyncReplayTesting, TestRejectsInvalidLog) {
+  TempFile recording;
+  writeCsv(recording.path.c_str(), 100);
+
+  AsyncReplaySettings settings;
+  settings.format = RECORDING_IMULOG;
+  AsyncReplayReport report;
+  ASSERT_FALSE(runPipeline(recording.path.c_str(), settings, report));
+  ASSERT_STREQ("not a valid IMU log", report.error);
+  ASSERT_EQ(0U, report.samples);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// keep the producer and consumer indices on separate cache lines on hosts,
+// while staying compact on microcontrollers without a data cache
+#ifndef RING_BUFFER_INDEX_ALIGNMENT
+#if defined(__arm__)
+#define RING_BUFFER_INDEX_ALIGNMENT 4
+#else
+#define RING_BUFFER_INDEX_ALIGNMENT 64
+#endif
+#endif
+
+namespace structures {
+
+/**
+ * @brief a bounded, lock-free, single producer single consumer ring buffer.
+ * Exactly one thread may call push() and exactly one thread may call pop().
+ * @tparam T the element type.
+ * @tparam capacity the maximum number of elements. Must be a power of two.
+ */
+template <typename T, size_t capacity> class SpscRingBuffer {
+  static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0,
+                "SpscRingBuffer capacity must be a power of two");
+
+public:
+  /**
+   * @brief constructs an empty ring buffer.
+   */
+  SpscRingBuffer() : _head(0), _tail(0) {}
+
+  SpscRingBuffer(const SpscRingBuffer &other) = delete;
+  SpscRingBuffer &operator=(const SpscRingBuffer &other) = delete;
+
+  /**
+   * @brief appends an element. Must only be called from the producer.
+   * @param item the element to append.
+   * @return false if the buffer was full, true otherwise.
+   */
+  bool push(const T &item) {
+    const size_t head = this->_head.load(std::memory_order_relaxed);
+    if (head - this->_tail.load(std::memory_order_acquire) >= capacity) {
+      return false;
+    }
+
+    this->_items[head & (capacity - 1)] = item;
+    this->_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief removes the oldest element. Must only be called from the
+   * consumer.
+   * @param item the element to copy the removed value into.
+   * @return false if the buffer was empty, true otherwise.
+   */
+  bool pop(T &item) {
+    const size_t tail = this->_tail.load(std::memory_order_relaxed);
+    if (tail == this->_head.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    item = this->_items[tail & (capacity - 1)];
+    this->_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief returns the number of elements currently stored. Only exact when
+   * called from the producer or consumer while the other side is idle.
+   * @return the number of elements currently stored.
+   */
+  size_t size() const {
+    return this->_head.load(std::memory_order_acquire) -
+           this->_tail.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief checks if the buffer is empty.
+   * @return true if empty, false otherwise.
+   */
+  bool empty() const { return this->size() == 0; }
+
+  /**
+   * @brief checks if the buffer is full.
+   * @return true if full, false otherwise.
+   */
+  bool full() const { return this->size() >= capacity; }
+
+  /**
+   * @brief returns the maximum number of elements.
+   * @return the maximum number of elements.
+   */
+  size_t getCapacity() const { return capacity; }
+
+private:
+  T _items[capacity];
+  alignas(RING_BUFFER_INDEX_ALIGNMENT) std::atomic<size_t> _head;
+  alignas(RING_BUFFER_INDEX_ALIGNMENT) std::atomic<size_t> _tail;
+}; // end SpscRingBuffer class
+
+/**
+ * @brief a bounded, lock-free, single producer ring buffer that delivers
+ * every element to each of several consumers. Each consumer reads at its
+ * own pace, and an element is only overwritten once every consumer has
+ * read it, so the producer is held back by the slowest consumer. Exactly
+ * one thread may call push(), and each consumer index may only be popped
+ * by one thread.
+ * @tparam T the element type.
+ * @tparam capacity the maximum number of unread elements. Must be a power
+ * of two.
+ * @tparam max_consumers the maximum number of consumers.
+ */
+template <typename T, size_t capacity, size_t max_consumers>
+class BroadcastRingBuffer {
+  static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0,
+                "BroadcastRingBuffer capacity must be a power of two");
+
+public:
+  /**
+   * @brief constructs an empty ring buffer.
+   * @param consumers the number of consumers, at most max_consumers.
+   */
+  BroadcastRingBuffer(size_t consumers)
+      : _consumers(consumers < max_consumers ? consumers : max_consumers),
+        _head(0), _min_tail(0) {
+    for (size_t i = 0; i < max_consumers; i++) {
+      this->_tails[i].index.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  BroadcastRingBuffer(const BroadcastRingBuffer &other) = delete;
+  BroadcastRingBuffer &operator=(const BroadcastRingBuffer &other) = delete;
+
+  /**
+   * @brief appends an element for every consumer. Must only be called from
+   * the producer.
+   * @param item the element to append.
+   * @return false if the slowest consumer has not made room yet, true
+   * otherwise.
+   */
+  bool push(const T &item) {
+    const size_t head = this->_head.load(std::memory_order_relaxed);
+    if (head - this->_min_tail >= capacity) {
+      // only rescan the consumers once the cached slowest one blocks
+      this->_min_tail = this->minTail(head);
+      if (head - this->_min_tail >= capacity) {
+        return false;
+      }
+    }
+
+    this->_items[head & (capacity - 1)] = item;
+    this->_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief removes the oldest element a consumer has not read yet. Must
+   * only be called from that consumer.
+   * @param consumer the consumer index.
+   * @param item the element to copy the removed value into.
+   * @return false if the consumer has read every element, true otherwise.
+   */
+  bool pop(size_t consumer, T &item) {
+    std::atomic<size_t> &tail_index = this->_tails[consumer].index;
+    const size_t tail = tail_index.load(std::memory_order_relaxed);
+    if (tail == this->_head.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    item = this->_items[tail & (capacity - 1)];
+    tail_index.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief returns the number of elements a consumer has not read yet.
+   * @param consumer the consumer index.
+   * @return the number of unread elements.
+   */
+  size_t size(size_t consumer) const {
+    return this->_head.load(std::memory_order_acquire) -
+           this->_tails[consumer].index.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief returns the number of consumers.
+   * @return the number of consumers.
+   */
+  size_t getConsumerCount() const { return this->_consumers; }
+
+  /**
+   * @brief returns the maximum number of unread elements.
+   * @return the maximum number of unread elements.
+   */
+  size_t getCapacity() const { return capacity; }
+
+private:
+  size_t minTail(size_t head) const {
+    size_t min_tail = head;
+    for (size_t i = 0; i < this->_consumers; i++) {
+      size_t tail = this->_tails[i].index.load(std::memory_order_acquire);
+      if (head - tail > head - min_tail) {
+        min_tail = tail;
+      }
+    }
+    return min_tail;
+  }
+
+  struct alignas(RING_BUFFER_INDEX_ALIGNMENT) ConsumerIndex {
+    std::atomic<size_t> index;
+  };
+
+  T _items[capacity];
+  size_t _consumers;
+  alignas(RING_BUFFER_INDEX_ALIGNMENT) std::atomic<size_t> _head;
+  size_t _min_tail; // producer's cached copy of the slowest consumer's tail
+  ConsumerIndex _tails[max_consumers];
+}; // end BroadcastRingBuffer class
+} // namespace structures
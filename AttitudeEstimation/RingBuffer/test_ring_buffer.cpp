@@ -0,0 +1,135 @@
+#include "RingBuffer.hpp"
+#include "gtest/gtest.h"
+#include <thread>
+#include <vector>
+
+using namespace structures;
+
+TEST(RingBufferTesting, TestPushPop) {
+  SpscRingBuffer<int, 4> ring;
+  ASSERT_TRUE(ring.empty());
+  ASSERT_EQ(4, ring.getCapacity());
+
+  // fill the buffer
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(ring.push(i));
+  }
+  ASSERT_TRUE(ring.full());
+  ASSERT_FALSE(ring.push(4));
+
+  // drain it in FIFO order
+  int value = -1;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(ring.pop(value));
+    ASSERT_EQ(i, value);
+  }
+  ASSERT_FALSE(ring.pop(value));
+  ASSERT_TRUE(ring.empty());
+}
+
+TEST(RingBufferTesting, TestWrapAround) {
+  SpscRingBuffer<int, 2> ring;
+  int value = 0;
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(ring.push(i));
+    ASSERT_EQ(1, ring.size());
+    ASSERT_TRUE(ring.pop(value));
+    ASSERT_EQ(i, value);
+  }
+}
+
+TEST(RingBufferTesting, TestConcurrentProducerConsumer) {
+  SpscRingBuffer<long, 64> ring;
+  const long num_items = 200000;
+
+  std::thread producer([&ring, num_items]() {
+    for (long i = 0; i < num_items; i++) {
+      while (!ring.push(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // every element must arrive exactly once and in order
+  long expected = 0;
+  long value = 0;
+  while (expected < num_items) {
+    if (ring.pop(value)) {
+      ASSERT_EQ(expected, value);
+      expected++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  producer.join();
+  ASSERT_TRUE(ring.empty());
+}
+
+TEST(RingBufferTesting, TestBroadcastEveryConsumer) {
+  BroadcastRingBuffer<int, 4, 4> ring(3);
+  ASSERT_EQ(3U, ring.getConsumerCount());
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(ring.push(i));
+  }
+  ASSERT_FALSE(ring.push(4));
+
+  // every consumer sees every element, and the slowest one holds back the
+  // producer
+  int value = -1;
+  for (size_t consumer = 0; consumer < 2; consumer++) {
+    for (int i = 0; i < 4; i++) {
+      ASSERT_TRUE(ring.pop(consumer, value));
+      ASSERT_EQ(i, value);
+    }
+    ASSERT_FALSE(ring.pop(consumer, value));
+  }
+  ASSERT_FALSE(ring.push(4));
+  ASSERT_EQ(4U, ring.size(2));
+
+  ASSERT_TRUE(ring.pop(2, value));
+  ASSERT_EQ(0, value);
+  ASSERT_TRUE(ring.push(4));
+  ASSERT_EQ(1U, ring.size(0));
+  ASSERT_EQ(4U, ring.size(2));
+}
+
+TEST(RingBufferTesting, TestConcurrentBroadcast) {
+  const size_t num_consumers = 3;
+  BroadcastRingBuffer<long, 64, 4> ring(num_consumers);
+  const long num_items = 200000;
+
+  // every consumer must see every element exactly once and in order
+  std::vector<long> mismatches(num_consumers, 0);
+  std::vector<std::thread> consumers;
+  for (size_t consumer = 0; consumer < num_consumers; consumer++) {
+    consumers.emplace_back([&ring, &mismatches, consumer, num_items]() {
+      long expected = 0;
+      long value = 0;
+      while (expected < num_items) {
+        if (ring.pop(consumer, value)) {
+          mismatches[consumer] += value != expected;
+          expected++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  for (long i = 0; i < num_items; i++) {
+    while (!ring.push(i)) {
+      std::this_thread::yield();
+    }
+  }
+  for (size_t consumer = 0; consumer < num_consumers; consumer++) {
+    consumers[consumer].join();
+    ASSERT_EQ(0, mismatches[consumer]);
+    ASSERT_EQ(0U, ring.size(consumer));
+  }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
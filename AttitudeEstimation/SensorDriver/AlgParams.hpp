@@ -1,17 +1,26 @@
 #pragma once
 
+namespace filters {
+
 /**
  * @brief algorithm parameters for the complementary filter
 */
-#define COMP_FILTER_ALPHA_GAIN 0.9
+struct ComplementaryParams {
+  static constexpr double alpha() { return 0.9; }
+};
 
 /**
  * @brief algorithm parameters for the Madgwick Filter
 */
-#define BETA_GAIN (0.866*0.05)
+struct MadgwickParams {
+  static constexpr double beta() { return 0.866 * 0.05; }
+};
 
 /**
  * @brief algorithm parameters for the Mahony Filter
 */
-#define KI 0.1
-#define KP 1.0
\ No newline at end of file
+struct MahonyParams {
+  static constexpr double kI() { return 0.1; }
+  static constexpr double kP() { return 1.0; }
+};
+} // namespace filters
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "../EstimationAlgs/SensorSample.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+// nominal sensor constants used to build the default calibration
+#define EARTH_G_MSS 9.81
+#define ACCEL_SENSITIVITY 4096 // LSB/g
+#define GYRO_SENSITIVITY 16.4  // LSB/deg/sec
+#define MAG_SENSITIVITY 16     // LSB/uT
+#define DEG_TO_RAD_SCALE 0.017453292519943
+#define UT_TO_NT_SCALE 1000.0
+
+namespace filters {
+
+/**
+ * @brief a precomputed 3x4 affine transform that maps one raw int16 sensor
+ * triple to body frame SI units in a single multiply-add pass:
+ *
+ *   out = A * raw + b
+ *
+ * where A folds together the LSB scale, unit conversion, scale/soft-iron
+ * correction and sensor-to-body alignment, and b folds in the bias or
+ * hard-iron offset.
+ */
+template <typename T> class AffineCalibration {
+public:
+  /**
+   * @brief default constructor. Creates an identity transform.
+   */
+  AffineCalibration() {
+    for (size_t row = 0; row < 3; row++) {
+      for (size_t col = 0; col < 4; col++) {
+        this->_affine[row][col] = (row == col) ? 1 : 0;
+      }
+    }
+  }
+
+  /**
+   * @brief constructor for AffineCalibration class.
+   * @param affine the 3x4 affine transform [A | b] to use directly.
+   */
+  AffineCalibration(const T affine[3][4]) {
+    for (size_t row = 0; row < 3; row++) {
+      for (size_t col = 0; col < 4; col++) {
+        this->_affine[row][col] = affine[row][col];
+      }
+    }
+  }
+
+  /**
+   * @brief builds a pure scale calibration (no bias, soft-iron or
+   * misalignment correction).
+   * @param lsb_to_si the factor converting one LSB to the output unit.
+   * @return the resulting calibration.
+   */
+  static AffineCalibration<T> fromScale(T lsb_to_si) {
+    AffineCalibration<T> calibration;
+    for (size_t row = 0; row < 3; row++) {
+      calibration._affine[row][row] = lsb_to_si;
+    }
+    return calibration;
+  }
+
+  /**
+   * @brief folds a full calibration model into a single affine transform.
+   * The modelled conversion is:
+   *
+   *   out = alignment * correction * (lsb_to_si * raw - bias)
+   *
+   * @param lsb_to_si the factor converting one LSB to the output unit.
+   * @param bias the bias (or hard-iron offset) in output units.
+   * @param correction the scale/cross-axis (or soft-iron) correction matrix.
+   * @param alignment the rotation from the sensor frame to the body frame.
+   * @return the resulting calibration.
+   */
+  static AffineCalibration<T> fromComponents(T lsb_to_si, const T bias[3],
+                                             const T correction[3][3],
+                                             const T alignment[3][3]) {
+    // M = alignment * correction
+    T combined[3][3];
+    for (size_t i = 0; i < 3; i++) {
+      for (size_t j = 0; j < 3; j++) {
+        T sum = 0;
+        for (size_t k = 0; k < 3; k++) {
+          sum += alignment[i][k] * correction[k][j];
+        }
+        combined[i][j] = sum;
+      }
+    }
+
+    // A = M * lsb_to_si, b = -M * bias
+    AffineCalibration<T> calibration;
+    for (size_t i = 0; i < 3; i++) {
+      T offset = 0;
+      for (size_t j = 0; j < 3; j++) {
+        calibration._affine[i][j] = combined[i][j] * lsb_to_si;
+        offset -= combined[i][j] * bias[j];
+      }
+      calibration._affine[i][3] = offset;
+    }
+    return calibration;
+  }
+
+  /**
+   * @brief applies this calibration to a single raw triple.
+   * @param raw the raw <X, Y, Z> reading.
+   * @param out the calibrated <X, Y, Z> reading.
+   */
+  void apply(const int16_t raw[3], T out[3]) const {
+    const T x = raw[0];
+    const T y = raw[1];
+    const T z = raw[2];
+    for (size_t row = 0; row < 3; row++) {
+      out[row] = this->_affine[row][0] * x + this->_affine[row][1] * y +
+                 this->_affine[row][2] * z + this->_affine[row][3];
+    }
+  }
+
+  /**
+   * @brief applies this calibration to a batch of raw triples, such as the
+   * contents of a sensor FIFO.
+   * @param raw pointer to count packed raw <X, Y, Z> readings.
+   * @param count the number of readings in the batch.
+   * @param out pointer to count packed calibrated <X, Y, Z> readings.
+   */
+  void applyBatch(const int16_t (*raw)[3], size_t count, T (*out)[3]) const {
+    for (size_t i = 0; i < count; i++) {
+      this->apply(raw[i], out[i]);
+    }
+  }
+
+  /**
+   * @brief gets a value of the affine transform.
+   * @param row the row to get the value from.
+   * @param col the column to get the value from, column 3 being the offset.
+   * @return the value at (row, col).
+   */
+  T getValue(size_t row, size_t col) const { return this->_affine[row][col]; }
+
+private:
+  T _affine[3][4];
+}; // end AffineCalibration class
+
+/**
+ * @brief the calibration stage converting a raw 9DOF sample into a
+ * SensorSample, holding one precomputed affine transform per sensor.
+ */
+template <typename T> class SensorCalibration {
+public:
+  /**
+   * @brief default constructor. Creates identity transforms for all sensors.
+   */
+  SensorCalibration() {}
+
+  /**
+   * @brief constructor for SensorCalibration class.
+   * @param acc_cal the accelerometer calibration (output in m/s^2).
+   * @param gyro_cal the gyroscope calibration (output in rad/s).
+   * @param mag_cal the magnetometer calibration (output in nT).
+   */
+  SensorCalibration(const AffineCalibration<T> &acc_cal,
+                    const AffineCalibration<T> &gyro_cal,
+                    const AffineCalibration<T> &mag_cal)
+      : _acc_cal(acc_cal), _gyro_cal(gyro_cal), _mag_cal(mag_cal) {}
+
+  /**
+   * @brief builds the calibration matching the nominal datasheet
+   * sensitivities, with no bias or alignment correction.
+   * @return the nominal calibration.
+   */
+  static SensorCalibration<T> nominal() {
+    return SensorCalibration<T>(
+        AffineCalibration<T>::fromScale(EARTH_G_MSS / ACCEL_SENSITIVITY),
+        AffineCalibration<T>::fromScale(DEG_TO_RAD_SCALE / GYRO_SENSITIVITY),
+        AffineCalibration<T>::fromScale(UT_TO_NT_SCALE / MAG_SENSITIVITY));
+  }
+
+  /**
+   * @brief converts a single raw sample.
+   * @param raw the raw sample.
+   * @param out the calibrated sample. The timestamp is carried over.
+   */
+  void apply(const RawSensorSample &raw, SensorSample<T> &out) const {
+    this->_acc_cal.apply(raw.acc, out.acc);
+    this->_gyro_cal.apply(raw.gyro, out.gyro);
+    this->_mag_cal.apply(raw.mag, out.mag);
+    out.timestamp_us = raw.timestamp_us;
+  }
+
+  /**
+   * @brief converts a batch of raw samples.
+   * @param raw pointer to count raw samples.
+   * @param count the number of samples in the batch.
+   * @param out pointer to count calibrated samples.
+   */
+  void applyBatch(const RawSensorSample *raw, size_t count,
+                  SensorSample<T> *out) const {
+    for (size_t i = 0; i < count; i++) {
+      this->apply(raw[i], out[i]);
+    }
+  }
+
+  /**
+   * @brief gets the accelerometer calibration.
+   * @return the accelerometer calibration.
+   */
+  const AffineCalibration<T> &getAccCalibration() const {
+    return this->_acc_cal;
+  }
+
+  /**
+   * @brief gets the gyroscope calibration.
+   * @return the gyroscope calibration.
+   */
+  const AffineCalibration<T> &getGyroCalibration() const {
+    return this->_gyro_cal;
+  }
+
+  /**
+   * @brief gets the magnetometer calibration.
+   * @return the magnetometer calibration.
+   */
+  const AffineCalibration<T> &getMagCalibration() const {
+    return this->_mag_cal;
+  }
+
+private:
+  AffineCalibration<T> _acc_cal;
+  AffineCalibration<T> _gyro_cal;
+  AffineCalibration<T> _mag_cal;
+}; // end SensorCalibration class
+} // namespace filters
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#if !defined(ARDUINO)
+#include <chrono>
+#endif
+
+namespace filters {
+
+/**
+ * Clocks provide uint64_t nowUs(), returning a monotonic time in
+ * microseconds. The on-device clock extending the Arduino micros() counter
+ * lives in SensorDriver.hpp with the rest of the board specific code.
+ */
+
+/**
+ * @brief a clock that only moves when told to, for simulation and tests.
+ */
+class ManualClock {
+public:
+  /**
+   * @brief constructor for ManualClock class.
+   * @param start_us the initial time in microseconds.
+   */
+  ManualClock(uint64_t start_us = 0U) { this->_now_us = start_us; }
+
+  /**
+   * @brief returns the current time.
+   * @return the current time in microseconds.
+   */
+  uint64_t nowUs() const { return this->_now_us; }
+
+  /**
+   * @brief moves the clock forward.
+   * @param delta_us the time to advance by in microseconds.
+   */
+  void advance(uint64_t delta_us) { this->_now_us += delta_us; }
+
+  /**
+   * @brief sets the current time.
+   * @param now_us the new time in microseconds.
+   */
+  void set(uint64_t now_us) { this->_now_us = now_us; }
+
+private:
+  uint64_t _now_us;
+}; // end ManualClock class
+
+#if !defined(ARDUINO)
+/**
+ * @brief a host clock backed by std::chrono::steady_clock, counting from
+ * the moment it was constructed.
+ */
+class SteadyClock {
+public:
+  /**
+   * @brief default constructor for SteadyClock class.
+   */
+  SteadyClock() : _start(std::chrono::steady_clock::now()) {}
+
+  /**
+   * @brief returns the time since construction.
+   * @return the time since construction in microseconds.
+   */
+  uint64_t nowUs() const {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - this->_start)
+        .count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point _start;
+}; // end SteadyClock class
+#endif
+} // namespace filters
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "../Quaternion/Quaternion.hpp"
+#include "Records.hpp"
+#include <math.h>
+#include <stdint.h>
+
+namespace filters {
+
+/**
+ * @brief enum to hold available estimate emission modes.
+ */
+typedef enum {
+  EMIT_EVERY_UPDATE, // emit one estimate per filter update
+  EMIT_FIXED_RATE,   // emit at a fixed rate, independent of the filter rate
+  EMIT_DEADBAND      // emit when the estimate moves, with a keep-alive
+} emission_mode_t;
+
+/**
+ * @brief decides which filter estimates are sent to the output stage, so
+ * the filter can run at the full sensor rate without saturating the link.
+ * All decisions are made on sample timestamps, so replayed data is
+ * decimated exactly as it would have been live.
+ */
+class EmissionPolicy {
+public:
+  /**
+   * @brief default constructor. Emits every estimate.
+   */
+  EmissionPolicy() {
+    this->_mode = EMIT_EVERY_UPDATE;
+    this->_interval_us = 0U;
+    this->_min_abs_dot = 1.0;
+    this->reset();
+  }
+
+  /**
+   * @brief builds a policy emitting every estimate.
+   * @return the resulting policy.
+   */
+  static EmissionPolicy everyUpdate() { return EmissionPolicy(); }
+
+  /**
+   * @brief builds a policy emitting at a fixed rate. Estimates are picked on
+   * a fixed time grid, so the long term output rate does not drift with
+   * sample jitter.
+   * @param rate_hz the output rate in Hz. A rate that is not positive, or
+   * not a number, leaves nothing to pick a grid from, so every estimate is
+   * emitted.
+   * @return the resulting policy.
+   */
+  static EmissionPolicy fixedRate(double rate_hz) {
+    if (!(rate_hz > 0)) {
+      return EmissionPolicy::everyUpdate();
+    }
+    EmissionPolicy policy;
+    policy._mode = EMIT_FIXED_RATE;
+    policy._interval_us = (uint64_t)(1e6 / rate_hz + 0.5);
+    return policy;
+  }
+
+  /**
+   * @brief builds a policy emitting only when the estimate has rotated more
+   * than a threshold away from the last emitted estimate, or when the
+   * keep-alive interval has passed since the last emitted estimate.
+   * @param threshold_rad the angular distance threshold in radians.
+   * @param keep_alive_us the longest time between emitted estimates in
+   * microseconds, or zero to disable the keep-alive.
+   * @return the resulting policy.
+   */
+  static EmissionPolicy deadband(double threshold_rad, uint64_t keep_alive_us) {
+    EmissionPolicy policy;
+    policy._mode = EMIT_DEADBAND;
+    policy._interval_us = keep_alive_us;
+
+    // the angle between unit quaternions p and q is 2 * acos(|p . q|), so
+    // the threshold is compared on the dot product to skip the acos
+    policy._min_abs_dot = cos(threshold_rad / 2.0);
+    return policy;
+  }
+
+  /**
+   * @brief forgets the previously emitted estimate, so the next estimate is
+   * always emitted.
+   */
+  void reset() {
+    this->_has_emitted = false;
+    this->_next_emit_us = 0U;
+    this->_last_emit_us = 0U;
+    this->_suppressed = 0U;
+  }
+
+  /**
+   * @brief decides whether an estimate should be emitted, and records it as
+   * the last emitted estimate if so.
+   * @param record the new estimate.
+   * @return true if the estimate should be emitted, false otherwise.
+   */
+  bool shouldEmit(const EstimateRecord &record) {
+    bool emit = !this->_has_emitted;
+    if (!emit) {
+      switch (this->_mode) {
+      case EMIT_EVERY_UPDATE:
+        emit = true;
+        break;
+      case EMIT_FIXED_RATE:
+        emit = record.timestamp_us >= this->_next_emit_us;
+        break;
+      case EMIT_DEADBAND:
+        emit = this->exceedsDeadband(record.estimate) ||
+               (this->_interval_us > 0 &&
+                record.timestamp_us - this->_last_emit_us >=
+                    this->_interval_us);
+        break;
+      }
+    }
+
+    if (!emit) {
+      this->_suppressed++;
+      return false;
+    }
+
+    if (this->_mode == EMIT_FIXED_RATE) {
+      // advance along the grid, skipping any slots missed entirely
+      this->_next_emit_us =
+          this->_has_emitted ? this->_next_emit_us + this->_interval_us
+                             : record.timestamp_us + this->_interval_us;
+      if (this->_next_emit_us <= record.timestamp_us) {
+        this->_next_emit_us = record.timestamp_us + this->_interval_us;
+      }
+    }
+    this->_last_emit_us = record.timestamp_us;
+    this->_last_estimate = record.estimate;
+    this->_has_emitted = true;
+    return true;
+  }
+
+  /**
+   * @brief returns the number of estimates withheld by this policy.
+   * @return the number of suppressed estimates.
+   */
+  uint32_t getSuppressedCount() const { return this->_suppressed; }
+
+  /**
+   * @brief returns the emission mode of this policy.
+   * @return the emission mode of this policy.
+   */
+  emission_mode_t getMode() const { return this->_mode; }
+
+private:
+  /**
+   * @brief checks if an estimate is outside the deadband around the last
+   * emitted estimate.
+   * @param estimate the new estimate.
+   * @return true if outside the deadband, false otherwise.
+   */
+  bool exceedsDeadband(const structures::Quaternion<double> &estimate) const {
+    double dot = estimate.getW() * this->_last_estimate.getW() +
+                 estimate.getX() * this->_last_estimate.getX() +
+                 estimate.getY() * this->_last_estimate.getY() +
+                 estimate.getZ() * this->_last_estimate.getZ();
+    return fabs(dot) < this->_min_abs_dot;
+  }
+
+  emission_mode_t _mode;
+  uint64_t _interval_us;
+  double _min_abs_dot;
+  bool _has_emitted;
+  uint64_t _next_emit_us;
+  uint64_t _last_emit_us;
+  structures::Quaternion<double> _last_estimate;
+  uint32_t _suppressed;
+}; // end EmissionPolicy class
+} // namespace filters
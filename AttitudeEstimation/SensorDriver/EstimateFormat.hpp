@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Records.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace filters {
+
+/**
+ * @brief formats estimate records as the line oriented JSON messages
+ * consumed by the visualization tool.
+ */
+class JsonEstimateFormatter {
+public:
+  /**
+   * @brief the largest message this formatter can produce.
+   */
+  static const size_t kMaxMessageLength = 512;
+
+  /**
+   * @brief formats a single estimate record.
+   * @param record the record to format.
+   * @param buffer the buffer to write the message into.
+   * @param buffer_len the size of buffer in bytes.
+   * @return the message length in bytes, or zero if it did not fit.
+   */
+  size_t format(const EstimateRecord &record, uint8_t *buffer,
+                size_t buffer_len) const {
+    int message_len =
+        snprintf((char *)buffer, buffer_len, _JSON_format_patt,
+                 record.ground_truth.getW(), record.ground_truth.getX(),
+                 record.ground_truth.getY(), record.ground_truth.getZ(),
+                 record.estimate.getW(), record.estimate.getX(),
+                 record.estimate.getY(), record.estimate.getZ());
+
+    if (message_len < 0 || (size_t)message_len >= buffer_len) {
+      return 0;
+    }
+    return (size_t)message_len;
+  }
+
+  /**
+   * @brief formats a line of text, such as a diagnostic report, for the
+   * same stream as the estimate messages.
+   * @param text the text, ending in a newline.
+   * @param text_len the text length in bytes.
+   * @param buffer the buffer to write the message into.
+   * @param buffer_len the size of buffer in bytes.
+   * @return the message length in bytes, or zero if it did not fit.
+   */
+  size_t formatText(const uint8_t *text, size_t text_len, uint8_t *buffer,
+                    size_t buffer_len) const {
+    if (text_len > buffer_len) {
+      return 0;
+    }
+    memcpy(buffer, text, text_len);
+    return text_len;
+  }
+
+private:
+  static constexpr const char *_JSON_format_patt =
+      "{\"ground_truth_quat\": {\"w\": %f, \"x\": %f, \"y\": %f, \"z\": "
+      "%f},\"estimated_quat\": {\"w\": %f,\"x\": %f,\"y\": %f,\"z\": %f}}\n";
+}; // end JsonEstimateFormatter class
+} // namespace filters
@@ -0,0 +1,401 @@
+#pragma once
+
+#include "../RingBuffer/RingBuffer.hpp"
+#include "Calibration.hpp"
+#include "Records.hpp"
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace filters {
+
+/**
+ * @brief the largest number of filters a FilterBank can run.
+ */
+static const size_t kMaxBankFilters = 8;
+
+/**
+ * @brief the estimates of every filter in a bank for one sample.
+ */
+struct BankRow {
+  uint32_t sequence;                           // acquisition sequence number
+  uint64_t timestamp_us;                       // sample timestamp
+  structures::Quaternion<double> ground_truth; // sensor's own estimate
+  structures::Quaternion<double> estimates[kMaxBankFilters]; // per filter
+  uint32_t valid_mask; // bit i is set if filter i produced estimates[i]
+};
+
+/**
+ * @brief a host side bank of filters fed from one sample stream. Every
+ * sample is broadcast to all filters through a lock-free ring, each filter
+ * runs on its own worker thread, optionally pinned to its own CPU, and the
+ * estimates are merged back into rows aligned by sequence number. The
+ * filters are held by value and updated in a loop specialized for their
+ * type, so the only virtual call is the one that starts a worker.
+ */
+class FilterBank {
+public:
+  static const size_t kInputDepth = 1024;
+  static const size_t kOutputDepth = 256;
+
+  /**
+   * @brief constructor for FilterBank class.
+   * @param calibration the raw-to-SI calibration applied to every sample.
+   */
+  FilterBank(const SensorCalibration<double> &calibration =
+                 SensorCalibration<double>::nominal())
+      : _calibration(calibration), _pinning(true), _started(false),
+        _closed(false), _abandoned(false) {}
+
+  FilterBank(const FilterBank &other) = delete;
+  FilterBank &operator=(const FilterBank &other) = delete;
+
+  /**
+   * @brief destructor for FilterBank class. Stops the workers, discarding
+   * any samples and estimates still queued.
+   */
+  ~FilterBank() {
+    this->_abandoned.store(true, std::memory_order_release);
+    this->close();
+    this->stop();
+  }
+
+  /**
+   * @brief adds a filter to the bank. Must be called before start().
+   * @tparam DriverT the filter or filter driver. Must provide
+   * update(const SensorSample<double> &, structures::Quaternion<double> &).
+   * @param name the filter name, used in reports. Not copied.
+   * @param driver the filter to copy into the bank.
+   * @return false if the bank is full or already started, true otherwise.
+   */
+  template <typename DriverT>
+  bool addFilter(const char *name, const DriverT &driver = DriverT()) {
+    if (this->_started || this->_lanes.size() >= kMaxBankFilters) {
+      return false;
+    }
+    this->_lanes.emplace_back(new DriverLane<DriverT>(name, driver));
+    return true;
+  }
+
+  /**
+   * @brief returns the number of filters in the bank.
+   * @return the number of filters.
+   */
+  size_t size() const { return this->_lanes.size(); }
+
+  /**
+   * @brief returns the name of a filter.
+   * @param index the filter index.
+   * @return the filter name.
+   */
+  const char *getName(size_t index) const {
+    return this->_lanes[index]->name;
+  }
+
+  /**
+   * @brief sets whether the workers are pinned to CPUs when started. Worker
+   * i is pinned to CPU (i + 1) modulo the CPU count, leaving CPU 0 to the
+   * producer. Enabled by default.
+   * @param enabled true to pin the workers, false to leave them floating.
+   */
+  void setPinning(bool enabled) { this->_pinning = enabled; }
+
+  /**
+   * @brief returns whether a worker was pinned to a CPU. Pinning can fail
+   * without failing the bank, for example when the process is restricted to
+   * fewer CPUs.
+   * @param index the filter index.
+   * @return true if the worker is pinned, false otherwise.
+   */
+  bool isPinned(size_t index) const { return this->_lanes[index]->pinned; }
+
+  /**
+   * @brief returns the number of samples a filter has processed.
+   * @param index the filter index.
+   * @return the number of processed samples.
+   */
+  uint64_t getProcessedCount(size_t index) const {
+    return this->_lanes[index]->processed.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief starts one worker per filter.
+   * @return false if the bank is empty or already started, true otherwise.
+   */
+  bool start() {
+    if (this->_started || this->_lanes.empty()) {
+      return false;
+    }
+    this->_input.reset(new input_ring_t(this->_lanes.size()));
+    this->_started = true;
+
+    unsigned int cpus = std::thread::hardware_concurrency();
+    for (size_t i = 0; i < this->_lanes.size(); i++) {
+      Lane *lane = this->_lanes[i].get();
+      lane->thread = std::thread([this, lane, i]() { lane->run(*this, i); });
+      if (this->_pinning && cpus > 1) {
+        lane->pinned = pinThread(lane->thread, (i + 1) % cpus);
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief offers a sample to every filter. Must only be called from one
+   * thread, after start().
+   * @param sample the sample, numbered by the caller.
+   * @return false if the slowest filter has not made room yet, true
+   * otherwise.
+   */
+  bool push(const AcquiredSample &sample) {
+    return this->_input->push(sample);
+  }
+
+  /**
+   * @brief signals that no more samples will be pushed. The workers exit
+   * once they have processed every pushed sample.
+   */
+  void close() { this->_closed.store(true, std::memory_order_release); }
+
+  /**
+   * @brief merges the next row of estimates, if every filter that has not
+   * finished has produced its estimate for the oldest outstanding sample.
+   * Must only be called from one thread. Filters that skipped the sample
+   * are left out of the row's valid mask.
+   * @param row the row to fill in.
+   * @return true if a row was merged, false otherwise.
+   */
+  bool pollAligned(BankRow &row) {
+    bool any_pending = false;
+    uint32_t oldest = 0;
+    for (size_t i = 0; i < this->_lanes.size(); i++) {
+      Lane &lane = *this->_lanes[i];
+      if (!lane.has_pending && !lane.fetch()) {
+        if (!lane.exhausted()) {
+          return false; // its estimate may still be coming
+        }
+        continue;
+      }
+      if (!any_pending || (int32_t)(lane.pending.sequence - oldest) < 0) {
+        oldest = lane.pending.sequence;
+      }
+      any_pending = true;
+    }
+    if (!any_pending) {
+      return false;
+    }
+
+    row.sequence = oldest;
+    row.valid_mask = 0;
+    for (size_t i = 0; i < this->_lanes.size(); i++) {
+      Lane &lane = *this->_lanes[i];
+      if (lane.has_pending && lane.pending.sequence == oldest) {
+        row.timestamp_us = lane.pending.timestamp_us;
+        row.ground_truth = lane.pending.ground_truth;
+        row.estimates[i] = lane.pending.estimate;
+        row.valid_mask |= 1U << i;
+        lane.has_pending = false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief checks whether the bank is closed and every row was merged.
+   * @return true if there is nothing left to merge, false otherwise.
+   */
+  bool finished() const {
+    if (!this->_closed.load(std::memory_order_acquire)) {
+      return false;
+    }
+    for (size_t i = 0; i < this->_lanes.size(); i++) {
+      const Lane &lane = *this->_lanes[i];
+      if (lane.has_pending || !lane.exhausted()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief waits for the workers to exit. Only returns once close() was
+   * called and the workers drained their input.
+   */
+  void stop() {
+    for (size_t i = 0; i < this->_lanes.size(); i++) {
+      if (this->_lanes[i]->thread.joinable()) {
+        this->_lanes[i]->thread.join();
+      }
+    }
+  }
+
+  /**
+   * @brief starts the bank if needed, then numbers and broadcasts every
+   * sample of a source until it is exhausted, passing each aligned row to
+   * a callback on the calling thread.
+   * @param source the sample source. Must provide
+   * bool read(AcquiredSample &sample), returning false once exhausted.
+   * @param callback called with every BankRow, in sequence order.
+   * @return the number of samples read.
+   */
+  template <typename SourceT, typename CallbackT>
+  uint64_t run(SourceT &source, CallbackT &&callback) {
+    if (!this->_started && !this->start()) {
+      return 0;
+    }
+
+    AcquiredSample sample;
+    BankRow row;
+    uint64_t acquired = 0;
+    while (source.read(sample)) {
+      sample.sequence = (uint32_t)acquired++;
+      while (!this->push(sample)) {
+        // the slowest filter is behind, merge rows while it catches up
+        if (!this->pollAligned(row)) {
+          std::this_thread::yield();
+          continue;
+        }
+        callback(row);
+      }
+      while (this->pollAligned(row)) {
+        callback(row);
+      }
+    }
+
+    this->close();
+    while (!this->finished()) {
+      if (this->pollAligned(row)) {
+        callback(row);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    this->stop();
+    return acquired;
+  }
+
+private:
+  typedef structures::BroadcastRingBuffer<AcquiredSample, kInputDepth,
+                                          kMaxBankFilters>
+      input_ring_t;
+
+  /**
+   * @brief one filter of the bank: its worker, its estimate ring and the
+   * merge state of the consumer side.
+   */
+  struct Lane {
+    Lane(const char *lane_name)
+        : name(lane_name), pinned(false), processed(0), done(false),
+          has_pending(false) {}
+    virtual ~Lane() {}
+
+    /**
+     * @brief the worker loop. Returns once the bank is closed and every
+     * sample was processed.
+     */
+    virtual void run(FilterBank &bank, size_t index) = 0;
+
+    /**
+     * @brief pops the next estimate into the pending slot.
+     * @return true if an estimate was popped, false otherwise.
+     */
+    bool fetch() {
+      this->has_pending = this->output.pop(this->pending);
+      return this->has_pending;
+    }
+
+    /**
+     * @brief checks whether the worker exited and its estimates were all
+     * popped.
+     * @return true if no more estimates will arrive, false otherwise.
+     */
+    bool exhausted() const {
+      return this->done.load(std::memory_order_acquire) &&
+             this->output.empty();
+    }
+
+    const char *name;
+    bool pinned;
+    std::atomic<uint64_t> processed;
+    std::atomic<bool> done;
+    std::thread thread;
+    structures::SpscRingBuffer<EstimateRecord, kOutputDepth> output;
+    EstimateRecord pending;
+    bool has_pending;
+  };
+
+  template <typename DriverT> struct DriverLane : public Lane {
+    DriverLane(const char *lane_name, const DriverT &lane_driver)
+        : Lane(lane_name), driver(lane_driver) {}
+
+    void run(FilterBank &bank, size_t index) override {
+      input_ring_t &input = *bank._input;
+      AcquiredSample acquired;
+      SensorSample<double> sample;
+      EstimateRecord record;
+      uint64_t processed = 0;
+      while (true) {
+        if (!input.pop(index, acquired)) {
+          // the closed flag is set after the last push, so an empty ring
+          // seen after it is final
+          if ((bank._closed.load(std::memory_order_acquire) &&
+               input.size(index) == 0) ||
+              bank._abandoned.load(std::memory_order_acquire)) {
+            break;
+          }
+          std::this_thread::yield();
+          continue;
+        }
+
+        bank._calibration.apply(acquired.raw, sample);
+        this->driver.update(sample, record.estimate);
+        record.sequence = acquired.sequence;
+        record.timestamp_us = sample.timestamp_us;
+        record.ground_truth = acquired.ground_truth;
+        while (!this->output.push(record) &&
+               !bank._abandoned.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+        this->processed.store(++processed, std::memory_order_relaxed);
+      }
+      this->done.store(true, std::memory_order_release);
+    }
+
+    DriverT driver;
+  };
+
+  /**
+   * @brief pins a thread to one CPU.
+   * @return true if the thread was pinned, false otherwise.
+   */
+  static bool pinThread(std::thread &thread, unsigned int cpu) {
+#if defined(__linux__)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set),
+                                  &cpu_set) == 0;
+#else
+    (void)thread;
+    (void)cpu;
+    return false;
+#endif
+  }
+
+  SensorCalibration<double> _calibration;
+  std::vector<std::unique_ptr<Lane>> _lanes;
+  std::unique_ptr<input_ring_t> _input;
+  bool _pinning;
+  bool _started;
+  std::atomic<bool> _closed;
+  std::atomic<bool> _abandoned;
+}; // end FilterBank class
+} // namespace filters
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "../EstimationAlgs/ComplementaryFilter/ComplementaryFilter.hpp"
+#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
+#include "../EstimationAlgs/MahonyFilter/MahonyFilter.hpp"
+#include "../EstimationAlgs/SensorSample.hpp"
+#include "../Matrix/Matrix.hpp"
+#include "../Quaternion/Quaternion.hpp"
+#include "AlgParams.hpp"
+#include <stdint.h>
+
+namespace filters {
+
+/**
+ * @brief enum to hold available filter types.
+ */
+typedef enum { COMPLEMENTARY, EKF, MADGWICK, MAHONY } available_filters_t;
+
+#ifdef TUNABLE_FILTER_GAINS
+// tuning builds keep the gains as runtime members, seeded from AlgParams.hpp
+typedef ComplementaryFilter ComplementaryDriverFilter;
+typedef MadgwickFilter MadgwickDriverFilter;
+typedef MahonyFilter MahonyDriverFilter;
+#else
+// the gains from AlgParams.hpp are folded into the filter update at compile
+// time
+typedef BasicComplementaryFilter<ComplementaryParams>
+    ComplementaryDriverFilter;
+typedef BasicMadgwickFilter<MadgwickParams> MadgwickDriverFilter;
+typedef BasicMahonyFilter<MahonyParams> MahonyDriverFilter;
+#endif
+
+/**
+ * @brief a class to perform an update operation on a complementary filter.
+ */
+class ComplementaryDriver {
+public:
+  /**
+   * @brief ComplementaryDriver constructor
+   */
+  ComplementaryDriver()
+#ifdef TUNABLE_FILTER_GAINS
+      : _comp_filt(ComplementaryGains(ComplementaryParams::alpha()))
+#endif
+  {
+  }
+
+  /**
+   * @brief Complementary filter update function. NOTE: all reading matricies
+   * are expected to be packed in <X, Y, Z> axis order.
+   * @param acc_mat accelerometer reading matrix.
+   * @param gyro_mat gyroscope reading matrix.
+   * @param mag_mat magnetometer reading matrix.
+   * @param ellapsed_time elapsed time since last update.
+   * @return a Quaternion instance with the newly estimated attitude.
+   */
+  structures::Quaternion<double>
+  update(const structures::Matrix<double, 3, 1> &acc_mat,
+         const structures::Matrix<double, 3, 1> &gyro_mat,
+         const structures::Matrix<double, 3, 1> &mag_mat,
+         uint32_t ellapsed_time) {
+
+    // perform complementary filter update
+    structures::Quaternion<double> new_quat_est =
+        this->_comp_filt.update(acc_mat, gyro_mat, mag_mat, ellapsed_time);
+
+    return new_quat_est;
+  }
+
+  /**
+   * @brief in-place Complementary filter update function.
+   * @param sample the new sensor sample.
+   * @param out the quaternion to write the newly estimated attitude into.
+   */
+  void update(const SensorSample<double> &sample,
+              structures::Quaternion<double> &out) {
+    this->_comp_filt.update(sample, out);
+  }
+
+private:
+  ComplementaryDriverFilter _comp_filt;
+}; // end ComplementaryDriver class
+
+/**
+ * @brief a class to perform an update operation on a EKF filter.
+ */
+class EKFDriver {
+public:
+  /**
+   * @brief EKF filter update function. NOTE: all reading matricies
+   * are expected to be packed in <X, Y, Z> axis order.
+   * @param acc_mat accelerometer reading matrix.
+   * @param gyro_mat gyroscope reading matrix.
+   * @param mag_mat magnetometer reading matrix.
+   * @param ellapsed_time elapsed time since last update.
+   * @return a Quaternion instance with the newly estimated attitude.
+   */
+  structures::Quaternion<double>
+  update(const structures::Matrix<double, 3, 1> &acc_mat,
+         const structures::Matrix<double, 3, 1> &gyro_mat,
+         const structures::Matrix<double, 3, 1> &mag_mat,
+         uint32_t ellapsed_time) {
+    (void)acc_mat;
+    (void)gyro_mat;
+    (void)mag_mat;
+    (void)ellapsed_time;
+
+    // TODO: Implement me
+    structures::Quaternion<double> new_quat_est;
+    return new_quat_est;
+  }
+
+  /**
+   * @brief in-place EKF filter update function.
+   * @param sample the new sensor sample, unused until the EKF exists.
+   * @param out the quaternion to write the newly estimated attitude into.
+   */
+  void update(const SensorSample<double> & /* sample */,
+              structures::Quaternion<double> &out) {
+    // TODO: Implement me
+    out = structures::Quaternion<double>();
+  }
+}; // end EKFDriver class
+
+/**
+ * @brief a class to perform an update operation on a Madgwick filter.
+ */
+class MadgwickDriver {
+public:
+  /**
+   * @brief default constructor
+   */
+  MadgwickDriver()
+#ifdef TUNABLE_FILTER_GAINS
+      : _madgwick_filter(MadgwickGains(MadgwickParams::beta()))
+#endif
+  {
+  }
+
+  /**
+   * @brief Madgwick filter update function. NOTE: all reading matricies
+   * are expected to be packed in <X, Y, Z> axis order.
+   * @param acc_mat accelerometer reading matrix.
+   * @param gyro_mat gyroscope reading matrix.
+   * @param mag_mat magnetometer reading matrix.
+   * @param ellapsed_time elapsed time since last update.
+   * @return a Quaternion instance with the newly estimated attitude.
+   */
+  structures::Quaternion<double>
+  update(const structures::Matrix<double, 3, 1> &acc_mat,
+         const structures::Matrix<double, 3, 1> &gyro_mat,
+         const structures::Matrix<double, 3, 1> &mag_mat,
+         uint32_t ellapsed_time) {
+
+    structures::Quaternion<double> new_quat_est = this->_madgwick_filter.update(
+        acc_mat, gyro_mat, mag_mat, ellapsed_time);
+    return new_quat_est;
+  }
+
+  /**
+   * @brief in-place Madgwick filter update function.
+   * @param sample the new sensor sample.
+   * @param out the quaternion to write the newly estimated attitude into.
+   */
+  void update(const SensorSample<double> &sample,
+              structures::Quaternion<double> &out) {
+    this->_madgwick_filter.update(sample, out);
+  }
+
+private:
+  MadgwickDriverFilter _madgwick_filter;
+}; // end MadgwickDriver class
+
+/**
+ * @brief a class to perform an update operation on a Mahony filter.
+ */
+class MahonyDriver {
+public:
+  /**
+   * @brief default constructor
+   */
+  MahonyDriver()
+#ifdef TUNABLE_FILTER_GAINS
+      : _mahony_filter(MahonyGains(MahonyParams::kI(), MahonyParams::kP()))
+#endif
+  {
+  }
+
+  /**
+   * @brief Mahony filter update function. NOTE: all reading matricies
+   * are expected to be packed in <X, Y, Z> axis order.
+   * @param acc_mat accelerometer reading matrix.
+   * @param gyro_mat gyroscope reading matrix.
+   * @param mag_mat magnetometer reading matrix.
+   * @param ellapsed_time elapsed time since last update.
+   * @return a Quaternion instance with the newly estimated attitude.
+   */
+  structures::Quaternion<double>
+  update(const structures::Matrix<double, 3, 1> &acc_mat,
+         const structures::Matrix<double, 3, 1> &gyro_mat,
+         const structures::Matrix<double, 3, 1> &mag_mat,
+         uint32_t ellapsed_time) {
+
+    structures::Quaternion<double> new_quat_est =
+        this->_mahony_filter.update(acc_mat, gyro_mat, mag_mat, ellapsed_time);
+    return new_quat_est;
+  }
+
+  /**
+   * @brief in-place Mahony filter update function.
+   * @param sample the new sensor sample.
+   * @param out the quaternion to write the newly estimated attitude into.
+   */
+  void update(const SensorSample<double> &sample,
+              structures::Quaternion<double> &out) {
+    this->_mahony_filter.update(sample, out);
+  }
+
+private:
+  MahonyDriverFilter _mahony_filter;
+}; // end MahonyDriver class
+
+/**
+ * @brief compile time mapping from an available_filters_t value to the
+ * driver class that implements it. The selected driver is stored by value
+ * in its owner, so every update is a direct (inlinable) call with no heap
+ * allocation or virtual dispatch.
+ */
+template <available_filters_t selected_filter> struct FilterDriverSelector;
+
+template <> struct FilterDriverSelector<COMPLEMENTARY> {
+  typedef ComplementaryDriver type;
+};
+
+template <> struct FilterDriverSelector<EKF> { typedef EKFDriver type; };
+
+template <> struct FilterDriverSelector<MADGWICK> {
+  typedef MadgwickDriver type;
+};
+
+template <> struct FilterDriverSelector<MAHONY> { typedef MahonyDriver type; };
+} // namespace filters
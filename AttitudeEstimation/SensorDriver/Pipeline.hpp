@@ -0,0 +1,287 @@
+#pragma once
+
+#include "../RingBuffer/RingBuffer.hpp"
+#include "Calibration.hpp"
+#include "Emission.hpp"
+#include "Records.hpp"
+#include "StageTiming.hpp"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// hook used while waiting on a full channel with the BLOCK policy
+#ifndef PIPELINE_YIELD
+#if defined(ARDUINO)
+#define PIPELINE_YIELD() yield()
+#else
+#include <thread>
+#define PIPELINE_YIELD() std::this_thread::yield()
+#endif
+#endif
+
+namespace filters {
+
+/**
+ * @brief what a pipeline channel does with a new item when it is full.
+ */
+typedef enum {
+  DROP_NEWEST, // discard the new item and count it as dropped
+  BLOCK        // wait until the consumer frees a slot
+} overflow_policy_t;
+
+/**
+ * @brief a bounded lock-free connection between two pipeline stages, with a
+ * configurable overflow policy. Exactly one stage may push and exactly one
+ * stage may pop. NOTE: the BLOCK policy only makes progress if the consumer
+ * runs on a different thread than the producer.
+ * @tparam T the item type.
+ * @tparam capacity the channel depth. Must be a power of two.
+ */
+template <typename T, size_t capacity> class StageChannel {
+public:
+  /**
+   * @brief constructor for StageChannel class.
+   * @param policy the overflow policy to apply when the channel is full.
+   */
+  StageChannel(overflow_policy_t policy = DROP_NEWEST)
+      : _policy(policy), _dropped(0) {}
+
+  /**
+   * @brief pushes an item, applying the overflow policy if full.
+   * @param item the item to push.
+   * @return true if the item was queued, false if it was dropped.
+   */
+  bool push(const T &item) {
+    while (!this->_ring.push(item)) {
+      if (this->_policy == DROP_NEWEST) {
+        this->_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      PIPELINE_YIELD();
+    }
+    return true;
+  }
+
+  /**
+   * @brief pops the oldest item.
+   * @param item the item to copy the popped value into.
+   * @return false if the channel was empty, true otherwise.
+   */
+  bool pop(T &item) { return this->_ring.pop(item); }
+
+  /**
+   * @brief returns the number of queued items.
+   * @return the number of queued items.
+   */
+  size_t size() const { return this->_ring.size(); }
+
+  /**
+   * @brief returns the number of items dropped due to overflow.
+   * @return the number of items dropped due to overflow.
+   */
+  uint32_t getDroppedCount() const {
+    return this->_dropped.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief returns the overflow policy of this channel.
+   * @return the overflow policy of this channel.
+   */
+  overflow_policy_t getOverflowPolicy() const { return this->_policy; }
+
+private:
+  structures::SpscRingBuffer<T, capacity> _ring;
+  overflow_policy_t _policy;
+  std::atomic<uint32_t> _dropped;
+}; // end StageChannel class
+
+/**
+ * @brief the acquisition stage. Reads samples from a source, numbers them
+ * and pushes them to the filter stage.
+ * @tparam SourceT the sample source. Must provide
+ * bool read(AcquiredSample &sample), returning false if no sample was ready.
+ * @tparam capacity the depth of the output channel.
+ */
+template <typename SourceT, size_t capacity> class AcquisitionStage {
+public:
+  /**
+   * @brief constructor for AcquisitionStage class.
+   * @param source the sample source.
+   * @param output the channel to push acquired samples into.
+   */
+  AcquisitionStage(SourceT &source,
+                   StageChannel<AcquiredSample, capacity> &output)
+      : _source(source), _output(output), _next_sequence(0) {}
+
+  /**
+   * @brief reads at most one sample from the source.
+   * @return true if a sample was read, false otherwise.
+   */
+  bool poll() {
+    STAGE_TIMING(uint32_t start_ticks = StageClock::now();)
+    if (!this->_source.read(this->_sample)) {
+      return false;
+    }
+    STAGE_TIMING(recordStage(this->_profiler, STAGE_READ, start_ticks);)
+    STAGE_TIMING(this->_sample.acquired_ticks = start_ticks;)
+
+    this->_sample.sequence = this->_next_sequence++;
+    this->_output.push(this->_sample);
+    return true;
+  }
+
+#if SENSOR_MANAGER_STAGE_TIMING
+  /**
+   * @brief sets the profiler recording the read time of every sample.
+   * @param profiler the profiler, or NULL to stop recording.
+   */
+  void setProfiler(StageProfiler *profiler) { this->_profiler = profiler; }
+#endif
+
+private:
+  SourceT &_source;
+  StageChannel<AcquiredSample, capacity> &_output;
+  AcquiredSample _sample;
+  uint32_t _next_sequence;
+  STAGE_TIMING(StageProfiler *_profiler = NULL;)
+}; // end AcquisitionStage class
+
+/**
+ * @brief the filter stage. Calibrates acquired samples, runs them through
+ * the filter driver, and pushes the estimates selected by the emission
+ * policy to the output stage.
+ * @tparam DriverT the filter driver type.
+ * @tparam in_capacity the depth of the input channel.
+ * @tparam out_capacity the depth of the output channel.
+ */
+template <typename DriverT, size_t in_capacity, size_t out_capacity>
+class FilterStage {
+public:
+  /**
+   * @brief constructor for FilterStage class.
+   * @param input the channel to pop acquired samples from.
+   * @param output the channel to push estimates into.
+   * @param calibration the raw-to-SI calibration applied to every sample.
+   * @param emission the policy deciding which estimates are passed on.
+   */
+  FilterStage(StageChannel<AcquiredSample, in_capacity> &input,
+              StageChannel<EstimateRecord, out_capacity> &output,
+              const SensorCalibration<double> &calibration,
+              const EmissionPolicy &emission = EmissionPolicy::everyUpdate())
+      : _input(input), _output(output), _calibration(calibration),
+        _emission(emission) {}
+
+  /**
+   * @brief processes queued samples.
+   * @param max_items the maximum number of samples to process.
+   * @return the number of samples processed.
+   */
+  size_t process(size_t max_items) {
+    size_t processed = 0;
+    while (processed < max_items && this->_input.pop(this->_acquired)) {
+      STAGE_TIMING(uint32_t ticks = StageClock::now();)
+      this->_calibration.apply(this->_acquired.raw, this->_sample);
+      STAGE_TIMING(
+          ticks = recordStage(this->_profiler, STAGE_CALIBRATE, ticks);)
+      this->_driver.update(this->_sample, this->_record.estimate);
+      STAGE_TIMING(recordStage(this->_profiler, STAGE_FILTER, ticks);)
+      STAGE_TIMING(
+          this->_record.acquired_ticks = this->_acquired.acquired_ticks;)
+
+      this->_record.sequence = this->_acquired.sequence;
+      this->_record.timestamp_us = this->_sample.timestamp_us;
+      this->_record.ground_truth = this->_acquired.ground_truth;
+      if (this->_emission.shouldEmit(this->_record)) {
+        this->_output.push(this->_record);
+      }
+      processed++;
+    }
+    return processed;
+  }
+
+  /**
+   * @brief returns the emission policy of this stage.
+   * @return the emission policy of this stage.
+   */
+  const EmissionPolicy &getEmissionPolicy() const { return this->_emission; }
+
+#if SENSOR_MANAGER_STAGE_TIMING
+  /**
+   * @brief sets the profiler recording the calibration and filter update
+   * time of every sample.
+   * @param profiler the profiler, or NULL to stop recording.
+   */
+  void setProfiler(StageProfiler *profiler) { this->_profiler = profiler; }
+#endif
+
+private:
+  StageChannel<AcquiredSample, in_capacity> &_input;
+  StageChannel<EstimateRecord, out_capacity> &_output;
+  SensorCalibration<double> _calibration;
+  EmissionPolicy _emission;
+  DriverT _driver;
+  AcquiredSample _acquired;
+  SensorSample<double> _sample;
+  EstimateRecord _record;
+  STAGE_TIMING(StageProfiler *_profiler = NULL;)
+}; // end FilterStage class
+
+/**
+ * @brief the output stage. Formats estimates and writes them to a sink.
+ * @tparam FormatterT the message formatter. Must provide kMaxMessageLength
+ * and size_t format(const EstimateRecord &, uint8_t *, size_t).
+ * @tparam SinkT the byte sink. Must provide write(const uint8_t *, size_t),
+ * such as the Arduino Serial object.
+ * @tparam capacity the depth of the input channel.
+ */
+template <typename FormatterT, typename SinkT, size_t capacity>
+class OutputStage {
+public:
+  /**
+   * @brief constructor for OutputStage class.
+   * @param input the channel to pop estimates from.
+   * @param sink the sink to write formatted messages to.
+   */
+  OutputStage(StageChannel<EstimateRecord, capacity> &input, SinkT &sink)
+      : _input(input), _sink(sink) {}
+
+  /**
+   * @brief formats and writes queued estimates.
+   * @param max_items the maximum number of estimates to write.
+   * @return the number of estimates written.
+   */
+  size_t process(size_t max_items) {
+    size_t processed = 0;
+    while (processed < max_items && this->_input.pop(this->_record)) {
+      STAGE_TIMING(uint32_t ticks = StageClock::now();)
+      size_t message_len = this->_formatter.format(
+          this->_record, this->_message, FormatterT::kMaxMessageLength);
+      STAGE_TIMING(recordStage(this->_profiler, STAGE_FORMAT, ticks);)
+      if (message_len > 0) {
+        this->_sink.write(this->_message, message_len);
+        STAGE_TIMING(recordStage(this->_profiler, STAGE_END_TO_END,
+                                 this->_record.acquired_ticks);)
+      }
+      processed++;
+    }
+    return processed;
+  }
+
+#if SENSOR_MANAGER_STAGE_TIMING
+  /**
+   * @brief sets the profiler recording the formatting and end-to-end time
+   * of every estimate.
+   * @param profiler the profiler, or NULL to stop recording.
+   */
+  void setProfiler(StageProfiler *profiler) { this->_profiler = profiler; }
+#endif
+
+private:
+  StageChannel<EstimateRecord, capacity> &_input;
+  SinkT &_sink;
+  FormatterT _formatter;
+  EstimateRecord _record;
+  uint8_t _message[FormatterT::kMaxMessageLength];
+  STAGE_TIMING(StageProfiler *_profiler = NULL;)
+}; // end OutputStage class
+} // namespace filters
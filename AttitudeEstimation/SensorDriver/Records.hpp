@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../EstimationAlgs/SensorSample.hpp"
+#include "../Quaternion/Quaternion.hpp"
+#include "StageTiming.hpp"
+#include <stdint.h>
+
+namespace filters {
+
+/**
+ * @brief a raw sample as captured by the acquisition stage, together with
+ * the sensor's internal attitude estimate used as ground truth.
+ */
+struct AcquiredSample {
+  uint32_t sequence;                           // acquisition sequence number
+  RawSensorSample raw;                         // raw sensor readings
+  structures::Quaternion<double> ground_truth; // sensor's own estimate
+#if SENSOR_MANAGER_STAGE_TIMING
+  uint32_t acquired_ticks; // stage clock tick when the read started
+#endif
+};
+
+/**
+ * @brief an attitude estimate as produced by the filter stage.
+ */
+struct EstimateRecord {
+  uint32_t sequence;                           // acquisition sequence number
+  uint64_t timestamp_us;                       // sample timestamp
+  structures::Quaternion<double> ground_truth; // sensor's own estimate
+  structures::Quaternion<double> estimate;     // filter estimate
+#if SENSOR_MANAGER_STAGE_TIMING
+  uint32_t acquired_ticks; // stage clock tick when the read started
+#endif
+};
+} // namespace filters
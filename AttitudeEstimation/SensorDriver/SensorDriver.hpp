@@ -1,184 +1,126 @@
 #pragma once
 
-#include "../EstimationAlgs/ComplementaryFilter/ComplementaryFilter.hpp"
-#include "../EstimationAlgs/MadgwickFilter/MadgwickFilter.hpp"
-#include "../EstimationAlgs/MahonyFilter/MahonyFilter.hpp"
 #include "../Matrix/Matrix.hpp"
 #include "../Quaternion/Quaternion.hpp"
-#include "AlgParams.hpp"
+#include "../Telemetry/Transport.hpp"
+#include "Calibration.hpp"
 #include "Nicla_System.h"
-#include "memory.h"
-
-// define a few macros to do unit conversion
-#define EARTH_G_MSS 9.81
-#define ACCEL_SENSITIVITY 4096 // LSB/g
-#define GYRO_SENSITIVITY 16.4  // LSB/deg/sec
-#define MAG_SENSITIVITY 16     // LSB/uT
-#define DEG_SEC_TO_RAD_SEC(x)                                                  \
-  (x * 0.017453292519943) // convert from deg/sec to rad/sec
-#define ACC_TO_MSS(x)                                                          \
-  (x * (EARTH_G_MSS / ACCEL_SENSITIVITY)) // convert from ADC reading to m/sec^s
-#define GYRO_TO_DEG_SEC(x)                                                     \
-  (x * (1.0 / GYRO_SENSITIVITY)) // convert from ADC reading to deg/sec
-#define MAG_TO_nT(x)                                                           \
-  (x * (1.0 / MAG_SENSITIVITY) * 1000) // convert from ADC reading to nT
+#include "SensorManager.hpp"
 
 namespace filters {
 
 /**
- * @brief enum to hold available filter types.
+ * @brief a clock extending the 32 bit Arduino micros() counter to 64 bits.
+ * Must be read at least once per counter wrap (about 71 minutes).
  */
-typedef enum { COMPLEMENTARY, EKF, MADGWICK, MAHONY } available_filters_t;
-
-/**
- * @brief a class to perform an update operation on our selected filter.
- */
-class FilterDriver {
+class ArduinoClock {
 public:
   /**
-   * @brief generic filter update function. NOTE: all reading matricies
-   * are expected to be packed in <X, Y, Z> axis order.
-   * @param acc_mat accelerometer reading matrix.
-   * @param gyro_mat gyroscope reading matrix.
-   * @param mag_mat magnetometer reading matrix.
-   * @param ellapsed_time elapsed time since last update.
-   * @return a Quaternion instance with the newly estimated attitude.
+   * @brief default constructor for ArduinoClock class.
    */
-  virtual structures::Quaternion<double>
-  update(structures::Matrix<double, 3, 1> acc_mat,
-         structures::Matrix<double, 3, 1> gyro_mat,
-         structures::Matrix<double, 3, 1> mag_mat, uint32_t ellapsed_time) = 0;
-}; // end FilterDriver class
-
-/**
- * @brief a class to perform an update operation on a complementary filter.
- */
-class ComplementaryDriver : public FilterDriver {
-public:
-  /**
-   * @brief ComplementaryDriver constructor
-   */
-  ComplementaryDriver() : _comp_filt(COMP_FILTER_ALPHA_GAIN) {}
+  ArduinoClock() {
+    this->_last_micros = 0U;
+    this->_now_us = 0U;
+  }
 
   /**
-   * @brief Complementary filter update function. NOTE: all reading matricies
-   * are expected to be packed in <X, Y, Z> axis order.
-   * @param acc_mat accelerometer reading matrix.
-   * @param gyro_mat gyroscope reading matrix.
-   * @param mag_mat magnetometer reading matrix.
-   * @param ellapsed_time elapsed time since last update.
-   * @return a Quaternion instance with the newly estimated attitude.
+   * @brief returns the time since the board started.
+   * @return the time since the board started in microseconds.
    */
-  structures::Quaternion<double>
-  update(structures::Matrix<double, 3, 1> acc_mat,
-         structures::Matrix<double, 3, 1> gyro_mat,
-         structures::Matrix<double, 3, 1> mag_mat,
-         uint32_t ellapsed_time) override {
-
-    // perform complementary filter update
-    structures::Quaternion<double> new_quat_est =
-        this->_comp_filt.update(acc_mat, gyro_mat, mag_mat, ellapsed_time);
-
-    return new_quat_est;
+  uint64_t nowUs() {
+    uint32_t now = micros();
+    this->_now_us += (uint32_t)(now - this->_last_micros);
+    this->_last_micros = now;
+    return this->_now_us;
   }
 
 private:
-  ComplementaryFilter _comp_filt;
-}; // end ComplementaryDriver class
+  uint32_t _last_micros;
+  uint64_t _now_us;
+}; // end ArduinoClock class
 
 /**
- * @brief a class to perform an update operation on a EKF filter.
+ * @brief a sample source reading the BHY2 sensor objects.
  */
-class EKFDriver : public FilterDriver {
+class Bhy2SensorSource {
 public:
   /**
-   * @brief EKF filter update function. NOTE: all reading matricies
-   * are expected to be packed in <X, Y, Z> axis order.
-   * @param acc_mat accelerometer reading matrix.
-   * @param gyro_mat gyroscope reading matrix.
-   * @param mag_mat magnetometer reading matrix.
-   * @param ellapsed_time elapsed time since last update.
-   * @return a Quaternion instance with the newly estimated attitude.
+   * @brief constructor for the Bhy2SensorSource class.
+   * @param accelerometer pointer to the accelerometer SensorXYZ instance.
+   * @param gyro pointer to the gyroscope SensorXYZ instance.
+   * @param magnetometer pointer to the accelerometer SensorXYZ instance.
+   * @param quaternion pointer to the internal quaternion estimation
+   * SensorQuaternion instance.
    */
-  structures::Quaternion<double>
-  update(structures::Matrix<double, 3, 1> acc_mat,
-         structures::Matrix<double, 3, 1> gyro_mat,
-         structures::Matrix<double, 3, 1> mag_mat,
-         uint32_t ellapsed_time) override {
-
-    // TODO: Implement me
-    structures::Quaternion<double> new_quat_est;
-    return new_quat_est;
+  Bhy2SensorSource(SensorXYZ *accelerometer, SensorXYZ *gyro,
+                   SensorXYZ *magnetometer, SensorQuaternion *quaternion) {
+    this->_accelerometer = accelerometer;
+    this->_gyro = gyro;
+    this->_magnetometer = magnetometer;
+    this->_ground_truth_quat = quaternion;
   }
-}; // end EKFDriver class
 
-/**
- * @brief a class to perform an update operation on a Madgwick filter.
- */
-class MadgwickDriver : public FilterDriver {
-public:
   /**
-   * @brief default constructor
+   * @brief polls the sensor hub and captures the latest readings.
+   * @param sample the sample to fill.
+   * @return true, the sensor objects always hold a reading.
    */
-  MadgwickDriver() : _madgwick_filter(BETA_GAIN) {}
-  /**
-   * @brief Madgwick filter update function. NOTE: all reading matricies
-   * are expected to be packed in <X, Y, Z> axis order.
-   * @param acc_mat accelerometer reading matrix.
-   * @param gyro_mat gyroscope reading matrix.
-   * @param mag_mat magnetometer reading matrix.
-   * @param ellapsed_time elapsed time since last update.
-   * @return a Quaternion instance with the newly estimated attitude.
-   */
-  structures::Quaternion<double>
-  update(structures::Matrix<double, 3, 1> acc_mat,
-         structures::Matrix<double, 3, 1> gyro_mat,
-         structures::Matrix<double, 3, 1> mag_mat,
-         uint32_t ellapsed_time) override {
-
-    structures::Quaternion<double> new_quat_est = this->_madgwick_filter.update(
-        acc_mat, gyro_mat, mag_mat, ellapsed_time);
-    return new_quat_est;
+  bool read(AcquiredSample &sample) {
+    // get new sensor readings
+    BHY2.update();
+
+    // pack raw sensor readings into the raw sample
+    sample.raw.acc[0] = this->_accelerometer->x();
+    sample.raw.acc[1] = this->_accelerometer->y();
+    sample.raw.acc[2] = this->_accelerometer->z();
+    sample.raw.gyro[0] = this->_gyro->x();
+    sample.raw.gyro[1] = this->_gyro->y();
+    sample.raw.gyro[2] = this->_gyro->z();
+    sample.raw.mag[0] = this->_magnetometer->x();
+    sample.raw.mag[1] = this->_magnetometer->y();
+    sample.raw.mag[2] = this->_magnetometer->z();
+    sample.raw.timestamp_us = this->_clock.nowUs();
+
+    sample.ground_truth = structures::Quaternion<double>(
+        this->_ground_truth_quat->x(), this->_ground_truth_quat->y(),
+        this->_ground_truth_quat->z(), this->_ground_truth_quat->w());
+    return true;
   }
 
 private:
-  MadgwickFilter _madgwick_filter;
-}; // end MadgwickDriver class
+  SensorXYZ *_accelerometer;
+  SensorXYZ *_gyro;
+  SensorXYZ *_magnetometer;
+  SensorQuaternion *_ground_truth_quat;
+  ArduinoClock _clock;
+}; // end Bhy2SensorSource class
 
 /**
- * @brief a class to perform an update operation on a Mahony filter.
+ * @brief the board hardware used by SensorManager. Kept in a base class so
+ * it is constructed before the BasicSensorManager that refers to it.
  */
-class MahonyDriver : public FilterDriver {
-public:
-  /**
-   * @brief default constructor
-   */
-  MahonyDriver() : _mahony_filter(KI, KP) {}
-  /**
-   * @brief Mahony filter update function. NOTE: all reading matricies
-   * are expected to be packed in <X, Y, Z> axis order.
-   * @param acc_mat accelerometer reading matrix.
-   * @param gyro_mat gyroscope reading matrix.
-   * @param mag_mat magnetometer reading matrix.
-   * @param ellapsed_time elapsed time since last update.
-   * @return a Quaternion instance with the newly estimated attitude.
-   */
-  structures::Quaternion<double>
-  update(structures::Matrix<double, 3, 1> acc_mat,
-         structures::Matrix<double, 3, 1> gyro_mat,
-         structures::Matrix<double, 3, 1> mag_mat,
-         uint32_t ellapsed_time) override {
+class Bhy2Hardware {
+protected:
+  Bhy2Hardware(SensorXYZ *accelerometer, SensorXYZ *gyro,
+               SensorXYZ *magnetometer, SensorQuaternion *quaternion)
+      : _bhy2_source(accelerometer, gyro, magnetometer, quaternion),
+        _serial_transport(Serial) {}
 
-    structures::Quaternion<double> new_quat_est =
-        this->_mahony_filter.update(acc_mat, gyro_mat, mag_mat, ellapsed_time);
-    return new_quat_est;
-  }
+  Bhy2SensorSource _bhy2_source;
+  telemetry::SerialTransport<decltype(Serial)> _serial_transport;
+}; // end Bhy2Hardware class
 
-private:
-  MahonyFilter _mahony_filter;
-}; // end MahonyDriver class
-
-class SensorManager {
+/**
+ * @brief a class to run the selected filter on data from the board's BHY2
+ * sensor hub, writing the estimates to the serial port.
+ * @tparam selected_filter the filter that this instance of SensorManager will
+ * use. The filter driver is resolved at compile time and held by value.
+ */
+template <available_filters_t selected_filter>
+class SensorManager
+    : private Bhy2Hardware,
+      public BasicSensorManager<selected_filter, Bhy2SensorSource,
+                                telemetry::SerialTransport<decltype(Serial)>> {
 public:
   /**
    * @brief constructor for the SensorManager class.
@@ -187,101 +129,27 @@ public:
    * @param magnetometer pointer to the accelerometer SensorXYZ instance.
    * @param quaternion pointer to the internal quaternion estimation
    * SensorQuaternion instance.
-   * @param selected_filter the filter that this instance of SensorManager will
-   * use.
+   * @param calibration the raw-to-SI calibration applied to every sample.
+   * @param emission the policy deciding which estimates are sent, such as
+   * EmissionPolicy::fixedRate(50.0) to decouple the output rate from the
+   * filter rate.
+   * @param overflow_policy what to do with new estimates when the output
+   * stage falls behind.
+   * @param transmit_policy what to do with new messages when the serial
+   * link falls behind.
    */
   SensorManager(SensorXYZ *accelerometer, SensorXYZ *gyro,
                 SensorXYZ *magnetometer, SensorQuaternion *quaternion,
-                available_filters_t selected_filter) {
-
-    // assign class members
-    this->_accelerometer = accelerometer;
-    this->_gyro = gyro;
-    this->_magnetometer = magnetometer;
-    this->_ground_truth_quat = quaternion;
-    this->_selected_filter = selected_filter;
-    this->_last_update = 0U;
-
-    // create filter object based on selected_filter input
-    switch (this->_selected_filter) {
-    case COMPLEMENTARY:
-      this->_filter_driver = std::make_unique<ComplementaryDriver>();
-      break;
-    case EKF:
-      this->_filter_driver = std::make_unique<EKFDriver>();
-      break;
-    case MADGWICK:
-      this->_filter_driver = std::make_unique<MadgwickDriver>();
-      break;
-    case MAHONY:
-      this->_filter_driver = std::make_unique<MahonyDriver>();
-      break;
-    }
-  }
-
-  /**
-   * @brief handles running the selected filter on new data.
-   */
-  void run() {
-
-    // initialize last update value with current time
-    this->_last_update = micros();
-    while (true) {
-      // get new sensor readings
-      BHY2.update();
-
-      // pack sensor readings into arrays
-      double accelerometer_readings[3][1] = {
-          {ACC_TO_MSS(this->_accelerometer->x())},
-          {ACC_TO_MSS(this->_accelerometer->y())},
-          {ACC_TO_MSS(this->_accelerometer->z())}};
-      double gyro_readings[3][1] = {
-          {DEG_SEC_TO_RAD_SEC(GYRO_TO_DEG_SEC(this->_gyro->x()))},
-          {DEG_SEC_TO_RAD_SEC(GYRO_TO_DEG_SEC(this->_gyro->y()))},
-          {DEG_SEC_TO_RAD_SEC(GYRO_TO_DEG_SEC(this->_gyro->z()))}};
-      double magnetometer_readings[3][1] = {
-          {MAG_TO_nT(this->_magnetometer->x())},
-          {MAG_TO_nT(this->_magnetometer->y())},
-          {MAG_TO_nT(this->_magnetometer->z())}};
-
-      // construct matrix objects
-      structures::Matrix<double, 3, 1> acc_mat(accelerometer_readings);
-      structures::Matrix<double, 3, 1> gyro_mat(gyro_readings);
-      structures::Matrix<double, 3, 1> mag_mat(magnetometer_readings);
-
-      // get elapsed time since last update
-      uint64_t ellapsed_time = micros() - this->_last_update;
-
-      // perform update
-      structures::Quaternion<double> estimated_quat =
-          this->_filter_driver->update(acc_mat, gyro_mat, mag_mat,
-                                       ellapsed_time);
-
-      // update ellapsed_time
-      this->_last_update = micros();
-
-      // format json message and print to serial monitor
-      char final_json_char_arr[512];
-      sprintf(final_json_char_arr, this->_JSON_format_patt,
-              this->_ground_truth_quat->w(), this->_ground_truth_quat->x(),
-              this->_ground_truth_quat->y(), this->_ground_truth_quat->z(),
-              estimated_quat.getW(), estimated_quat.getX(),
-              estimated_quat.getY(), estimated_quat.getZ());
-
-      Serial.print(final_json_char_arr);
-    }
-  }
-
-private:
-  std::unique_ptr<FilterDriver> _filter_driver;
-  SensorXYZ *_accelerometer;
-  SensorXYZ *_gyro;
-  SensorXYZ *_magnetometer;
-  SensorQuaternion *_ground_truth_quat;
-  available_filters_t _selected_filter;
-  uint64_t _last_update;
-  char _JSON_format_patt[200] =
-      "{\"ground_truth_quat\": {\"w\": %f, \"x\": %f, \"y\": %f, \"z\": "
-      "%f},\"estimated_quat\": {\"w\": %f,\"x\": %f,\"y\": %f,\"z\": %f}}\n";
-};
+                const SensorCalibration<double> &calibration =
+                    SensorCalibration<double>::nominal(),
+                const EmissionPolicy &emission = EmissionPolicy::everyUpdate(),
+                overflow_policy_t overflow_policy = DROP_NEWEST,
+                telemetry::transmit_policy_t transmit_policy =
+                    telemetry::TRANSMIT_DROP_NEWEST)
+      : Bhy2Hardware(accelerometer, gyro, magnetometer, quaternion),
+        BasicSensorManager<selected_filter, Bhy2SensorSource,
+                           telemetry::SerialTransport<decltype(Serial)>>(
+            this->_bhy2_source, this->_serial_transport, calibration, emission,
+            overflow_policy, transmit_policy) {}
+}; // end SensorManager class
 } // namespace filters
@@ -0,0 +1,316 @@
+#pragma once
+
+#include "../Telemetry/TransmitQueue.hpp"
+#include "Calibration.hpp"
+#include "Emission.hpp"
+#include "EstimateFormat.hpp"
+#include "FilterDriver.hpp"
+#include "Pipeline.hpp"
+#include "StageTiming.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+// on mbed based boards the output stage runs on its own RTOS thread, so a
+// slow serial write never delays the next sensor read
+#ifndef SENSOR_MANAGER_OUTPUT_THREAD
+#if defined(ARDUINO_ARCH_MBED)
+#define SENSOR_MANAGER_OUTPUT_THREAD 1
+#else
+#define SENSOR_MANAGER_OUTPUT_THREAD 0
+#endif
+#endif
+
+#if SENSOR_MANAGER_OUTPUT_THREAD
+#include "mbed.h"
+#endif
+
+// define SENSOR_MANAGER_BINARY_TELEMETRY to emit COBS framed binary estimate
+// frames instead of JSON lines
+#ifdef SENSOR_MANAGER_BINARY_TELEMETRY
+#include "../Telemetry/TelemetryProtocol.hpp"
+#endif
+
+namespace filters {
+
+#ifdef SENSOR_MANAGER_BINARY_TELEMETRY
+typedef telemetry::BinaryEstimateFormatter SensorManagerFormatter;
+#else
+typedef JsonEstimateFormatter SensorManagerFormatter;
+#endif
+
+/**
+ * @brief a class to run the selected filter on samples from any sensor
+ * source. Acquisition, filtering and output run as separate stages
+ * connected by bounded lock-free channels. Formatted messages are queued in
+ * a ring of transmit buffers that is drained to the transport without ever
+ * blocking. With SENSOR_MANAGER_STAGE_TIMING every stage is timed into
+ * latency histograms that can be reported over the same transport.
+ * @tparam selected_filter the filter that this instance will use. The filter
+ * driver is resolved at compile time and held by value.
+ * @tparam SourceT the sample source. Must provide
+ * bool read(AcquiredSample &sample), returning false if no sample was ready.
+ * @tparam TransportT the output transport. Must provide
+ * size_t write(const uint8_t *, size_t), returning the number of bytes
+ * accepted without blocking.
+ * @tparam FormatterT the message formatter.
+ */
+template <available_filters_t selected_filter, typename SourceT,
+          typename TransportT, typename FormatterT = SensorManagerFormatter>
+class BasicSensorManager {
+public:
+  static const size_t kSampleQueueDepth = 8;
+  static const size_t kEstimateQueueDepth = 16;
+  static const size_t kTransmitBufferCount = 4;
+
+  /**
+   * @brief constructor for the BasicSensorManager class. The source and
+   * transport are not owned.
+   * @param source the sample source.
+   * @param transport the transport to write messages to.
+   * @param calibration the raw-to-SI calibration applied to every sample.
+   * @param emission the policy deciding which estimates are sent, such as
+   * EmissionPolicy::fixedRate(50.0) to decouple the output rate from the
+   * filter rate.
+   * @param overflow_policy what to do with new estimates when the output
+   * stage falls behind.
+   * @param transmit_policy what to do with new messages when the transport
+   * falls behind.
+   */
+  BasicSensorManager(SourceT &source, TransportT &transport,
+                     const SensorCalibration<double> &calibration =
+                         SensorCalibration<double>::nominal(),
+                     const EmissionPolicy &emission =
+                         EmissionPolicy::everyUpdate(),
+                     overflow_policy_t overflow_policy = DROP_NEWEST,
+                     telemetry::transmit_policy_t transmit_policy =
+                         telemetry::TRANSMIT_DROP_NEWEST)
+      : _transport(transport), _sample_channel(DROP_NEWEST),
+        _estimate_channel(overflow_policy),
+        _acquisition(source, _sample_channel),
+        _filter_stage(_sample_channel, _estimate_channel, calibration,
+                      emission),
+        _transmit_queue(transmit_policy),
+        _output_stage(_estimate_channel, _transmit_queue) {
+#if SENSOR_MANAGER_STAGE_TIMING
+    this->_acquisition.setProfiler(&this->_profiler);
+    this->_filter_stage.setProfiler(&this->_profiler);
+    this->_output_stage.setProfiler(&this->_profiler);
+    this->_report_stage = STAGE_COUNT;
+#endif
+  }
+
+  /**
+   * @brief handles running the selected filter on new data. Never returns.
+   */
+  void run() {
+#if SENSOR_MANAGER_OUTPUT_THREAD
+    this->_output_thread.start(
+        mbed::callback(this, &BasicSensorManager::outputLoop));
+#endif
+
+    while (true) {
+      // acquire and filter on this thread
+      this->_acquisition.poll();
+      this->_filter_stage.process(kSampleQueueDepth);
+
+#if !SENSOR_MANAGER_OUTPUT_THREAD
+      // without an output thread, interleave output with acquisition. None
+      // of these calls wait on the transport
+      this->transmit();
+#endif
+    }
+  }
+
+  /**
+   * @brief runs every stage once on the calling thread.
+   * @return true if a new sample was acquired, false otherwise.
+   */
+  bool step() {
+    bool acquired = this->_acquisition.poll();
+    this->_filter_stage.process(kSampleQueueDepth);
+    this->transmit();
+    return acquired;
+  }
+
+  /**
+   * @brief runs every stage on the calling thread until the source has no
+   * more samples, then flushes the output as far as the transport allows.
+   * Used to replay recorded or synthetic data as fast as possible.
+   * @return the number of samples acquired.
+   */
+  uint64_t runUntilExhausted() {
+    uint64_t acquired = 0;
+    while (this->step()) {
+      acquired++;
+    }
+
+    // drain the pipeline, giving up if the transport stops accepting bytes
+    while (this->_sample_channel.size() > 0 ||
+           this->_estimate_channel.size() > 0 ||
+           this->_transmit_queue.size() > 0) {
+      this->_filter_stage.process(kSampleQueueDepth);
+      if (this->transmit() == 0 && this->_estimate_channel.size() == 0 &&
+          this->_sample_channel.size() == 0) {
+        break;
+      }
+    }
+    return acquired;
+  }
+
+  /**
+   * @brief returns the number of estimates dropped because the output stage
+   * fell behind.
+   * @return the number of dropped estimates.
+   */
+  uint32_t getDroppedEstimates() const {
+    return this->_estimate_channel.getDroppedCount();
+  }
+
+  /**
+   * @brief returns the number of estimates withheld by the emission policy.
+   * @return the number of suppressed estimates.
+   */
+  uint32_t getSuppressedEstimates() const {
+    return this->_filter_stage.getEmissionPolicy().getSuppressedCount();
+  }
+
+  /**
+   * @brief returns the number of messages dropped because the transport
+   * fell behind.
+   * @return the number of dropped messages.
+   */
+  uint32_t getDroppedFrames() const {
+    return this->_transmit_queue.getDroppedCount();
+  }
+
+  /**
+   * @brief returns the largest number of transmit buffers ever waiting on
+   * the transport at once.
+   * @return the transmit buffer high-water mark.
+   */
+  uint32_t getTransmitHighWaterMark() const {
+    return this->_transmit_queue.getHighWaterMark();
+  }
+
+  /**
+   * @brief returns the number of bytes written to the transport.
+   * @return the number of bytes written to the transport.
+   */
+  uint64_t getBytesSent() const { return this->_transmit_queue.getBytesSent(); }
+
+#if SENSOR_MANAGER_STAGE_TIMING
+  /**
+   * @brief asks the output stage to send the stage latency report, one
+   * JSON line per stage, between the following estimate messages. Safe to
+   * call from any thread.
+   * @param reset_after whether to clear the histograms once reported.
+   */
+  void requestTimingReport(bool reset_after = false) {
+    this->_report_reset.store(reset_after, std::memory_order_relaxed);
+    this->_report_requested.store(true, std::memory_order_release);
+  }
+
+  /**
+   * @brief returns the stage latency histograms. While the pipeline runs on
+   * more than one thread the histograms are only approximately consistent.
+   * @return the stage profiler.
+   */
+  const StageProfiler &getStageProfiler() const { return this->_profiler; }
+#endif
+
+private:
+  /**
+   * @brief formats queued estimates into transmit buffers, and hands as many
+   * buffered bytes to the transport as it can take without blocking.
+   * @return the number of bytes written to the transport.
+   */
+  size_t transmit() {
+    this->_output_stage.process(kEstimateQueueDepth);
+    this->_transmit_queue.flushPending();
+    STAGE_TIMING(this->queueTimingReport();)
+    STAGE_TIMING(uint32_t ticks = StageClock::now();)
+    size_t sent = this->_transmit_queue.drain(this->_transport);
+    STAGE_TIMING(if (sent > 0) {
+      this->_profiler.record(STAGE_TRANSMIT, ticks);
+    })
+    return sent;
+  }
+
+#if SENSOR_MANAGER_STAGE_TIMING
+  /**
+   * @brief queues the next line of a requested timing report. Lines are
+   * only queued while a transmit buffer is free, so a report never pushes
+   * out estimate messages.
+   */
+  void queueTimingReport() {
+    if (this->_report_requested.exchange(false, std::memory_order_acquire)) {
+      this->_report_stage = 0;
+    }
+    if (this->_report_stage >= STAGE_COUNT ||
+        this->_transmit_queue.size() >= kTransmitBufferCount) {
+      return;
+    }
+
+    uint8_t line[StageProfiler::kMaxReportLineLength];
+    size_t line_len = this->_profiler.formatReportLine(
+        (pipeline_stage_t)this->_report_stage, line, sizeof(line));
+    size_t message_len = this->_formatter.formatText(
+        line, line_len, this->_report_message, kTransmitSlotSize);
+    if (message_len > 0) {
+      this->_transmit_queue.write(this->_report_message, message_len);
+    }
+    if (++this->_report_stage == STAGE_COUNT &&
+        this->_report_reset.load(std::memory_order_relaxed)) {
+      this->_profiler.reset();
+    }
+  }
+#endif
+
+#if SENSOR_MANAGER_OUTPUT_THREAD
+  /**
+   * @brief the output thread body, draining estimates to the transport.
+   */
+  void outputLoop() {
+    while (true) {
+      if (this->transmit() == 0) {
+        rtos::ThisThread::yield();
+      }
+    }
+  }
+
+  rtos::Thread _output_thread;
+#endif
+
+#if SENSOR_MANAGER_STAGE_TIMING
+  // transmit buffers also hold report lines
+  static const size_t kTransmitSlotSize =
+      FormatterT::kMaxMessageLength > StageProfiler::kMaxReportLineLength + 1
+          ? FormatterT::kMaxMessageLength
+          : StageProfiler::kMaxReportLineLength + 1;
+#else
+  static const size_t kTransmitSlotSize = FormatterT::kMaxMessageLength;
+#endif
+
+  typedef telemetry::TransmitQueue<kTransmitBufferCount, kTransmitSlotSize>
+      transmit_queue_t;
+
+  TransportT &_transport;
+  StageChannel<AcquiredSample, kSampleQueueDepth> _sample_channel;
+  StageChannel<EstimateRecord, kEstimateQueueDepth> _estimate_channel;
+  AcquisitionStage<SourceT, kSampleQueueDepth> _acquisition;
+  FilterStage<typename FilterDriverSelector<selected_filter>::type,
+              kSampleQueueDepth, kEstimateQueueDepth>
+      _filter_stage;
+  transmit_queue_t _transmit_queue;
+  OutputStage<FormatterT, transmit_queue_t, kEstimateQueueDepth>
+      _output_stage;
+#if SENSOR_MANAGER_STAGE_TIMING
+  StageProfiler _profiler;
+  FormatterT _formatter;
+  std::atomic<bool> _report_requested{false};
+  std::atomic<bool> _report_reset{false};
+  size_t _report_stage;
+  uint8_t _report_message[kTransmitSlotSize];
+#endif
+}; // end BasicSensorManager class
+} // namespace filters
@@ -0,0 +1,310 @@
+#pragma once
+
+#include "../Quaternion/Quaternion.hpp"
+#include "Calibration.hpp"
+#include "Records.hpp"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace filters {
+
+/**
+ * Sensor sources provide bool read(AcquiredSample &sample), filling the raw
+ * readings, timestamp and ground truth of the next sample and returning
+ * false if no sample is ready. The sequence number is assigned by the
+ * acquisition stage. The on-device BHY2 source lives in SensorDriver.hpp
+ * with the rest of the board specific code.
+ */
+
+/**
+ * @brief the column header of a recorded sample file.
+ */
+static constexpr const char *kRecordedSampleHeader =
+    "timestamp_us,acc_x,acc_y,acc_z,gyro_x,gyro_y,gyro_z,mag_x,mag_y,mag_z,"
+    "gt_w,gt_x,gt_y,gt_z\n";
+
+/**
+ * @brief writes one sample as a line of a recorded sample file.
+ * @param file the file to write to.
+ * @param sample the sample to write.
+ * @return true if the line was written, false otherwise.
+ */
+inline bool writeRecordedSample(FILE *file, const AcquiredSample &sample) {
+  const RawSensorSample &raw = sample.raw;
+  return fprintf(file,
+                 "%llu,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.9f,%.9f,%.9f,%.9f\n",
+                 (unsigned long long)raw.timestamp_us, raw.acc[0], raw.acc[1],
+                 raw.acc[2], raw.gyro[0], raw.gyro[1], raw.gyro[2],
+                 raw.mag[0], raw.mag[1], raw.mag[2],
+                 sample.ground_truth.getW(), sample.ground_truth.getX(),
+                 sample.ground_truth.getY(), sample.ground_truth.getZ()) > 0;
+}
+
+/**
+ * @brief rounds a reading to the nearest LSB, saturating at the int16 range.
+ * @param lsb the reading in LSB.
+ * @return the quantized reading.
+ */
+inline int16_t quantizeReading(double lsb) {
+  if (lsb > 32767.0) {
+    return 32767;
+  }
+  if (lsb < -32768.0) {
+    return -32768;
+  }
+  return (int16_t)lround(lsb);
+}
+
+/**
+ * @brief converts SI readings to raw ADC readings with the nominal sensor
+ * sensitivities, the inverse of SensorCalibration<T>::nominal().
+ * @param acc the accelerometer reading in m/s^2.
+ * @param gyro the gyroscope reading in rad/s.
+ * @param mag the magnetometer reading in nT.
+ * @param raw the raw sample to fill. The timestamp is left untouched.
+ */
+inline void quantizeNominal(const double acc[3], const double gyro[3],
+                            const double mag[3], RawSensorSample &raw) {
+  for (int axis = 0; axis < 3; axis++) {
+    raw.acc[axis] =
+        quantizeReading(acc[axis] * ACCEL_SENSITIVITY / EARTH_G_MSS);
+    raw.gyro[axis] =
+        quantizeReading(gyro[axis] * GYRO_SENSITIVITY / DEG_TO_RAD_SCALE);
+    raw.mag[axis] =
+        quantizeReading(mag[axis] * MAG_SENSITIVITY / UT_TO_NT_SCALE);
+  }
+}
+
+/**
+ * @brief parses one line of a recorded sample file.
+ * @param line the line, in the kRecordedSampleHeader column order.
+ * @param sample the sample to fill. The sequence number is left untouched.
+ * @return false if the line does not parse, such as the header, true
+ * otherwise.
+ */
+inline bool parseRecordedSample(const char *line, AcquiredSample &sample) {
+  unsigned long long timestamp_us;
+  int raw[9];
+  double quat[4];
+  int fields = sscanf(line, "%llu,%d,%d,%d,%d,%d,%d,%d,%d,%d,%lf,%lf,%lf,%lf",
+                      &timestamp_us, &raw[0], &raw[1], &raw[2], &raw[3],
+                      &raw[4], &raw[5], &raw[6], &raw[7], &raw[8], &quat[0],
+                      &quat[1], &quat[2], &quat[3]);
+  if (fields != 14) {
+    return false;
+  }
+
+  for (int axis = 0; axis < 3; axis++) {
+    sample.raw.acc[axis] = (int16_t)raw[axis];
+    sample.raw.gyro[axis] = (int16_t)raw[3 + axis];
+    sample.raw.mag[axis] = (int16_t)raw[6 + axis];
+  }
+  sample.raw.timestamp_us = timestamp_us;
+  sample.ground_truth =
+      structures::Quaternion<double>(quat[1], quat[2], quat[3], quat[0]);
+  return true;
+}
+
+/**
+ * @brief a sample source replaying a recorded sample file, one CSV line per
+ * sample in the kRecordedSampleHeader column order. Lines that do not parse,
+ * such as the header, are skipped.
+ */
+class RecordedSensorSource {
+public:
+  /**
+   * @brief constructor for RecordedSensorSource class. The file is not
+   * owned.
+   * @param file the file to read samples from.
+   */
+  RecordedSensorSource(FILE *file) {
+    this->_file = file;
+    this->_skipped_lines = 0;
+  }
+
+  /**
+   * @brief reads the next sample from the file.
+   * @param sample the sample to fill.
+   * @return false at the end of the file, true otherwise.
+   */
+  bool read(AcquiredSample &sample) {
+    char line[256];
+    while (this->_file != NULL && fgets(line, sizeof(line), this->_file)) {
+      if (parseRecordedSample(line, sample)) {
+        return true;
+      }
+      this->_skipped_lines++;
+    }
+    return false;
+  }
+
+  /**
+   * @brief returns the number of lines skipped because they did not parse.
+   * @return the number of skipped lines.
+   */
+  uint32_t getSkippedLines() const { return this->_skipped_lines; }
+
+private:
+  FILE *_file;
+  uint32_t _skipped_lines;
+}; // end RecordedSensorSource class
+
+/**
+ * @brief a sample source simulating a noiseless device spinning at a
+ * constant body rate. Readings are quantized with the nominal sensor
+ * sensitivities, so SensorCalibration::nominal() recovers them, and the
+ * exact attitude is reported as ground truth.
+ */
+class SyntheticSensorSource {
+public:
+  /**
+   * @brief constructor for SyntheticSensorSource class.
+   * @param num_samples the number of samples to produce.
+   * @param sample_rate_hz the sample rate in Hz.
+   * @param body_rate the <X, Y, Z> body angular rate in rad/s.
+   */
+  SyntheticSensorSource(uint64_t num_samples, double sample_rate_hz,
+                        const double body_rate[3]) {
+    this->_remaining = num_samples;
+    this->_period_us = 1e6 / sample_rate_hz;
+    this->_step = 0;
+    for (int axis = 0; axis < 3; axis++) {
+      this->_body_rate[axis] = body_rate[axis];
+    }
+
+    // rotation over one sample period, applied in the body frame
+    double rate = sqrt(body_rate[0] * body_rate[0] +
+                       body_rate[1] * body_rate[1] +
+                       body_rate[2] * body_rate[2]);
+    double half_angle = 0.5 * rate / sample_rate_hz;
+    double scale = rate > 0 ? sin(half_angle) / rate : 0.0;
+    this->_delta = structures::Quaternion<double>(
+        body_rate[0] * scale, body_rate[1] * scale, body_rate[2] * scale,
+        cos(half_angle));
+  }
+
+  /**
+   * @brief produces the next sample.
+   * @param sample the sample to fill.
+   * @return false once all samples were produced, true otherwise.
+   */
+  bool read(AcquiredSample &sample) {
+    if (this->_remaining == 0) {
+      return false;
+    }
+
+    // gravity reaction and the earth field, seen from the body frame
+    const double gravity[3] = {0.0, 0.0, EARTH_G_MSS};
+    const double field[3] = {20000.0, 0.0, -45000.0}; // nT
+    double acc[3];
+    double mag[3];
+    this->toBody(gravity, acc);
+    this->toBody(field, mag);
+
+    quantizeNominal(acc, this->_body_rate, mag, sample.raw);
+    sample.raw.timestamp_us = (uint64_t)(this->_step * this->_period_us);
+    sample.ground_truth = this->_attitude;
+
+    this->_attitude = (this->_attitude * this->_delta).norm();
+    this->_step++;
+    this->_remaining--;
+    return true;
+  }
+
+private:
+  /**
+   * @brief rotates a world frame vector into the body frame.
+   * @param world the world frame vector.
+   * @param body the body frame vector.
+   */
+  void toBody(const double world[3], double body[3]) const {
+    structures::Quaternion<double> rotated =
+        this->_attitude.conj() *
+        structures::Quaternion<double>(world[0], world[1], world[2], 0.0) *
+        this->_attitude;
+    body[0] = rotated.getX();
+    body[1] = rotated.getY();
+    body[2] = rotated.getZ();
+  }
+
+  uint64_t _remaining;
+  double _period_us;
+  uint64_t _step;
+  double _body_rate[3];
+  structures::Quaternion<double> _delta;
+  structures::Quaternion<double> _attitude;
+}; // end SyntheticSensorSource class
+
+/**
+ * @brief a source adapter releasing samples no earlier than their
+ * timestamps, measured from the first sample, to replay a recording in real
+ * time. Sources read without this adapter run as fast as they can.
+ * @tparam SourceT the wrapped sample source.
+ * @tparam ClockT the clock to pace against.
+ */
+template <typename SourceT, typename ClockT> class PacedSensorSource {
+public:
+  /**
+   * @brief constructor for PacedSensorSource class.
+   * @param source the source to pace.
+   * @param clock the clock to pace against.
+   */
+  PacedSensorSource(SourceT &source, ClockT &clock)
+      : _source(source), _clock(clock), _next() {
+    this->_has_sample = false;
+    this->_started = false;
+    this->_exhausted = false;
+    this->_first_timestamp_us = 0U;
+    this->_start_us = 0U;
+  }
+
+  /**
+   * @brief reads the next sample if its time has come.
+   * @param sample the sample to fill.
+   * @return true if a sample was released, false otherwise.
+   */
+  bool read(AcquiredSample &sample) {
+    if (!this->_has_sample) {
+      if (this->_exhausted || !this->_source.read(this->_next)) {
+        this->_exhausted = true;
+        return false;
+      }
+      this->_has_sample = true;
+    }
+
+    if (!this->_started) {
+      this->_first_timestamp_us = this->_next.raw.timestamp_us;
+      this->_start_us = this->_clock.nowUs();
+      this->_started = true;
+    }
+
+    uint64_t due_us =
+        this->_start_us + (this->_next.raw.timestamp_us -
+                           this->_first_timestamp_us);
+    if (this->_clock.nowUs() < due_us) {
+      return false;
+    }
+
+    sample = this->_next;
+    this->_has_sample = false;
+    return true;
+  }
+
+  /**
+   * @brief checks if the wrapped source has run out of samples.
+   * @return true if no more samples will be released, false otherwise.
+   */
+  bool exhausted() const { return this->_exhausted && !this->_has_sample; }
+
+private:
+  SourceT &_source;
+  ClockT &_clock;
+  AcquiredSample _next;
+  bool _has_sample;
+  bool _started;
+  bool _exhausted;
+  uint64_t _first_timestamp_us;
+  uint64_t _start_us;
+}; // end PacedSensorSource class
+} // namespace filters
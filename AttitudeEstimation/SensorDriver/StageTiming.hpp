@@ -0,0 +1,340 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// define SENSOR_MANAGER_STAGE_TIMING to 1 to time every pipeline stage. When
+// it is 0 (the default) the timing code, the profiler and the timestamps
+// carried by the pipeline records are compiled out entirely
+#ifndef SENSOR_MANAGER_STAGE_TIMING
+#define SENSOR_MANAGER_STAGE_TIMING 0
+#endif
+
+#if SENSOR_MANAGER_STAGE_TIMING
+// wraps statements that only exist in timing builds
+#define STAGE_TIMING(...) __VA_ARGS__
+#else
+#define STAGE_TIMING(...)
+#endif
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+namespace filters {
+
+/**
+ * @brief the tick source of the stage timers. Ticks are 32 bit and wrap;
+ * only differences between ticks less than one wrap apart are meaningful.
+ */
+class StageClock {
+public:
+#if defined(ARDUINO)
+  /**
+   * @brief the tick unit, as printed in timing reports.
+   */
+  static constexpr const char *kUnit = "us";
+
+  /**
+   * @brief returns the current tick.
+   * @return the current time in microseconds.
+   */
+  static uint32_t now() { return micros(); }
+#else
+  static constexpr const char *kUnit = "ns";
+
+  /**
+   * @brief returns the current tick.
+   * @return the current time in nanoseconds.
+   */
+  static uint32_t now() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+#endif
+}; // end StageClock class
+
+/**
+ * @brief a fixed-memory latency histogram in the style of HdrHistogram.
+ * Values below 2^precision_bits are counted exactly; above that every
+ * power of two range is split into 2^(precision_bits - 1) equal buckets,
+ * so any recorded value is known to within 2^(1 - precision_bits) of its
+ * magnitude. Recording is a few shifts and an increment, and never
+ * allocates.
+ * @tparam precision_bits the number of significant bits kept per value.
+ */
+template <unsigned precision_bits> class LatencyHistogram {
+  static_assert(precision_bits >= 2 && precision_bits < 16,
+                "LatencyHistogram precision_bits must be in [2, 16)");
+
+public:
+  static const uint32_t kLinearCount = 1U << precision_bits;
+  static const uint32_t kSubBucketCount = kLinearCount / 2;
+  static const size_t kBucketCount =
+      kLinearCount + (32 - precision_bits) * kSubBucketCount;
+
+  /**
+   * @brief default constructor for LatencyHistogram class.
+   */
+  LatencyHistogram() { this->reset(); }
+
+  /**
+   * @brief removes every recorded value.
+   */
+  void reset() {
+    memset(this->_counts, 0, sizeof(this->_counts));
+    this->_count = 0;
+    this->_sum = 0;
+    this->_min = UINT32_MAX;
+    this->_max = 0;
+  }
+
+  /**
+   * @brief records one value.
+   * @param value the value to record.
+   */
+  void record(uint32_t value) {
+    this->_counts[bucketIndex(value)]++;
+    this->_count++;
+    this->_sum += value;
+    if (value < this->_min) {
+      this->_min = value;
+    }
+    if (value > this->_max) {
+      this->_max = value;
+    }
+  }
+
+  /**
+   * @brief returns the number of recorded values.
+   * @return the value count.
+   */
+  uint32_t count() const { return this->_count; }
+
+  /**
+   * @brief returns the smallest recorded value.
+   * @return the smallest value, or zero if there are none.
+   */
+  uint32_t min() const { return this->_count > 0 ? this->_min : 0; }
+
+  /**
+   * @brief returns the largest recorded value.
+   * @return the largest value, or zero if there are none.
+   */
+  uint32_t max() const { return this->_max; }
+
+  /**
+   * @brief returns the mean of the recorded values.
+   * @return the exact mean, or zero if there are none.
+   */
+  double mean() const {
+    return this->_count > 0 ? (double)this->_sum / this->_count : 0.0;
+  }
+
+  /**
+   * @brief returns a percentile of the recorded values, as the largest
+   * value that falls in the same bucket, so it never understates a
+   * latency.
+   * @param percent the percentile, from 0 to 100.
+   * @return the percentile, or zero if there are no values.
+   */
+  uint32_t percentile(double percent) const {
+    if (this->_count == 0) {
+      return 0;
+    }
+
+    // the rank of the requested value, counting from one
+    uint64_t rank = (uint64_t)(percent / 100.0 * this->_count + 0.5);
+    if (rank < 1) {
+      rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t index = 0; index < kBucketCount; index++) {
+      seen += this->_counts[index];
+      if (seen >= rank) {
+        uint32_t highest = bucketHighest(index);
+        return highest < this->_max ? highest : this->_max;
+      }
+    }
+    return this->_max;
+  }
+
+  /**
+   * @brief returns the bucket a value is counted in.
+   * @param value the value.
+   * @return the bucket index.
+   */
+  static size_t bucketIndex(uint32_t value) {
+    if (value < kLinearCount) {
+      return value;
+    }
+    unsigned shift = msb(value) - precision_bits + 1;
+    return kLinearCount + (shift - 1) * kSubBucketCount +
+           ((value >> shift) - kSubBucketCount);
+  }
+
+  /**
+   * @brief returns the largest value counted in a bucket.
+   * @param index the bucket index.
+   * @return the largest value of the bucket.
+   */
+  static uint32_t bucketHighest(size_t index) {
+    if (index < kLinearCount) {
+      return (uint32_t)index;
+    }
+    unsigned shift = (unsigned)((index - kLinearCount) / kSubBucketCount) + 1;
+    uint64_t sub = (index - kLinearCount) % kSubBucketCount + kSubBucketCount;
+    return (uint32_t)(((sub + 1) << shift) - 1);
+  }
+
+private:
+  /**
+   * @brief returns the position of the highest set bit.
+   * @param value a non-zero value.
+   * @return the bit position, from 0 to 31.
+   */
+  static unsigned msb(uint32_t value) {
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(value);
+#else
+    unsigned position = 0;
+    while (value >>= 1) {
+      position++;
+    }
+    return position;
+#endif
+  }
+
+  uint32_t _counts[kBucketCount];
+  uint32_t _count;
+  uint64_t _sum;
+  uint32_t _min;
+  uint32_t _max;
+}; // end LatencyHistogram class
+
+/**
+ * @brief the timed pipeline stages.
+ */
+typedef enum {
+  STAGE_READ,       // sensor source read
+  STAGE_CALIBRATE,  // raw-to-SI unit conversion
+  STAGE_FILTER,     // filter update
+  STAGE_FORMAT,     // message formatting
+  STAGE_TRANSMIT,   // transmit buffer drain to the transport
+  STAGE_END_TO_END, // from the start of the read to the queued message
+  STAGE_COUNT
+} pipeline_stage_t;
+
+/**
+ * @brief one latency histogram per pipeline stage. Each histogram must
+ * only be recorded from one thread; the acquisition thread records the
+ * read, calibrate and filter stages, and the output thread the rest.
+ */
+class StageProfiler {
+public:
+  /**
+   * @brief the longest report line, in bytes.
+   */
+  static const size_t kMaxReportLineLength = 160;
+
+  /**
+   * @brief 8 buckets per power of two, for 12% resolution in under 1 KB
+   * per stage.
+   */
+  typedef LatencyHistogram<4> histogram_t;
+
+  /**
+   * @brief records the time since a start tick.
+   * @param stage the stage that was timed.
+   * @param start_ticks the tick taken when the stage started.
+   * @return the current tick, to start timing the next stage.
+   */
+  uint32_t record(pipeline_stage_t stage, uint32_t start_ticks) {
+    uint32_t now = StageClock::now();
+    this->_histograms[stage].record(now - start_ticks);
+    return now;
+  }
+
+  /**
+   * @brief returns the histogram of a stage.
+   * @param stage the stage.
+   * @return the histogram.
+   */
+  const histogram_t &getHistogram(pipeline_stage_t stage) const {
+    return this->_histograms[stage];
+  }
+
+  /**
+   * @brief removes every recorded latency.
+   */
+  void reset() {
+    for (size_t stage = 0; stage < STAGE_COUNT; stage++) {
+      this->_histograms[stage].reset();
+    }
+  }
+
+  /**
+   * @brief returns the name of a stage, as printed in reports.
+   * @param stage the stage.
+   * @return the stage name.
+   */
+  static const char *stageName(pipeline_stage_t stage) {
+    static const char *const names[STAGE_COUNT] = {
+        "read", "calibrate", "filter", "format", "transmit", "end_to_end"};
+    return names[stage];
+  }
+
+  /**
+   * @brief formats the report line of one stage as a JSON object, such as
+   * {"stage": "filter", "unit": "ns", "count": 1000, "mean": 210,
+   * "p50": 207, "p90": 223, "p99": 255, "max": 1220}.
+   * @param stage the stage.
+   * @param buffer the buffer to write the line into.
+   * @param buffer_len the size of buffer in bytes.
+   * @return the line length in bytes, or zero if it did not fit.
+   */
+  size_t formatReportLine(pipeline_stage_t stage, uint8_t *buffer,
+                          size_t buffer_len) const {
+    const histogram_t &histogram = this->_histograms[stage];
+    int line_len = snprintf(
+        (char *)buffer, buffer_len,
+        "{\"stage\": \"%s\", \"unit\": \"%s\", \"count\": %lu, \"mean\": "
+        "%lu, \"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu}\n",
+        stageName(stage), StageClock::kUnit,
+        (unsigned long)histogram.count(),
+        (unsigned long)(histogram.mean() + 0.5),
+        (unsigned long)histogram.percentile(50),
+        (unsigned long)histogram.percentile(90),
+        (unsigned long)histogram.percentile(99),
+        (unsigned long)histogram.max());
+
+    if (line_len < 0 || (size_t)line_len >= buffer_len) {
+      return 0;
+    }
+    return (size_t)line_len;
+  }
+
+private:
+  histogram_t _histograms[STAGE_COUNT];
+}; // end StageProfiler class
+
+/**
+ * @brief records the time since a start tick if a profiler is attached.
+ * @param profiler the profiler, or NULL.
+ * @param stage the stage that was timed.
+ * @param start_ticks the tick taken when the stage started.
+ * @return the current tick, to start timing the next stage.
+ */
+inline uint32_t recordStage(StageProfiler *profiler, pipeline_stage_t stage,
+                            uint32_t start_ticks) {
+  if (profiler == NULL) {
+    return StageClock::now();
+  }
+  return profiler->record(stage, start_ticks);
+}
+} // namespace filters
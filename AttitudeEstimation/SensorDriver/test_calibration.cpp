@@ -0,0 +1,101 @@
+#include "Calibration.hpp"
+#include "gtest/gtest.h"
+
+using namespace filters;
+
+TEST(CalibrationTesting, TestIdentityCalibration) {
+  AffineCalibration<double> identity;
+  int16_t raw[3] = {10, -20, 30};
+  double out[3];
+  identity.apply(raw, out);
+  ASSERT_DOUBLE_EQ(10, out[0]);
+  ASSERT_DOUBLE_EQ(-20, out[1]);
+  ASSERT_DOUBLE_EQ(30, out[2]);
+}
+
+TEST(CalibrationTesting, TestNominalCalibration) {
+  SensorCalibration<double> nominal = SensorCalibration<double>::nominal();
+  RawSensorSample raw = {{4096, -2048, 0}, {164, 0, -328}, {16, 32, -48}, 42U};
+  SensorSample<double> out;
+  nominal.apply(raw, out);
+
+  // 4096 LSB is 1g
+  EXPECT_NEAR(9.81, out.acc[0], 1e-9);
+  EXPECT_NEAR(-4.905, out.acc[1], 1e-9);
+  EXPECT_NEAR(0.0, out.acc[2], 1e-9);
+
+  // 164 LSB is 10 deg/sec
+  EXPECT_NEAR(10 * 0.017453292519943, out.gyro[0], 1e-9);
+  EXPECT_NEAR(-20 * 0.017453292519943, out.gyro[2], 1e-9);
+
+  // 16 LSB is 1uT, or 1000nT
+  EXPECT_NEAR(1000.0, out.mag[0], 1e-9);
+  EXPECT_NEAR(2000.0, out.mag[1], 1e-9);
+  EXPECT_NEAR(-3000.0, out.mag[2], 1e-9);
+
+  ASSERT_EQ(42U, out.timestamp_us);
+}
+
+TEST(CalibrationTesting, TestFoldedComponents) {
+  // sensor is mounted rotated 90 degrees about z, with a bias and a
+  // 2x scale error on its x axis.
+  double bias[3] = {1.0, 2.0, 3.0};
+  double correction[3][3] = {{0.5, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  double alignment[3][3] = {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}};
+  AffineCalibration<double> cal =
+      AffineCalibration<double>::fromComponents(0.1, bias, correction,
+                                                alignment);
+
+  int16_t raw[3] = {100, 200, 300};
+  double out[3];
+  cal.apply(raw, out);
+
+  // reference: alignment * correction * (0.1 * raw - bias)
+  double unbiased[3] = {10.0 - 1.0, 20.0 - 2.0, 30.0 - 3.0};
+  double corrected[3] = {0.5 * unbiased[0], unbiased[1], unbiased[2]};
+  EXPECT_NEAR(-corrected[1], out[0], 1e-12);
+  EXPECT_NEAR(corrected[0], out[1], 1e-12);
+  EXPECT_NEAR(corrected[2], out[2], 1e-12);
+
+  // offset column holds the folded bias
+  EXPECT_NEAR(2.0, cal.getValue(0, 3), 1e-12);
+  EXPECT_NEAR(-0.5, cal.getValue(1, 3), 1e-12);
+  EXPECT_NEAR(-3.0, cal.getValue(2, 3), 1e-12);
+}
+
+TEST(CalibrationTesting, TestBatchMatchesSingle) {
+  SensorCalibration<double> nominal = SensorCalibration<double>::nominal();
+  RawSensorSample raw[8];
+  for (int i = 0; i < 8; i++) {
+    for (int axis = 0; axis < 3; axis++) {
+      raw[i].acc[axis] = (int16_t)(100 * i - 7 * axis);
+      raw[i].gyro[axis] = (int16_t)(-50 * i + 3 * axis);
+      raw[i].mag[axis] = (int16_t)(25 * i + axis);
+    }
+    raw[i].timestamp_us = 1000U * i;
+  }
+
+  SensorSample<double> batch_out[8];
+  nominal.applyBatch(raw, 8, batch_out);
+  for (int i = 0; i < 8; i++) {
+    SensorSample<double> single_out;
+    nominal.apply(raw[i], single_out);
+    for (int axis = 0; axis < 3; axis++) {
+      ASSERT_DOUBLE_EQ(single_out.acc[axis], batch_out[i].acc[axis]);
+      ASSERT_DOUBLE_EQ(single_out.gyro[axis], batch_out[i].gyro[axis]);
+      ASSERT_DOUBLE_EQ(single_out.mag[axis], batch_out[i].mag[axis]);
+    }
+    ASSERT_EQ(single_out.timestamp_us, batch_out[i].timestamp_us);
+  }
+
+  // triple batches work on packed FIFO style buffers too
+  int16_t fifo[4][3] = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}, {10, 11, 12}};
+  double fifo_out[4][3];
+  nominal.getMagCalibration().applyBatch(fifo, 4, fifo_out);
+  EXPECT_NEAR(12 * 1000.0 / 16, fifo_out[3][2], 1e-9);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
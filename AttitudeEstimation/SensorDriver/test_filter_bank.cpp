@@ -0,0 +1,119 @@
+#include "FilterBank.hpp"
+#include "FilterDriver.hpp"
+#include "SensorSources.hpp"
+#include "gtest/gtest.h"
+#include <vector>
+
+using namespace filters;
+
+/**
+ * @brief runs one filter driver over a synthetic stream on the calling
+ * thread, as the reference for the bank.
+ */
+template <typename DriverT>
+static std::vector<structures::Quaternion<double>>
+runSequential(uint64_t num_samples, const double body_rate[3]) {
+  SyntheticSensorSource source(num_samples, 100.0, body_rate);
+  SensorCalibration<double> calibration = SensorCalibration<double>::nominal();
+  DriverT driver;
+  AcquiredSample acquired;
+  SensorSample<double> sample;
+  std::vector<structures::Quaternion<double>> estimates;
+  while (source.read(acquired)) {
+    calibration.apply(acquired.raw, sample);
+    structures::Quaternion<double> estimate;
+    driver.update(sample, estimate);
+    estimates.push_back(estimate);
+  }
+  return estimates;
+}
+
+TEST(FilterBankTesting, TestAlignedEstimates) {
+  const uint64_t num_samples = 5000;
+  const double body_rate[3] = {0.1, -0.2, 0.3};
+  SyntheticSensorSource source(num_samples, 100.0, body_rate);
+
+  FilterBank bank;
+  ASSERT_TRUE(bank.addFilter<ComplementaryDriver>("complementary"));
+  ASSERT_TRUE(bank.addFilter<EKFDriver>("ekf"));
+  ASSERT_TRUE(bank.addFilter<MadgwickDriver>("madgwick"));
+  ASSERT_TRUE(bank.addFilter<MahonyDriver>("mahony"));
+  ASSERT_EQ(4U, bank.size());
+  ASSERT_STREQ("madgwick", bank.getName(2));
+
+  std::vector<BankRow> rows;
+  ASSERT_EQ(num_samples,
+            bank.run(source, [&rows](const BankRow &row) {
+              rows.push_back(row);
+            }));
+  ASSERT_FALSE(bank.addFilter<MadgwickDriver>("late"));
+
+  // one complete row per sample, in order, and every filter gives the same
+  // estimates as when run alone
+  std::vector<structures::Quaternion<double>> expected[4] = {
+      runSequential<ComplementaryDriver>(num_samples, body_rate),
+      runSequential<EKFDriver>(num_samples, body_rate),
+      runSequential<MadgwickDriver>(num_samples, body_rate),
+      runSequential<MahonyDriver>(num_samples, body_rate)};
+  ASSERT_EQ(num_samples, rows.size());
+  for (size_t i = 0; i < rows.size(); i++) {
+    ASSERT_EQ(i, rows[i].sequence);
+    ASSERT_EQ(10000U * i, rows[i].timestamp_us);
+    ASSERT_EQ(0xFU, rows[i].valid_mask);
+    for (size_t filter = 0; filter < 4; filter++) {
+      ASSERT_EQ(expected[filter][i].getW(), rows[i].estimates[filter].getW());
+      ASSERT_EQ(expected[filter][i].getZ(), rows[i].estimates[filter].getZ());
+    }
+  }
+  for (size_t filter = 0; filter < 4; filter++) {
+    ASSERT_EQ(num_samples, bank.getProcessedCount(filter));
+  }
+}
+
+TEST(FilterBankTesting, TestLimits) {
+  FilterBank bank;
+  ASSERT_FALSE(bank.start());
+  for (size_t i = 0; i < kMaxBankFilters; i++) {
+    ASSERT_TRUE(bank.addFilter<MadgwickDriver>("madgwick"));
+  }
+  ASSERT_FALSE(bank.addFilter<MadgwickDriver>("madgwick"));
+
+  bank.setPinning(false);
+  ASSERT_TRUE(bank.start());
+  ASSERT_FALSE(bank.start());
+  ASSERT_FALSE(bank.isPinned(0));
+
+  // nothing pushed, so the bank finishes without rows once closed
+  BankRow row;
+  ASSERT_FALSE(bank.finished());
+  bank.close();
+  bank.stop();
+  ASSERT_FALSE(bank.pollAligned(row));
+  ASSERT_TRUE(bank.finished());
+}
+
+TEST(FilterBankTesting, TestAbandonedBank) {
+  // destroying a bank whose rows were never merged must not hang on the
+  // blocked workers
+  const double body_rate[3] = {0.1, -0.2, 0.3};
+  SyntheticSensorSource source(4 * FilterBank::kInputDepth, 100.0, body_rate);
+  FilterBank bank;
+  ASSERT_TRUE(bank.addFilter<MadgwickDriver>("madgwick"));
+  ASSERT_TRUE(bank.addFilter<MahonyDriver>("mahony"));
+  ASSERT_TRUE(bank.start());
+
+  AcquiredSample sample;
+  uint32_t sequence = 0;
+  while (source.read(sample)) {
+    sample.sequence = sequence++;
+    if (!bank.push(sample)) {
+      break;
+    }
+  }
+  ASSERT_GT(sequence, 0U);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
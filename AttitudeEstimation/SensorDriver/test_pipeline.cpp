@@ -0,0 +1,234 @@
+#include "Emission.hpp"
+#include "EstimateFormat.hpp"
+#include "FilterDriver.hpp"
+#include "Pipeline.hpp"
+#include "gtest/gtest.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace filters;
+
+/**
+ * @brief a simulated sensor producing a fixed number of raw samples of a
+ * slowly rotating device.
+ */
+class SimulatedSource {
+public:
+  SimulatedSource(uint32_t num_samples) : _remaining(num_samples), _step(0) {}
+
+  bool read(AcquiredSample &sample) {
+    if (this->_remaining == 0) {
+      return false;
+    }
+
+    double phase = 0.01 * this->_step;
+    for (int axis = 0; axis < 3; axis++) {
+      sample.raw.acc[axis] = (int16_t)(axis == 2 ? 4096 : 300 * sin(phase));
+      sample.raw.gyro[axis] = (int16_t)(50 * cos(phase + axis));
+      sample.raw.mag[axis] = (int16_t)(axis == 0 ? 350 : -650 + axis);
+    }
+    sample.raw.timestamp_us = 10000U * this->_step;
+    sample.ground_truth = structures::Quaternion<double>();
+
+    this->_step++;
+    this->_remaining--;
+    return true;
+  }
+
+private:
+  uint32_t _remaining;
+  uint32_t _step;
+};
+
+/**
+ * @brief a sink collecting written messages.
+ */
+struct CollectingSink {
+  void write(const uint8_t *buffer, size_t len) {
+    messages.push_back(std::string((const char *)buffer, len));
+  }
+
+  std::vector<std::string> messages;
+};
+
+TEST(PipelineTesting, TestChannelOverflowPolicy) {
+  StageChannel<int, 4> drop_channel(DROP_NEWEST);
+  for (int i = 0; i < 10; i++) {
+    drop_channel.push(i);
+  }
+  ASSERT_EQ(6U, drop_channel.getDroppedCount());
+
+  // the oldest items are kept
+  int value = -1;
+  ASSERT_TRUE(drop_channel.pop(value));
+  ASSERT_EQ(0, value);
+}
+
+TEST(PipelineTesting, TestThreadedSourceAndFilter) {
+  const uint32_t num_samples = 5000;
+  SimulatedSource source(num_samples);
+  StageChannel<AcquiredSample, 16> sample_channel(BLOCK);
+  StageChannel<EstimateRecord, 16> estimate_channel(BLOCK);
+  AcquisitionStage<SimulatedSource, 16> acquisition(source, sample_channel);
+  FilterStage<MadgwickDriver, 16, 16> filter_stage(
+      sample_channel, estimate_channel, SensorCalibration<double>::nominal());
+
+  // sensor source on one thread, filter on another, consumer on this one
+  std::thread source_thread([&acquisition]() {
+    while (acquisition.poll()) {
+    }
+  });
+  std::thread filter_thread([&filter_stage, num_samples]() {
+    uint32_t filtered = 0;
+    while (filtered < num_samples) {
+      filtered += filter_stage.process(16);
+    }
+  });
+
+  // replay the same samples through a driver directly as the reference
+  SimulatedSource reference_source(num_samples);
+  SensorCalibration<double> calibration = SensorCalibration<double>::nominal();
+  MadgwickDriver reference_driver;
+  AcquiredSample reference_sample;
+  SensorSample<double> calibrated;
+  structures::Quaternion<double> expected;
+
+  uint32_t received = 0;
+  EstimateRecord record;
+  while (received < num_samples) {
+    if (!estimate_channel.pop(record)) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    reference_source.read(reference_sample);
+    calibration.apply(reference_sample.raw, calibrated);
+    reference_driver.update(calibrated, expected);
+
+    ASSERT_EQ(received, record.sequence);
+    ASSERT_EQ(calibrated.timestamp_us, record.timestamp_us);
+    ASSERT_DOUBLE_EQ(expected.getW(), record.estimate.getW());
+    ASSERT_DOUBLE_EQ(expected.getZ(), record.estimate.getZ());
+    received++;
+  }
+
+  source_thread.join();
+  filter_thread.join();
+  ASSERT_EQ(0U, sample_channel.getDroppedCount());
+  ASSERT_EQ(0U, estimate_channel.getDroppedCount());
+}
+
+TEST(PipelineTesting, TestOutputStageFormatsJson) {
+  StageChannel<EstimateRecord, 4> estimate_channel;
+  CollectingSink sink;
+  OutputStage<JsonEstimateFormatter, CollectingSink, 4> output_stage(
+      estimate_channel, sink);
+
+  EstimateRecord record;
+  record.sequence = 0;
+  record.timestamp_us = 0;
+  record.ground_truth = structures::Quaternion<double>(0.5, -0.5, 0.5, 0.5);
+  record.estimate = structures::Quaternion<double>();
+  estimate_channel.push(record);
+
+  ASSERT_EQ(1U, output_stage.process(10));
+  ASSERT_EQ(1U, sink.messages.size());
+  ASSERT_EQ("{\"ground_truth_quat\": {\"w\": 0.500000, \"x\": 0.500000, "
+            "\"y\": -0.500000, \"z\": 0.500000},\"estimated_quat\": {\"w\": "
+            "1.000000,\"x\": 0.000000,\"y\": 0.000000,\"z\": 0.000000}}\n",
+            sink.messages[0]);
+}
+
+/**
+ * @brief builds an estimate rotated about Z by the provided angle.
+ */
+EstimateRecord makeYawRecord(uint64_t timestamp_us, double yaw_rad) {
+  EstimateRecord record;
+  record.sequence = 0;
+  record.timestamp_us = timestamp_us;
+  record.ground_truth = structures::Quaternion<double>();
+  record.estimate = structures::Quaternion<double>(
+      0.0, 0.0, sin(yaw_rad / 2.0), cos(yaw_rad / 2.0));
+  return record;
+}
+
+TEST(PipelineTesting, TestFixedRateEmission) {
+  // 1 kHz filter updates with some jitter, decimated to 50 Hz
+  EmissionPolicy policy = EmissionPolicy::fixedRate(50.0);
+  uint32_t emitted = 0;
+  for (uint64_t i = 0; i < 1000; i++) {
+    uint64_t timestamp_us = 1000U * i + (i % 3) * 100U;
+    if (policy.shouldEmit(makeYawRecord(timestamp_us, 0.0))) {
+      emitted++;
+    }
+  }
+  ASSERT_EQ(50U, emitted);
+  ASSERT_EQ(950U, policy.getSuppressedCount());
+}
+
+TEST(PipelineTesting, TestInvalidFixedRateEmitsEverySample) {
+  // rates without a grid fall back to emitting every estimate
+  const double rates[] = {0.0, -50.0, NAN};
+  for (double rate_hz : rates) {
+    EmissionPolicy policy = EmissionPolicy::fixedRate(rate_hz);
+    ASSERT_EQ(EMIT_EVERY_UPDATE, policy.getMode());
+    for (uint64_t i = 0; i < 100; i++) {
+      ASSERT_TRUE(policy.shouldEmit(makeYawRecord(1000U * i, 0.0)));
+    }
+    ASSERT_EQ(0U, policy.getSuppressedCount());
+  }
+}
+
+TEST(PipelineTesting, TestDeadbandEmission) {
+  const double threshold = 0.01;
+  EmissionPolicy policy = EmissionPolicy::deadband(threshold, 100000U);
+
+  // the first estimate is always sent
+  ASSERT_TRUE(policy.shouldEmit(makeYawRecord(0U, 0.0)));
+
+  // small motion stays inside the deadband, even in the opposite
+  // quaternion hemisphere
+  ASSERT_FALSE(policy.shouldEmit(makeYawRecord(1000U, 0.5 * threshold)));
+  EstimateRecord flipped = makeYawRecord(2000U, 0.5 * threshold);
+  flipped.estimate = flipped.estimate * -1.0;
+  ASSERT_FALSE(policy.shouldEmit(flipped));
+
+  // large motion is sent, and becomes the new reference
+  ASSERT_TRUE(policy.shouldEmit(makeYawRecord(3000U, 2.0 * threshold)));
+  ASSERT_FALSE(policy.shouldEmit(makeYawRecord(4000U, 2.5 * threshold)));
+
+  // the keep-alive fires while the estimate is still
+  ASSERT_FALSE(policy.shouldEmit(makeYawRecord(102999U, 2.0 * threshold)));
+  ASSERT_TRUE(policy.shouldEmit(makeYawRecord(103000U, 2.0 * threshold)));
+  ASSERT_EQ(4U, policy.getSuppressedCount());
+}
+
+TEST(PipelineTesting, TestFilterStageEmission) {
+  const uint32_t num_samples = 100;
+  SimulatedSource source(num_samples);
+  StageChannel<AcquiredSample, 128> sample_channel;
+  StageChannel<EstimateRecord, 128> estimate_channel;
+  AcquisitionStage<SimulatedSource, 128> acquisition(source, sample_channel);
+
+  // samples arrive at 100 Hz, estimates leave at 10 Hz
+  FilterStage<MadgwickDriver, 128, 128> filter_stage(
+      sample_channel, estimate_channel, SensorCalibration<double>::nominal(),
+      EmissionPolicy::fixedRate(10.0));
+  while (acquisition.poll()) {
+  }
+  ASSERT_EQ(num_samples, filter_stage.process(num_samples));
+
+  ASSERT_EQ(10U, estimate_channel.size());
+  EstimateRecord record;
+  for (uint32_t i = 0; i < 10; i++) {
+    ASSERT_TRUE(estimate_channel.pop(record));
+    ASSERT_EQ(10U * i, record.sequence);
+  }
+  ASSERT_EQ(90U, filter_stage.getEmissionPolicy().getSuppressedCount());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
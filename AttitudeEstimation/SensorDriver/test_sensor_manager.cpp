@@ -0,0 +1,149 @@
+#include "../Telemetry/TelemetryDecoder.hpp"
+#include "../Telemetry/TelemetryProtocol.hpp"
+#include "Clock.hpp"
+#include "SensorManager.hpp"
+#include "SensorSources.hpp"
+#include "gtest/gtest.h"
+#include <vector>
+
+using namespace filters;
+
+/**
+ * @brief a transport collecting every written byte.
+ */
+struct CollectingTransport {
+  size_t write(const uint8_t *data, size_t len) {
+    bytes.insert(bytes.end(), data, data + len);
+    return len;
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+TEST(SensorManagerTesting, TestSyntheticSource) {
+  const double body_rate[3] = {0.0, 0.0, 0.5};
+  SyntheticSensorSource source(101, 100.0, body_rate);
+  SensorCalibration<double> calibration = SensorCalibration<double>::nominal();
+
+  AcquiredSample sample;
+  SensorSample<double> calibrated;
+  uint32_t count = 0;
+  while (source.read(sample)) {
+    calibration.apply(sample.raw, calibrated);
+    ASSERT_EQ(10000U * count, calibrated.timestamp_us);
+    ASSERT_NEAR(EARTH_G_MSS, calibrated.acc[2], 0.01);
+    ASSERT_NEAR(0.5, calibrated.gyro[2], 0.001);
+    count++;
+  }
+  ASSERT_EQ(101U, count);
+
+  // one second at 0.5 rad/s about Z
+  ASSERT_NEAR(cos(0.25), sample.ground_truth.getW(), 1e-9);
+  ASSERT_NEAR(sin(0.25), sample.ground_truth.getZ(), 1e-9);
+}
+
+TEST(SensorManagerTesting, TestRecordedSourceRoundTrip) {
+  const double body_rate[3] = {0.3, -0.2, 0.1};
+  SyntheticSensorSource synthetic(50, 200.0, body_rate);
+  FILE *file = tmpfile();
+  ASSERT_NE(nullptr, file);
+  fputs(kRecordedSampleHeader, file);
+
+  std::vector<AcquiredSample> written;
+  AcquiredSample sample = AcquiredSample();
+  while (synthetic.read(sample)) {
+    ASSERT_TRUE(writeRecordedSample(file, sample));
+    written.push_back(sample);
+  }
+  rewind(file);
+
+  RecordedSensorSource recorded(file);
+  for (const AcquiredSample &expected : written) {
+    ASSERT_TRUE(recorded.read(sample));
+    ASSERT_EQ(expected.raw.timestamp_us, sample.raw.timestamp_us);
+    for (int axis = 0; axis < 3; axis++) {
+      ASSERT_EQ(expected.raw.acc[axis], sample.raw.acc[axis]);
+      ASSERT_EQ(expected.raw.gyro[axis], sample.raw.gyro[axis]);
+      ASSERT_EQ(expected.raw.mag[axis], sample.raw.mag[axis]);
+    }
+    ASSERT_NEAR(expected.ground_truth.getX(), sample.ground_truth.getX(),
+                1e-9);
+    ASSERT_NEAR(expected.ground_truth.getW(), sample.ground_truth.getW(),
+                1e-9);
+  }
+  ASSERT_FALSE(recorded.read(sample));
+  ASSERT_EQ(1U, recorded.getSkippedLines());
+  fclose(file);
+}
+
+TEST(SensorManagerTesting, TestPacedSource) {
+  const double body_rate[3] = {0.0, 0.0, 0.0};
+  SyntheticSensorSource synthetic(3, 100.0, body_rate);
+  ManualClock clock(5000U);
+  PacedSensorSource<SyntheticSensorSource, ManualClock> paced(synthetic,
+                                                              clock);
+
+  AcquiredSample sample;
+  ASSERT_TRUE(paced.read(sample));
+  ASSERT_FALSE(paced.read(sample));
+  clock.advance(9999U);
+  ASSERT_FALSE(paced.read(sample));
+  clock.advance(1U);
+  ASSERT_TRUE(paced.read(sample));
+  ASSERT_EQ(10000U, sample.raw.timestamp_us);
+
+  clock.advance(10000U);
+  ASSERT_TRUE(paced.read(sample));
+  ASSERT_FALSE(paced.exhausted());
+  ASSERT_FALSE(paced.read(sample));
+  ASSERT_TRUE(paced.exhausted());
+}
+
+TEST(SensorManagerTesting, TestReplayThroughSensorManager) {
+  const uint64_t num_samples = 1000;
+  const double body_rate[3] = {0.1, -0.2, 0.3};
+  SyntheticSensorSource source(num_samples, 100.0, body_rate);
+  CollectingTransport transport;
+  BasicSensorManager<MADGWICK, SyntheticSensorSource, CollectingTransport,
+                     telemetry::BinaryEstimateFormatter>
+      sensor_man(source, transport);
+
+  ASSERT_EQ(num_samples, sensor_man.runUntilExhausted());
+  ASSERT_EQ(0U, sensor_man.getDroppedEstimates());
+  ASSERT_EQ(0U, sensor_man.getDroppedFrames());
+  ASSERT_EQ(transport.bytes.size(), sensor_man.getBytesSent());
+
+  // replay the same samples through a driver directly as the reference
+  SyntheticSensorSource reference_source(num_samples, 100.0, body_rate);
+  SensorCalibration<double> calibration = SensorCalibration<double>::nominal();
+  MadgwickDriver reference_driver;
+  std::vector<structures::Quaternion<double>> expected;
+  AcquiredSample sample;
+  SensorSample<double> calibrated;
+  structures::Quaternion<double> estimate;
+  while (reference_source.read(sample)) {
+    calibration.apply(sample.raw, calibrated);
+    reference_driver.update(calibrated, estimate);
+    expected.push_back(estimate);
+  }
+
+  telemetry::TelemetryDecoder decoder;
+  uint32_t decoded = 0;
+  decoder.feed(transport.bytes.data(), transport.bytes.size(),
+               [&](const EstimateRecord &record) {
+                 ASSERT_EQ(decoded, record.sequence);
+                 double dot = record.estimate.getW() * expected[decoded].getW() +
+                              record.estimate.getX() * expected[decoded].getX() +
+                              record.estimate.getY() * expected[decoded].getY() +
+                              record.estimate.getZ() * expected[decoded].getZ();
+                 ASSERT_NEAR(1.0, fabs(dot), 1e-6);
+                 decoded++;
+               });
+  ASSERT_EQ(num_samples, decoded);
+  ASSERT_EQ(0U, decoder.getMissingFrameCount());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
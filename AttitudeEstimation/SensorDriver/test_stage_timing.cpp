@@ -0,0 +1,153 @@
+#define SENSOR_MANAGER_STAGE_TIMING 1
+
+#include "../Telemetry/TelemetryDecoder.hpp"
+#include "../Telemetry/TelemetryProtocol.hpp"
+#include "SensorManager.hpp"
+#include "SensorSources.hpp"
+#include "StageTiming.hpp"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+using namespace filters;
+
+/**
+ * @brief a transport collecting every written byte.
+ */
+struct CollectingTransport {
+  size_t write(const uint8_t *data, size_t len) {
+    bytes.insert(bytes.end(), data, data + len);
+    return len;
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+TEST(StageTimingTesting, TestHistogramBuckets) {
+  typedef LatencyHistogram<4> histogram_t;
+  const size_t bucket_count = histogram_t::kBucketCount;
+  ASSERT_EQ(240U, bucket_count);
+  ASSERT_EQ(bucket_count - 1, histogram_t::bucketIndex(UINT32_MAX));
+  ASSERT_EQ(UINT32_MAX, histogram_t::bucketHighest(bucket_count - 1));
+
+  // every value lands in a bucket whose range covers it, within 1/8 of the
+  // value, and the buckets are ordered
+  size_t last_index = 0;
+  for (uint64_t value = 0; value <= UINT32_MAX; value += 1 + value / 64) {
+    size_t index = histogram_t::bucketIndex((uint32_t)value);
+    ASSERT_GE(index, last_index);
+    ASSERT_GE(histogram_t::bucketHighest(index), value);
+    ASSERT_LE(histogram_t::bucketHighest(index) - value, value / 8);
+    if (index > 0) {
+      ASSERT_LT(histogram_t::bucketHighest(index - 1), value);
+    }
+    last_index = index;
+  }
+}
+
+TEST(StageTimingTesting, TestHistogramStatistics) {
+  LatencyHistogram<4> histogram;
+  ASSERT_EQ(0U, histogram.percentile(50));
+  ASSERT_EQ(0U, histogram.min());
+
+  for (uint32_t value = 1; value <= 1000; value++) {
+    histogram.record(value);
+  }
+  ASSERT_EQ(1000U, histogram.count());
+  ASSERT_EQ(1U, histogram.min());
+  ASSERT_EQ(1000U, histogram.max());
+  ASSERT_DOUBLE_EQ(500.5, histogram.mean());
+
+  // percentiles never understate, and are within the bucket resolution
+  ASSERT_GE(histogram.percentile(50), 500U);
+  ASSERT_LE(histogram.percentile(50), 500U + 500U / 8);
+  ASSERT_GE(histogram.percentile(99), 990U);
+  ASSERT_LE(histogram.percentile(99), 1000U);
+  ASSERT_EQ(1000U, histogram.percentile(100));
+  ASSERT_EQ(1U, histogram.percentile(0));
+
+  histogram.reset();
+  ASSERT_EQ(0U, histogram.count());
+  ASSERT_EQ(0U, histogram.max());
+}
+
+TEST(StageTimingTesting, TestSensorManagerTimings) {
+  const uint64_t num_samples = 200;
+  const double body_rate[3] = {0.1, -0.2, 0.3};
+  SyntheticSensorSource source(num_samples, 100.0, body_rate);
+  CollectingTransport transport;
+  BasicSensorManager<MADGWICK, SyntheticSensorSource, CollectingTransport>
+      sensor_man(source, transport);
+  ASSERT_EQ(num_samples, sensor_man.runUntilExhausted());
+
+  const StageProfiler &profiler = sensor_man.getStageProfiler();
+  ASSERT_EQ(num_samples, profiler.getHistogram(STAGE_READ).count());
+  ASSERT_EQ(num_samples, profiler.getHistogram(STAGE_CALIBRATE).count());
+  ASSERT_EQ(num_samples, profiler.getHistogram(STAGE_FILTER).count());
+  ASSERT_EQ(num_samples, profiler.getHistogram(STAGE_FORMAT).count());
+  ASSERT_EQ(num_samples, profiler.getHistogram(STAGE_END_TO_END).count());
+  ASSERT_GT(profiler.getHistogram(STAGE_TRANSMIT).count(), 0U);
+  ASSERT_GT(profiler.getHistogram(STAGE_FILTER).max(), 0U);
+
+  // a sample takes longer end to end than its filter update
+  ASSERT_GE(profiler.getHistogram(STAGE_END_TO_END).percentile(50),
+            profiler.getHistogram(STAGE_FILTER).percentile(50));
+
+  // the report follows the estimates, one JSON line per stage
+  size_t estimate_bytes = transport.bytes.size();
+  sensor_man.requestTimingReport(true);
+  for (int i = 0; i < 2 * STAGE_COUNT; i++) {
+    sensor_man.step();
+  }
+  std::string report(transport.bytes.begin() + estimate_bytes,
+                     transport.bytes.end());
+  size_t lines = 0;
+  for (size_t pos = 0; (pos = report.find('\n', pos)) != std::string::npos;
+       pos++) {
+    lines++;
+  }
+  ASSERT_EQ((size_t)STAGE_COUNT, lines);
+  ASSERT_EQ(0U, report.find("{\"stage\": \"read\", \"unit\": \"ns\", "
+                            "\"count\": 200,"));
+  ASSERT_NE(std::string::npos, report.find("\"stage\": \"end_to_end\""));
+
+  // the histograms were reset once reported
+  ASSERT_EQ(0U, profiler.getHistogram(STAGE_FILTER).count());
+}
+
+TEST(StageTimingTesting, TestBinaryReport) {
+  const uint64_t num_samples = 100;
+  const double body_rate[3] = {0.1, -0.2, 0.3};
+  SyntheticSensorSource source(num_samples, 100.0, body_rate);
+  CollectingTransport transport;
+  BasicSensorManager<MADGWICK, SyntheticSensorSource, CollectingTransport,
+                     telemetry::BinaryEstimateFormatter>
+      sensor_man(source, transport);
+
+  // a report in the middle of the estimate frames
+  for (int i = 0; i < 50; i++) {
+    ASSERT_TRUE(sensor_man.step());
+  }
+  sensor_man.requestTimingReport();
+  ASSERT_EQ(num_samples - 50, sensor_man.runUntilExhausted());
+  ASSERT_EQ(0U, sensor_man.getDroppedFrames());
+
+  // the decoder skips every report line as one invalid frame, and loses no
+  // estimates
+  telemetry::TelemetryDecoder decoder;
+  size_t decoded = decoder.feed(transport.bytes.data(), transport.bytes.size(),
+                                [](const EstimateRecord &) {});
+  ASSERT_EQ(num_samples, decoded);
+  ASSERT_EQ(0U, decoder.getMissingFrameCount());
+  ASSERT_EQ((uint64_t)STAGE_COUNT, decoder.getFramingErrorCount());
+
+  // the histograms keep accumulating without a reset
+  ASSERT_EQ(num_samples, sensor_man.getStageProfiler()
+                             .getHistogram(STAGE_FILTER)
+                             .count());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+namespace simulation {
+
+/**
+ * @brief the tables of the Marsaglia-Tsang ziggurat for the standard normal
+ * distribution, with 128 layers.
+ */
+struct ZigguratTables {
+  int64_t k[128]; // layer acceptance thresholds
+  double w[128];  // layer widths, scaled to 31 bit draws
+  double f[128];  // density at each layer edge
+
+  /**
+   * @brief default constructor for ZigguratTables struct. Builds the tables.
+   */
+  ZigguratTables() {
+    const double m1 = 2147483648.0;
+    const double vn = 9.91256303526217e-3;
+    double dn = 3.442619855899;
+    double tn = dn;
+    double q = vn / exp(-0.5 * dn * dn);
+
+    this->k[0] = (int64_t)((dn / q) * m1);
+    this->k[1] = 0;
+    this->w[0] = q / m1;
+    this->w[127] = dn / m1;
+    this->f[0] = 1.0;
+    this->f[127] = exp(-0.5 * dn * dn);
+    for (int i = 126; i >= 1; i--) {
+      dn = sqrt(-2.0 * log(vn / dn + exp(-0.5 * dn * dn)));
+      this->k[i + 1] = (int64_t)((dn / tn) * m1);
+      tn = dn;
+      this->f[i] = exp(-0.5 * dn * dn);
+      this->w[i] = dn / m1;
+    }
+  }
+
+  /**
+   * @brief returns the shared tables, built on first use.
+   * @return the shared tables.
+   */
+  static const ZigguratTables &get() {
+    static const ZigguratTables tables;
+    return tables;
+  }
+};
+
+/**
+ * @brief a seeded xoshiro256+ generator. Unlike the standard library
+ * distributions its output is identical on every platform, so a seed fully
+ * determines a simulated recording.
+ */
+class Random {
+public:
+  /**
+   * @brief constructor for Random class.
+   * @param seed the seed. Every seed, including zero, gives a distinct
+   * stream.
+   */
+  Random(uint64_t seed) { this->seed(seed); }
+
+  /**
+   * @brief restarts the stream.
+   * @param seed the seed.
+   */
+  void seed(uint64_t seed) {
+    // expand the seed with splitmix64 so similar seeds give unrelated streams
+    for (int i = 0; i < 4; i++) {
+      seed += 0x9E3779B97F4A7C15ULL;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      this->_state[i] = z ^ (z >> 31);
+    }
+  }
+
+  /**
+   * @brief draws 64 random bits.
+   * @return the random bits.
+   */
+  uint64_t next() {
+    uint64_t *s = this->_state;
+    const uint64_t result = s[0] + s[3];
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return result;
+  }
+
+  /**
+   * @brief draws a uniform value.
+   * @return a value in [0, 1).
+   */
+  double uniform() {
+    return (this->next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  /**
+   * @brief draws a standard normal value with the ziggurat method. Nearly
+   * every draw is a table lookup and a multiply; only the rare draws that
+   * land outside a layer's rectangle need exp() or log().
+   * @return a normal value with zero mean and unit variance.
+   */
+  double gaussian() {
+    const ZigguratTables &tables = ZigguratTables::get();
+    for (;;) {
+      int32_t hz = (int32_t)(uint32_t)(this->next() >> 32);
+      int iz = hz & 127;
+      int64_t magnitude = hz < 0 ? -(int64_t)hz : (int64_t)hz;
+      double x = hz * tables.w[iz];
+      if (magnitude < tables.k[iz]) {
+        return x;
+      }
+
+      if (iz == 0) {
+        // the tail beyond the base layer
+        const double r = 3.442619855899;
+        double tail;
+        double y;
+        do {
+          tail = -log(1.0 - this->uniform()) / r;
+          y = -log(1.0 - this->uniform());
+        } while (y + y < tail * tail);
+        return hz > 0 ? r + tail : -r - tail;
+      }
+      if (tables.f[iz] + this->uniform() * (tables.f[iz - 1] - tables.f[iz]) <
+          exp(-0.5 * x * x)) {
+        return x;
+      }
+    }
+  }
+
+private:
+  uint64_t _state[4];
+}; // end Random class
+
+/**
+ * @brief the noise of one three axis sensor, the same on every axis. All
+ * terms are in the sensor's SI unit; a zero term costs nothing.
+ */
+struct SensorNoise {
+  double white;              // white noise density (unit/sqrt(Hz))
+  double random_walk;        // bias random walk (unit/s/sqrt(Hz))
+  double bias_instability;   // Gauss-Markov bias standard deviation (unit)
+  double correlation_time_s; // Gauss-Markov correlation time
+  double turn_on_bias;       // constant bias standard deviation (unit)
+};
+
+/**
+ * @brief transient magnetic disturbances, such as a passing vehicle or a
+ * nearby appliance. Each one adds a field of fixed world direction that
+ * rises and falls smoothly over its duration.
+ */
+struct MagneticDisturbance {
+  double rate_hz;    // mean number of disturbances per second
+  double duration_s; // length of each disturbance
+  double magnitude;  // peak disturbance field (nT)
+};
+
+/**
+ * @brief the noise of a whole 9DOF sensor.
+ */
+struct NoiseModel {
+  SensorNoise acc;  // m/s^2
+  SensorNoise gyro; // rad/s
+  SensorNoise mag;  // nT
+  MagneticDisturbance disturbance;
+
+  /**
+   * @brief creates a noiseless model.
+   * @return the noise model.
+   */
+  static NoiseModel ideal() {
+    NoiseModel model = {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0},
+                        {0, 0, 0}};
+    return model;
+  }
+
+  /**
+   * @brief creates a model in the range of a consumer MEMS IMU, such as the
+   * BMI270 and BMM150 behind the BHI260.
+   * @return the noise model.
+   */
+  static NoiseModel consumerMems() {
+    NoiseModel model = {
+        {1.6e-3, 1e-4, 4e-4, 100.0, 0.02},   // 160 ug/sqrt(Hz)
+        {1.2e-4, 1e-5, 3e-5, 100.0, 0.005},  // 0.007 deg/s/sqrt(Hz)
+        {30.0, 1.0, 50.0, 300.0, 200.0},     // 30 nT/sqrt(Hz)
+        {0.05, 2.0, 10000.0}};               // one 10 uT event per 20 s
+    return model;
+  }
+};
+
+/**
+ * @brief the evolving noise of one three axis sensor.
+ */
+class SensorNoiseState {
+public:
+  /**
+   * @brief constructor for SensorNoiseState class.
+   * @param noise the noise terms.
+   * @param sample_rate_hz the sample rate in Hz.
+   * @param random the generator to draw the turn-on bias from.
+   */
+  SensorNoiseState(const SensorNoise &noise, double sample_rate_hz,
+                   Random &random) {
+    const double dt = 1.0 / sample_rate_hz;
+    this->_white_sigma = noise.white * sqrt(sample_rate_hz);
+    this->_walk_sigma = noise.random_walk * sqrt(dt);
+
+    // exact discretization of the first order Gauss-Markov process
+    this->_markov_decay = noise.correlation_time_s > 0
+                              ? exp(-dt / noise.correlation_time_s)
+                              : 0.0;
+    this->_markov_sigma =
+        noise.bias_instability *
+        sqrt(1.0 - this->_markov_decay * this->_markov_decay);
+
+    for (int axis = 0; axis < 3; axis++) {
+      this->_turn_on[axis] =
+          noise.turn_on_bias > 0 ? noise.turn_on_bias * random.gaussian() : 0;
+      this->_walk[axis] = 0;
+      this->_markov[axis] =
+          noise.bias_instability > 0
+              ? noise.bias_instability * random.gaussian()
+              : 0;
+    }
+  }
+
+  /**
+   * @brief adds one sample period of noise to a reading and advances the
+   * biases.
+   * @param ideal the noiseless reading.
+   * @param measured the noisy reading.
+   * @param random the generator to draw from.
+   */
+  void apply(const double ideal[3], double measured[3], Random &random) {
+    for (int axis = 0; axis < 3; axis++) {
+      double value = ideal[axis] + this->_turn_on[axis] + this->_walk[axis] +
+                     this->_markov[axis];
+      if (this->_white_sigma > 0) {
+        value += this->_white_sigma * random.gaussian();
+      }
+      measured[axis] = value;
+
+      if (this->_walk_sigma > 0) {
+        this->_walk[axis] += this->_walk_sigma * random.gaussian();
+      }
+      if (this->_markov_sigma > 0) {
+        this->_markov[axis] = this->_markov_decay * this->_markov[axis] +
+                              this->_markov_sigma * random.gaussian();
+      }
+    }
+  }
+
+  /**
+   * @brief returns the current total bias of an axis.
+   * @param axis the axis index.
+   * @return the current bias.
+   */
+  double getBias(int axis) const {
+    return this->_turn_on[axis] + this->_walk[axis] + this->_markov[axis];
+  }
+
+private:
+  double _white_sigma;
+  double _walk_sigma;
+  double _markov_decay;
+  double _markov_sigma;
+  double _turn_on[3];
+  double _walk[3];
+  double _markov[3];
+}; // end SensorNoiseState class
+} // namespace simulation
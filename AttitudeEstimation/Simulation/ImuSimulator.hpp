@@ -0,0 +1,297 @@
+#pragma once
+
+#include "../EstimationAlgs/SensorSample.hpp"
+#include "../SensorDriver/Calibration.hpp"
+#include "../SensorDriver/Records.hpp"
+#include "../SensorDriver/SensorSources.hpp"
+#include "ImuNoise.hpp"
+#include "Trajectory.hpp"
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace simulation {
+
+/**
+ * @brief one simulated sample: the exact readings, the noisy readings, the
+ * noisy readings quantized as the sensor ADCs would, and the exact attitude.
+ */
+struct SimulatedSample {
+  filters::SensorSample<double> ideal;         // noiseless readings
+  filters::SensorSample<double> measured;      // noisy readings
+  filters::RawSensorSample raw;                // quantized noisy readings
+  structures::Quaternion<double> ground_truth; // exact body to world attitude
+};
+
+/**
+ * @brief generates deterministic IMU samples along a trajectory. The same
+ * trajectory, rate, noise model and seed always produce the same samples.
+ * @tparam TrajectoryT provides void evaluate(double t, TrajectoryState &).
+ */
+template <typename TrajectoryT> class ImuSimulator {
+public:
+  /**
+   * @brief constructor for ImuSimulator class.
+   * @param trajectory the trajectory to follow.
+   * @param sample_rate_hz the sample rate in Hz.
+   * @param noise the sensor noise model.
+   * @param seed the noise seed.
+   */
+  ImuSimulator(const TrajectoryT &trajectory, double sample_rate_hz,
+               const NoiseModel &noise = NoiseModel::ideal(),
+               uint64_t seed = 1)
+      : _trajectory(trajectory), _initial_trajectory(trajectory),
+        _random(seed), _acc_noise(noise.acc, sample_rate_hz, _random),
+        _gyro_noise(noise.gyro, sample_rate_hz, _random),
+        _mag_noise(noise.mag, sample_rate_hz, _random) {
+    this->_sample_rate_hz = sample_rate_hz;
+    this->_period_us = 1e6 / sample_rate_hz;
+    this->_noise = noise;
+    this->_seed = seed;
+    this->_step = 0;
+    this->_disturbance_left = 0;
+    this->_disturbance_length = (uint64_t)ceil(
+        noise.disturbance.duration_s * sample_rate_hz);
+    this->_disturbance_chance = noise.disturbance.rate_hz / sample_rate_hz;
+    for (int axis = 0; axis < 3; axis++) {
+      this->_disturbance[axis] = 0;
+    }
+  }
+
+  /**
+   * @brief restarts the simulation, replaying the same samples.
+   */
+  void reset() {
+    *this = ImuSimulator(this->_initial_trajectory, this->_sample_rate_hz,
+                         this->_noise, this->_seed);
+  }
+
+  /**
+   * @brief produces the next sample.
+   * @param sample the sample to fill.
+   */
+  void next(SimulatedSample &sample) {
+    const uint64_t timestamp_us = (uint64_t)(this->_step * this->_period_us);
+    TrajectoryState state;
+    this->_trajectory.evaluate(this->_step / this->_sample_rate_hz, state);
+
+    // specific force and earth field, with any disturbance, in the body frame
+    const double specific_force[3] = {state.acceleration[0],
+                                      state.acceleration[1],
+                                      state.acceleration[2] + EARTH_G_MSS};
+    double field[3];
+    this->disturbedField(field);
+    double rotation[3][3];
+    toMatrix(state.attitude, rotation);
+    toBody(rotation, specific_force, sample.ideal.acc);
+    toBody(rotation, field, sample.ideal.mag);
+    for (int axis = 0; axis < 3; axis++) {
+      sample.ideal.gyro[axis] = state.body_rate[axis];
+    }
+    sample.ideal.timestamp_us = timestamp_us;
+
+    this->_acc_noise.apply(sample.ideal.acc, sample.measured.acc,
+                           this->_random);
+    this->_gyro_noise.apply(sample.ideal.gyro, sample.measured.gyro,
+                            this->_random);
+    this->_mag_noise.apply(sample.ideal.mag, sample.measured.mag,
+                           this->_random);
+    sample.measured.timestamp_us = timestamp_us;
+
+    filters::quantizeNominal(sample.measured.acc, sample.measured.gyro,
+                             sample.measured.mag, sample.raw);
+    sample.raw.timestamp_us = timestamp_us;
+    sample.ground_truth = state.attitude;
+    this->_step++;
+  }
+
+  /**
+   * @brief produces a batch of consecutive samples.
+   * @param samples pointer to count samples to fill.
+   * @param count the number of samples.
+   */
+  void generate(SimulatedSample *samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      this->next(samples[i]);
+    }
+  }
+
+  /**
+   * @brief returns the number of samples produced so far.
+   * @return the number of samples produced so far.
+   */
+  uint64_t getStep() const { return this->_step; }
+
+  /**
+   * @brief returns the sample rate.
+   * @return the sample rate in Hz.
+   */
+  double getSampleRate() const { return this->_sample_rate_hz; }
+
+  /**
+   * @brief returns the current gyroscope bias of an axis.
+   * @param axis the axis index.
+   * @return the current gyroscope bias in rad/s.
+   */
+  double getGyroBias(int axis) const { return this->_gyro_noise.getBias(axis); }
+
+  /**
+   * @brief checks if a magnetic disturbance is in progress.
+   * @return true if a magnetic disturbance is in progress, false otherwise.
+   */
+  bool isDisturbed() const { return this->_disturbance_left > 0; }
+
+private:
+  /**
+   * @brief computes the world frame field for the current sample, starting,
+   * shaping and ending disturbances.
+   * @param field the <X, Y, Z> world field in nT.
+   */
+  void disturbedField(double field[3]) {
+    const double earth[3] = {20000.0, 0.0, -45000.0}; // nT
+    for (int axis = 0; axis < 3; axis++) {
+      field[axis] = earth[axis];
+    }
+
+    if (this->_disturbance_left == 0 && this->_disturbance_chance > 0 &&
+        this->_random.uniform() < this->_disturbance_chance) {
+      // a uniformly random direction
+      double z = 2 * this->_random.uniform() - 1;
+      double angle = 2 * M_PI * this->_random.uniform();
+      double r = sqrt(1 - z * z);
+      this->_disturbance[0] = r * cos(angle);
+      this->_disturbance[1] = r * sin(angle);
+      this->_disturbance[2] = z;
+      this->_disturbance_left = this->_disturbance_length;
+    }
+    if (this->_disturbance_left == 0) {
+      return;
+    }
+
+    // a raised cosine envelope over the disturbance
+    double phase = 1.0 - (double)this->_disturbance_left /
+                             (double)this->_disturbance_length;
+    double envelope = 0.5 - 0.5 * cos(2 * M_PI * phase);
+    for (int axis = 0; axis < 3; axis++) {
+      field[axis] += this->_noise.disturbance.magnitude * envelope *
+                     this->_disturbance[axis];
+    }
+    this->_disturbance_left--;
+  }
+
+  /**
+   * @brief computes the rotation matrix of a unit quaternion.
+   * @param q the quaternion.
+   * @param m the body to world rotation matrix.
+   */
+  static void toMatrix(const structures::Quaternion<double> &q,
+                       double m[3][3]) {
+    const double w = q.getW();
+    const double x = q.getX();
+    const double y = q.getY();
+    const double z = q.getZ();
+    m[0][0] = 1 - 2 * (y * y + z * z);
+    m[0][1] = 2 * (x * y - w * z);
+    m[0][2] = 2 * (x * z + w * y);
+    m[1][0] = 2 * (x * y + w * z);
+    m[1][1] = 1 - 2 * (x * x + z * z);
+    m[1][2] = 2 * (y * z - w * x);
+    m[2][0] = 2 * (x * z - w * y);
+    m[2][1] = 2 * (y * z + w * x);
+    m[2][2] = 1 - 2 * (x * x + y * y);
+  }
+
+  /**
+   * @brief rotates a world frame vector into the body frame.
+   * @param m the body to world rotation matrix.
+   * @param world the world frame vector.
+   * @param body the body frame vector.
+   */
+  static void toBody(const double m[3][3], const double world[3],
+                     double body[3]) {
+    for (int row = 0; row < 3; row++) {
+      body[row] = m[0][row] * world[0] + m[1][row] * world[1] +
+                  m[2][row] * world[2];
+    }
+  }
+
+  TrajectoryT _trajectory;
+  TrajectoryT _initial_trajectory;
+  Random _random;
+  SensorNoiseState _acc_noise;
+  SensorNoiseState _gyro_noise;
+  SensorNoiseState _mag_noise;
+  NoiseModel _noise;
+  double _sample_rate_hz;
+  double _period_us;
+  uint64_t _seed;
+  uint64_t _step;
+  uint64_t _disturbance_left;
+  uint64_t _disturbance_length;
+  double _disturbance_chance;
+  double _disturbance[3];
+}; // end ImuSimulator class
+
+/**
+ * @brief a sample source producing a fixed number of simulated samples, for
+ * use with BasicSensorManager or the log writers.
+ */
+template <typename TrajectoryT> class SimulatedSensorSource {
+public:
+  /**
+   * @brief constructor for SimulatedSensorSource class.
+   * @param simulator the simulator to draw samples from.
+   * @param num_samples the number of samples to produce.
+   */
+  SimulatedSensorSource(ImuSimulator<TrajectoryT> &simulator,
+                        uint64_t num_samples)
+      : _simulator(simulator) {
+    this->_remaining = num_samples;
+  }
+
+  /**
+   * @brief produces the next sample.
+   * @param sample the sample to fill.
+   * @return false once all samples were produced, true otherwise.
+   */
+  bool read(filters::AcquiredSample &sample) {
+    if (this->_remaining == 0) {
+      return false;
+    }
+    sample.sequence = (uint32_t)this->_simulator.getStep();
+    this->_simulator.next(this->_sample);
+    sample.raw = this->_sample.raw;
+    sample.ground_truth = this->_sample.ground_truth;
+    this->_remaining--;
+    return true;
+  }
+
+private:
+  ImuSimulator<TrajectoryT> &_simulator;
+  SimulatedSample _sample;
+  uint64_t _remaining;
+}; // end SimulatedSensorSource class
+
+/**
+ * @brief returns a cycle of noisy 100 Hz handheld readings, simulated once
+ * per process from a fixed seed, so every benchmarked or profiled filter
+ * update sees the same realistic, changing input.
+ * @return the readings, 4096 samples.
+ */
+inline const std::vector<filters::SensorSample<double>> &handheldReadings() {
+  static const std::vector<filters::SensorSample<double>> readings = [] {
+    std::vector<filters::SensorSample<double>> cycle;
+    ImuSimulator<SinusoidalTrajectory> simulator(
+        SinusoidalTrajectory::handheld(), 100.0, NoiseModel::consumerMems(),
+        1);
+    SimulatedSample sample;
+    for (size_t i = 0; i < 4096; i++) {
+      simulator.next(sample);
+      cycle.push_back(sample.measured);
+    }
+    return cycle;
+  }();
+  return readings;
+}
+} // namespace simulation
@@ -0,0 +1,264 @@
+#pragma once
+
+#include "../Quaternion/Quaternion.hpp"
+#include <math.h>
+#include <stddef.h>
+#include <vector>
+
+namespace simulation {
+
+/**
+ * @brief the exact motion of the body at one instant.
+ */
+struct TrajectoryState {
+  structures::Quaternion<double> attitude; // body to world rotation
+  double body_rate[3];                     // body frame angular rate (rad/s)
+  double acceleration[3]; // world frame linear acceleration (m/s^2)
+};
+
+/**
+ * @brief fills a trajectory state from roll, pitch and yaw angles and their
+ * rates. The attitude matches Euler<double>::toQuaternion(), a Z-Y-X
+ * rotation from the body to the world frame.
+ * @param angles the <roll, pitch, yaw> angles in rad.
+ * @param rates the <roll, pitch, yaw> angle rates in rad/s.
+ * @param acceleration the world frame linear acceleration in m/s^2.
+ * @param state the state to fill.
+ */
+inline void eulerState(const double angles[3], const double rates[3],
+                       const double acceleration[3], TrajectoryState &state) {
+  double sr = sin(0.5 * angles[0]);
+  double cr = cos(0.5 * angles[0]);
+  double sp = sin(0.5 * angles[1]);
+  double cp = cos(0.5 * angles[1]);
+  double sy = sin(0.5 * angles[2]);
+  double cy = cos(0.5 * angles[2]);
+  state.attitude = structures::Quaternion<double>(
+      sr * cp * cy - cr * sp * sy, cr * sp * cy + sr * cp * sy,
+      cr * cp * sy - sr * sp * cy, cr * cp * cy + sr * sp * sy);
+
+  // full angle terms from the half angles
+  double sin_roll = 2 * sr * cr;
+  double cos_roll = cr * cr - sr * sr;
+  double sin_pitch = 2 * sp * cp;
+  double cos_pitch = cp * cp - sp * sp;
+  state.body_rate[0] = rates[0] - rates[2] * sin_pitch;
+  state.body_rate[1] =
+      rates[1] * cos_roll + rates[2] * cos_pitch * sin_roll;
+  state.body_rate[2] =
+      -rates[1] * sin_roll + rates[2] * cos_pitch * cos_roll;
+
+  for (int axis = 0; axis < 3; axis++) {
+    state.acceleration[axis] = acceleration[axis];
+  }
+}
+
+/**
+ * @brief a signal made of an offset, a linear drift and a sine wave, with
+ * its first and second derivatives.
+ */
+struct Sinusoid {
+  double offset;       // value at t = 0 without the sine wave
+  double slope;        // linear drift per second
+  double amplitude;    // sine wave amplitude
+  double frequency_hz; // sine wave frequency
+  double phase;        // sine wave phase in rad
+
+  /**
+   * @brief evaluates the signal and its derivatives.
+   * @param t the time in seconds.
+   * @param value the signal value.
+   * @param rate the first derivative.
+   * @param second the second derivative.
+   */
+  void evaluate(double t, double &value, double &rate,
+                double &second) const {
+    double omega = 2 * M_PI * this->frequency_hz;
+    double s = sin(omega * t + this->phase);
+    double c = cos(omega * t + this->phase);
+    value = this->offset + this->slope * t + this->amplitude * s;
+    rate = this->slope + this->amplitude * omega * c;
+    second = -this->amplitude * omega * omega * s;
+  }
+};
+
+/**
+ * @brief a parametric trajectory whose roll, pitch, yaw and world position
+ * are each a Sinusoid.
+ */
+class SinusoidalTrajectory {
+public:
+  /**
+   * @brief constructor for SinusoidalTrajectory class.
+   * @param angles the <roll, pitch, yaw> signals in rad.
+   * @param position the <X, Y, Z> world position signals in m.
+   */
+  SinusoidalTrajectory(const Sinusoid angles[3], const Sinusoid position[3]) {
+    for (int axis = 0; axis < 3; axis++) {
+      this->_angles[axis] = angles[axis];
+      this->_position[axis] = position[axis];
+    }
+  }
+
+  /**
+   * @brief creates a busy handheld style motion: every angle swings at a
+   * different frequency, the heading drifts, and the body shakes by a few
+   * centimetres.
+   * @return the trajectory.
+   */
+  static SinusoidalTrajectory handheld() {
+    const Sinusoid angles[3] = {{0.0, 0.0, 0.6, 0.31, 0.0},
+                                {0.0, 0.0, 0.4, 0.17, 1.0},
+                                {0.0, 0.05, 1.2, 0.07, 2.0}};
+    const Sinusoid position[3] = {{0.0, 0.0, 0.05, 0.9, 0.0},
+                                  {0.0, 0.0, 0.03, 1.3, 0.5},
+                                  {0.0, 0.0, 0.02, 2.1, 1.5}};
+    return SinusoidalTrajectory(angles, position);
+  }
+
+  /**
+   * @brief evaluates the trajectory.
+   * @param t the time in seconds.
+   * @param state the state to fill.
+   */
+  void evaluate(double t, TrajectoryState &state) {
+    double angles[3];
+    double rates[3];
+    double unused;
+    double position;
+    double velocity;
+    double acceleration[3];
+    for (int axis = 0; axis < 3; axis++) {
+      this->_angles[axis].evaluate(t, angles[axis], rates[axis], unused);
+      this->_position[axis].evaluate(t, position, velocity,
+                                     acceleration[axis]);
+    }
+    eulerState(angles, rates, acceleration, state);
+  }
+
+private:
+  Sinusoid _angles[3];
+  Sinusoid _position[3];
+}; // end SinusoidalTrajectory class
+
+/**
+ * @brief a trajectory keyframe.
+ */
+struct Keyframe {
+  double t;           // keyframe time in seconds
+  double angles[3];   // <roll, pitch, yaw> in rad, unwrapped
+  double position[3]; // <X, Y, Z> world position in m
+};
+
+/**
+ * @brief a trajectory through keyframes, interpolated per component with a
+ * Catmull-Rom cubic spline. The motion starts and ends at rest, and holds
+ * still before the first and after the last keyframe.
+ */
+class SplineTrajectory {
+public:
+  /**
+   * @brief constructor for SplineTrajectory class.
+   * @param keyframes the keyframes, in increasing time order. At least two
+   * are needed for any motion.
+   */
+  SplineTrajectory(const std::vector<Keyframe> &keyframes)
+      : _keyframes(keyframes) {
+    this->_segment = 0;
+  }
+
+  /**
+   * @brief evaluates the trajectory.
+   * @param t the time in seconds. Evaluating in increasing time order finds
+   * the segment in constant time.
+   * @param state the state to fill.
+   */
+  void evaluate(double t, TrajectoryState &state) {
+    double angles[3] = {0, 0, 0};
+    double rates[3] = {0, 0, 0};
+    double acceleration[3] = {0, 0, 0};
+    const size_t count = this->_keyframes.size();
+    if (count == 0) {
+      eulerState(angles, rates, acceleration, state);
+      return;
+    }
+    if (count == 1 || t <= this->_keyframes.front().t ||
+        t >= this->_keyframes.back().t) {
+      const Keyframe &held =
+          t <= this->_keyframes.front().t ? this->_keyframes.front()
+                                          : this->_keyframes.back();
+      eulerState(held.angles, rates, acceleration, state);
+      return;
+    }
+
+    this->seek(t);
+    const size_t i = this->_segment;
+    const Keyframe &k0 = this->_keyframes[i > 0 ? i - 1 : i];
+    const Keyframe &k1 = this->_keyframes[i];
+    const Keyframe &k2 = this->_keyframes[i + 1];
+    const Keyframe &k3 = this->_keyframes[i + 2 < count ? i + 2 : i + 1];
+    const double u = (t - k1.t) / (k2.t - k1.t);
+
+    double unused;
+    for (int axis = 0; axis < 3; axis++) {
+      interpolate(k0.angles[axis], k1.angles[axis], k2.angles[axis],
+                  k3.angles[axis], k0.t, k1.t, k2.t, k3.t, u, angles[axis],
+                  rates[axis], unused);
+      double position;
+      double velocity;
+      interpolate(k0.position[axis], k1.position[axis], k2.position[axis],
+                  k3.position[axis], k0.t, k1.t, k2.t, k3.t, u, position,
+                  velocity, acceleration[axis]);
+    }
+    eulerState(angles, rates, acceleration, state);
+  }
+
+private:
+  /**
+   * @brief moves the cached segment to the one holding t.
+   * @param t a time strictly inside the keyframe range.
+   */
+  void seek(double t) {
+    if (t < this->_keyframes[this->_segment].t) {
+      this->_segment = 0;
+    }
+    while (t >= this->_keyframes[this->_segment + 1].t) {
+      this->_segment++;
+    }
+  }
+
+  /**
+   * @brief evaluates a cubic Hermite segment from p1 to p2, with tangents
+   * taken from the neighbouring keyframes.
+   * @param u the normalized position in the segment, in [0, 1).
+   * @param value the interpolated value.
+   * @param rate the first time derivative.
+   * @param second the second time derivative.
+   */
+  static void interpolate(double p0, double p1, double p2, double p3,
+                          double t0, double t1, double t2, double t3,
+                          double u, double &value, double &rate,
+                          double &second) {
+    const double h = t2 - t1;
+    // tangents in value per second, zero at the first and last keyframes
+    double m1 = t1 > t0 ? (p2 - p0) / (t2 - t0) : 0.0;
+    double m2 = t3 > t2 ? (p3 - p1) / (t3 - t1) : 0.0;
+    m1 *= h;
+    m2 *= h;
+
+    const double u2 = u * u;
+    const double u3 = u2 * u;
+    value = (2 * u3 - 3 * u2 + 1) * p1 + (u3 - 2 * u2 + u) * m1 +
+            (-2 * u3 + 3 * u2) * p2 + (u3 - u2) * m2;
+    rate = ((6 * u2 - 6 * u) * p1 + (3 * u2 - 4 * u + 1) * m1 +
+            (-6 * u2 + 6 * u) * p2 + (3 * u2 - 2 * u) * m2) /
+           h;
+    second = ((12 * u - 6) * p1 + (6 * u - 4) * m1 + (-12 * u + 6) * p2 +
+              (6 * u - 2) * m2) /
+             (h * h);
+  }
+
+  std::vector<Keyframe> _keyframes;
+  size_t _segment;
+}; // end SplineTrajectory class
+} // namespace simulation
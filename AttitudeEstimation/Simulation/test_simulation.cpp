@@ -0,0 +1,219 @@
+#include "../Euler/Euler.hpp"
+#include "ImuNoise.hpp"
+#include "ImuSimulator.hpp"
+#include "Trajectory.hpp"
+#include "gtest/gtest.h"
+#include <vector>
+
+using namespace simulation;
+using namespace structures;
+
+/**
+ * @brief returns the angle between two attitudes.
+ */
+double attitudeError(const Quaternion<double> &a, const Quaternion<double> &b) {
+  double dot = a.getW() * b.getW() + a.getX() * b.getX() +
+               a.getY() * b.getY() + a.getZ() * b.getZ();
+  return 2 * acos(fmin(1.0, fabs(dot)));
+}
+
+/**
+ * @brief integrates the ideal gyroscope readings and checks they follow the
+ * ground truth attitude.
+ */
+template <typename TrajectoryT>
+void expectConsistentRates(const TrajectoryT &trajectory, double seconds) {
+  const double rate_hz = 1000.0;
+  ImuSimulator<TrajectoryT> simulator(trajectory, rate_hz);
+  SimulatedSample sample;
+  simulator.next(sample);
+  Quaternion<double> integrated = sample.ground_truth;
+  for (int i = 1; i < seconds * rate_hz; i++) {
+    // midpoint rule over the sample period
+    double previous[3] = {sample.ideal.gyro[0], sample.ideal.gyro[1],
+                          sample.ideal.gyro[2]};
+    simulator.next(sample);
+    double omega[3];
+    for (int axis = 0; axis < 3; axis++) {
+      omega[axis] = 0.5 * (previous[axis] + sample.ideal.gyro[axis]);
+    }
+    double rate = sqrt(omega[0] * omega[0] + omega[1] * omega[1] +
+                       omega[2] * omega[2]);
+    double half_angle = 0.5 * rate / rate_hz;
+    double scale = rate > 0 ? sin(half_angle) / rate : 0.0;
+    integrated = (integrated * Quaternion<double>(omega[0] * scale,
+                                                  omega[1] * scale,
+                                                  omega[2] * scale,
+                                                  cos(half_angle)))
+                     .norm();
+  }
+  EXPECT_LT(attitudeError(sample.ground_truth, integrated), 1e-4);
+}
+
+TEST(SimulationTesting, TestEulerState) {
+  const double angles[3] = {0.3, -0.2, 1.1};
+  const double rates[3] = {0, 0, 0};
+  const double acceleration[3] = {0, 0, 0};
+  TrajectoryState state;
+  eulerState(angles, rates, acceleration, state);
+
+  Quaternion<double> expected =
+      Euler<double>(angles[0], angles[1], angles[2], RADIANS).toQuaternion();
+  ASSERT_NEAR(0.0, attitudeError(expected, state.attitude), 1e-7);
+}
+
+TEST(SimulationTesting, TestTrajectoryKinematics) {
+  expectConsistentRates(SinusoidalTrajectory::handheld(), 20.0);
+
+  std::vector<Keyframe> keyframes = {
+      {0.0, {0.0, 0.0, 0.0}, {0, 0, 0}},
+      {1.0, {0.4, 0.1, 0.5}, {1, 0, 0}},
+      {2.5, {-0.2, 0.5, 1.5}, {1, 1, 0}},
+      {4.0, {0.1, -0.3, 3.0}, {0, 1, 1}},
+      {5.0, {0.0, 0.0, 3.5}, {0, 0, 0}}};
+  expectConsistentRates(SplineTrajectory(keyframes), 6.0);
+
+  // the spline passes through its keyframes and holds still past the ends
+  SplineTrajectory spline(keyframes);
+  TrajectoryState state;
+  spline.evaluate(2.5, state);
+  Quaternion<double> expected =
+      Euler<double>(-0.2, 0.5, 1.5, RADIANS).toQuaternion();
+  ASSERT_NEAR(0.0, attitudeError(expected, state.attitude), 1e-7);
+  spline.evaluate(7.0, state);
+  ASSERT_DOUBLE_EQ(0.0, state.body_rate[2]);
+  ASSERT_DOUBLE_EQ(0.0, state.acceleration[0]);
+}
+
+TEST(SimulationTesting, TestIdealReadings) {
+  // a still body reads gravity and the earth field, whatever its attitude
+  const Sinusoid angles[3] = {{0.3, 0, 0, 0, 0}, {-0.5, 0, 0, 0, 0},
+                              {2.0, 0, 0, 0, 0}};
+  const Sinusoid position[3] = {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0},
+                                {0, 0, 0, 0, 0}};
+  ImuSimulator<SinusoidalTrajectory> simulator(
+      SinusoidalTrajectory(angles, position), 100.0);
+  SimulatedSample sample;
+  simulator.next(sample);
+  simulator.next(sample);
+
+  const double *acc = sample.ideal.acc;
+  const double *mag = sample.ideal.mag;
+  ASSERT_NEAR(EARTH_G_MSS, sqrt(acc[0] * acc[0] + acc[1] * acc[1] +
+                                acc[2] * acc[2]),
+              1e-9);
+  ASSERT_NEAR(sqrt(20000.0 * 20000.0 + 45000.0 * 45000.0),
+              sqrt(mag[0] * mag[0] + mag[1] * mag[1] + mag[2] * mag[2]),
+              1e-6);
+  ASSERT_NEAR(0.0, sample.ideal.gyro[0], 1e-12);
+  ASSERT_EQ(10000U, sample.raw.timestamp_us);
+
+  // without noise the measured readings are the ideal ones, and the raw
+  // readings calibrate back to them within one LSB
+  filters::SensorSample<double> calibrated;
+  filters::SensorCalibration<double>::nominal().apply(sample.raw, calibrated);
+  for (int axis = 0; axis < 3; axis++) {
+    ASSERT_EQ(sample.ideal.acc[axis], sample.measured.acc[axis]);
+    ASSERT_NEAR(sample.ideal.acc[axis], calibrated.acc[axis],
+                EARTH_G_MSS / ACCEL_SENSITIVITY);
+    ASSERT_NEAR(sample.ideal.mag[axis], calibrated.mag[axis],
+                UT_TO_NT_SCALE / MAG_SENSITIVITY);
+  }
+}
+
+TEST(SimulationTesting, TestDeterminism) {
+  const NoiseModel noise = NoiseModel::consumerMems();
+  ImuSimulator<SinusoidalTrajectory> first(SinusoidalTrajectory::handheld(),
+                                           200.0, noise, 42);
+  ImuSimulator<SinusoidalTrajectory> second(SinusoidalTrajectory::handheld(),
+                                            200.0, noise, 42);
+  ImuSimulator<SinusoidalTrajectory> other(SinusoidalTrajectory::handheld(),
+                                           200.0, noise, 43);
+  std::vector<SimulatedSample> a(5000);
+  std::vector<SimulatedSample> b(5000);
+  std::vector<SimulatedSample> c(5000);
+  first.generate(a.data(), a.size());
+  second.generate(b.data(), b.size());
+  other.generate(c.data(), c.size());
+  ASSERT_EQ(0, memcmp(&a[4999].measured, &b[4999].measured,
+                      sizeof(a[4999].measured)));
+  ASSERT_NE(a[4999].measured.gyro[0], c[4999].measured.gyro[0]);
+  ASSERT_EQ(a[4999].ideal.gyro[0], c[4999].ideal.gyro[0]);
+
+  // a reset simulator replays the same samples
+  first.reset();
+  SimulatedSample replayed;
+  first.next(replayed);
+  ASSERT_EQ(0, memcmp(&a[0].measured, &replayed.measured,
+                      sizeof(replayed.measured)));
+  for (int axis = 0; axis < 3; axis++) {
+    ASSERT_EQ(a[0].raw.gyro[axis], replayed.raw.gyro[axis]);
+    ASSERT_EQ(a[0].raw.mag[axis], replayed.raw.mag[axis]);
+  }
+}
+
+TEST(SimulationTesting, TestHandheldReadings) {
+  // the shared benchmark input is simulated once, from the seed it names
+  const std::vector<filters::SensorSample<double>> &readings =
+      handheldReadings();
+  ASSERT_EQ(&readings, &handheldReadings());
+  ASSERT_EQ(4096U, readings.size());
+
+  ImuSimulator<SinusoidalTrajectory> simulator(
+      SinusoidalTrajectory::handheld(), 100.0, NoiseModel::consumerMems(), 1);
+  std::vector<SimulatedSample> expected(readings.size());
+  simulator.generate(expected.data(), expected.size());
+  ASSERT_EQ(0, memcmp(&expected.back().measured, &readings.back(),
+                      sizeof(readings.back())));
+  ASSERT_EQ(10000U, readings[1].timestamp_us - readings[0].timestamp_us);
+}
+
+TEST(SimulationTesting, TestNoiseStatistics) {
+  const double rate_hz = 100.0;
+  const int count = 200000;
+  NoiseModel noise = NoiseModel::ideal();
+  noise.gyro.white = 0.01;
+  noise.disturbance.rate_hz = 0.1;
+  noise.disturbance.duration_s = 1.0;
+  noise.disturbance.magnitude = 5000.0;
+  const Sinusoid still[3] = {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0},
+                             {0, 0, 0, 0, 0}};
+  ImuSimulator<SinusoidalTrajectory> simulator(
+      SinusoidalTrajectory(still, still), rate_hz, noise, 7);
+
+  double sum = 0;
+  double sum_squares = 0;
+  int disturbed = 0;
+  SimulatedSample sample;
+  for (int i = 0; i < count; i++) {
+    simulator.next(sample);
+    sum += sample.measured.gyro[1];
+    sum_squares += sample.measured.gyro[1] * sample.measured.gyro[1];
+    disturbed += simulator.isDisturbed();
+  }
+  double mean = sum / count;
+  double sigma = sqrt(sum_squares / count - mean * mean);
+  ASSERT_NEAR(0.01 * sqrt(rate_hz), sigma, 0.002);
+  ASSERT_NEAR(0.0, mean, 0.001);
+
+  // disturbed for roughly rate * duration of the time
+  ASSERT_NEAR(0.1, (double)disturbed / count, 0.03);
+
+  // the Gauss-Markov bias wanders with its configured spread
+  noise = NoiseModel::ideal();
+  noise.gyro.bias_instability = 0.002;
+  noise.gyro.correlation_time_s = 1.0;
+  ImuSimulator<SinusoidalTrajectory> drifting(
+      SinusoidalTrajectory(still, still), rate_hz, noise, 9);
+  sum_squares = 0;
+  for (int i = 0; i < count; i++) {
+    drifting.next(sample);
+    sum_squares += drifting.getGyroBias(2) * drifting.getGyroBias(2);
+  }
+  ASSERT_NEAR(0.002, sqrt(sum_squares / count), 0.0003);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "../Quaternion/Quaternion.hpp"
+#include "../SensorDriver/Records.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace telemetry {
+
+/**
+ * @brief finds a numeric member of a flat JSON object.
+ * @param object the object text, from its opening brace.
+ * @param object_end one past the closing brace.
+ * @param key the member name, quoted, such as "\"w\"".
+ * @param value the value to fill.
+ * @return true if the member was found and holds a number, false otherwise.
+ */
+inline bool parseJsonMember(const char *object, const char *object_end,
+                            const char *key, double &value) {
+  size_t key_len = strlen(key);
+  for (const char *at = object; at + key_len <= object_end; at++) {
+    if (memcmp(at, key, key_len) != 0) {
+      continue;
+    }
+    const char *cursor = at + key_len;
+    while (cursor < object_end && (*cursor == ' ' || *cursor == ':')) {
+      cursor++;
+    }
+    char *number_end;
+    value = strtod(cursor, &number_end);
+    return number_end != cursor && number_end <= object_end;
+  }
+  return false;
+}
+
+/**
+ * @brief parses the quaternion object following a key.
+ * @param line the NUL terminated line.
+ * @param key the quoted key of the object.
+ * @param quat the quaternion to fill.
+ * @return true if the object was found and holds w, x, y and z, false
+ * otherwise.
+ */
+inline bool parseJsonQuaternion(const char *line, const char *key,
+                                structures::Quaternion<double> &quat) {
+  const char *at = strstr(line, key);
+  const char *object = at != NULL ? strchr(at, '{') : NULL;
+  const char *object_end = object != NULL ? strchr(object, '}') : NULL;
+  if (object_end == NULL) {
+    return false;
+  }
+  double w, x, y, z;
+  if (!parseJsonMember(object, object_end, "\"w\"", w) ||
+      !parseJsonMember(object, object_end, "\"x\"", x) ||
+      !parseJsonMember(object, object_end, "\"y\"", y) ||
+      !parseJsonMember(object, object_end, "\"z\"", z)) {
+    return false;
+  }
+  quat = structures::Quaternion<double>(x, y, z, w);
+  return true;
+}
+
+/**
+ * @brief parses one line produced by filters::JsonEstimateFormatter.
+ * @param line the NUL terminated line.
+ * @param record the record to fill with the ground truth and estimate. The
+ * sequence number and timestamp are left untouched, since the JSON messages
+ * do not carry them.
+ * @return true if the line holds both quaternions, false otherwise.
+ */
+inline bool parseJsonEstimate(const char *line,
+                              filters::EstimateRecord &record) {
+  return parseJsonQuaternion(line, "\"ground_truth_quat\"",
+                             record.ground_truth) &&
+         parseJsonQuaternion(line, "\"estimated_quat\"", record.estimate);
+}
+
+/**
+ * @brief a streaming decoder for the line oriented JSON estimate messages,
+ * the text counterpart of TelemetryDecoder. Bytes can be fed in arbitrary
+ * chunks into a fixed line buffer. Lines that start with a brace but do not
+ * parse, and lines too long for the buffer, are counted as parse errors;
+ * other lines, such as diagnostic reports, are counted as text and skipped.
+ * Since the messages carry no sequence number, valid records are numbered
+ * in arrival order, and their timestamp is left at zero.
+ */
+class JsonEstimateDecoder {
+public:
+  /**
+   * @brief the longest line kept, including its newline.
+   */
+  static const size_t kMaxLineLength = 512;
+
+  /**
+   * @brief default constructor for JsonEstimateDecoder class.
+   */
+  JsonEstimateDecoder() { this->reset(); }
+
+  /**
+   * @brief clears all decoder state and statistics.
+   */
+  void reset() {
+    this->_line_len = 0;
+    this->_overflowed = false;
+    this->_frame_count = 0;
+    this->_parse_error_count = 0;
+    this->_text_line_count = 0;
+  }
+
+  /**
+   * @brief feeds received bytes through the decoder.
+   * @param data the received bytes.
+   * @param len the number of received bytes.
+   * @param handler a callable invoked as handler(const EstimateRecord &) for
+   * every valid line.
+   * @return the number of valid lines decoded from these bytes.
+   */
+  template <typename HandlerT>
+  size_t feed(const uint8_t *data, size_t len, HandlerT &&handler) {
+    size_t decoded = 0;
+    for (size_t i = 0; i < len; i++) {
+      if (data[i] != '\n') {
+        if (this->_line_len < kMaxLineLength) {
+          this->_line[this->_line_len++] = (char)data[i];
+        } else {
+          this->_overflowed = true;
+        }
+        continue;
+      }
+
+      if (this->decodeLine()) {
+        handler(this->_record);
+        decoded++;
+      }
+      this->_line_len = 0;
+      this->_overflowed = false;
+    }
+    return decoded;
+  }
+
+  /**
+   * @brief returns the number of valid lines decoded.
+   * @return the number of valid lines decoded.
+   */
+  uint64_t getFrameCount() const { return this->_frame_count; }
+
+  /**
+   * @brief returns the number of JSON lines that did not parse or did not
+   * fit the line buffer.
+   * @return the number of rejected lines.
+   */
+  uint64_t getParseErrorCount() const { return this->_parse_error_count; }
+
+  /**
+   * @brief returns the number of skipped lines that are not JSON.
+   * @return the number of text lines.
+   */
+  uint64_t getTextLineCount() const { return this->_text_line_count; }
+
+private:
+  bool decodeLine() {
+    size_t start = 0;
+    while (start < this->_line_len &&
+           (this->_line[start] == ' ' || this->_line[start] == '\r')) {
+      start++;
+    }
+    if (start == this->_line_len && !this->_overflowed) {
+      return false; // blank lines are not an error
+    }
+    if (this->_line[start] != '{') {
+      this->_text_line_count++;
+      return false;
+    }
+
+    this->_line[this->_line_len] = '\0';
+    if (this->_overflowed ||
+        !parseJsonEstimate(this->_line + start, this->_record)) {
+      this->_parse_error_count++;
+      return false;
+    }
+    this->_record.sequence = (uint32_t)this->_frame_count;
+    this->_record.timestamp_us = 0;
+    this->_frame_count++;
+    return true;
+  }
+
+  char _line[kMaxLineLength + 1];
+  size_t _line_len;
+  bool _overflowed;
+  filters::EstimateRecord _record;
+  uint64_t _frame_count;
+  uint64_t _parse_error_count;
+  uint64_t _text_line_count;
+}; // end JsonEstimateDecoder class
+} // namespace telemetry
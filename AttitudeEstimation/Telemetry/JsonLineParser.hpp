@@ -0,0 +1,439 @@
+#pragma once
+
+#include "../Quaternion/Quaternion.hpp"
+#include <charconv>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <system_error>
+
+// define JSON_LINE_PARSER_SCALAR to use the portable delimiter scan even
+// when the compiler targets SSE2 or AVX2
+#if !defined(JSON_LINE_PARSER_SCALAR) && defined(__AVX2__)
+#define JSON_SCAN_AVX2 1
+#else
+#define JSON_SCAN_AVX2 0
+#endif
+#if !defined(JSON_LINE_PARSER_SCALAR) && defined(__SSE2__)
+#define JSON_SCAN_SSE2 1
+#else
+#define JSON_SCAN_SSE2 0
+#endif
+
+#if JSON_SCAN_AVX2 || JSON_SCAN_SSE2
+#include <immintrin.h>
+#endif
+
+namespace telemetry {
+
+/**
+ * @brief portable delimiter scan, eight bytes per block.
+ */
+struct ScalarScanOps {
+  static const size_t kBlockWidth = 8;
+  static const char *name() { return "scalar"; }
+
+  /**
+   * @brief compares a block of bytes against one character.
+   * @param block pointer to kBlockWidth bytes.
+   * @param c the character to find.
+   * @return a mask with bit i set if block[i] equals c.
+   */
+  static uint32_t match(const char *block, char c) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kBlockWidth; i++) {
+      mask |= (uint32_t)(block[i] == c) << i;
+    }
+    return mask;
+  }
+}; // end ScalarScanOps struct
+
+#if JSON_SCAN_SSE2
+/**
+ * @brief SSE2 delimiter scan, sixteen bytes per block.
+ */
+struct Sse2ScanOps {
+  static const size_t kBlockWidth = 16;
+  static const char *name() { return "sse2"; }
+
+  static uint32_t match(const char *block, char c) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)block);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(c)));
+  }
+}; // end Sse2ScanOps struct
+#endif
+
+#if JSON_SCAN_AVX2
+/**
+ * @brief AVX2 delimiter scan, thirty two bytes per block.
+ */
+struct Avx2ScanOps {
+  static const size_t kBlockWidth = 32;
+  static const char *name() { return "avx2"; }
+
+  static uint32_t match(const char *block, char c) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)block);
+    return (uint32_t)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(c)));
+  }
+}; // end Avx2ScanOps struct
+#endif
+
+/**
+ * @brief the widest delimiter scan the target supports.
+ */
+#if JSON_SCAN_AVX2
+typedef Avx2ScanOps JsonScanOps;
+#elif JSON_SCAN_SSE2
+typedef Sse2ScanOps JsonScanOps;
+#else
+typedef ScalarScanOps JsonScanOps;
+#endif
+
+/**
+ * @brief finds the first occurrence of a character, a block at a time.
+ * @param begin the first byte to search.
+ * @param end one past the last byte to search.
+ * @param c the character to find.
+ * @return a pointer to the character, or end if it does not occur.
+ */
+template <typename OpsT>
+inline const char *findByte(const char *begin, const char *end, char c) {
+  const char *at = begin;
+  for (; end - at >= (ptrdiff_t)OpsT::kBlockWidth; at += OpsT::kBlockWidth) {
+    uint32_t mask = OpsT::match(at, c);
+    if (mask != 0) {
+      return at + __builtin_ctz(mask);
+    }
+  }
+  for (; at < end; at++) {
+    if (*at == c) {
+      return at;
+    }
+  }
+  return end;
+}
+
+/**
+ * @brief finds the occurrences of a character, a block at a time.
+ * @param begin the first byte to search.
+ * @param end one past the last byte to search.
+ * @param c the character to find.
+ * @param found array of max_found pointers to fill, in order.
+ * @param max_found the size of found.
+ * @return the number of occurrences, or max_found + 1 if there are more
+ * than fit in found.
+ */
+template <typename OpsT>
+inline size_t findAll(const char *begin, const char *end, char c,
+                      const char **found, size_t max_found) {
+  size_t count = 0;
+  const char *at = begin;
+  for (; end - at >= (ptrdiff_t)OpsT::kBlockWidth; at += OpsT::kBlockWidth) {
+    for (uint32_t mask = OpsT::match(at, c); mask != 0; mask &= mask - 1) {
+      if (count == max_found) {
+        return max_found + 1;
+      }
+      found[count++] = at + __builtin_ctz(mask);
+    }
+  }
+  for (; at < end; at++) {
+    if (*at == c) {
+      if (count == max_found) {
+        return max_found + 1;
+      }
+      found[count++] = at;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief checks that a key ends right before a colon.
+ * @param begin the start of the line.
+ * @param colon the colon following the key.
+ * @param key the quoted key.
+ * @return true if the key precedes the colon, false otherwise.
+ */
+template <size_t KeyLengthT>
+inline bool hasJsonKey(const char *begin, const char *colon,
+                       const char (&key)[KeyLengthT]) {
+  size_t key_len = KeyLengthT - 1;
+  return (size_t)(colon - begin) >= key_len &&
+         memcmp(colon - key_len, key, key_len) == 0;
+}
+
+/**
+ * @brief parses the number following a single letter key.
+ * @param begin the start of the line.
+ * @param end one past the end of the line.
+ * @param colon the colon following the key.
+ * @param key the letter of the key.
+ * @param terminator the character expected after the number.
+ * @param value the value to fill.
+ * @return a pointer past the terminator, or NULL if the member does not
+ * have the expected shape.
+ */
+inline const char *parseJsonComponent(const char *begin, const char *end,
+                                      const char *colon, char key,
+                                      char terminator, double &value) {
+  if (colon - begin < 3 || colon[-3] != '"' || colon[-2] != key ||
+      colon[-1] != '"') {
+    return NULL;
+  }
+  const char *cursor = colon + 1;
+  while (cursor < end && *cursor == ' ') {
+    cursor++;
+  }
+  std::from_chars_result result = std::from_chars(cursor, end, value);
+  if (result.ec != std::errc()) {
+    return NULL;
+  }
+  cursor = result.ptr;
+  while (cursor < end && *cursor == ' ') {
+    cursor++;
+  }
+  return cursor < end && *cursor == terminator ? cursor + 1 : NULL;
+}
+
+/**
+ * @brief parses one line in the fixed layout of
+ * filters::JsonEstimateFormatter: a ground_truth_quat object and an
+ * estimated_quat object, each with w, x, y and z in that order. The colons
+ * are located with a block scan, so a line with a missing or extra member
+ * is rejected before any number is converted. Spaces between tokens are
+ * allowed, keys and their order are not flexible.
+ * @param begin the first byte of the line, its opening brace.
+ * @param end one past the last byte of the line, without the newline.
+ * @param ground_truth the W, X, Y and Z components are written to
+ * ground_truth[0], ground_truth[stride], ground_truth[2 * stride] and
+ * ground_truth[3 * stride].
+ * @param estimate the estimate components, in the same layout.
+ * @param stride the distance between components.
+ * @return true if the line holds both quaternions, false otherwise. The
+ * outputs may be partially written when false is returned.
+ */
+template <typename OpsT = JsonScanOps>
+inline bool parseJsonEstimateLine(const char *begin, const char *end,
+                                  double *ground_truth, double *estimate,
+                                  size_t stride) {
+  static const size_t kColonCount = 10;
+  static const char kComponents[4] = {'w', 'x', 'y', 'z'};
+  const char *colons[kColonCount];
+  if (findAll<OpsT>(begin, end, ':', colons, kColonCount) != kColonCount ||
+      !hasJsonKey(begin, colons[0], "\"ground_truth_quat\"") ||
+      !hasJsonKey(begin, colons[5], "\"estimated_quat\"")) {
+    return false;
+  }
+
+  const char *cursor = NULL;
+  for (size_t i = 0; i < 4; i++) {
+    cursor = parseJsonComponent(begin, end, colons[1 + i], kComponents[i],
+                                i < 3 ? ',' : '}', ground_truth[i * stride]);
+    if (cursor == NULL) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < 4; i++) {
+    cursor = parseJsonComponent(begin, end, colons[6 + i], kComponents[i],
+                                i < 3 ? ',' : '}', estimate[i * stride]);
+    if (cursor == NULL) {
+      return false;
+    }
+  }
+
+  // the closing brace of the line, so truncated lines are rejected
+  while (cursor < end && *cursor == ' ') {
+    cursor++;
+  }
+  if (cursor == end || *cursor != '}') {
+    return false;
+  }
+  for (cursor++; cursor < end; cursor++) {
+    if (*cursor != ' ' && *cursor != '\r') {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief a fixed capacity batch of parsed estimates, stored as structure
+ * of arrays: one row per quaternion component, in W, X, Y, Z order.
+ */
+template <size_t CapacityT> struct EstimateBatch {
+  static const size_t kCapacity = CapacityT;
+
+  /**
+   * @brief default constructor for EstimateBatch struct. The batch starts
+   * empty.
+   */
+  EstimateBatch() : count(0) {}
+
+  /**
+   * @brief returns whether the batch has no room left.
+   * @return true if the batch holds kCapacity estimates.
+   */
+  bool full() const { return this->count == CapacityT; }
+
+  /**
+   * @brief empties the batch.
+   */
+  void clear() { this->count = 0; }
+
+  /**
+   * @brief returns a ground truth quaternion of the batch.
+   * @param index the position in the batch.
+   * @return the ground truth quaternion.
+   */
+  structures::Quaternion<double> getGroundTruth(size_t index) const {
+    return structures::Quaternion<double>(
+        this->ground_truth[1][index], this->ground_truth[2][index],
+        this->ground_truth[3][index], this->ground_truth[0][index]);
+  }
+
+  /**
+   * @brief returns an estimated quaternion of the batch.
+   * @param index the position in the batch.
+   * @return the estimated quaternion.
+   */
+  structures::Quaternion<double> getEstimate(size_t index) const {
+    return structures::Quaternion<double>(
+        this->estimate[1][index], this->estimate[2][index],
+        this->estimate[3][index], this->estimate[0][index]);
+  }
+
+  double ground_truth[4][CapacityT];
+  double estimate[4][CapacityT];
+  size_t count;
+}; // end EstimateBatch struct
+
+/**
+ * @brief a streaming parser for the JSON estimate lines, built for bulk
+ * captures. Newlines are found with a block scan and complete lines are
+ * parsed where they lie in the caller's buffer, straight into the batch
+ * rows; only a line split across two calls is copied, into a fixed carry
+ * buffer, so parsing never allocates. As in JsonEstimateDecoder, lines that
+ * start with a brace but do not parse, including lines truncated or
+ * garbled by serial noise and lines too long for the carry buffer, are
+ * counted as parse errors, and other lines are counted as text and
+ * skipped.
+ */
+template <typename OpsT = JsonScanOps> class JsonLineParser {
+public:
+  /**
+   * @brief the longest line kept across calls, without its newline.
+   */
+  static const size_t kMaxLineLength = 512;
+
+  /**
+   * @brief default constructor for JsonLineParser class.
+   */
+  JsonLineParser() { this->reset(); }
+
+  /**
+   * @brief clears the carried line and all statistics.
+   */
+  void reset() {
+    this->_carry_len = 0;
+    this->_overflowed = false;
+    this->_line_count = 0;
+    this->_parse_error_count = 0;
+    this->_text_line_count = 0;
+  }
+
+  /**
+   * @brief parses received bytes into a batch, stopping early once the
+   * batch is full. A trailing partial line is kept for the next call.
+   * @param data the received bytes.
+   * @param len the number of received bytes.
+   * @param batch the batch to append the parsed estimates to.
+   * @return the number of bytes consumed. Fewer than len only when the
+   * batch filled up; pass the rest again once it has been emptied.
+   */
+  template <size_t CapacityT>
+  size_t parse(const char *data, size_t len, EstimateBatch<CapacityT> &batch) {
+    const char *at = data;
+    const char *end = data + len;
+    while (at < end && !batch.full()) {
+      const char *newline = findByte<OpsT>(at, end, '\n');
+      if (newline == end) {
+        this->carry(at, end);
+        return len;
+      }
+      if (this->_carry_len > 0 || this->_overflowed) {
+        this->carry(at, newline);
+        this->parseLine(this->_carry, this->_carry + this->_carry_len, batch);
+        this->_carry_len = 0;
+        this->_overflowed = false;
+      } else {
+        this->parseLine(at, newline, batch);
+      }
+      at = newline + 1;
+    }
+    return at - data;
+  }
+
+  /**
+   * @brief returns the number of valid lines parsed.
+   * @return the number of valid lines.
+   */
+  uint64_t getLineCount() const { return this->_line_count; }
+
+  /**
+   * @brief returns the number of JSON lines that did not parse or did not
+   * fit the carry buffer.
+   * @return the number of rejected lines.
+   */
+  uint64_t getParseErrorCount() const { return this->_parse_error_count; }
+
+  /**
+   * @brief returns the number of skipped lines that are not JSON.
+   * @return the number of text lines.
+   */
+  uint64_t getTextLineCount() const { return this->_text_line_count; }
+
+private:
+  void carry(const char *begin, const char *end) {
+    size_t len = end - begin;
+    if (this->_carry_len + len > kMaxLineLength) {
+      this->_overflowed = true;
+      return;
+    }
+    memcpy(this->_carry + this->_carry_len, begin, len);
+    this->_carry_len += len;
+  }
+
+  template <size_t CapacityT>
+  void parseLine(const char *begin, const char *end,
+                 EstimateBatch<CapacityT> &batch) {
+    while (begin < end && (*begin == ' ' || *begin == '\r')) {
+      begin++;
+    }
+    if (begin == end && !this->_overflowed) {
+      return; // blank lines are not an error
+    }
+    if (begin < end && *begin != '{') {
+      this->_text_line_count++;
+      return;
+    }
+
+    size_t index = batch.count;
+    if (this->_overflowed ||
+        !parseJsonEstimateLine<OpsT>(begin, end, &batch.ground_truth[0][index],
+                                     &batch.estimate[0][index], CapacityT)) {
+      this->_parse_error_count++;
+      return;
+    }
+    batch.count++;
+    this->_line_count++;
+  }
+
+  char _carry[kMaxLineLength];
+  size_t _carry_len;
+  bool _overflowed;
+  uint64_t _line_count;
+  uint64_t _parse_error_count;
+  uint64_t _text_line_count;
+}; // end JsonLineParser class
+} // namespace telemetry
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "TelemetryProtocol.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace telemetry {
+
+/**
+ * @brief a streaming decoder for the COBS framed binary estimate protocol.
+ * Bytes can be fed in arbitrary chunks; corrupted or truncated frames are
+ * counted and skipped, and decoding resynchronizes on the next delimiter.
+ * The 16 bit sequence number and 32 bit timestamp are unwrapped back to
+ * their full width.
+ */
+class TelemetryDecoder {
+public:
+  /**
+   * @brief default constructor for TelemetryDecoder class.
+   */
+  TelemetryDecoder() { this->reset(); }
+
+  /**
+   * @brief clears all decoder state and statistics.
+   */
+  void reset() {
+    this->_encoded_len = 0;
+    this->_overflowed = false;
+    this->_has_frame = false;
+    this->_last_sequence = 0;
+    this->_last_timestamp_us = 0;
+    this->_frame_count = 0;
+    this->_crc_error_count = 0;
+    this->_framing_error_count = 0;
+    this->_missing_frame_count = 0;
+  }
+
+  /**
+   * @brief feeds received bytes through the decoder.
+   * @param data the received bytes.
+   * @param len the number of received bytes.
+   * @param handler a callable invoked as handler(const EstimateRecord &) for
+   * every valid frame.
+   * @return the number of valid frames decoded from these bytes.
+   */
+  template <typename HandlerT>
+  size_t feed(const uint8_t *data, size_t len, HandlerT &&handler) {
+    size_t decoded = 0;
+    for (size_t i = 0; i < len; i++) {
+      if (data[i] != 0) {
+        if (this->_encoded_len < kMaxEncodedLength) {
+          this->_encoded[this->_encoded_len++] = data[i];
+        } else {
+          this->_overflowed = true;
+        }
+        continue;
+      }
+
+      // delimiter reached, decode the collected frame
+      if (this->decodeFrame()) {
+        handler(this->_record);
+        decoded++;
+      }
+      this->_encoded_len = 0;
+      this->_overflowed = false;
+    }
+    return decoded;
+  }
+
+  /**
+   * @brief returns the number of valid frames decoded.
+   * @return the number of valid frames decoded.
+   */
+  uint64_t getFrameCount() const { return this->_frame_count; }
+
+  /**
+   * @brief returns the number of frames rejected by the CRC check.
+   * @return the number of frames rejected by the CRC check.
+   */
+  uint64_t getCrcErrorCount() const { return this->_crc_error_count; }
+
+  /**
+   * @brief returns the number of frames with invalid framing or length.
+   * @return the number of frames with invalid framing or length.
+   */
+  uint64_t getFramingErrorCount() const { return this->_framing_error_count; }
+
+  /**
+   * @brief returns the number of frames missing according to the sequence
+   * numbers of the valid frames.
+   * @return the number of missing frames.
+   */
+  uint64_t getMissingFrameCount() const { return this->_missing_frame_count; }
+
+private:
+  static const size_t kMaxEncodedLength = kEstimateFrameLength + 1;
+
+  /**
+   * @brief decodes the collected frame into _record.
+   * @return true if the frame was valid, false otherwise.
+   */
+  bool decodeFrame() {
+    // back to back delimiters are not an error
+    if (this->_encoded_len == 0) {
+      return false;
+    }
+
+    uint8_t frame[kMaxEncodedLength];
+    size_t frame_len =
+        this->_overflowed ? 0
+                          : cobsDecode(this->_encoded, this->_encoded_len, frame);
+    if (frame_len != kEstimateFrameLength || frame[0] != kEstimateFrameType) {
+      this->_framing_error_count++;
+      return false;
+    }
+
+    if (crc16(frame, kEstimatePayloadLength) !=
+        getU16(frame + kEstimatePayloadLength)) {
+      this->_crc_error_count++;
+      return false;
+    }
+
+    // unwrap the truncated sequence number and timestamp
+    uint16_t sequence_low = getU16(frame + 1);
+    uint32_t timestamp_low = getU32(frame + 3);
+    uint32_t sequence = sequence_low;
+    uint64_t timestamp_us = timestamp_low;
+    if (this->_has_frame) {
+      uint16_t sequence_delta =
+          (uint16_t)(sequence_low - (uint16_t)this->_last_sequence);
+      sequence = this->_last_sequence + sequence_delta;
+      timestamp_us = this->_last_timestamp_us +
+                     (uint32_t)(timestamp_low -
+                                (uint32_t)this->_last_timestamp_us);
+      if (sequence_delta > 1) {
+        this->_missing_frame_count += sequence_delta - 1;
+      }
+    }
+    this->_last_sequence = sequence;
+    this->_last_timestamp_us = timestamp_us;
+    this->_has_frame = true;
+
+    int16_t ground_truth[3];
+    int16_t estimate[3];
+    for (int i = 0; i < 3; i++) {
+      ground_truth[i] = (int16_t)getU16(frame + 8 + 2 * i);
+      estimate[i] = (int16_t)getU16(frame + 14 + 2 * i);
+    }
+
+    this->_record.sequence = sequence;
+    this->_record.timestamp_us = timestamp_us;
+    this->_record.ground_truth =
+        smallestThreeDecode(frame[7] & 0x03, ground_truth);
+    this->_record.estimate =
+        smallestThreeDecode((frame[7] >> 2) & 0x03, estimate);
+    this->_frame_count++;
+    return true;
+  }
+
+  uint8_t _encoded[kMaxEncodedLength];
+  size_t _encoded_len;
+  bool _overflowed;
+  bool _has_frame;
+  uint32_t _last_sequence;
+  uint64_t _last_timestamp_us;
+  filters::EstimateRecord _record;
+  uint64_t _frame_count;
+  uint64_t _crc_error_count;
+  uint64_t _framing_error_count;
+  uint64_t _missing_frame_count;
+}; // end TelemetryDecoder class
+} // namespace telemetry
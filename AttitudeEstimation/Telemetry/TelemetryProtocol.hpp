@@ -0,0 +1,291 @@
+#pragma once
+
+#include "../Quaternion/Quaternion.hpp"
+#include "../SensorDriver/Records.hpp"
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace telemetry {
+
+/**
+ * @brief the binary estimate frame layout, before COBS framing. All
+ * multi-byte fields are little endian.
+ *
+ *   offset size field
+ *        0    1 frame type (kEstimateFrameType)
+ *        1    2 sequence number, low 16 bits
+ *        3    4 timestamp in microseconds, low 32 bits
+ *        7    1 largest component index, ground truth (bits 0-1) and
+ *               estimate (bits 2-3)
+ *        8    6 ground truth quaternion, smallest three int16 values
+ *       14    6 estimated quaternion, smallest three int16 values
+ *       20    2 CRC-16/CCITT-FALSE over bytes 0-19
+ *
+ * On the wire each frame is COBS encoded and terminated by a zero byte.
+ */
+static const uint8_t kEstimateFrameType = 0x01;
+static const size_t kEstimatePayloadLength = 20;
+static const size_t kEstimateFrameLength = kEstimatePayloadLength + 2;
+
+/**
+ * @brief returns the worst case COBS encoded length of a buffer.
+ * @param len the unencoded length.
+ * @return the worst case encoded length, excluding the delimiter.
+ */
+inline size_t cobsMaxEncodedLength(size_t len) { return len + len / 254 + 1; }
+
+/**
+ * @brief computes the CRC-16/CCITT-FALSE of a buffer.
+ * @param data the buffer.
+ * @param len the buffer length.
+ * @return the computed CRC.
+ */
+inline uint16_t crc16(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021)
+                           : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+/**
+ * @brief COBS encodes a buffer. The output contains no zero bytes.
+ * @param input the buffer to encode.
+ * @param len the input length.
+ * @param output the output buffer, at least cobsMaxEncodedLength(len) long.
+ * @return the encoded length.
+ */
+inline size_t cobsEncode(const uint8_t *input, size_t len, uint8_t *output) {
+  size_t code_index = 0;
+  size_t out_index = 1;
+  uint8_t code = 1;
+
+  for (size_t i = 0; i < len; i++) {
+    if (input[i] == 0) {
+      output[code_index] = code;
+      code_index = out_index++;
+      code = 1;
+    } else {
+      output[out_index++] = input[i];
+      code++;
+      if (code == 0xFF) {
+        output[code_index] = code;
+        code_index = out_index++;
+        code = 1;
+      }
+    }
+  }
+
+  output[code_index] = code;
+  return out_index;
+}
+
+/**
+ * @brief decodes a COBS encoded buffer (without its delimiter).
+ * @param input the encoded buffer.
+ * @param len the encoded length.
+ * @param output the output buffer, at least len bytes long.
+ * @return the decoded length, or zero if the input is malformed.
+ */
+inline size_t cobsDecode(const uint8_t *input, size_t len, uint8_t *output) {
+  size_t in_index = 0;
+  size_t out_index = 0;
+
+  while (in_index < len) {
+    uint8_t code = input[in_index++];
+    if (code == 0 || in_index + code - 1 > len) {
+      return 0;
+    }
+
+    for (uint8_t i = 1; i < code; i++) {
+      output[out_index++] = input[in_index++];
+    }
+
+    if (code != 0xFF && in_index < len) {
+      output[out_index++] = 0;
+    }
+  }
+  return out_index;
+}
+
+/**
+ * @brief encodes a unit quaternion with the smallest three method: the
+ * largest magnitude component is dropped (the quaternion is negated so it is
+ * positive) and the other three are quantized to int16.
+ * @param quat the quaternion to encode.
+ * @param values the three quantized components, in w, x, y, z order with the
+ * largest skipped.
+ * @return the index (0 = w, 3 = z) of the dropped component.
+ */
+inline uint8_t smallestThreeEncode(const structures::Quaternion<double> &quat,
+                                   int16_t values[3]) {
+  double components[4] = {quat.getW(), quat.getX(), quat.getY(),
+                          quat.getZ()};
+
+  uint8_t largest = 0;
+  for (uint8_t i = 1; i < 4; i++) {
+    if (fabs(components[i]) > fabs(components[largest])) {
+      largest = i;
+    }
+  }
+
+  // the remaining components lie in [-1/sqrt(2), 1/sqrt(2)]
+  double sign = components[largest] < 0 ? -1.0 : 1.0;
+  double scale = 32767.0 * M_SQRT2 * sign;
+  uint8_t out = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (i == largest) {
+      continue;
+    }
+
+    double scaled = components[i] * scale;
+    if (scaled > 32767.0) {
+      scaled = 32767.0;
+    } else if (scaled < -32767.0) {
+      scaled = -32767.0;
+    }
+    values[out++] = (int16_t)lround(scaled);
+  }
+  return largest;
+}
+
+/**
+ * @brief decodes a smallest three quaternion.
+ * @param largest the index of the dropped component.
+ * @param values the three quantized components.
+ * @return the decoded unit quaternion.
+ */
+inline structures::Quaternion<double>
+smallestThreeDecode(uint8_t largest, const int16_t values[3]) {
+  double components[4];
+  double sum_squares = 0;
+  uint8_t in = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (i == (largest & 0x03)) {
+      continue;
+    }
+
+    components[i] = values[in++] / (32767.0 * M_SQRT2);
+    sum_squares += components[i] * components[i];
+  }
+
+  double remainder = 1.0 - sum_squares;
+  components[largest & 0x03] = remainder > 0 ? sqrt(remainder) : 0.0;
+  return structures::Quaternion<double>(components[1], components[2],
+                                        components[3], components[0]);
+}
+
+/**
+ * @brief writes a little endian 16 bit value.
+ */
+inline void putU16(uint8_t *buffer, uint16_t value) {
+  buffer[0] = (uint8_t)(value & 0xFF);
+  buffer[1] = (uint8_t)(value >> 8);
+}
+
+/**
+ * @brief writes a little endian 32 bit value.
+ */
+inline void putU32(uint8_t *buffer, uint32_t value) {
+  putU16(buffer, (uint16_t)(value & 0xFFFF));
+  putU16(buffer + 2, (uint16_t)(value >> 16));
+}
+
+/**
+ * @brief reads a little endian 16 bit value.
+ */
+inline uint16_t getU16(const uint8_t *buffer) {
+  return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+/**
+ * @brief reads a little endian 32 bit value.
+ */
+inline uint32_t getU32(const uint8_t *buffer) {
+  return (uint32_t)getU16(buffer) | ((uint32_t)getU16(buffer + 2) << 16);
+}
+
+/**
+ * @brief builds the unframed binary estimate frame for a record.
+ * @param record the record to encode.
+ * @param frame the output buffer, kEstimateFrameLength bytes long.
+ */
+inline void encodeEstimateFrame(const filters::EstimateRecord &record,
+                                uint8_t frame[kEstimateFrameLength]) {
+  int16_t ground_truth[3];
+  int16_t estimate[3];
+  uint8_t gt_largest = smallestThreeEncode(record.ground_truth, ground_truth);
+  uint8_t est_largest = smallestThreeEncode(record.estimate, estimate);
+
+  frame[0] = kEstimateFrameType;
+  putU16(frame + 1, (uint16_t)(record.sequence & 0xFFFF));
+  putU32(frame + 3, (uint32_t)(record.timestamp_us & 0xFFFFFFFF));
+  frame[7] = (uint8_t)(gt_largest | (est_largest << 2));
+  for (int i = 0; i < 3; i++) {
+    putU16(frame + 8 + 2 * i, (uint16_t)ground_truth[i]);
+    putU16(frame + 14 + 2 * i, (uint16_t)estimate[i]);
+  }
+  putU16(frame + kEstimatePayloadLength,
+         crc16(frame, kEstimatePayloadLength));
+}
+
+/**
+ * @brief formats estimate records as COBS framed binary messages. A drop-in
+ * alternative to filters::JsonEstimateFormatter for the output stage.
+ */
+class BinaryEstimateFormatter {
+public:
+  /**
+   * @brief the largest message this formatter can produce, including the
+   * frame delimiter.
+   */
+  static const size_t kMaxMessageLength = kEstimateFrameLength + 2;
+
+  /**
+   * @brief formats a single estimate record.
+   * @param record the record to format.
+   * @param buffer the buffer to write the message into.
+   * @param buffer_len the size of buffer in bytes.
+   * @return the message length in bytes, or zero if it did not fit.
+   */
+  size_t format(const filters::EstimateRecord &record, uint8_t *buffer,
+                size_t buffer_len) const {
+    if (buffer_len < kMaxMessageLength) {
+      return 0;
+    }
+
+    uint8_t frame[kEstimateFrameLength];
+    encodeEstimateFrame(record, frame);
+    size_t encoded_len = cobsEncode(frame, kEstimateFrameLength, buffer);
+    buffer[encoded_len] = 0;
+    return encoded_len + 1;
+  }
+
+  /**
+   * @brief formats a line of text, such as a diagnostic report, for the
+   * same stream as the estimate frames. The text is sent as is followed by
+   * a frame delimiter, so a decoder discards it as a single invalid frame
+   * and stays in sync for the next estimate frame.
+   * @param text the text, without zero bytes.
+   * @param text_len the text length in bytes.
+   * @param buffer the buffer to write the message into.
+   * @param buffer_len the size of buffer in bytes.
+   * @return the message length in bytes, or zero if it did not fit.
+   */
+  size_t formatText(const uint8_t *text, size_t text_len, uint8_t *buffer,
+                    size_t buffer_len) const {
+    if (text_len + 1 > buffer_len) {
+      return 0;
+    }
+    memcpy(buffer, text, text_len);
+    buffer[text_len] = 0;
+    return text_len + 1;
+  }
+}; // end BinaryEstimateFormatter class
+} // namespace telemetry
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "../RingBuffer/RingBuffer.hpp"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace telemetry {
+
+/**
+ * @brief what a TransmitQueue does with a new frame when every transmit
+ * buffer is still waiting to be sent.
+ */
+typedef enum {
+  TRANSMIT_DROP_NEWEST, // discard the new frame and count it as dropped
+  TRANSMIT_COALESCE     // hold the new frame aside, replacing any older held
+                        // frame, and queue it as soon as a buffer frees up
+} transmit_policy_t;
+
+/**
+ * @brief a ring of transmit buffers between a producer that formats whole
+ * frames and a consumer that drains them to a non-blocking transport. The
+ * producer never waits on the link: when all buffers are in flight the new
+ * frame is dropped or coalesced according to the transmit policy. Frames
+ * are only ever sent whole, so a dropped or coalesced frame never corrupts
+ * the byte stream. Exactly one thread may call write() and flushPending(),
+ * and exactly one thread may call drain().
+ * @tparam slot_count the number of transmit buffers. Must be a power of two.
+ * @tparam slot_size the size of each transmit buffer in bytes.
+ */
+template <size_t slot_count, size_t slot_size> class TransmitQueue {
+  static_assert(slot_count > 0 && (slot_count & (slot_count - 1)) == 0,
+                "TransmitQueue slot_count must be a power of two");
+
+public:
+  /**
+   * @brief constructor for TransmitQueue class.
+   * @param policy the policy to apply when all transmit buffers are full.
+   */
+  TransmitQueue(transmit_policy_t policy = TRANSMIT_DROP_NEWEST)
+      : _policy(policy), _head(0), _tail(0), _dropped(0), _coalesced(0),
+        _high_water_mark(0), _frames_sent(0), _bytes_sent(0) {
+    this->_has_pending = false;
+    this->_pending.len = 0;
+    this->_send_offset = 0;
+  }
+
+  TransmitQueue(const TransmitQueue &other) = delete;
+  TransmitQueue &operator=(const TransmitQueue &other) = delete;
+
+  /**
+   * @brief queues one frame for transmission without blocking. Must only be
+   * called from the producer.
+   * @param data the frame bytes.
+   * @param len the frame length in bytes.
+   * @return true if the frame was queued or held for coalescing, false if
+   * it was dropped.
+   */
+  bool write(const uint8_t *data, size_t len) {
+    if (len == 0 || len > slot_size) {
+      this->_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    // a held frame is older than this one, so it goes out first
+    this->flushPending();
+
+    if (this->pushSlot(data, len)) {
+      return true;
+    }
+
+    if (this->_policy == TRANSMIT_DROP_NEWEST) {
+      this->_dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    // only the newest frame is worth sending once the link catches up
+    if (this->_has_pending) {
+      this->_coalesced.fetch_add(1, std::memory_order_relaxed);
+    }
+    memcpy(this->_pending.data, data, len);
+    this->_pending.len = len;
+    this->_has_pending = true;
+    return true;
+  }
+
+  /**
+   * @brief moves a frame held by the coalesce policy into a free transmit
+   * buffer. Must only be called from the producer.
+   * @return true if no frame is held any more, false otherwise.
+   */
+  bool flushPending() {
+    if (!this->_has_pending) {
+      return true;
+    }
+    if (!this->pushSlot(this->_pending.data, this->_pending.len)) {
+      return false;
+    }
+    this->_has_pending = false;
+    return true;
+  }
+
+  /**
+   * @brief writes queued frames to a transport until the queue is empty or
+   * the transport stops accepting bytes. Partially written frames are
+   * resumed on the next call. Must only be called from the consumer.
+   * @tparam TransportT the transport type. Must provide
+   * size_t write(const uint8_t *, size_t) returning the number of bytes
+   * accepted without blocking.
+   * @param transport the transport to write to.
+   * @return the number of bytes written.
+   */
+  template <typename TransportT> size_t drain(TransportT &transport) {
+    size_t written = 0;
+    size_t tail = this->_tail.load(std::memory_order_relaxed);
+    while (tail != this->_head.load(std::memory_order_acquire)) {
+      const Slot &slot = this->_slots[tail & (slot_count - 1)];
+      size_t remaining = slot.len - this->_send_offset;
+      size_t accepted =
+          transport.write(slot.data + this->_send_offset, remaining);
+      written += accepted;
+      this->_send_offset += accepted;
+      if (accepted < remaining) {
+        break;
+      }
+
+      this->_send_offset = 0;
+      this->_tail.store(++tail, std::memory_order_release);
+      this->_frames_sent.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    this->_bytes_sent.fetch_add(written, std::memory_order_relaxed);
+    return written;
+  }
+
+  /**
+   * @brief returns the number of transmit buffers waiting to be sent.
+   * @return the number of transmit buffers waiting to be sent.
+   */
+  size_t size() const {
+    return this->_head.load(std::memory_order_acquire) -
+           this->_tail.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief returns the number of frames dropped, either by the drop policy
+   * or because they did not fit in a transmit buffer.
+   * @return the number of dropped frames.
+   */
+  uint32_t getDroppedCount() const {
+    return this->_dropped.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief returns the number of held frames replaced by a newer frame under
+   * the coalesce policy.
+   * @return the number of coalesced frames.
+   */
+  uint32_t getCoalescedCount() const {
+    return this->_coalesced.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief returns the largest number of transmit buffers ever waiting to
+   * be sent at once.
+   * @return the transmit buffer high-water mark.
+   */
+  uint32_t getHighWaterMark() const {
+    return this->_high_water_mark.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief returns the number of frames fully written to the transport.
+   * @return the number of frames sent.
+   */
+  uint32_t getFramesSent() const {
+    return this->_frames_sent.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief returns the number of bytes written to the transport.
+   * @return the number of bytes sent.
+   */
+  uint64_t getBytesSent() const {
+    return this->_bytes_sent.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief returns the transmit policy of this queue.
+   * @return the transmit policy of this queue.
+   */
+  transmit_policy_t getPolicy() const { return this->_policy; }
+
+private:
+  struct Slot {
+    size_t len;
+    uint8_t data[slot_size];
+  };
+
+  /**
+   * @brief copies a frame into the next free transmit buffer.
+   * @param data the frame bytes.
+   * @param len the frame length in bytes.
+   * @return false if every transmit buffer was in use, true otherwise.
+   */
+  bool pushSlot(const uint8_t *data, size_t len) {
+    const size_t head = this->_head.load(std::memory_order_relaxed);
+    const size_t used = head - this->_tail.load(std::memory_order_acquire);
+    if (used >= slot_count) {
+      return false;
+    }
+
+    Slot &slot = this->_slots[head & (slot_count - 1)];
+    memcpy(slot.data, data, len);
+    slot.len = len;
+    this->_head.store(head + 1, std::memory_order_release);
+
+    if (used + 1 > this->_high_water_mark.load(std::memory_order_relaxed)) {
+      this->_high_water_mark.store((uint32_t)(used + 1),
+                                   std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  transmit_policy_t _policy;
+  Slot _slots[slot_count];
+  Slot _pending;
+  bool _has_pending;
+  size_t _send_offset;
+  alignas(RING_BUFFER_INDEX_ALIGNMENT) std::atomic<size_t> _head;
+  alignas(RING_BUFFER_INDEX_ALIGNMENT) std::atomic<size_t> _tail;
+  std::atomic<uint32_t> _dropped;
+  std::atomic<uint32_t> _coalesced;
+  std::atomic<uint32_t> _high_water_mark;
+  std::atomic<uint32_t> _frames_sent;
+  std::atomic<uint64_t> _bytes_sent;
+}; // end TransmitQueue class
+} // namespace telemetry
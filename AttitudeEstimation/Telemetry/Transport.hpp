@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(ARDUINO)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace telemetry {
+
+/**
+ * @brief a non-blocking transport over an Arduino style serial port. Only
+ * as many bytes as fit in the UART transmit buffer are handed over, so a
+ * write never stalls the caller.
+ * @tparam SerialT the serial port type. Must provide availableForWrite() and
+ * write(const uint8_t *, size_t).
+ */
+template <typename SerialT> class SerialTransport {
+public:
+  /**
+   * @brief constructor for SerialTransport class.
+   * @param serial the serial port to write to.
+   */
+  SerialTransport(SerialT &serial) : _serial(serial) {}
+
+  /**
+   * @brief writes as many bytes as the port can accept right now.
+   * @param data the bytes to write.
+   * @param len the number of bytes to write.
+   * @return the number of bytes accepted.
+   */
+  size_t write(const uint8_t *data, size_t len) {
+    int available = this->_serial.availableForWrite();
+    if (available <= 0) {
+      return 0;
+    }
+    if ((size_t)available < len) {
+      len = (size_t)available;
+    }
+    return this->_serial.write(data, len);
+  }
+
+private:
+  SerialT &_serial;
+}; // end SerialTransport class
+
+/**
+ * @brief a transport that accepts and discards every byte, for measuring
+ * the pipeline without any output cost.
+ */
+class NullTransport {
+public:
+  /**
+   * @brief accepts and discards the provided bytes.
+   * @param data the bytes to write.
+   * @param len the number of bytes to write.
+   * @return the number of bytes accepted, always len.
+   */
+  size_t write(const uint8_t *data, size_t len) {
+    (void)data;
+    return len;
+  }
+}; // end NullTransport class
+
+#if !defined(ARDUINO)
+/**
+ * @brief a non-blocking transport over a POSIX file descriptor, such as the
+ * master side of a pty, a pipe or a regular file. Used to exercise the
+ * transmit path on a host.
+ */
+class FdTransport {
+public:
+  /**
+   * @brief constructor for FdTransport class. The descriptor is switched to
+   * non-blocking mode but is not owned.
+   * @param fd the file descriptor to write to.
+   */
+  FdTransport(int fd) : _fd(fd), _error_count(0) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) {
+      fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+  }
+
+  /**
+   * @brief writes as many bytes as the descriptor can accept right now.
+   * @param data the bytes to write.
+   * @param len the number of bytes to write.
+   * @return the number of bytes accepted.
+   */
+  size_t write(const uint8_t *data, size_t len) {
+    ssize_t written = ::write(this->_fd, data, len);
+    if (written < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        this->_error_count++;
+      }
+      return 0;
+    }
+    return (size_t)written;
+  }
+
+  /**
+   * @brief returns the number of failed writes, not counting writes that
+   * would have blocked.
+   * @return the number of failed writes.
+   */
+  uint32_t getErrorCount() const { return this->_error_count; }
+
+private:
+  int _fd;
+  uint32_t _error_count;
+}; // end FdTransport class
+#endif
+} // namespace telemetry
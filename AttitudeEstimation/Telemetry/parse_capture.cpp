@@ -0,0 +1,118 @@
+#include "../ImuLog/MappedFile.hpp"
+#include "JsonEstimateDecoder.hpp"
+#include "JsonLineParser.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+
+using namespace telemetry;
+
+/**
+ * @brief the command line options of the capture parser.
+ */
+struct ParseCaptureOptions {
+  const char *capture = NULL; // JSON lines captured from a device
+  unsigned repeat = 1;        // passes over the capture
+  bool baseline = false;      // also time JsonEstimateDecoder
+};
+
+static void printUsage(const char *name) {
+  fprintf(stderr,
+          "usage: %s <capture> [--repeat <n>] [--baseline]\n"
+          "  parses a capture of JSON estimate lines and reports lines/s\n"
+          "  --repeat <n>   parse the capture n times (default 1)\n"
+          "  --baseline     also time the strtod based JsonEstimateDecoder\n",
+          name);
+}
+
+static bool parseOptions(int argc, char **argv,
+                         ParseCaptureOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--repeat") == 0 && i + 1 < argc) {
+      options.repeat = (unsigned)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "--baseline") == 0) {
+      options.baseline = true;
+    } else if (arg[0] != '-' && options.capture == NULL) {
+      options.capture = arg;
+    } else {
+      return false;
+    }
+  }
+  return options.capture != NULL && options.repeat > 0;
+}
+
+static double monotonicS() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void printRate(const char *name, uint64_t lines, uint64_t errors,
+                      uint64_t text, size_t bytes, double seconds) {
+  printf("%-22s %10llu lines %6llu errors %6llu text %8.3f s "
+         "%12.0f lines/s %8.1f MB/s\n",
+         name, (unsigned long long)lines, (unsigned long long)errors,
+         (unsigned long long)text, seconds, lines / seconds,
+         bytes / seconds / 1e6);
+}
+
+int main(int argc, char **argv) {
+  ParseCaptureOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  imulog::MappedFile file;
+  const char *error = file.open(options.capture);
+  if (error != NULL) {
+    fprintf(stderr, "%s: %s\n", options.capture, error);
+    return 1;
+  }
+  file.advise(0, file.size(), MADV_SEQUENTIAL);
+  const char *data = (const char *)file.data();
+  size_t bytes = file.size() * options.repeat;
+
+  // the batch is consumed by summing it, standing in for a real consumer
+  static EstimateBatch<1024> batch;
+  JsonLineParser<> parser;
+  double checksum = 0;
+  double start_s = monotonicS();
+  for (unsigned pass = 0; pass < options.repeat; pass++) {
+    for (size_t offset = 0; offset < file.size();) {
+      offset += parser.parse(data + offset, file.size() - offset, batch);
+      for (size_t i = 0; i < batch.count; i++) {
+        checksum += batch.estimate[0][i];
+      }
+      batch.clear();
+    }
+  }
+  std::string name = std::string("JsonLineParser/") + JsonScanOps::name();
+  printRate(name.c_str(), parser.getLineCount(), parser.getParseErrorCount(),
+            parser.getTextLineCount(), bytes, monotonicS() - start_s);
+
+  if (options.baseline) {
+    JsonEstimateDecoder decoder;
+    double baseline_checksum = 0;
+    start_s = monotonicS();
+    for (unsigned pass = 0; pass < options.repeat; pass++) {
+      decoder.feed(file.data(), file.size(),
+                   [&baseline_checksum](const filters::EstimateRecord &r) {
+                     baseline_checksum += r.estimate.getW();
+                   });
+    }
+    printRate("JsonEstimateDecoder", decoder.getFrameCount(),
+              decoder.getParseErrorCount(), decoder.getTextLineCount(), bytes,
+              monotonicS() - start_s);
+
+    // both parsers round correctly, so the sums match exactly
+    if (baseline_checksum != checksum) {
+      fprintf(stderr, "the parsers disagree\n");
+      return 1;
+    }
+  }
+  return 0;
+}
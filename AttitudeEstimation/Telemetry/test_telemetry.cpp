@@ -0,0 +1,399 @@
+#include "../SensorDriver/EstimateFormat.hpp"
+#include "JsonEstimateDecoder.hpp"
+#include "JsonLineParser.hpp"
+#include "TelemetryDecoder.hpp"
+#include "TelemetryProtocol.hpp"
+#include "TransmitQueue.hpp"
+#include "Transport.hpp"
+#include "gtest/gtest.h"
+#include <stdlib.h>
+#include <string>
+#include <termios.h>
+#include <vector>
+
+using namespace telemetry;
+using namespace filters;
+
+/**
+ * @brief builds an estimate record with a pair of normalized quaternions.
+ */
+EstimateRecord makeRecord(uint32_t sequence, uint64_t timestamp_us) {
+  EstimateRecord record;
+  record.sequence = sequence;
+  record.timestamp_us = timestamp_us;
+  record.ground_truth =
+      structures::Quaternion<double>(0.1, -0.2, 0.3 + 0.001 * sequence, 0.9)
+          .norm();
+  record.estimate =
+      structures::Quaternion<double>(-0.7, 0.1, 0.05, -0.6).norm();
+  return record;
+}
+
+TEST(TelemetryTesting, TestCrc) {
+  // standard check value for CRC-16/CCITT-FALSE
+  const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  ASSERT_EQ(0x29B1, crc16(check, sizeof(check)));
+}
+
+TEST(TelemetryTesting, TestCobsRoundTrip) {
+  // zeros at the start, middle and end, and a run longer than 254 bytes
+  std::vector<uint8_t> input = {0, 1, 2, 0, 0, 3};
+  for (int i = 0; i < 300; i++) {
+    input.push_back((uint8_t)(i % 255 + 1));
+  }
+  input.push_back(0);
+
+  std::vector<uint8_t> encoded(cobsMaxEncodedLength(input.size()));
+  size_t encoded_len = cobsEncode(input.data(), input.size(), encoded.data());
+  ASSERT_LE(encoded_len, encoded.size());
+  for (size_t i = 0; i < encoded_len; i++) {
+    ASSERT_NE(0, encoded[i]);
+  }
+
+  std::vector<uint8_t> decoded(encoded_len);
+  size_t decoded_len = cobsDecode(encoded.data(), encoded_len, decoded.data());
+  ASSERT_EQ(input.size(), decoded_len);
+  for (size_t i = 0; i < input.size(); i++) {
+    ASSERT_EQ(input[i], decoded[i]);
+  }
+}
+
+TEST(TelemetryTesting, TestSmallestThree) {
+  structures::Quaternion<double> quats[] = {
+      structures::Quaternion<double>(),
+      structures::Quaternion<double>(0.5, 0.5, 0.5, 0.5),
+      structures::Quaternion<double>(0.1, -0.9, 0.2, -0.3).norm(),
+      structures::Quaternion<double>(0.0, 0.0, -1.0, 0.0)};
+
+  for (const structures::Quaternion<double> &quat : quats) {
+    int16_t values[3];
+    uint8_t largest = smallestThreeEncode(quat, values);
+    structures::Quaternion<double> decoded =
+        smallestThreeDecode(largest, values);
+
+    // q and -q are the same rotation, so compare |<q, q'>|
+    double dot = quat.getW() * decoded.getW() + quat.getX() * decoded.getX() +
+                 quat.getY() * decoded.getY() + quat.getZ() * decoded.getZ();
+    EXPECT_NEAR(1.0, fabs(dot), 1e-8);
+    EXPECT_NEAR(fabs(quat.getX()), fabs(decoded.getX()), 5e-5);
+    EXPECT_NEAR(fabs(quat.getZ()), fabs(decoded.getZ()), 5e-5);
+  }
+}
+
+TEST(TelemetryTesting, TestFormatAndDecode) {
+  BinaryEstimateFormatter formatter;
+  TelemetryDecoder decoder;
+  std::vector<uint8_t> stream;
+
+  // sequence and timestamp both wrap their on-wire width
+  const uint32_t first_sequence = 65530;
+  const uint64_t first_timestamp = 0xFFFFF000ULL;
+  for (uint32_t i = 0; i < 20; i++) {
+    uint8_t message[BinaryEstimateFormatter::kMaxMessageLength];
+    size_t len = formatter.format(
+        makeRecord(first_sequence + i, first_timestamp + 1000U * i), message,
+        sizeof(message));
+    ASSERT_GT(len, 0U);
+    ASSERT_EQ(0, message[len - 1]);
+    stream.insert(stream.end(), message, message + len);
+  }
+
+  std::vector<EstimateRecord> records;
+  decoder.feed(stream.data(), stream.size(),
+               [&records](const EstimateRecord &record) {
+                 records.push_back(record);
+               });
+
+  ASSERT_EQ(20U, records.size());
+  for (uint32_t i = 0; i < 20; i++) {
+    EstimateRecord expected = makeRecord(first_sequence + i,
+                                         first_timestamp + 1000U * i);
+    ASSERT_EQ(expected.sequence, records[i].sequence);
+    ASSERT_EQ(expected.timestamp_us, records[i].timestamp_us);
+    EXPECT_NEAR(expected.ground_truth.getZ(), records[i].ground_truth.getZ(),
+                5e-5);
+    EXPECT_NEAR(fabs(expected.estimate.getW()),
+                fabs(records[i].estimate.getW()), 5e-5);
+  }
+  ASSERT_EQ(0U, decoder.getCrcErrorCount());
+  ASSERT_EQ(0U, decoder.getMissingFrameCount());
+}
+
+TEST(TelemetryTesting, TestDecoderRejectsCorruption) {
+  BinaryEstimateFormatter formatter;
+  TelemetryDecoder decoder;
+  std::vector<uint8_t> stream;
+  for (uint32_t i = 0; i < 4; i++) {
+    uint8_t message[BinaryEstimateFormatter::kMaxMessageLength];
+    size_t len = formatter.format(makeRecord(i, 1000U * i), message,
+                                  sizeof(message));
+    // corrupt one payload byte of the second frame, truncate the third
+    if (i == 1) {
+      message[10] ^= 0x40;
+    }
+    if (i == 2) {
+      message[len - 5] = 0;
+    }
+    stream.insert(stream.end(), message, message + len);
+  }
+
+  // feed one byte at a time to exercise resynchronization
+  size_t decoded = 0;
+  for (size_t i = 0; i < stream.size(); i++) {
+    decoded += decoder.feed(&stream[i], 1, [](const EstimateRecord &) {});
+  }
+
+  ASSERT_EQ(2U, decoded);
+  ASSERT_EQ(1U, decoder.getCrcErrorCount());
+  ASSERT_EQ(2U, decoder.getFramingErrorCount());
+  ASSERT_EQ(2U, decoder.getMissingFrameCount());
+}
+
+/**
+ * @brief a transport that accepts a limited number of bytes per write, to
+ * stand in for a slow serial link.
+ */
+struct LimitedTransport {
+  size_t budget;
+  std::vector<uint8_t> received;
+
+  size_t write(const uint8_t *data, size_t len) {
+    size_t accepted = len < budget ? len : budget;
+    received.insert(received.end(), data, data + accepted);
+    budget -= accepted;
+    return accepted;
+  }
+};
+
+TEST(TelemetryTesting, TestJsonDecoder) {
+  JsonEstimateFormatter formatter;
+  std::vector<uint8_t> stream;
+  for (uint32_t i = 0; i < 3; i++) {
+    uint8_t message[JsonEstimateFormatter::kMaxMessageLength];
+    size_t len = formatter.format(makeRecord(i, 0), message, sizeof(message));
+    stream.insert(stream.end(), message, message + len);
+  }
+
+  // a diagnostic report, a truncated message, a blank line and a line too
+  // long for the decoder, then a valid message
+  const char noise[] = "stage timing: 12 us\n{\"ground_truth_quat\": {\"w\""
+                       "\n\n";
+  stream.insert(stream.end(), noise, noise + sizeof(noise) - 1);
+  stream.insert(stream.end(), 1000, '{');
+  stream.push_back('\n');
+  uint8_t message[JsonEstimateFormatter::kMaxMessageLength];
+  size_t len = formatter.format(makeRecord(7, 0), message, sizeof(message));
+  stream.insert(stream.end(), message, message + len);
+
+  // feed the stream in uneven chunks
+  JsonEstimateDecoder decoder;
+  std::vector<EstimateRecord> received;
+  for (size_t offset = 0; offset < stream.size(); offset += 37) {
+    size_t chunk = std::min<size_t>(37, stream.size() - offset);
+    decoder.feed(stream.data() + offset, chunk,
+                 [&received](const EstimateRecord &r) {
+                   received.push_back(r);
+                 });
+  }
+
+  ASSERT_EQ(4U, received.size());
+  ASSERT_EQ(4U, decoder.getFrameCount());
+  ASSERT_EQ(2U, decoder.getParseErrorCount());
+  ASSERT_EQ(1U, decoder.getTextLineCount());
+  for (uint32_t i = 0; i < 4; i++) {
+    EstimateRecord expected = makeRecord(i == 3 ? 7 : i, 0);
+    ASSERT_EQ(i, received[i].sequence);
+    ASSERT_EQ(0U, received[i].timestamp_us);
+
+    // the messages carry six decimals
+    ASSERT_NEAR(expected.ground_truth.getW(), received[i].ground_truth.getW(),
+                1e-6);
+    ASSERT_NEAR(expected.ground_truth.getZ(), received[i].ground_truth.getZ(),
+                1e-6);
+    ASSERT_NEAR(expected.estimate.getX(), received[i].estimate.getX(), 1e-6);
+    ASSERT_NEAR(expected.estimate.getY(), received[i].estimate.getY(), 1e-6);
+  }
+}
+
+/**
+ * @brief parses a noisy capture in chunks of several sizes and checks it
+ * against JsonEstimateDecoder.
+ */
+template <typename OpsT> void checkJsonLineParser() {
+  JsonEstimateFormatter formatter;
+  std::string capture;
+  for (uint32_t i = 0; i < 40; i++) {
+    uint8_t message[JsonEstimateFormatter::kMaxMessageLength];
+    size_t len = formatter.format(makeRecord(i, 0), message, sizeof(message));
+    capture.append((const char *)message, len);
+    if (i == 10) {
+      // a message cut short by a reset, then serial noise
+      capture.append((const char *)message, len / 2);
+      capture.append("\x01{:\xff\":}\r\n");
+    } else if (i == 20) {
+      // a diagnostic report, a blank line and a line too long to carry
+      capture.append("stage timing: 12 us\n\r\n");
+      capture.append(1000, '{');
+      capture.append("\n");
+    } else if (i == 30) {
+      // a message with a missing member and one with a garbled number
+      capture.append("{\"ground_truth_quat\": {\"w\": 1, \"x\": 0, \"y\": 0},"
+                     "\"estimated_quat\": {\"w\": 1,\"x\": 0,\"y\": 0,"
+                     "\"z\": 0}}\n");
+      std::string garbled((const char *)message, len);
+      garbled[garbled.find("\"y\": ") + 5] = 'q';
+      capture.append(garbled);
+    }
+  }
+
+  JsonEstimateDecoder decoder;
+  std::vector<EstimateRecord> expected;
+  decoder.feed((const uint8_t *)capture.data(), capture.size(),
+               [&expected](const EstimateRecord &r) { expected.push_back(r); });
+  ASSERT_EQ(40U, expected.size());
+
+  const size_t chunks[] = {1, 7, 37, 4096};
+  for (size_t chunk : chunks) {
+    JsonLineParser<OpsT> parser;
+    EstimateBatch<8> batch;
+    std::vector<EstimateRecord> received;
+    for (size_t offset = 0; offset < capture.size();) {
+      size_t len = std::min(chunk, capture.size() - offset);
+      offset += parser.parse(capture.data() + offset, len, batch);
+      if (batch.full() || offset == capture.size()) {
+        for (size_t i = 0; i < batch.count; i++) {
+          EstimateRecord record = EstimateRecord();
+          record.ground_truth = batch.getGroundTruth(i);
+          record.estimate = batch.getEstimate(i);
+          received.push_back(record);
+        }
+        batch.clear();
+      }
+    }
+
+    ASSERT_EQ(expected.size(), received.size()) << OpsT::name() << chunk;
+    ASSERT_EQ(40U, parser.getLineCount());
+    ASSERT_EQ(4U, parser.getParseErrorCount());
+    ASSERT_EQ(1U, parser.getTextLineCount());
+    for (size_t i = 0; i < expected.size(); i++) {
+      // both parsers round correctly, so the values match exactly
+      ASSERT_EQ(expected[i].ground_truth.getW(),
+                received[i].ground_truth.getW());
+      ASSERT_EQ(expected[i].ground_truth.getX(),
+                received[i].ground_truth.getX());
+      ASSERT_EQ(expected[i].ground_truth.getY(),
+                received[i].ground_truth.getY());
+      ASSERT_EQ(expected[i].ground_truth.getZ(),
+                received[i].ground_truth.getZ());
+      ASSERT_EQ(expected[i].estimate.getW(), received[i].estimate.getW());
+      ASSERT_EQ(expected[i].estimate.getX(), received[i].estimate.getX());
+      ASSERT_EQ(expected[i].estimate.getY(), received[i].estimate.getY());
+      ASSERT_EQ(expected[i].estimate.getZ(), received[i].estimate.getZ());
+    }
+  }
+}
+
+TEST(TelemetryTesting, TestJsonLineParser) {
+  checkJsonLineParser<ScalarScanOps>();
+  checkJsonLineParser<JsonScanOps>();
+}
+
+TEST(TelemetryTesting, TestTransmitQueueDropNewest) {
+  TransmitQueue<2, 8> queue(TRANSMIT_DROP_NEWEST);
+  const uint8_t frames[4][3] = {
+      {1, 1, 0}, {2, 2, 0}, {3, 3, 0}, {4, 4, 0}};
+  ASSERT_TRUE(queue.write(frames[0], 3));
+  ASSERT_TRUE(queue.write(frames[1], 3));
+  ASSERT_FALSE(queue.write(frames[2], 3));
+
+  // oversized frames are never split
+  uint8_t oversized[9] = {0};
+  ASSERT_FALSE(queue.write(oversized, sizeof(oversized)));
+  ASSERT_EQ(2U, queue.getDroppedCount());
+  ASSERT_EQ(2U, queue.getHighWaterMark());
+
+  // the first frame is written partially, then resumed
+  LimitedTransport transport = {4, {}};
+  ASSERT_EQ(4U, queue.drain(transport));
+  ASSERT_EQ(1U, queue.getFramesSent());
+  ASSERT_TRUE(queue.write(frames[3], 3));
+  transport.budget = 100;
+  ASSERT_EQ(5U, queue.drain(transport));
+
+  std::vector<uint8_t> expected = {1, 1, 0, 2, 2, 0, 4, 4, 0};
+  ASSERT_EQ(expected, transport.received);
+  ASSERT_EQ(3U, queue.getFramesSent());
+  ASSERT_EQ(9U, queue.getBytesSent());
+  ASSERT_EQ(0U, queue.size());
+}
+
+TEST(TelemetryTesting, TestTransmitQueueCoalesce) {
+  TransmitQueue<2, 8> queue(TRANSMIT_COALESCE);
+  for (uint8_t i = 1; i <= 5; i++) {
+    const uint8_t frame[2] = {i, 0};
+    ASSERT_TRUE(queue.write(frame, sizeof(frame)));
+  }
+
+  // frames 3 and 4 were replaced by frame 5 while the link was full
+  ASSERT_EQ(2U, queue.getCoalescedCount());
+  ASSERT_EQ(0U, queue.getDroppedCount());
+  ASSERT_FALSE(queue.flushPending());
+
+  LimitedTransport transport = {2, {}};
+  queue.drain(transport);
+  ASSERT_TRUE(queue.flushPending());
+  transport.budget = 100;
+  queue.drain(transport);
+
+  std::vector<uint8_t> expected = {1, 0, 2, 0, 5, 0};
+  ASSERT_EQ(expected, transport.received);
+}
+
+TEST(TelemetryTesting, TestTransmitOverPty) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  ASSERT_GE(master, 0);
+  ASSERT_EQ(0, grantpt(master));
+  ASSERT_EQ(0, unlockpt(master));
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  ASSERT_GE(slave, 0);
+
+  // pass the frame bytes through untouched
+  struct termios attributes;
+  ASSERT_EQ(0, tcgetattr(slave, &attributes));
+  cfmakeraw(&attributes);
+  ASSERT_EQ(0, tcsetattr(slave, TCSANOW, &attributes));
+
+  BinaryEstimateFormatter formatter;
+  TransmitQueue<4, BinaryEstimateFormatter::kMaxMessageLength> queue;
+  FdTransport transport(master);
+  for (uint32_t i = 0; i < 3; i++) {
+    uint8_t message[BinaryEstimateFormatter::kMaxMessageLength];
+    size_t len = formatter.format(makeRecord(i, 1000U * i), message,
+                                  sizeof(message));
+    ASSERT_TRUE(queue.write(message, len));
+  }
+  ASSERT_EQ(3 * BinaryEstimateFormatter::kMaxMessageLength,
+            queue.drain(transport));
+
+  TelemetryDecoder decoder;
+  std::vector<EstimateRecord> received;
+  uint8_t buffer[256];
+  while (received.size() < 3) {
+    ssize_t len = read(slave, buffer, sizeof(buffer));
+    ASSERT_GT(len, 0);
+    decoder.feed(buffer, (size_t)len, [&received](const EstimateRecord &r) {
+      received.push_back(r);
+    });
+  }
+
+  ASSERT_EQ(2U, received[2].sequence);
+  ASSERT_EQ(2000U, received[2].timestamp_us);
+  ASSERT_EQ(0U, transport.getErrorCount());
+  close(slave);
+  close(master);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}